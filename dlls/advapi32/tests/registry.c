@@ -2716,6 +2716,107 @@ static void test_delete_value(void)
        "expect ERROR_FILE_NOT_FOUND, got %i\n", res);
 }
 
+#define QUERY_ITERATIONS 2000
+
+static LONG query_errors;
+
+static DWORD WINAPI query_thread( void *arg )
+{
+    char name[20], value[20];
+    DWORD i, type, name_size, size;
+    LONG res;
+
+    for (i = 0; i < QUERY_ITERATIONS; i++)
+    {
+        size = sizeof(value);
+        res = RegQueryValueExA( hkey_main, "query", NULL, &type, (BYTE *)value, &size );
+        if (res || type != REG_SZ || size != 6 || strcmp( value, "value" ))
+            InterlockedIncrement( &query_errors );
+
+        name_size = sizeof(name);
+        size = sizeof(value);
+        res = RegEnumValueA( hkey_main, 0, name, &name_size, NULL, &type, (BYTE *)value, &size );
+        if (res || strcmp( name, "query" ) || strcmp( value, "value" ))
+            InterlockedIncrement( &query_errors );
+
+        res = RegEnumKeyA( hkey_main, 0, name, sizeof(name) );
+        if (res || strcmp( name, "subkey" ))
+            InterlockedIncrement( &query_errors );
+    }
+    return 0;
+}
+
+static DWORD WINAPI update_thread( void *arg )
+{
+    HANDLE stop = arg;
+    DWORD dw = 0;
+    HKEY hkey;
+
+    /* modify the keys while they are queried */
+    while (WaitForSingleObject( stop, 0 ) == WAIT_TIMEOUT)
+    {
+        RegSetValueExA( hkey_main, "update", 0, REG_DWORD, (const BYTE *)&dw, sizeof(dw) );
+        RegDeleteValueA( hkey_main, "update" );
+        if (!RegCreateKeyA( hkey_main, "update", &hkey ))
+        {
+            RegCloseKey( hkey );
+            RegDeleteKeyA( hkey_main, "update" );
+        }
+        dw++;
+    }
+    return 0;
+}
+
+static void test_concurrent_queries(void)
+{
+    HANDLE threads[16], updater, stop;
+    DWORD i, count, ticks;
+    SYSTEM_INFO si;
+    HKEY hkey;
+    LONG res;
+
+    res = RegSetValueExA( hkey_main, "query", 0, REG_SZ, (const BYTE *)"value", 6 );
+    ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+    res = RegCreateKeyA( hkey_main, "subkey", &hkey );
+    ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+    RegCloseKey( hkey );
+
+    GetSystemInfo( &si );
+
+    /* the throughput should scale with the threads up to the number of CPUs,
+     * when the server runs the queries on worker threads */
+    for (count = 1; count <= sizeof(threads) / sizeof(threads[0]); count *= 2)
+    {
+        query_errors = 0;
+        ticks = GetTickCount();
+        for (i = 0; i < count; i++) threads[i] = CreateThread( NULL, 0, query_thread, NULL, 0, NULL );
+        WaitForMultipleObjects( count, threads, TRUE, INFINITE );
+        ticks = GetTickCount() - ticks;
+        for (i = 0; i < count; i++) CloseHandle( threads[i] );
+
+        ok(!query_errors, "%u threads: %d queries failed\n", count, query_errors);
+        trace( "%u threads: %u queries in %u ms, %u/s\n", count, count * QUERY_ITERATIONS * 3,
+               ticks, ticks ? count * QUERY_ITERATIONS * 3000 / ticks : 0 );
+        if (count >= si.dwNumberOfProcessors * 2) break;
+    }
+
+    /* the queries still see consistent data while another thread updates the keys */
+    query_errors = 0;
+    stop = CreateEventA( NULL, TRUE, FALSE, NULL );
+    updater = CreateThread( NULL, 0, update_thread, stop, 0, NULL );
+    for (i = 0; i < 4; i++) threads[i] = CreateThread( NULL, 0, query_thread, NULL, 0, NULL );
+    WaitForMultipleObjects( 4, threads, TRUE, INFINITE );
+    SetEvent( stop );
+    WaitForSingleObject( updater, INFINITE );
+    for (i = 0; i < 4; i++) CloseHandle( threads[i] );
+    CloseHandle( updater );
+    CloseHandle( stop );
+    ok(!query_errors, "%d queries failed while updating\n", query_errors);
+
+    RegDeleteKeyA( hkey_main, "subkey" );
+    RegDeleteValueA( hkey_main, "query" );
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -2755,6 +2856,7 @@ START_TEST(registry)
     test_rw_order();
     test_deleted_key();
     test_delete_value();
+    test_concurrent_queries();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -19,6 +19,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include "gdi_private.h"
 #include "dibdrv.h"
@@ -466,6 +467,178 @@ static int get_overlap( const dib_info *dst, const RECT *dst_rect,
     return ret;
 }
 
+/* Large operations can be split into horizontal bands that are rendered in
+ * parallel on the thread pool.  This is only enabled when the "Threads" value
+ * of the DIB engine key is set to the number of threads to use, including the
+ * calling thread. */
+
+#define MAX_BAND_THREADS  32
+#define MIN_BAND_ROWS     16
+#define MIN_BAND_PIXELS   (512 * 512)
+
+struct band_work
+{
+    void       (*func)( void *arg, int top, int bottom );
+    void        *arg;
+    int          top;
+    int          height;
+    int          count;    /* number of bands */
+    LONG         next;     /* next band to be claimed */
+    LONG         pending;  /* number of queued workers still running */
+    HANDLE       done;
+};
+
+static int get_band_threads(void)
+{
+    static int threads;
+
+    if (!threads)
+    {
+        int count = get_dib_engine_option( "Threads", 1 );
+
+        threads = max( 1, min( count, MAX_BAND_THREADS ));
+        if (threads > 1) TRACE( "using %d threads for large operations\n", threads );
+    }
+    return threads;
+}
+
+static void run_bands( struct band_work *work )
+{
+    LONG band;
+
+    while ((band = InterlockedIncrement( &work->next ) - 1) < work->count)
+        work->func( work->arg,
+                    work->top + MulDiv( work->height, band, work->count ),
+                    work->top + MulDiv( work->height, band + 1, work->count ));
+}
+
+static DWORD CALLBACK band_worker( void *arg )
+{
+    struct band_work *work = arg;
+
+    run_bands( work );
+    if (!InterlockedDecrement( &work->pending )) SetEvent( work->done );
+    return 0;
+}
+
+/***********************************************************************
+ *           process_bands
+ *
+ * Call func for consecutive bands of rows in [top, bottom), in parallel when
+ * that is enabled and the operation covers enough pixels to be worth it.
+ * Returns FALSE without doing anything if the caller should do the work itself.
+ */
+static BOOL process_bands( void (*func)( void *arg, int top, int bottom ), void *arg,
+                           int top, int bottom, ULONGLONG pixels )
+{
+    struct band_work work;
+    int i, threads = get_band_threads();
+
+    if (threads < 2 || pixels < MIN_BAND_PIXELS) return FALSE;
+    threads = min( threads, (bottom - top) / MIN_BAND_ROWS );
+    if (threads < 2) return FALSE;
+    if (!(work.done = CreateEventW( NULL, TRUE, FALSE, NULL ))) return FALSE;
+
+    work.func    = func;
+    work.arg     = arg;
+    work.top     = top;
+    work.height  = bottom - top;
+    /* several bands per thread so that uneven rows get balanced */
+    work.count   = min( threads * 4, work.height / MIN_BAND_ROWS );
+    work.next    = 0;
+    work.pending = threads - 1;
+
+    for (i = 1; i < threads; i++)
+    {
+        if (QueueUserWorkItem( band_worker, &work, WT_EXECUTEDEFAULT )) continue;
+        /* the remaining bands will be done by the threads we already have */
+        if (InterlockedExchangeAdd( &work.pending, i - threads ) == threads - i) SetEvent( work.done );
+        break;
+    }
+
+    run_bands( &work );
+    WaitForSingleObject( work.done, INFINITE );
+    CloseHandle( work.done );
+    return TRUE;
+}
+
+struct rect_bands
+{
+    const RECT *rects;
+    int         count;
+    void      (*func)( void *arg, const RECT *rc );
+    void       *arg;
+};
+
+static void rect_band_proc( void *arg, int top, int bottom )
+{
+    struct rect_bands *bands = arg;
+    RECT rc;
+    int i;
+
+    for (i = 0; i < bands->count; i++)
+    {
+        rc = bands->rects[i];
+        rc.top = max( rc.top, top );
+        rc.bottom = min( rc.bottom, bottom );
+        if (rc.top < rc.bottom) bands->func( bands->arg, &rc );
+    }
+}
+
+/* call func on the parts of the rectangles that fall into each band */
+static BOOL process_rects_in_bands( const RECT *rects, int count,
+                                    void (*func)( void *arg, const RECT *rc ), void *arg )
+{
+    struct rect_bands bands;
+    ULONGLONG pixels = 0;
+    int i, top, bottom;
+
+    if (get_band_threads() < 2 || !count) return FALSE;
+
+    top = rects[0].top;
+    bottom = rects[0].bottom;
+    for (i = 0; i < count; i++)
+    {
+        pixels += (ULONGLONG)(rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+        top = min( top, rects[i].top );
+        bottom = max( bottom, rects[i].bottom );
+    }
+
+    bands.rects = rects;
+    bands.count = count;
+    bands.func  = func;
+    bands.arg   = arg;
+    return process_bands( rect_band_proc, &bands, top, bottom, pixels );
+}
+
+struct copy_rect_params
+{
+    dib_info       *dst;
+    const RECT     *dst_rect;
+    const dib_info *src;
+    const RECT     *src_rect;
+    int             rop2;
+    DWORD           and;
+    DWORD           xor;
+};
+
+static void solid_rect_band( void *arg, const RECT *rc )
+{
+    struct copy_rect_params *params = arg;
+
+    params->dst->funcs->solid_rects( params->dst, 1, rc, params->and, params->xor );
+}
+
+static void copy_rect_band( void *arg, const RECT *rc )
+{
+    struct copy_rect_params *params = arg;
+    POINT origin;
+
+    origin.x = params->src_rect->left + rc->left - params->dst_rect->left;
+    origin.y = params->src_rect->top  + rc->top  - params->dst_rect->top;
+    params->dst->funcs->copy_rect( params->dst, rc, params->src, &origin, params->rop2, 0 );
+}
+
 static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                         const struct clipped_rects *clipped_rects, INT rop2 )
 {
@@ -473,6 +646,7 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     const RECT *rects;
     int i, count, start, end, overlap;
     DWORD and = 0, xor = 0;
+    struct copy_rect_params params;
 
     if (clipped_rects)
     {
@@ -492,13 +666,26 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     case R2_WHITE: xor = ~0u;
         /* fall through */
     case R2_BLACK:
-        dst->funcs->solid_rects( dst, count, rects, and, xor );
+        params.dst = dst;
+        params.and = and;
+        params.xor = xor;
+        if (!process_rects_in_bands( rects, count, solid_rect_band, &params ))
+            dst->funcs->solid_rects( dst, count, rects, and, xor );
         /* fall through */
     case R2_NOP:
         return;
     }
 
     overlap = get_overlap( dst, dst_rect, src, src_rect );
+    if (!overlap)
+    {
+        params.dst      = dst;
+        params.dst_rect = dst_rect;
+        params.src      = src;
+        params.src_rect = src_rect;
+        params.rop2     = rop2;
+        if (process_rects_in_bands( rects, count, copy_rect_band, &params )) return;
+    }
     if (overlap & OVERLAP_BELOW)
     {
         if (overlap & OVERLAP_RIGHT)  /* right to left, bottom to top */
@@ -552,14 +739,48 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+struct blend_rect_params
+{
+    dib_info       *dst;
+    const RECT     *dst_rect;
+    const dib_info *src;
+    const RECT     *src_rect;
+    BLENDFUNCTION   blend;
+};
+
+static void blend_rect_band( void *arg, const RECT *rc )
+{
+    struct blend_rect_params *params = arg;
+    POINT origin;
+
+    origin.x = params->src_rect->left + rc->left - params->dst_rect->left;
+    origin.y = params->src_rect->top  + rc->top  - params->dst_rect->top;
+    params->dst->funcs->blend_rect( params->dst, rc, params->src, &origin, params->blend );
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
     POINT origin;
     struct clipped_rects clipped_rects;
+    struct blend_rect_params params;
     int i;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
+
+    /* rows depend on each other if the source overlaps the destination */
+    params.dst      = dst;
+    params.dst_rect = dst_rect;
+    params.src      = src;
+    params.src_rect = src_rect;
+    params.blend    = blend;
+    if (!get_overlap( dst, dst_rect, src, src_rect ) &&
+        process_rects_in_bands( clipped_rects.rects, clipped_rects.count, blend_rect_band, &params ))
+    {
+        free_clipped_rects( &clipped_rects );
+        return ERROR_SUCCESS;
+    }
+
     for (i = 0; i < clipped_rects.count; i++)
     {
         origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
@@ -649,13 +870,41 @@ static void get_gradient_triangle_vertices( const GRADIENT_TRIANGLE *tri, const
     bounds->bottom = v[2].y;
 }
 
+struct gradient_rect_params
+{
+    dib_info *dib;
+    TRIVERTEX *v;
+    int        mode;
+    BOOL       ret;
+};
+
+static void gradient_rect_band( void *arg, const RECT *rc )
+{
+    struct gradient_rect_params *params = arg;
+
+    if (!params->dib->funcs->gradient_rect( params->dib, rc, params->v, params->mode ))
+        params->ret = FALSE;
+}
+
 static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
 {
     int i;
     struct clipped_rects clipped_rects;
+    struct gradient_rect_params params;
     BOOL ret = TRUE;
 
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
+
+    params.dib  = dib;
+    params.v    = v;
+    params.mode = mode;
+    params.ret  = TRUE;
+    if (process_rects_in_bands( clipped_rects.rects, clipped_rects.count, gradient_rect_band, &params ))
+    {
+        free_clipped_rects( &clipped_rects );
+        return params.ret;
+    }
+
     for (i = 0; i < clipped_rects.count; i++)
     {
         if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
@@ -796,7 +1045,7 @@ static void set_color_info( const dib_info *dib, BITMAPINFO *info )
         info->bmiHeader.biCompression = BI_BITFIELDS;
         break;
     case 32:
-        if (dib->funcs != &funcs_8888)
+        if (dib->funcs != dib_funcs_8888)
         {
             masks[0] = dib->red_mask;
             masks[1] = dib->green_mask;
@@ -898,7 +1147,7 @@ static BOOL matching_color_info( const dib_info *dib, const BITMAPINFO *info )
     case 32:
     {
         DWORD *masks = (DWORD *)info->bmiColors;
-        if (info->bmiHeader.biCompression == BI_RGB) return dib->funcs == &funcs_8888;
+        if (info->bmiHeader.biCompression == BI_RGB) return dib->funcs == dib_funcs_8888;
         if (info->bmiHeader.biCompression == BI_BITFIELDS)
             return masks[0] == dib->red_mask && masks[1] == dib->green_mask && masks[2] == dib->blue_mask;
         break;
@@ -1142,6 +1391,99 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
 }
 
 
+struct stretch_band_params
+{
+    dib_info             *dst_dib;
+    dib_info             *src_dib;
+    POINT                 dst_start;
+    POINT                 src_start;
+    struct stretch_params v_params;
+    struct stretch_params h_params;
+    BOOL                  vstretch;
+    int                   mode;
+    int                   width;
+    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
+                    const dib_info *src_dib, const POINT *src_start,
+                    const struct stretch_params *params, int mode, BOOL keep_dst);
+};
+
+/***********************************************************************
+ *           stretch_band
+ *
+ * Render the steps [start, end) of the vertical stretch.  The error term is
+ * replayed from the first step so that a band produces exactly the rows the
+ * whole loop would have produced.
+ */
+static void stretch_band( void *arg, int start, int end )
+{
+    const struct stretch_band_params *params = arg;
+    const struct stretch_params *v_params = &params->v_params;
+    POINT dst_start = params->dst_start, src_start = params->src_start;
+    int i, err = v_params->err_start;
+
+    if (params->vstretch)
+    {
+        BOOL need_row = TRUE;
+        RECT last_row, this_row;
+
+        last_row.left = 0;
+        last_row.right = params->width;
+
+        for (i = 0; i < end; i++)
+        {
+            if (i < start)
+                ;  /* only replaying the error term */
+            else if (need_row || i == start)  /* the previous row may belong to another band */
+            {
+                params->row_fn( params->dst_dib, &dst_start, params->src_dib, &src_start,
+                                &params->h_params, params->mode, FALSE );
+                need_row = FALSE;
+            }
+            else
+            {
+                last_row.top = dst_start.y - v_params->dst_inc;
+                last_row.bottom = last_row.top + 1;
+                this_row = last_row;
+                offset_rect( &this_row, 0, v_params->dst_inc );
+                copy_rect( params->dst_dib, &this_row, params->dst_dib, &last_row, NULL, R2_COPYPEN );
+            }
+
+            if (err > 0)
+            {
+                src_start.y += v_params->src_inc;
+                need_row = TRUE;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            dst_start.y += v_params->dst_inc;
+        }
+    }
+    else
+    {
+        int merged_rows = 0;
+        BOOL active = FALSE;
+
+        /* source rows merged into the same destination row must stay in one band */
+        for (i = 0; i < v_params->length && (i < end || merged_rows); i++)
+        {
+            if (i >= start && !merged_rows) active = TRUE;
+            if (active && (params->mode != STRETCH_DELETESCANS || !merged_rows))
+                params->row_fn( params->dst_dib, &dst_start, params->src_dib, &src_start,
+                                &params->h_params, params->mode, merged_rows != 0 );
+            merged_rows++;
+
+            if (err > 0)
+            {
+                dst_start.y += v_params->dst_inc;
+                merged_rows = 0;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            src_start.y += v_params->src_inc;
+        }
+    }
+}
+
 DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
                           const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
                           INT mode )
@@ -1151,11 +1493,8 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     RECT rect;
     BOOL hstretch, vstretch;
     struct stretch_params v_params, h_params;
-    int err;
+    struct stretch_band_params params;
     DWORD ret;
-    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
-                    const dib_info *src_dib, const POINT *src_start,
-                    const struct stretch_params *params, int mode, BOOL keep_dst);
 
     TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
           dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
@@ -1189,64 +1528,20 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     dst_start.x -= dst->visrect.left;
     dst_start.y -= dst->visrect.top;
 
-    err = v_params.err_start;
-
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
-
-    if (vstretch)
-    {
-        BOOL need_row = TRUE;
-        RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
-        last_row.left = 0;
-        last_row.right = dst->visrect.right - dst->visrect.left;
-
-        while (v_params.length--)
-        {
-            if (need_row)
-            {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
-                need_row = FALSE;
-            }
-            else
-            {
-                last_row.top = dst_start.y - v_params.dst_inc;
-                last_row.bottom = last_row.top + 1;
-                this_row = last_row;
-                offset_rect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
-            }
-
-            if (err > 0)
-            {
-                src_start.y += v_params.src_inc;
-                need_row = TRUE;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            dst_start.y += v_params.dst_inc;
-        }
-    }
-    else
-    {
-        int merged_rows = 0;
-
-        while (v_params.length--)
-        {
-            if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
-            merged_rows++;
-
-            if (err > 0)
-            {
-                dst_start.y += v_params.dst_inc;
-                merged_rows = 0;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            src_start.y += v_params.src_inc;
-        }
-    }
+    params.dst_dib   = &dst_dib;
+    params.src_dib   = &src_dib;
+    params.dst_start = dst_start;
+    params.src_start = src_start;
+    params.v_params  = v_params;
+    params.h_params  = h_params;
+    params.vstretch  = vstretch;
+    params.mode      = (vstretch && hstretch) ? STRETCH_DELETESCANS : mode;
+    params.width     = dst->visrect.right - dst->visrect.left;
+    params.row_fn    = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+
+    if (!process_bands( stretch_band, &params, 0, v_params.length,
+                        (ULONGLONG)v_params.length * h_params.length ))
+        stretch_band( &params, 0, v_params.length );
 
     /* update coordinates, the destination rectangle is always stored at 0,0 */
     *src = *dst;
@@ -1404,7 +1699,7 @@ BOOL dibdrv_GradientFill( PHYSDEV dev, TRIVERTEX *vert_array, ULONG nvert,
         {
             get_gradient_hrect_vertices( rect, vert_array, pts, vert, &bounds );
             /* Windows bug: no alpha on a8r8g8b8 created with bitfields */
-            if (pdev->dib.funcs == &funcs_8888 && pdev->dib.compression == BI_BITFIELDS)
+            if (pdev->dib.funcs == dib_funcs_8888 && pdev->dib.compression == BI_BITFIELDS)
                 vert[0].Alpha = vert[1].Alpha = 0;
             add_clipped_bounds( pdev, &bounds, pdev->clip );
             gradient_rect( &pdev->dib, vert, mode, pdev->clip, &bounds );
@@ -1416,7 +1711,7 @@ BOOL dibdrv_GradientFill( PHYSDEV dev, TRIVERTEX *vert_array, ULONG nvert,
         {
             get_gradient_vrect_vertices( rect, vert_array, pts, vert, &bounds );
             /* Windows bug: no alpha on a8r8g8b8 created with bitfields */
-            if (pdev->dib.funcs == &funcs_8888 && pdev->dib.compression == BI_BITFIELDS)
+            if (pdev->dib.funcs == dib_funcs_8888 && pdev->dib.compression == BI_BITFIELDS)
                 vert[0].Alpha = vert[1].Alpha = 0;
             add_clipped_bounds( pdev, &bounds, pdev->clip );
             gradient_rect( &pdev->dib, vert, mode, pdev->clip, &bounds );
@@ -1428,7 +1723,7 @@ BOOL dibdrv_GradientFill( PHYSDEV dev, TRIVERTEX *vert_array, ULONG nvert,
         {
             get_gradient_triangle_vertices( tri, vert_array, pts, vert, &bounds );
             /* Windows bug: no alpha on a8r8g8b8 created with bitfields */
-            if (pdev->dib.funcs == &funcs_8888 && pdev->dib.compression == BI_BITFIELDS)
+            if (pdev->dib.funcs == dib_funcs_8888 && pdev->dib.compression == BI_BITFIELDS)
                 vert[0].Alpha = vert[1].Alpha = vert[2].Alpha = 0;
             add_clipped_bounds( pdev, &bounds, pdev->clip );
             if (!gradient_rect( &pdev->dib, vert, mode, pdev->clip, &bounds )) ret = FALSE;
@@ -21,6 +21,7 @@
 #include <assert.h>
 
 #include "gdi_private.h"
+#include "winreg.h"
 #include "dibdrv.h"
 
 #include "wine/exception.h"
@@ -106,9 +107,9 @@ static void init_dib_info(dib_info *dib, const BITMAPINFOHEADER *bi, const DWORD
         init_bit_fields(dib, bit_fields);
 
         if(dib->red_mask == 0xff0000 && dib->green_mask == 0x00ff00 && dib->blue_mask == 0x0000ff)
-            dib->funcs = &funcs_8888;
+            dib->funcs = dib_funcs_8888;
         else
-            dib->funcs = &funcs_32;
+            dib->funcs = dib_funcs_32;
         break;
 
     case 24:
@@ -259,7 +260,7 @@ int get_clipped_rects( const dib_info *dib, const RECT *rc, HRGN clip, struct cl
 {
     const WINEREGION *region;
     RECT rect, *out = clip_rects->buffer;
-    int i;
+    int i, end;
 
     init_clipped_rects( clip_rects );
 
@@ -279,17 +280,23 @@ int get_clipped_rects( const dib_info *dib, const RECT *rc, HRGN clip, struct cl
 
     if (!(region = get_wine_region( clip ))) return 0;
 
-    for (i = 0; i < region->numRects; i++)
+    /* only look at the bands and the parts of them that overlap the rectangle */
+    for (i = find_region_band( region, 0, rect.top ); i < region->numRects; i = end)
     {
         if (region->rects[i].top >= rect.bottom) break;
-        if (!intersect_rect( out, &rect, &region->rects[i] )) continue;
-        out++;
-        if (out == &clip_rects->buffer[sizeof(clip_rects->buffer) / sizeof(RECT)])
+        end = find_region_band( region, i, region->rects[i].bottom );
+        for (i = find_region_rect( region, i, end, rect.left ); i < end; i++)
         {
-            clip_rects->rects = HeapAlloc( GetProcessHeap(), 0, region->numRects * sizeof(RECT) );
-            if (!clip_rects->rects) return 0;
-            memcpy( clip_rects->rects, clip_rects->buffer, (out - clip_rects->buffer) * sizeof(RECT) );
-            out = clip_rects->rects + (out - clip_rects->buffer);
+            if (region->rects[i].left >= rect.right) break;
+            if (!intersect_rect( out, &rect, &region->rects[i] )) continue;
+            out++;
+            if (out == &clip_rects->buffer[sizeof(clip_rects->buffer) / sizeof(RECT)])
+            {
+                clip_rects->rects = HeapAlloc( GetProcessHeap(), 0, region->numRects * sizeof(RECT) );
+                if (!clip_rects->rects) return 0;
+                memcpy( clip_rects->rects, clip_rects->buffer, (out - clip_rects->buffer) * sizeof(RECT) );
+                out = clip_rects->rects + (out - clip_rects->buffer);
+            }
         }
     }
     release_wine_region( clip );
@@ -320,6 +327,27 @@ void add_clipped_bounds( dibdrv_physdev *dev, const RECT *rect, HRGN clip )
 /**********************************************************************
  *	     dibdrv_CreateDC
  */
+/***********************************************************************
+ *           get_dib_engine_option
+ *
+ * Read a numeric option of the DIB engine, stored as a string.
+ */
+int get_dib_engine_option( const char *name, int def )
+{
+    char buffer[16] = "";
+    DWORD size = sizeof(buffer) - 1;
+    HKEY hkey;
+    int ret = def;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\DIB Engine */
+    if (!RegOpenKeyA( HKEY_CURRENT_USER, "Software\\Wine\\DIB Engine", &hkey ))
+    {
+        if (!RegQueryValueExA( hkey, name, NULL, NULL, (BYTE *)buffer, &size )) ret = atoi( buffer );
+        RegCloseKey( hkey );
+    }
+    return ret;
+}
+
 static BOOL dibdrv_CreateDC( PHYSDEV *dev, LPCWSTR driver, LPCWSTR device,
                              LPCWSTR output, const DEVMODEW *data )
 {
@@ -19,6 +19,8 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+
 #include "gdi_private.h"
 #include "dibdrv.h"
 
@@ -43,6 +45,19 @@ enum glyph_type
 #define GLYPH_CACHE_PAGE_SIZE  0x100
 #define GLYPH_CACHE_PAGES      (0x10000 / GLYPH_CACHE_PAGE_SIZE)
 
+/* identity of a realized font in the shared glyph cache */
+struct shared_font_key
+{
+    LOGFONTW              lf;
+    XFORM                 xform;
+    UINT                  aa_flags;
+    DWORD                 file_size;   /* size of the font data */
+    DWORD                 checksum;    /* checksum adjustment from the 'head' table */
+    LONG                  height;
+    LONG                  ascent;
+    LONG                  ave_width;
+};
+
 struct cached_font
 {
     struct list           entry;
@@ -52,6 +67,10 @@ struct cached_font
     XFORM                 xform;
     UINT                  aa_flags;
     struct cached_glyph **glyphs[GLYPH_NBTYPES][GLYPH_CACHE_PAGES];
+    int                   shared_state;  /* 0: key not computed yet, 1: key valid, -1: not shareable */
+    struct shared_font_key shared_key;
+    DWORD                 shared_font;   /* offset of the font in the shared cache */
+    DWORD                 shared_gen;    /* shared cache generation that offset belongs to */
 };
 
 static struct list font_cache = LIST_INIT( font_cache );
@@ -499,6 +518,9 @@ static struct cached_font *add_cached_font( HDC hdc, HFONT hfont, UINT aa_flags
     font.lf.lfWidth = abs( font.lf.lfWidth );
     font.aa_flags = aa_flags;
     font.hash = font_cache_hash( &font );
+    font.shared_state = 0;
+    font.shared_font = 0;
+    font.shared_gen = 0;
 
     EnterCriticalSection( &font_cache_cs );
     LIST_FOR_EACH_ENTRY( ptr, &font_cache, struct cached_font, entry )
@@ -588,6 +610,296 @@ static struct cached_glyph *get_cached_glyph( struct cached_font *font, UINT ind
     return font->glyphs[type][page][index % GLYPH_CACHE_PAGE_SIZE];
 }
 
+/* Glyph bitmaps can optionally be shared between all the processes of a
+ * prefix through a named section, so that a new process doesn't have to
+ * rasterize again the glyphs that others have already rendered.  This is
+ * enabled by setting the "GlyphCache" value of the DIB engine key to the size
+ * of the section in megabytes.
+ * The section is a bump allocator protected by a named mutex; when it fills
+ * up, everything is dropped and the generation counter is incremented.
+ * Records are chained from the newest to the oldest, so the offsets in a
+ * chain are strictly decreasing. Nothing read from the section is trusted:
+ * offsets and sizes are checked against the size of the local view, and the
+ * cache is flushed if they don't make sense. */
+
+#define SHARED_CACHE_MAGIC      0x63796c67  /* "glyc" */
+#define SHARED_FONT_BUCKETS     64
+#define SHARED_GLYPH_BUCKETS    4096
+#define MS_HEAD_TAG             0x64616568  /* 'head' */
+
+struct shared_cache_header
+{
+    DWORD magic;
+    DWORD size;         /* size of the whole section */
+    DWORD generation;   /* incremented every time the cache is flushed */
+    DWORD pos;          /* offset of the free space */
+    DWORD fonts[SHARED_FONT_BUCKETS];
+    DWORD glyphs[SHARED_GLYPH_BUCKETS];
+};
+
+struct shared_font
+{
+    DWORD                  next;
+    DWORD                  hash;
+    struct shared_font_key key;
+};
+
+struct shared_glyph
+{
+    DWORD                  next;
+    DWORD                  font;    /* offset of the shared_font */
+    DWORD                  index;
+    DWORD                  type;
+    GLYPHMETRICS           metrics;
+    DWORD                  size;
+    BYTE                   bits[1];
+};
+
+static struct shared_cache_header *shared_cache;
+static DWORD shared_cache_size;  /* size of the view of the section */
+static HANDLE shared_cache_mutex;
+
+static const WCHAR shared_cache_nameW[] =
+    {'_','_','w','i','n','e','_','g','l','y','p','h','_','c','a','c','h','e',0};
+static const WCHAR shared_cache_mutexW[] =
+    {'_','_','w','i','n','e','_','g','l','y','p','h','_','c','a','c','h','e','_','m','u','t','e','x',0};
+
+static void flush_shared_cache( struct shared_cache_header *cache )
+{
+    memset( cache->fonts, 0, sizeof(cache->fonts) );
+    memset( cache->glyphs, 0, sizeof(cache->glyphs) );
+    cache->magic = SHARED_CACHE_MAGIC;
+    cache->size = shared_cache_size;
+    cache->pos = sizeof(*cache);
+    cache->generation++;
+}
+
+static struct shared_cache_header *get_shared_cache(void)
+{
+    static BOOL init_done;
+    struct shared_cache_header *cache;
+    MEMORY_BASIC_INFORMATION info;
+    HANDLE mapping, mutex;
+    int size;
+
+    if (init_done) return shared_cache;
+
+    EnterCriticalSection( &font_cache_cs );
+    if (init_done) goto done;
+    init_done = TRUE;
+
+    if ((size = get_dib_engine_option( "GlyphCache", 0 )) <= 0) goto done;
+    size = min( size, 1024 ) * 1024 * 1024;
+
+    if (!(mutex = CreateMutexW( NULL, FALSE, shared_cache_mutexW ))) goto done;
+    if (!(mapping = CreateFileMappingW( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size,
+                                        shared_cache_nameW )))
+    {
+        CloseHandle( mutex );
+        goto done;
+    }
+    /* the section may have been created by another process with a different size */
+    cache = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, 0 );
+    CloseHandle( mapping );
+    if (!cache || !VirtualQuery( cache, &info, sizeof(info) ) || info.RegionSize < sizeof(*cache))
+    {
+        if (cache) UnmapViewOfFile( cache );
+        CloseHandle( mutex );
+        goto done;
+    }
+    shared_cache_size = info.RegionSize;
+
+    WaitForSingleObject( mutex, INFINITE );
+    if (cache->magic != SHARED_CACHE_MAGIC || cache->size != shared_cache_size) flush_shared_cache( cache );
+    ReleaseMutex( mutex );
+
+    TRACE( "using %u byte shared glyph cache\n", shared_cache_size );
+    shared_cache_mutex = mutex;
+    shared_cache = cache;
+done:
+    LeaveCriticalSection( &font_cache_cs );
+    return shared_cache;
+}
+
+static void lock_shared_cache(void)
+{
+    struct shared_cache_header *cache = shared_cache;
+
+    /* if the previous owner died, the cache may be inconsistent */
+    if (WaitForSingleObject( shared_cache_mutex, INFINITE ) == WAIT_ABANDONED ||
+        cache->magic != SHARED_CACHE_MAGIC || cache->size != shared_cache_size ||
+        cache->pos < sizeof(*cache) || cache->pos > shared_cache_size || (cache->pos & 7))
+        flush_shared_cache( cache );
+}
+
+/* get a record of the shared cache from its offset; cache must be locked */
+static void *get_shared_record( DWORD offset, DWORD size, DWORD prev )
+{
+    if (offset < sizeof(*shared_cache) || offset >= prev || (offset & 7) ||
+        size > shared_cache_size - offset)
+    {
+        WARN( "corrupted shared glyph cache, flushing\n" );
+        flush_shared_cache( shared_cache );
+        return NULL;
+    }
+    return (char *)shared_cache + offset;
+}
+
+static void *alloc_shared_cache( DWORD size )
+{
+    struct shared_cache_header *cache = shared_cache;
+    void *ret;
+
+    size = (size + 7) & ~7;
+    if (size > shared_cache_size - sizeof(*cache)) return NULL;
+    if (size > shared_cache_size - cache->pos)
+    {
+        TRACE( "shared glyph cache full, flushing\n" );
+        flush_shared_cache( cache );
+    }
+    ret = (char *)cache + cache->pos;
+    cache->pos += size;
+    return ret;
+}
+
+static DWORD shared_key_hash( const void *key, SIZE_T size )
+{
+    const BYTE *ptr = key;
+    DWORD hash = 2166136261u;
+
+    while (size--) hash = (hash ^ *ptr++) * 16777619;
+    return hash;
+}
+
+/* compute the identity of the realized font, which must not depend on the process */
+static BOOL init_shared_font_key( HDC hdc, struct cached_font *font )
+{
+    struct shared_font_key *key = &font->shared_key;
+    TEXTMETRICW tm;
+    DWORD checksum;
+
+    memset( key, 0, sizeof(*key) );
+    memcpy( &key->lf, &font->lf, FIELD_OFFSET( LOGFONTW, lfFaceName ));
+    lstrcpynW( key->lf.lfFaceName, font->lf.lfFaceName, LF_FACESIZE );
+    struprW( key->lf.lfFaceName );
+    key->xform = font->xform;
+    key->aa_flags = font->aa_flags;
+
+    /* only outline fonts are worth sharing, and they have a 'head' table */
+    if ((key->file_size = GetFontData( hdc, 0, 0, NULL, 0 )) == GDI_ERROR) return FALSE;
+    if (GetFontData( hdc, MS_HEAD_TAG, 8, &checksum, sizeof(checksum) ) != sizeof(checksum)) return FALSE;
+    if (!GetTextMetricsW( hdc, &tm )) return FALSE;
+    key->checksum  = checksum;
+    key->height    = tm.tmHeight;
+    key->ascent    = tm.tmAscent;
+    key->ave_width = tm.tmAveCharWidth;
+    return TRUE;
+}
+
+/* return the offset of the font in the shared cache, adding it if needed; cache must be locked */
+static DWORD get_shared_font( struct cached_font *font, BOOL create )
+{
+    struct shared_cache_header *cache = shared_cache;
+    struct shared_font *shared;
+    DWORD hash, offset, prev;
+
+    if (font->shared_font && font->shared_gen == cache->generation) return font->shared_font;
+
+    hash = shared_key_hash( &font->shared_key, sizeof(font->shared_key) );
+    for (offset = cache->fonts[hash % SHARED_FONT_BUCKETS], prev = cache->pos; offset;
+         prev = offset, offset = shared->next)
+    {
+        if (!(shared = get_shared_record( offset, sizeof(*shared), prev ))) return 0;
+        if (shared->hash == hash && !memcmp( &shared->key, &font->shared_key, sizeof(shared->key) ))
+            goto done;
+    }
+    if (!create || !(shared = alloc_shared_cache( sizeof(*shared) ))) return 0;
+
+    shared->hash = hash;
+    shared->key  = font->shared_key;
+    shared->next = cache->fonts[hash % SHARED_FONT_BUCKETS];
+    offset = (char *)shared - (char *)cache;
+    cache->fonts[hash % SHARED_FONT_BUCKETS] = offset;
+done:
+    font->shared_font = offset;
+    font->shared_gen  = cache->generation;
+    return offset;
+}
+
+static inline DWORD shared_glyph_bucket( DWORD font, UINT index, enum glyph_type type )
+{
+    return (font * 31 + index * GLYPH_NBTYPES + type) % SHARED_GLYPH_BUCKETS;
+}
+
+static BOOL use_shared_cache( HDC hdc, struct cached_font *font )
+{
+    if (!get_shared_cache()) return FALSE;
+    if (!font->shared_state) font->shared_state = init_shared_font_key( hdc, font ) ? 1 : -1;
+    return font->shared_state > 0;
+}
+
+static struct cached_glyph *find_shared_glyph( struct cached_font *font, UINT index, UINT flags )
+{
+    enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
+    struct shared_glyph *shared;
+    struct cached_glyph *glyph = NULL;
+    DWORD font_offset, offset, prev;
+
+    lock_shared_cache();
+    if (!(font_offset = get_shared_font( font, FALSE ))) goto done;
+
+    for (offset = shared_cache->glyphs[shared_glyph_bucket( font_offset, index, type )],
+         prev = shared_cache->pos; offset; prev = offset, offset = shared->next)
+    {
+        if (!(shared = get_shared_record( offset, FIELD_OFFSET( struct shared_glyph, bits ), prev ))) break;
+        if (shared->font != font_offset || shared->index != index || shared->type != type) continue;
+        if (shared->size > shared_cache_size - offset - FIELD_OFFSET( struct shared_glyph, bits ))
+        {
+            WARN( "corrupted shared glyph cache, flushing\n" );
+            flush_shared_cache( shared_cache );
+            break;
+        }
+
+        if ((glyph = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( struct cached_glyph, bits[shared->size] ))))
+        {
+            glyph->metrics = shared->metrics;
+            memcpy( glyph->bits, shared->bits, shared->size );
+        }
+        break;
+    }
+done:
+    ReleaseMutex( shared_cache_mutex );
+    return glyph;
+}
+
+static void add_shared_glyph( struct cached_font *font, UINT index, UINT flags,
+                              const struct cached_glyph *glyph, DWORD size )
+{
+    enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
+    struct shared_glyph *shared;
+    DWORD font_offset, bucket, generation;
+
+    lock_shared_cache();
+    if (!(font_offset = get_shared_font( font, TRUE ))) goto done;
+
+    generation = shared_cache->generation;
+    if (!(shared = alloc_shared_cache( FIELD_OFFSET( struct shared_glyph, bits[size] )))) goto done;
+    /* allocating may have flushed the cache, including the font */
+    if (shared_cache->generation != generation) goto done;
+
+    shared->font    = font_offset;
+    shared->index   = index;
+    shared->type    = type;
+    shared->metrics = glyph->metrics;
+    shared->size    = size;
+    memcpy( shared->bits, glyph->bits, size );
+    bucket = shared_glyph_bucket( font_offset, index, type );
+    shared->next = shared_cache->glyphs[bucket];
+    shared_cache->glyphs[bucket] = (char *)shared - (char *)shared_cache;
+done:
+    ReleaseMutex( shared_cache_mutex );
+}
+
 /**********************************************************************
  *                 get_text_bkgnd_masks
  *
@@ -684,6 +996,10 @@ static struct cached_glyph *cache_glyph_bitmap( HDC hdc, struct cached_font *fon
     int pad = 0, stride, bit_count;
     GLYPHMETRICS metrics;
     struct cached_glyph *glyph;
+    BOOL shared = use_shared_cache( hdc, font );
+
+    if (shared && (glyph = find_shared_glyph( font, index, flags )))
+        return add_cached_glyph( font, index, flags, glyph );
 
     if (flags & ETO_GLYPH_INDEX) ggo_flags |= GGO_GLYPH_INDEX;
     indices[0] = index;
@@ -733,6 +1049,7 @@ static struct cached_glyph *cache_glyph_bitmap( HDC hdc, struct cached_font *fon
 
 done:
     glyph->metrics = metrics;
+    if (shared) add_shared_glyph( font, indices[0], flags, glyph, size );
     return add_cached_glyph( font, index, flags, glyph );
 }
 
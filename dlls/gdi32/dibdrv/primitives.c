@@ -20,6 +20,16 @@
 
 #include <assert.h>
 
+/* the SSE2 primitives are selected at run time, so build them even when the
+ * compiler doesn't target SSE2 by default, as long as it supports per-function
+ * target attributes */
+#if defined(__x86_64__) || (defined(__i386__) && (defined(__SSE2__) || defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))))
+#define HAVE_SSE2_PRIMITIVES
+#include <emmintrin.h>
+#define SSE2_TARGET __attribute__((target("sse2")))
+#endif
+
 #include "gdi_private.h"
 #include "dibdrv.h"
 
@@ -1811,7 +1821,7 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
     case 32:
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == dib_funcs_8888)
         {
             if (src->stride > 0 && src->stride == dst->stride && !pad_size)
                 memcpy(dst_start, src_start, (src_rect->bottom - src_rect->top) * src->stride);
@@ -2051,7 +2061,7 @@ static void convert_to_32(dib_info *dst, const dib_info *src, const RECT *src_re
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
 
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == dib_funcs_8888)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
@@ -2318,7 +2328,7 @@ static void convert_to_24(dib_info *dst, const dib_info *src, const RECT *src_re
     case 32:
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == dib_funcs_8888)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
@@ -2563,7 +2573,7 @@ static void convert_to_555(dib_info *dst, const dib_info *src, const RECT *src_r
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
 
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == dib_funcs_8888)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
@@ -2806,7 +2816,7 @@ static void convert_to_16(dib_info *dst, const dib_info *src, const RECT *src_re
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
 
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == dib_funcs_8888)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
@@ -3085,7 +3095,7 @@ static void convert_to_8(dib_info *dst, const dib_info *src, const RECT *src_rec
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
 
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == dib_funcs_8888)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
@@ -3347,7 +3357,7 @@ static void convert_to_4(dib_info *dst, const dib_info *src, const RECT *src_rec
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
 
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == dib_funcs_8888)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
@@ -3735,7 +3745,7 @@ static void convert_to_1(dib_info *dst, const dib_info *src, const RECT *src_rec
     {
         DWORD *src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top), *src_pixel;
 
-        if(src->funcs == &funcs_8888)
+        if(src->funcs == dib_funcs_8888)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
@@ -6225,6 +6235,211 @@ static void shrink_row_null(const dib_info *dst_dib, const POINT *dst_start,
     return;
 }
 
+#ifdef HAVE_SSE2_PRIMITIVES
+
+/* SSE2 versions of the 32-bpp primitives that dominate full-screen repaints.
+ * They are selected by init_dib_primitives() and must give exactly the same
+ * results as the generic versions, including for bogus premultiplied data. */
+
+static SSE2_TARGET void solid_rects_32_sse2(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
+{
+    const __m128i and_vec = _mm_set1_epi32( and ), xor_vec = _mm_set1_epi32( xor );
+    DWORD *start;
+    int x, y, i, width;
+
+    for(i = 0; i < num; i++, rc++)
+    {
+        assert( !is_rect_empty( rc ));
+
+        start = get_pixel_ptr_32(dib, rc->left, rc->top);
+        width = rc->right - rc->left;
+        if (!and)
+        {
+            for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
+                memset_32( start, xor, width );
+            continue;
+        }
+        for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
+        {
+            for (x = 0; x + 4 <= width; x += 4)
+            {
+                __m128i val = _mm_loadu_si128( (__m128i *)(start + x) );
+                val = _mm_xor_si128( _mm_and_si128( val, and_vec ), xor_vec );
+                _mm_storeu_si128( (__m128i *)(start + x), val );
+            }
+            for (; x < width; x++) do_rop_32( start + x, and, xor );
+        }
+    }
+}
+
+static SSE2_TARGET void do_rop_codes_line_32_sse2(DWORD *dst, const DWORD *src, struct rop_codes *codes, int len)
+{
+    const __m128i a1 = _mm_set1_epi32( codes->a1 ), a2 = _mm_set1_epi32( codes->a2 );
+    const __m128i x1 = _mm_set1_epi32( codes->x1 ), x2 = _mm_set1_epi32( codes->x2 );
+    int x;
+
+    /* going forward, dst never overtakes the part of src that is still to be read */
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i d = _mm_loadu_si128( (__m128i *)(dst + x) );
+        __m128i and = _mm_xor_si128( _mm_and_si128( s, a1 ), a2 );
+        __m128i xor = _mm_xor_si128( _mm_and_si128( s, x1 ), x2 );
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_xor_si128( _mm_and_si128( d, and ), xor ));
+    }
+    do_rop_codes_line_32( dst + x, src + x, codes, len - x );
+}
+
+static SSE2_TARGET void copy_rect_32_sse2(const dib_info *dst, const RECT *rc,
+                              const dib_info *src, const POINT *origin, int rop2, int overlap)
+{
+    DWORD *dst_start, *src_start;
+    struct rop_codes codes;
+    int y, dst_stride, src_stride;
+
+    if (rop2 == R2_COPYPEN || (overlap & OVERLAP_RIGHT))
+    {
+        copy_rect_32( dst, rc, src, origin, rop2, overlap );
+        return;
+    }
+
+    if (overlap & OVERLAP_BELOW)
+    {
+        dst_start = get_pixel_ptr_32(dst, rc->left, rc->bottom - 1);
+        src_start = get_pixel_ptr_32(src, origin->x, origin->y + rc->bottom - rc->top - 1);
+        dst_stride = -dst->stride / 4;
+        src_stride = -src->stride / 4;
+    }
+    else
+    {
+        dst_start = get_pixel_ptr_32(dst, rc->left, rc->top);
+        src_start = get_pixel_ptr_32(src, origin->x, origin->y);
+        dst_stride = dst->stride / 4;
+        src_stride = src->stride / 4;
+    }
+
+    get_rop_codes( rop2, &codes );
+    for (y = rc->top; y < rc->bottom; y++, dst_start += dst_stride, src_start += src_stride)
+        do_rop_codes_line_32_sse2( dst_start, src_start, &codes, rc->right - rc->left );
+}
+
+/* exact floor( val / 255 ) for every unsigned 16-bit lane */
+static inline SSE2_TARGET __m128i div255_epu16( __m128i val )
+{
+    return _mm_srli_epi16( _mm_mulhi_epu16( val, _mm_set1_epi16( (short)0x8081 )), 7 );
+}
+
+static inline SSE2_TARGET __m128i broadcast_alpha( __m128i val )
+{
+    return _mm_shufflehi_epi16( _mm_shufflelo_epi16( val, 0xff ), 0xff );
+}
+
+/* the generic code ORs the shifted channel sums together, so the carry out of
+ * a channel lands in the low bit of the next one and the top one is lost */
+static inline SSE2_TARGET __m128i pack_channels( __m128i lo, __m128i hi )
+{
+    const __m128i mask = _mm_set1_epi16( 0xff );
+
+    lo = _mm_or_si128( _mm_and_si128( lo, mask ), _mm_slli_epi64( _mm_srli_epi16( lo, 8 ), 16 ));
+    hi = _mm_or_si128( _mm_and_si128( hi, mask ), _mm_slli_epi64( _mm_srli_epi16( hi, 8 ), 16 ));
+    return _mm_packus_epi16( lo, hi );
+}
+
+/* blend_argb() on two pixels unpacked to 16-bit channels */
+static inline SSE2_TARGET __m128i blend_argb_sse2( __m128i dst, __m128i src )
+{
+    __m128i inv = _mm_sub_epi16( _mm_set1_epi16( 255 ), broadcast_alpha( src ));
+
+    dst = _mm_add_epi16( _mm_mullo_epi16( dst, inv ), _mm_set1_epi16( 127 ));
+    return _mm_add_epi16( src, div255_epu16( dst ));
+}
+
+/* blend_color() on two pixels unpacked to 16-bit channels */
+static inline SSE2_TARGET __m128i blend_color_sse2( __m128i dst, __m128i src, __m128i alpha )
+{
+    __m128i inv = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+
+    src = _mm_add_epi16( _mm_mullo_epi16( src, alpha ), _mm_mullo_epi16( dst, inv ));
+    return div255_epu16( _mm_add_epi16( src, _mm_set1_epi16( 127 )));
+}
+
+enum blend_op
+{
+    BLEND_ARGB,
+    BLEND_ARGB_ALPHA,
+    BLEND_CONSTANT_ALPHA,
+    BLEND_NO_SRC_ALPHA
+};
+
+static inline SSE2_TARGET __m128i blend_pixels_sse2( __m128i dst, __m128i src, enum blend_op op, __m128i alpha )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i dst_lo = _mm_unpacklo_epi8( dst, zero ), dst_hi = _mm_unpackhi_epi8( dst, zero );
+    __m128i src_lo, src_hi;
+
+    if (op == BLEND_NO_SRC_ALPHA) src = _mm_or_si128( src, _mm_set1_epi32( 0xff000000 ));
+    src_lo = _mm_unpacklo_epi8( src, zero );
+    src_hi = _mm_unpackhi_epi8( src, zero );
+
+    switch (op)
+    {
+    case BLEND_ARGB_ALPHA:
+        src_lo = div255_epu16( _mm_add_epi16( _mm_mullo_epi16( src_lo, alpha ), _mm_set1_epi16( 127 )));
+        src_hi = div255_epu16( _mm_add_epi16( _mm_mullo_epi16( src_hi, alpha ), _mm_set1_epi16( 127 )));
+        /* fall through */
+    case BLEND_ARGB:
+        dst_lo = blend_argb_sse2( dst_lo, src_lo );
+        dst_hi = blend_argb_sse2( dst_hi, src_hi );
+        break;
+    default:
+        dst_lo = blend_color_sse2( dst_lo, src_lo, alpha );
+        dst_hi = blend_color_sse2( dst_hi, src_hi, alpha );
+        break;
+    }
+    return pack_channels( dst_lo, dst_hi );
+}
+
+static SSE2_TARGET void blend_rect_8888_sse2(const dib_info *dst, const RECT *rc,
+                                 const dib_info *src, const POINT *origin, BLENDFUNCTION blend)
+{
+    DWORD *src_ptr = get_pixel_ptr_32( src, origin->x, origin->y );
+    DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
+    const __m128i alpha = _mm_set1_epi16( blend.SourceConstantAlpha );
+    int x, y, width = rc->right - rc->left;
+    enum blend_op op;
+
+    if (blend.AlphaFormat & AC_SRC_ALPHA)
+        op = (blend.SourceConstantAlpha == 255) ? BLEND_ARGB : BLEND_ARGB_ALPHA;
+    else if (src->compression == BI_RGB)
+        op = BLEND_CONSTANT_ALPHA;
+    else
+        op = BLEND_NO_SRC_ALPHA;
+
+    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+    {
+        for (x = 0; x + 4 <= width; x += 4)
+        {
+            __m128i s = _mm_loadu_si128( (const __m128i *)(src_ptr + x) );
+            __m128i d = _mm_loadu_si128( (__m128i *)(dst_ptr + x) );
+            _mm_storeu_si128( (__m128i *)(dst_ptr + x), blend_pixels_sse2( d, s, op, alpha ));
+        }
+        if (x < width)
+        {
+            DWORD src_tail[4] = { 0 }, dst_tail[4] = { 0 };
+            __m128i res;
+
+            memcpy( src_tail, src_ptr + x, (width - x) * 4 );
+            memcpy( dst_tail, dst_ptr + x, (width - x) * 4 );
+            res = blend_pixels_sse2( _mm_loadu_si128( (__m128i *)dst_tail ),
+                                     _mm_loadu_si128( (__m128i *)src_tail ), op, alpha );
+            _mm_storeu_si128( (__m128i *)dst_tail, res );
+            memcpy( dst_ptr + x, dst_tail, (width - x) * 4 );
+        }
+    }
+}
+
+#endif  /* HAVE_SSE2_PRIMITIVES */
+
 const primitive_funcs funcs_8888 =
 {
     solid_rects_32,
@@ -6265,6 +6480,54 @@ const primitive_funcs funcs_32 =
     shrink_row_32
 };
 
+#ifdef HAVE_SSE2_PRIMITIVES
+
+static const primitive_funcs funcs_8888_sse2 =
+{
+    solid_rects_32_sse2,
+    solid_line_32,
+    pattern_rects_32,
+    copy_rect_32_sse2,
+    blend_rect_8888_sse2,
+    gradient_rect_8888,
+    draw_glyph_8888,
+    draw_subpixel_glyph_8888,
+    get_pixel_32,
+    colorref_to_pixel_888,
+    pixel_to_colorref_888,
+    convert_to_8888,
+    create_rop_masks_32,
+    create_dither_masks_null,
+    stretch_row_32,
+    shrink_row_32
+};
+
+static const primitive_funcs funcs_32_sse2 =
+{
+    solid_rects_32_sse2,
+    solid_line_32,
+    pattern_rects_32,
+    copy_rect_32_sse2,
+    blend_rect_32,
+    gradient_rect_32,
+    draw_glyph_32,
+    draw_subpixel_glyph_32,
+    get_pixel_32,
+    colorref_to_pixel_masks,
+    pixel_to_colorref_masks,
+    convert_to_32,
+    create_rop_masks_32,
+    create_dither_masks_null,
+    stretch_row_32,
+    shrink_row_32
+};
+
+#endif  /* HAVE_SSE2_PRIMITIVES */
+
+/* the 32-bpp tables used for new DIBs, set up by init_dib_primitives() */
+const primitive_funcs *dib_funcs_8888 = &funcs_8888;
+const primitive_funcs *dib_funcs_32   = &funcs_32;
+
 const primitive_funcs funcs_24 =
 {
     solid_rects_24,
@@ -6404,3 +6667,19 @@ const primitive_funcs funcs_null =
     stretch_row_null,
     shrink_row_null
 };
+
+/***********************************************************************
+ *           init_dib_primitives
+ *
+ * Install the optimized primitives supported by the host cpu.
+ */
+void init_dib_primitives(void)
+{
+#ifdef HAVE_SSE2_PRIMITIVES
+    if (!IsProcessorFeaturePresent( PF_XMMI64_INSTRUCTIONS_AVAILABLE )) return;
+
+    TRACE( "using SSE2 primitives\n" );
+    dib_funcs_8888 = &funcs_8888_sse2;
+    dib_funcs_32   = &funcs_32_sse2;
+#endif
+}
@@ -469,24 +469,10 @@ typedef struct tagFontSubst {
     NameCs to;
 } FontSubst;
 
-/* Registry font cache key and value names */
+/* Registry font cache key name */
 static const WCHAR wine_fonts_key[] = {'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\',
                                        'F','o','n','t','s',0};
 static const WCHAR wine_fonts_cache_key[] = {'C','a','c','h','e',0};
-static const WCHAR english_name_value[] = {'E','n','g','l','i','s','h',' ','N','a','m','e',0};
-static const WCHAR face_index_value[] = {'I','n','d','e','x',0};
-static const WCHAR face_ntmflags_value[] = {'N','t','m','f','l','a','g','s',0};
-static const WCHAR face_version_value[] = {'V','e','r','s','i','o','n',0};
-static const WCHAR face_height_value[] = {'H','e','i','g','h','t',0};
-static const WCHAR face_width_value[] = {'W','i','d','t','h',0};
-static const WCHAR face_size_value[] = {'S','i','z','e',0};
-static const WCHAR face_x_ppem_value[] = {'X','p','p','e','m',0};
-static const WCHAR face_y_ppem_value[] = {'Y','p','p','e','m',0};
-static const WCHAR face_flags_value[] = {'F','l','a','g','s',0};
-static const WCHAR face_internal_leading_value[] = {'I','n','t','e','r','n','a','l',' ','L','e','a','d','i','n','g',0};
-static const WCHAR face_font_sig_value[] = {'F','o','n','t',' ','S','i','g','n','a','t','u','r','e',0};
-static const WCHAR face_file_name_value[] = {'F','i','l','e',' ','N','a','m','e','\0'};
-static const WCHAR face_full_name_value[] = {'F','u','l','l',' ','N','a','m','e','\0'};
 
 
 struct font_mapping
@@ -502,7 +488,6 @@ struct font_mapping
 static struct list mappings_list = LIST_INIT( mappings_list );
 
 static UINT default_aa_flags;
-static HKEY hkey_font_cache;
 
 static CRITICAL_SECTION freetype_cs;
 static CRITICAL_SECTION_DEBUG critsect_debug =
@@ -514,6 +499,7 @@ static CRITICAL_SECTION_DEBUG critsect_debug =
 static CRITICAL_SECTION freetype_cs = { &critsect_debug, -1, 0, 0, 0, 0 };
 
 static const WCHAR font_mutex_nameW[] = {'_','_','W','I','N','E','_','F','O','N','T','_','M','U','T','E','X','_','_','\0'};
+static HANDLE font_mutex;
 
 static const WCHAR szDefaultFallbackLink[] = {'M','i','c','r','o','s','o','f','t',' ','S','a','n','s',' ','S','e','r','i','f',0};
 static BOOL use_default_fallback = FALSE;
@@ -522,7 +508,6 @@ static BOOL get_glyph_index_linked(GdiFont *font, UINT c, GdiFont **linked_font,
 static BOOL get_outline_text_metrics(GdiFont *font);
 static BOOL get_bitmap_text_metrics(GdiFont *font);
 static BOOL get_text_metrics(GdiFont *font, LPTEXTMETRICW ptm);
-static void remove_face_from_cache( Face *face );
 
 static const WCHAR system_link[] = {'S','o','f','t','w','a','r','e','\\','M','i','c','r','o','s','o','f','t','\\',
                                     'W','i','n','d','o','w','s',' ','N','T','\\',
@@ -1404,7 +1389,6 @@ static void release_face( Face *face )
     if (--face->refcount) return;
     if (face->family)
     {
-        if (face->flags & ADDFONT_ADD_TO_CACHE) remove_face_from_cache( face );
         list_remove( &face->entry );
         release_family( face->family );
     }
@@ -1516,88 +1500,6 @@ static LONG reg_load_dword(HKEY hkey, const WCHAR *value, DWORD *data)
     return ERROR_SUCCESS;
 }
 
-static inline LONG reg_save_dword(HKEY hkey, const WCHAR *value, DWORD data)
-{
-    return RegSetValueExW(hkey, value, 0, REG_DWORD, (BYTE*)&data, sizeof(DWORD));
-}
-
-static void load_face(HKEY hkey_face, WCHAR *face_name, Family *family, void *buffer, DWORD buffer_size)
-{
-    DWORD needed, strike_index = 0;
-    HKEY hkey_strike;
-
-    /* If we have a File Name key then this is a real font, not just the parent
-       key of a bunch of non-scalable strikes */
-    needed = buffer_size;
-    if (RegQueryValueExW(hkey_face, face_file_name_value, NULL, NULL, buffer, &needed) == ERROR_SUCCESS)
-    {
-        Face *face;
-        face = HeapAlloc(GetProcessHeap(), 0, sizeof(*face));
-        face->cached_enum_data = NULL;
-        face->family = NULL;
-
-        face->refcount = 1;
-        face->file = strdupW( buffer );
-        face->StyleName = strdupW(face_name);
-
-        needed = buffer_size;
-        if(RegQueryValueExW(hkey_face, face_full_name_value, NULL, NULL, buffer, &needed) == ERROR_SUCCESS)
-            face->FullName = strdupW( buffer );
-        else
-            face->FullName = NULL;
-
-        reg_load_dword(hkey_face, face_index_value, (DWORD*)&face->face_index);
-        reg_load_dword(hkey_face, face_ntmflags_value, &face->ntmFlags);
-        reg_load_dword(hkey_face, face_version_value, (DWORD*)&face->font_version);
-        reg_load_dword(hkey_face, face_flags_value, (DWORD*)&face->flags);
-
-        needed = sizeof(face->fs);
-        RegQueryValueExW(hkey_face, face_font_sig_value, NULL, NULL, (BYTE*)&face->fs, &needed);
-
-        if(reg_load_dword(hkey_face, face_height_value, (DWORD*)&face->size.height) != ERROR_SUCCESS)
-        {
-            face->scalable = TRUE;
-            memset(&face->size, 0, sizeof(face->size));
-        }
-        else
-        {
-            face->scalable = FALSE;
-            reg_load_dword(hkey_face, face_width_value, (DWORD*)&face->size.width);
-            reg_load_dword(hkey_face, face_size_value, (DWORD*)&face->size.size);
-            reg_load_dword(hkey_face, face_x_ppem_value, (DWORD*)&face->size.x_ppem);
-            reg_load_dword(hkey_face, face_y_ppem_value, (DWORD*)&face->size.y_ppem);
-            reg_load_dword(hkey_face, face_internal_leading_value, (DWORD*)&face->size.internal_leading);
-
-            TRACE("Adding bitmap size h %d w %d size %ld x_ppem %ld y_ppem %ld\n",
-                  face->size.height, face->size.width, face->size.size >> 6,
-                  face->size.x_ppem >> 6, face->size.y_ppem >> 6);
-        }
-
-        TRACE("fsCsb = %08x %08x/%08x %08x %08x %08x\n",
-              face->fs.fsCsb[0], face->fs.fsCsb[1],
-              face->fs.fsUsb[0], face->fs.fsUsb[1],
-              face->fs.fsUsb[2], face->fs.fsUsb[3]);
-
-        if (insert_face_in_family_list(face, family))
-            TRACE("Added font %s %s\n", debugstr_w(family->FamilyName), debugstr_w(face->StyleName));
-
-        release_face( face );
-    }
-
-    /* load bitmap strikes */
-
-    needed = buffer_size;
-    while (!RegEnumKeyExW(hkey_face, strike_index++, buffer, &needed, NULL, NULL, NULL, NULL))
-    {
-        if (!RegOpenKeyExW(hkey_face, buffer, 0, KEY_ALL_ACCESS, &hkey_strike))
-        {
-            load_face(hkey_strike, face_name, family, buffer, buffer_size);
-            RegCloseKey(hkey_strike);
-        }
-        needed = buffer_size;
-    }
-}
-
 /* move vertical fonts after their horizontal counterpart */
 /* assumes that font_list is already sorted by family name */
 static void reorder_vertical_fonts(void)
@@ -1630,149 +1532,539 @@ static void reorder_vertical_fonts(void)
     list_move_tail( &font_list, &vertical_families );
 }
 
-static void load_font_list_from_cache(HKEY hkey_font_cache)
+static LONG create_font_cache_key(HKEY *hkey, DWORD *disposition)
 {
-    DWORD size, family_index = 0;
-    Family *family;
-    HKEY hkey_family;
-    WCHAR buffer[4096];
+    LONG ret;
+    HKEY hkey_wine_fonts;
 
-    size = sizeof(buffer);
-    while (!RegEnumKeyExW(hkey_font_cache, family_index++, buffer, &size, NULL, NULL, NULL, NULL))
+    /* We don't want to create the fonts key as volatile, so open this first */
+    ret = RegCreateKeyExW(HKEY_CURRENT_USER, wine_fonts_key, 0, NULL, 0,
+                          KEY_ALL_ACCESS, NULL, &hkey_wine_fonts, NULL);
+    if(ret != ERROR_SUCCESS)
     {
-        WCHAR *english_family = NULL;
-        WCHAR *family_name = strdupW( buffer );
-        DWORD face_index = 0;
+        WARN("Can't create %s\n", debugstr_w(wine_fonts_key));
+        return ret;
+    }
+
+    ret = RegCreateKeyExW(hkey_wine_fonts, wine_fonts_cache_key, 0, NULL, REG_OPTION_VOLATILE,
+                          KEY_ALL_ACCESS, NULL, hkey, disposition);
+    RegCloseKey(hkey_wine_fonts);
+    return ret;
+}
 
-        RegOpenKeyExW(hkey_font_cache, family_name, 0, KEY_ALL_ACCESS, &hkey_family);
-        TRACE("opened family key %s\n", debugstr_w(family_name));
-        size = sizeof(buffer);
-        if (!RegQueryValueExW(hkey_family, english_name_value, NULL, NULL, (BYTE *)buffer, &size))
-            english_family = strdupW( buffer );
+/* The font index is a binary file in the prefix directory that replaces the
+ * old registry font cache.  It records the outcome of every cached
+ * AddFontToList() call (one entry per call, holding the faces it produced),
+ * so that processes can map it and replay it in order instead of parsing the
+ * font files with FreeType.  The first process of a session rebuilds it,
+ * reusing the entries of files whose size and modification time haven't
+ * changed.  All string offsets are relative to the enclosing record. */
+
+#define FONT_INDEX_MAGIC   0x58444e49  /* "INDX" */
+#define FONT_INDEX_VERSION 2
+
+struct font_index_header
+{
+    DWORD  magic;
+    DWORD  version;
+    DWORD  size;        /* total size of the index */
+    DWORD  count;       /* number of file entries */
+    LCID   lcid;        /* locale used to pick the face names */
+    LANGID langid;
+    WORD   pad;
+};
+
+struct font_index_file
+{
+    DWORD     size;        /* size of the entry, including faces and strings */
+    DWORD     flags;       /* AddFontToList() flags */
+    DWORD     face_count;
+    INT       result;      /* AddFontToList() return value */
+    ULONGLONG mtime;
+    ULONGLONG file_size;
+    ULONGLONG dev;
+    ULONGLONG ino;
+    DWORD     name;        /* offset of the unix file name */
+    DWORD     faces;       /* offset of the first face */
+};
+
+struct font_index_face
+{
+    DWORD         size;    /* size of the record, including strings */
+    DWORD         family_name;
+    DWORD         english_name;
+    DWORD         style_name;
+    DWORD         full_name;
+    DWORD         face_index;
+    DWORD         ntm_flags;
+    DWORD         flags;   /* ADDFONT_VERTICAL_FONT */
+    LONGLONG      font_version;
+    FONTSIGNATURE fs;
+    DWORD         scalable;
+    DWORD         pad1;    /* keep the layout identical for 32-bit and 64-bit code */
+    LONGLONG      bitmap_size;
+    LONGLONG      x_ppem;
+    LONGLONG      y_ppem;
+    SHORT         height;
+    SHORT         width;
+    SHORT         internal_leading;
+    SHORT         pad2;
+};
+
+/* the index is shared between 32-bit and 64-bit processes of a WoW64 prefix */
+C_ASSERT( sizeof(struct font_index_header) == 24 );
+C_ASSERT( sizeof(struct font_index_file) == 56 );
+C_ASSERT( FIELD_OFFSET(struct font_index_face, bitmap_size) == 72 );
+C_ASSERT( sizeof(struct font_index_face) == 104 );
+
+struct font_index_buffer
+{
+    BYTE *data;
+    DWORD size;
+    DWORD used;
+};
+
+struct font_index
+{
+    const BYTE  *data;
+    DWORD        size;
+    DWORD       *hash;        /* entry offsets, open addressing */
+    DWORD        hash_mask;
+};
 
-        family = create_family(family_name, english_family);
+static struct font_index_buffer *font_index_builder;  /* set while building the font list */
+static struct font_index *prev_font_index;            /* index being replaced by the builder */
 
-        if(english_family)
+static char *get_font_index_path(void)
+{
+    static const char nameA[] = "/fontcache.dat";
+    const char *dir = wine_get_config_dir();
+    char *path;
+
+    if (!dir) return NULL;
+    if ((path = HeapAlloc( GetProcessHeap(), 0, strlen(dir) + sizeof(nameA) )))
+    {
+        strcpy( path, dir );
+        strcat( path, nameA );
+    }
+    return path;
+}
+
+static DWORD index_append( struct font_index_buffer *buf, const void *data, DWORD size )
+{
+    DWORD pos = buf->used, aligned = (size + 7) & ~7;
+
+    if (!buf->data) return 0;
+    if (aligned > buf->size - pos)
+    {
+        DWORD new_size = max( buf->size * 2, pos + aligned );
+        BYTE *new_data = HeapReAlloc( GetProcessHeap(), 0, buf->data, new_size );
+
+        if (!new_data)
         {
-            FontSubst *subst = HeapAlloc(GetProcessHeap(), 0, sizeof(*subst));
-            subst->from.name = strdupW(english_family);
-            subst->from.charset = -1;
-            subst->to.name = strdupW(family_name);
-            subst->to.charset = -1;
-            add_font_subst(&font_subst_list, subst, 0);
+            HeapFree( GetProcessHeap(), 0, buf->data );
+            buf->data = NULL;
+            return 0;
         }
+        buf->data = new_data;
+        buf->size = new_size;
+    }
+    if (data) memcpy( buf->data + pos, data, size );
+    else memset( buf->data + pos, 0, size );
+    memset( buf->data + pos + size, 0, aligned - size );
+    buf->used = pos + aligned;
+    return pos;
+}
+
+static BOOL init_font_index_buffer( struct font_index_buffer *buf )
+{
+    buf->size = 0x10000;
+    buf->used = 0;
+    if (!(buf->data = HeapAlloc( GetProcessHeap(), 0, buf->size ))) return FALSE;
+    index_append( buf, NULL, sizeof(struct font_index_header) );
+    return TRUE;
+}
+
+static DWORD index_append_strW( struct font_index_buffer *buf, DWORD base, const WCHAR *str )
+{
+    DWORD pos;
+
+    if (!str) return 0;
+    if (!(pos = index_append( buf, str, (strlenW(str) + 1) * sizeof(WCHAR) ))) return 0;
+    return pos - base;
+}
+
+static DWORD index_add_entry( struct font_index_buffer *buf, const void *data, DWORD size )
+{
+    DWORD pos = index_append( buf, data, size );
+
+    if (pos) ((struct font_index_header *)buf->data)->count++;
+    return pos;
+}
+
+static DWORD index_begin_file( struct font_index_buffer *buf, const char *file, const struct stat *st, DWORD flags )
+{
+    struct font_index_file entry, *ptr;
+    DWORD pos, name;
+
+    memset( &entry, 0, sizeof(entry) );
+    entry.flags     = flags;
+    entry.mtime     = st->st_mtime;
+    entry.file_size = st->st_size;
+    entry.dev       = st->st_dev;
+    entry.ino       = st->st_ino;
+
+    if (!(pos = index_add_entry( buf, &entry, sizeof(entry) ))) return 0;
+    if (!(name = index_append( buf, file, strlen(file) + 1 ))) return 0;
+    ptr = (struct font_index_file *)(buf->data + pos);
+    ptr->name = name - pos;
+    ptr->faces = buf->used - pos;
+    ptr->size = buf->used - pos;
+    return pos;
+}
+
+static void index_end_file( struct font_index_buffer *buf, DWORD pos, INT result )
+{
+    struct font_index_file *entry;
 
-        size = sizeof(buffer);
-        while (!RegEnumKeyExW(hkey_family, face_index++, buffer, &size, NULL, NULL, NULL, NULL))
+    if (!buf->data || !pos) return;
+    entry = (struct font_index_file *)(buf->data + pos);
+    entry->size = buf->used - pos;
+    entry->result = result;
+}
+
+static void index_add_face( struct font_index_buffer *buf, DWORD file_pos, const Face *face, const Family *family )
+{
+    struct font_index_face rec, *ptr;
+    DWORD pos, family_name, english_name, style_name, full_name;
+
+    if (!buf->data || !file_pos) return;
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.face_index       = face->face_index;
+    rec.ntm_flags        = face->ntmFlags;
+    rec.flags            = face->flags & ADDFONT_VERTICAL_FONT;
+    rec.font_version     = face->font_version;
+    rec.fs               = face->fs;
+    rec.scalable         = face->scalable;
+    rec.bitmap_size      = face->size.size;
+    rec.x_ppem           = face->size.x_ppem;
+    rec.y_ppem           = face->size.y_ppem;
+    rec.height           = face->size.height;
+    rec.width            = face->size.width;
+    rec.internal_leading = face->size.internal_leading;
+
+    if (!(pos = index_append( buf, &rec, sizeof(rec) ))) return;
+    family_name  = index_append_strW( buf, pos, family->FamilyName );
+    english_name = index_append_strW( buf, pos, family->EnglishName );
+    style_name   = index_append_strW( buf, pos, face->StyleName );
+    full_name    = index_append_strW( buf, pos, face->FullName );
+    if (!buf->data) return;
+
+    ptr = (struct font_index_face *)(buf->data + pos);
+    ptr->family_name  = family_name;
+    ptr->english_name = english_name;
+    ptr->style_name   = style_name;
+    ptr->full_name    = full_name;
+    ptr->size         = buf->used - pos;
+    ((struct font_index_file *)(buf->data + file_pos))->face_count++;
+}
+
+static const char *index_strA( const void *base, DWORD size, DWORD offset )
+{
+    const char *str = (const char *)base + offset;
+
+    if (!offset || offset >= size || !memchr( str, 0, size - offset )) return NULL;
+    return str;
+}
+
+static const WCHAR *index_strW( const void *base, DWORD size, DWORD offset )
+{
+    const WCHAR *str = (const WCHAR *)((const char *)base + offset);
+    DWORD i, len;
+
+    if (!offset || offset >= size || (offset & 1)) return NULL;
+    len = (size - offset) / sizeof(WCHAR);
+    for (i = 0; i < len; i++) if (!str[i]) return str;
+    return NULL;
+}
+
+static BOOL validate_font_index( const BYTE *data, DWORD size )
+{
+    const struct font_index_header *header = (const struct font_index_header *)data;
+    DWORD pos, face_pos, count = 0, i;
+
+    for (pos = sizeof(*header); pos < size; pos += ((const struct font_index_file *)(data + pos))->size)
+    {
+        const struct font_index_file *entry = (const struct font_index_file *)(data + pos);
+
+        if (size - pos < sizeof(*entry)) return FALSE;
+        if (entry->size < sizeof(*entry) || entry->size > size - pos || (entry->size & 7)) return FALSE;
+        if (!index_strA( entry, entry->size, entry->name )) return FALSE;
+        if (entry->faces > entry->size || (entry->faces & 7)) return FALSE;
+
+        for (i = 0, face_pos = entry->faces; i < entry->face_count; i++, face_pos += ((const struct font_index_face *)((const BYTE *)entry + face_pos))->size)
         {
-            WCHAR *face_name = strdupW( buffer );
-            HKEY hkey_face;
+            const struct font_index_face *face = (const struct font_index_face *)((const BYTE *)entry + face_pos);
+
+            if (entry->size - face_pos < sizeof(*face)) return FALSE;
+            if (face->size < sizeof(*face) || face->size > entry->size - face_pos || (face->size & 7)) return FALSE;
+            if (!index_strW( face, face->size, face->family_name )) return FALSE;
+            if (!index_strW( face, face->size, face->style_name )) return FALSE;
+            if (face->english_name && !index_strW( face, face->size, face->english_name )) return FALSE;
+            if (face->full_name && !index_strW( face, face->size, face->full_name )) return FALSE;
+        }
+        count++;
+    }
+    return count == header->count;
+}
+
+static BOOL map_font_index( struct font_index *index )
+{
+    const struct font_index_header *header;
+    struct stat st;
+    char *path;
+    void *data;
+    int fd;
+
+    if (!(path = get_font_index_path())) return FALSE;
+    fd = open( path, O_RDONLY );
+    HeapFree( GetProcessHeap(), 0, path );
+    if (fd == -1) return FALSE;
+
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || st.st_size > 0x7fffffff)
+    {
+        close( fd );
+        return FALSE;
+    }
+    data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (data == MAP_FAILED) return FALSE;
+
+    header = data;
+    if (header->magic != FONT_INDEX_MAGIC || header->version != FONT_INDEX_VERSION ||
+        header->size != st.st_size || header->lcid != GetSystemDefaultLCID() ||
+        header->langid != GetSystemDefaultLangID() || !validate_font_index( data, st.st_size ))
+    {
+        TRACE( "ignoring out of date font index\n" );
+        munmap( data, st.st_size );
+        return FALSE;
+    }
+
+    index->data = data;
+    index->size = st.st_size;
+    index->hash = NULL;
+    index->hash_mask = 0;
+    return TRUE;
+}
+
+static void unmap_font_index( struct font_index *index )
+{
+    HeapFree( GetProcessHeap(), 0, index->hash );
+    munmap( (void *)index->data, index->size );
+}
+
+static void write_font_index( struct font_index_buffer *buf )
+{
+    struct font_index_header *header;
+    char *path, *tmp;
+    DWORD pos = 0;
+    int fd;
 
-            if (!RegOpenKeyExW(hkey_family, face_name, 0, KEY_ALL_ACCESS, &hkey_face))
+    if (!buf->data || !(path = get_font_index_path())) return;
+
+    header = (struct font_index_header *)buf->data;
+    header->magic   = FONT_INDEX_MAGIC;
+    header->version = FONT_INDEX_VERSION;
+    header->size    = buf->used;
+    header->lcid    = GetSystemDefaultLCID();
+    header->langid  = GetSystemDefaultLangID();
+
+    /* write a new file and rename it, so that readers always see a complete index */
+    if ((tmp = HeapAlloc( GetProcessHeap(), 0, strlen(path) + sizeof(".tmp") )))
+    {
+        sprintf( tmp, "%s.tmp", path );
+        if ((fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666 )) != -1)
+        {
+            while (pos < buf->used)
             {
-                load_face(hkey_face, face_name, family, buffer, sizeof(buffer));
-                RegCloseKey(hkey_face);
+                int ret = write( fd, buf->data + pos, buf->used - pos );
+                if (ret <= 0) break;
+                pos += ret;
+            }
+            close( fd );
+            if (pos < buf->used || rename( tmp, path ) == -1)
+            {
+                WARN( "failed to write font index %s\n", debugstr_a(path) );
+                unlink( tmp );
             }
-            HeapFree( GetProcessHeap(), 0, face_name );
-            size = sizeof(buffer);
         }
-        RegCloseKey(hkey_family);
-        release_family( family );
-        size = sizeof(buffer);
+        HeapFree( GetProcessHeap(), 0, tmp );
     }
+    HeapFree( GetProcessHeap(), 0, path );
+}
 
-    reorder_vertical_fonts();
+static inline DWORD hash_index_key( const char *file, DWORD flags )
+{
+    DWORD hash = 2166136261u ^ LOWORD(flags);
+
+    while (*file) hash = (hash ^ (BYTE)*file++) * 16777619;
+    return hash;
 }
 
-static LONG create_font_cache_key(HKEY *hkey, DWORD *disposition)
+static void hash_font_index( struct font_index *index )
 {
-    LONG ret;
-    HKEY hkey_wine_fonts;
+    const struct font_index_header *header = (const struct font_index_header *)index->data;
+    DWORD pos, i, size = 16;
 
-    /* We don't want to create the fonts key as volatile, so open this first */
-    ret = RegCreateKeyExW(HKEY_CURRENT_USER, wine_fonts_key, 0, NULL, 0,
-                          KEY_ALL_ACCESS, NULL, &hkey_wine_fonts, NULL);
-    if(ret != ERROR_SUCCESS)
+    while (size < header->count * 2) size *= 2;
+    if (!(index->hash = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(DWORD) ))) return;
+    index->hash_mask = size - 1;
+
+    for (pos = sizeof(*header); pos < index->size; pos += ((const struct font_index_file *)(index->data + pos))->size)
     {
-        WARN("Can't create %s\n", debugstr_w(wine_fonts_key));
-        return ret;
+        const struct font_index_file *entry = (const struct font_index_file *)(index->data + pos);
+
+        i = hash_index_key( (const char *)entry + entry->name, entry->flags ) & index->hash_mask;
+        while (index->hash[i]) i = (i + 1) & index->hash_mask;
+        index->hash[i] = pos;
     }
+}
 
-    ret = RegCreateKeyExW(hkey_wine_fonts, wine_fonts_cache_key, 0, NULL, REG_OPTION_VOLATILE,
-                          KEY_ALL_ACCESS, NULL, hkey, disposition);
-    RegCloseKey(hkey_wine_fonts);
-    return ret;
+static const struct font_index_file *find_font_index_file( const struct font_index *index, const char *file,
+                                                           DWORD flags )
+{
+    const struct font_index_file *entry;
+    DWORD i, pos;
+
+    if (!index->hash) return NULL;
+
+    for (i = hash_index_key( file, flags ) & index->hash_mask; (pos = index->hash[i]); i = (i + 1) & index->hash_mask)
+    {
+        entry = (const struct font_index_file *)(index->data + pos);
+        if (entry->flags == flags && !strcmp( (const char *)entry + entry->name, file )) return entry;
+    }
+    return NULL;
 }
 
-static void add_face_to_cache(Face *face)
+/* replace or remove the entry of a font file in the index of the running session */
+static void update_font_index( const char *file, DWORD flags, const struct font_index_buffer *entry )
 {
-    HKEY hkey_family, hkey_face;
-    WCHAR *face_key_name;
+    struct font_index index;
+    struct font_index_buffer buf;
+    DWORD pos;
 
-    RegCreateKeyExW(hkey_font_cache, face->family->FamilyName, 0,
-                    NULL, REG_OPTION_VOLATILE, KEY_ALL_ACCESS, NULL, &hkey_family, NULL);
-    if(face->family->EnglishName)
-        RegSetValueExW(hkey_family, english_name_value, 0, REG_SZ, (BYTE*)face->family->EnglishName,
-                       (strlenW(face->family->EnglishName) + 1) * sizeof(WCHAR));
+    WaitForSingleObject( font_mutex, INFINITE );
 
-    if(face->scalable)
-        face_key_name = face->StyleName;
-    else
+    if (map_font_index( &index ))
     {
-        static const WCHAR fmtW[] = {'%','s','\\','%','d',0};
-        face_key_name = HeapAlloc(GetProcessHeap(), 0, (strlenW(face->StyleName) + 10) * sizeof(WCHAR));
-        sprintfW(face_key_name, fmtW, face->StyleName, face->size.y_ppem);
+        if (init_font_index_buffer( &buf ))
+        {
+            for (pos = sizeof(struct font_index_header); pos < index.size; pos += ((const struct font_index_file *)(index.data + pos))->size)
+            {
+                const struct font_index_file *cur = (const struct font_index_file *)(index.data + pos);
+
+                if (LOWORD(cur->flags) == LOWORD(flags) && !strcmp( (const char *)cur + cur->name, file ))
+                    continue;
+                index_add_entry( &buf, cur, cur->size );
+            }
+            if (entry && entry->data)
+                index_add_entry( &buf, entry->data + sizeof(struct font_index_header),
+                                 entry->used - sizeof(struct font_index_header) );
+            write_font_index( &buf );
+            HeapFree( GetProcessHeap(), 0, buf.data );
+        }
+        unmap_font_index( &index );
     }
-    RegCreateKeyExW(hkey_family, face_key_name, 0, NULL, REG_OPTION_VOLATILE, KEY_ALL_ACCESS, NULL,
-                    &hkey_face, NULL);
-    if(!face->scalable)
-        HeapFree(GetProcessHeap(), 0, face_key_name);
 
-    RegSetValueExW(hkey_face, face_file_name_value, 0, REG_SZ, (BYTE *)face->file,
-                   (strlenW(face->file) + 1) * sizeof(WCHAR));
-    if (face->FullName)
-        RegSetValueExW(hkey_face, face_full_name_value, 0, REG_SZ, (BYTE*)face->FullName,
-                       (strlenW(face->FullName) + 1) * sizeof(WCHAR));
+    ReleaseMutex( font_mutex );
+}
 
-    reg_save_dword(hkey_face, face_index_value, face->face_index);
-    reg_save_dword(hkey_face, face_ntmflags_value, face->ntmFlags);
-    reg_save_dword(hkey_face, face_version_value, face->font_version);
-    if (face->flags) reg_save_dword(hkey_face, face_flags_value, face->flags);
+static Family *get_family_from_names( WCHAR *name, WCHAR *english_name );
 
-    RegSetValueExW(hkey_face, face_font_sig_value, 0, REG_BINARY, (BYTE*)&face->fs, sizeof(face->fs));
+static INT add_faces_from_index( const struct font_index_file *entry )
+{
+    const BYTE *ptr = (const BYTE *)entry + entry->faces;
+    WCHAR *file = towstr( CP_UNIXCP, (const char *)entry + entry->name );
+    DWORD i;
 
-    if(!face->scalable)
+    for (i = 0; i < entry->face_count; i++, ptr += ((const struct font_index_face *)ptr)->size)
     {
-        reg_save_dword(hkey_face, face_height_value, face->size.height);
-        reg_save_dword(hkey_face, face_width_value, face->size.width);
-        reg_save_dword(hkey_face, face_size_value, face->size.size);
-        reg_save_dword(hkey_face, face_x_ppem_value, face->size.x_ppem);
-        reg_save_dword(hkey_face, face_y_ppem_value, face->size.y_ppem);
-        reg_save_dword(hkey_face, face_internal_leading_value, face->size.internal_leading);
+        const struct font_index_face *rec = (const struct font_index_face *)ptr;
+        Face *face = HeapAlloc( GetProcessHeap(), 0, sizeof(*face) );
+        Family *family;
+
+        face->refcount = 1;
+        face->StyleName = strdupW( (const WCHAR *)(ptr + rec->style_name) );
+        face->FullName = rec->full_name ? strdupW( (const WCHAR *)(ptr + rec->full_name) ) : NULL;
+        face->file = strdupW( file );
+        face->font_data_ptr = NULL;
+        face->font_data_size = 0;
+        face->dev = entry->dev;
+        face->ino = entry->ino;
+        face->face_index = rec->face_index;
+        face->fs = rec->fs;
+        face->ntmFlags = rec->ntm_flags;
+        face->font_version = rec->font_version;
+        face->scalable = rec->scalable;
+        face->size.height = rec->height;
+        face->size.width = rec->width;
+        face->size.size = rec->bitmap_size;
+        face->size.x_ppem = rec->x_ppem;
+        face->size.y_ppem = rec->y_ppem;
+        face->size.internal_leading = rec->internal_leading;
+        face->flags = entry->flags | (rec->flags & ADDFONT_VERTICAL_FONT);
+        if (!HIWORD( face->flags )) face->flags |= ADDFONT_AA_FLAGS( default_aa_flags );
+        face->family = NULL;
+        face->cached_enum_data = NULL;
+
+        family = get_family_from_names( strdupW( (const WCHAR *)(ptr + rec->family_name) ),
+                                        rec->english_name ? strdupW( (const WCHAR *)(ptr + rec->english_name) ) : NULL );
+        if (insert_face_in_family_list( face, family ))
+            TRACE("Added font %s %s\n", debugstr_w(family->FamilyName), debugstr_w(face->StyleName));
+
+        release_face( face );
+        release_family( family );
     }
-    RegCloseKey(hkey_face);
-    RegCloseKey(hkey_family);
+    HeapFree( GetProcessHeap(), 0, file );
+    return entry->result;
 }
 
-static void remove_face_from_cache( Face *face )
+static int family_name_compare( const void *a, const void *b )
 {
-    HKEY hkey_family;
+    const Family *family1 = *(const Family * const *)a;
+    const Family *family2 = *(const Family * const *)b;
 
-    RegOpenKeyExW( hkey_font_cache, face->family->FamilyName, 0, KEY_ALL_ACCESS, &hkey_family );
+    return strcmpiW( family1->FamilyName, family2->FamilyName );
+}
 
-    if (face->scalable)
-    {
-        RegDeleteKeyW( hkey_family, face->StyleName );
-    }
-    else
+static BOOL load_font_list_from_index(void)
+{
+    struct font_index index;
+    Family *family, **families;
+    DWORD pos, count, i;
+
+    if (!map_font_index( &index )) return FALSE;
+
+    for (pos = sizeof(struct font_index_header); pos < index.size; pos += ((const struct font_index_file *)(index.data + pos))->size)
+        add_faces_from_index( (const struct font_index_file *)(index.data + pos) );
+
+    unmap_font_index( &index );
+
+    /* sort the families by name, reorder_vertical_fonts depends on it */
+    count = list_count( &font_list );
+    if ((families = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*families) )))
     {
-        static const WCHAR fmtW[] = {'%','s','\\','%','d',0};
-        WCHAR *face_key_name = HeapAlloc(GetProcessHeap(), 0, (strlenW(face->StyleName) + 10) * sizeof(WCHAR));
-        sprintfW(face_key_name, fmtW, face->StyleName, face->size.y_ppem);
-        RegDeleteKeyW( hkey_family, face_key_name );
-        HeapFree(GetProcessHeap(), 0, face_key_name);
+        i = 0;
+        LIST_FOR_EACH_ENTRY( family, &font_list, Family, entry ) families[i++] = family;
+        qsort( families, count, sizeof(*families), family_name_compare );
+        list_init( &font_list );
+        for (i = 0; i < count; i++) list_add_tail( &font_list, &families[i]->entry );
+        HeapFree( GetProcessHeap(), 0, families );
     }
-    RegCloseKey(hkey_family);
+
+    reorder_vertical_fonts();
+    return TRUE;
 }
 
 static WCHAR *prepend_at(WCHAR *family)
@@ -1813,14 +2105,10 @@ static void get_family_names( FT_Face ft_face, WCHAR **name, WCHAR **english, BO
     }
 }
 
-static Family *get_family( FT_Face ft_face, BOOL vertical )
+/* NB This function takes ownership of the name strings */
+static Family *get_family_from_names( WCHAR *name, WCHAR *english_name )
 {
-    Family *family;
-    WCHAR *name, *english_name;
-
-    get_family_names( ft_face, &name, &english_name, vertical );
-
-    family = find_family_from_name( name );
+    Family *family = find_family_from_name( name );
 
     if (!family)
     {
@@ -1845,6 +2133,14 @@ static Family *get_family( FT_Face ft_face, BOOL vertical )
     return family;
 }
 
+static Family *get_family( FT_Face ft_face, BOOL vertical )
+{
+    WCHAR *name, *english_name;
+
+    get_family_names( ft_face, &name, &english_name, vertical );
+    return get_family_from_names( name, english_name );
+}
+
 static inline FT_Fixed get_font_version( FT_Face ft_face )
 {
     FT_Fixed version = 0;
@@ -2022,21 +2318,17 @@ static Face *create_face( FT_Face ft_face, FT_Long face_index, const char *file,
 }
 
 static void AddFaceToList(FT_Face ft_face, const char *file, void *font_data_ptr, DWORD font_data_size,
-                          FT_Long face_index, DWORD flags )
+                          FT_Long face_index, DWORD flags, struct font_index_buffer *index, DWORD index_pos )
 {
     Face *face;
     Family *family;
 
     face = create_face( ft_face, face_index, file, font_data_ptr, font_data_size, flags );
     family = get_family( ft_face, flags & ADDFONT_VERTICAL_FONT );
+    if (index) index_add_face( index, index_pos, face, family );
     if (insert_face_in_family_list( face, family ))
-    {
-        if (flags & ADDFONT_ADD_TO_CACHE)
-            add_face_to_cache( face );
-
         TRACE("Added font %s %s\n", debugstr_w(family->FamilyName),
               debugstr_w(face->StyleName));
-    }
     release_face( face );
     release_family( family );
 }
@@ -2122,6 +2414,9 @@ static INT AddFontToList(const char *file, void *font_data_ptr, DWORD font_data_
     FT_Face ft_face;
     FT_Long face_index = 0, num_faces;
     INT ret = 0;
+    struct font_index_buffer *index = NULL, runtime_index;
+    DWORD index_pos = 0;
+    struct stat st;
 
     /* we always load external fonts from files - otherwise we would get a crash in update_reg_entries */
     assert(file || !(flags & ADDFONT_EXTERNAL_FONT));
@@ -2147,30 +2442,63 @@ static INT AddFontToList(const char *file, void *font_data_ptr, DWORD font_data_
     }
 #endif /* HAVE_CARBON_CARBON_H */
 
+    if (file && (flags & ADDFONT_ADD_TO_CACHE) && !stat( file, &st ))
+    {
+        const struct font_index_file *entry;
+
+        if (prev_font_index && (entry = find_font_index_file( prev_font_index, file, flags )) &&
+            entry->mtime == st.st_mtime && entry->file_size == st.st_size &&
+            entry->dev == st.st_dev && entry->ino == st.st_ino)
+        {
+            TRACE("Loading %s from the font index\n", debugstr_a(file));
+            index_add_entry( font_index_builder, entry, entry->size );
+            return add_faces_from_index( entry );
+        }
+
+        if (font_index_builder) index = font_index_builder;
+        else if (init_font_index_buffer( &runtime_index )) index = &runtime_index;
+        if (index) index_pos = index_begin_file( index, file, &st, flags );
+    }
+
     do {
         ft_face = new_ft_face( file, font_data_ptr, font_data_size, face_index, flags & ADDFONT_ALLOW_BITMAP );
-        if (!ft_face) return 0;
+        if (!ft_face)
+        {
+            ret = 0;
+            break;
+        }
 
         if(ft_face->family_name[0] == '.') /* Ignore fonts with names beginning with a dot */
         {
             TRACE("Ignoring %s since its family name begins with a dot\n", debugstr_a(file));
             pFT_Done_Face(ft_face);
-            return 0;
+            ret = 0;
+            break;
         }
 
-        AddFaceToList(ft_face, file, font_data_ptr, font_data_size, face_index, flags);
+        AddFaceToList(ft_face, file, font_data_ptr, font_data_size, face_index, flags, index, index_pos);
         ++ret;
 
         if (FT_HAS_VERTICAL(ft_face))
         {
             AddFaceToList(ft_face, file, font_data_ptr, font_data_size, face_index,
-                          flags | ADDFONT_VERTICAL_FONT);
+                          flags | ADDFONT_VERTICAL_FONT, index, index_pos);
             ++ret;
         }
 
 	num_faces = ft_face->num_faces;
 	pFT_Done_Face(ft_face);
     } while(num_faces > ++face_index);
+
+    if (index)
+    {
+        index_end_file( index, index_pos, ret );
+        if (index == &runtime_index)
+        {
+            update_font_index( file, flags, index );
+            HeapFree( GetProcessHeap(), 0, index->data );
+        }
+    }
     return ret;
 }
 
@@ -2198,6 +2526,7 @@ static int remove_font_resource( const char *file, DWORD flags )
 	}
         release_family( family );
     }
+    if (count && (flags & ADDFONT_ADD_TO_CACHE)) update_font_index( file, flags, NULL );
     return count;
 }
 
@@ -4109,8 +4438,10 @@ static void reorder_font_list(void)
  */
 BOOL WineEngInit(void)
 {
+    HKEY hkey_font_cache;
     DWORD disposition;
-    HANDLE font_mutex;
+    struct font_index_buffer index;
+    struct font_index prev_index;
 
     /* update locale dependent font info in registry */
     update_font_info();
@@ -4128,12 +4459,39 @@ BOOL WineEngInit(void)
     }
     WaitForSingleObject(font_mutex, INFINITE);
 
-    create_font_cache_key(&hkey_font_cache, &disposition);
+    /* the volatile cache key only tells whether the font index has been
+       brought up to date in this session */
+    if (!create_font_cache_key(&hkey_font_cache, &disposition))
+        RegCloseKey(hkey_font_cache);
+    else
+        disposition = REG_CREATED_NEW_KEY;
+
+    if(disposition == REG_CREATED_NEW_KEY || !load_font_list_from_index())
+    {
+        if (init_font_index_buffer( &index ))
+        {
+            font_index_builder = &index;
+            if (map_font_index( &prev_index ))
+            {
+                hash_font_index( &prev_index );
+                prev_font_index = &prev_index;
+            }
+        }
 
-    if(disposition == REG_CREATED_NEW_KEY)
         init_font_list();
-    else
-        load_font_list_from_cache(hkey_font_cache);
+
+        if (font_index_builder)
+        {
+            write_font_index( font_index_builder );
+            HeapFree( GetProcessHeap(), 0, index.data );
+            font_index_builder = NULL;
+        }
+        if (prev_font_index)
+        {
+            unmap_font_index( prev_font_index );
+            prev_font_index = NULL;
+        }
+    }
 
     reorder_font_list();
 
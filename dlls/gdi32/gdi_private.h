@@ -262,6 +262,7 @@ extern DWORD put_image_into_bitmap( BITMAPOBJ *bmp, HRGN clip, BITMAPINFO *info,
                                     const struct gdi_image_bits *bits, struct bitblt_coords *src,
                                     struct bitblt_coords *dst ) DECLSPEC_HIDDEN;
 extern void dibdrv_set_window_surface( DC *dc, struct window_surface *surface ) DECLSPEC_HIDDEN;
+extern void init_dib_primitives(void) DECLSPEC_HIDDEN;
 
 /* driver.c */
 extern const struct gdi_dc_funcs null_driver DECLSPEC_HIDDEN;
@@ -345,6 +346,8 @@ static inline void release_wine_region(HRGN rgn)
 {
     GDI_ReleaseObj(rgn);
 }
+extern int find_region_band( const WINEREGION *rgn, int start, int y ) DECLSPEC_HIDDEN;
+extern int find_region_rect( const WINEREGION *rgn, int start, int end, int x ) DECLSPEC_HIDDEN;
 
 /* null driver entry points */
 extern BOOL nulldrv_AbortPath( PHYSDEV dev ) DECLSPEC_HIDDEN;
@@ -445,6 +445,46 @@ static BOOL init_region( WINEREGION *pReg, INT n )
     return TRUE;
 }
 
+/***********************************************************************
+ *           find_region_band
+ *
+ * Return the index of the first rectangle at or after start whose bottom
+ * is below y.  Rectangles are sorted in bands that don't overlap, so this is
+ * the first one that can intersect row y, and find_region_band( rgn, i,
+ * rgn->rects[i].bottom ) is the start of the band following rectangle i.
+ */
+int find_region_band( const WINEREGION *rgn, int start, int y )
+{
+    int end = rgn->numRects, pos;
+
+    while (start < end)
+    {
+        pos = (start + end) / 2;
+        if (rgn->rects[pos].bottom <= y) start = pos + 1;
+        else end = pos;
+    }
+    return start;
+}
+
+/***********************************************************************
+ *           find_region_rect
+ *
+ * Return the index of the first rectangle of the band [start, end) whose
+ * right edge is to the right of x.
+ */
+int find_region_rect( const WINEREGION *rgn, int start, int end, int x )
+{
+    int pos;
+
+    while (start < end)
+    {
+        pos = (start + end) / 2;
+        if (rgn->rects[pos].right <= x) start = pos + 1;
+        else end = pos;
+    }
+    return start;
+}
+
 /***********************************************************************
  *           destroy_region
  */
@@ -1042,15 +1082,15 @@ BOOL WINAPI PtInRegion( HRGN hrgn, INT x, INT y )
 
     if ((obj = GDI_GetObjPtr( hrgn, OBJ_REGION )))
     {
-	int i;
+	int i, end;
 
 	if (obj->numRects > 0 && is_in_rect(&obj->extents, x, y))
-	    for (i = 0; i < obj->numRects; i++)
-		if (is_in_rect(&obj->rects[i], x, y))
-                {
-		    ret = TRUE;
-                    break;
-                }
+	{
+	    i = find_region_band( obj, 0, y );
+	    end = find_region_band( obj, i, obj->rects[i].bottom );
+	    i = find_region_rect( obj, i, end, x );
+	    ret = (i < end && is_in_rect(&obj->rects[i], x, y));
+	}
 	GDI_ReleaseObj( hrgn );
     }
     return ret;
@@ -1083,29 +1123,23 @@ BOOL WINAPI RectInRegion( HRGN hrgn, const RECT *rect )
 
     if ((obj = GDI_GetObjPtr( hrgn, OBJ_REGION )))
     {
-	RECT *pCurRect, *pRectEnd;
+	int i, end;
 
     /* this is (just) a useful optimization */
 	if ((obj->numRects > 0) && overlapping(&obj->extents, &rc))
 	{
-	    for (pCurRect = obj->rects, pRectEnd = pCurRect +
-	     obj->numRects; pCurRect < pRectEnd; pCurRect++)
+	    for (i = find_region_band( obj, 0, rc.top ); i < obj->numRects; i = end)
 	    {
-	        if (pCurRect->bottom <= rc.top)
-		    continue;             /* not far enough down yet */
-
-		if (pCurRect->top >= rc.bottom)
+		if (obj->rects[i].top >= rc.bottom)
 		    break;                /* too far down */
 
-		if (pCurRect->right <= rc.left)
-		    continue;              /* not far enough over yet */
-
-		if (pCurRect->left >= rc.right) {
-		    continue;
+		end = find_region_band( obj, i, obj->rects[i].bottom );
+		i = find_region_rect( obj, i, end, rc.left );
+		if (i < end && obj->rects[i].left < rc.right)
+		{
+		    ret = TRUE;
+		    break;
 		}
-
-		ret = TRUE;
-		break;
 	    }
 	}
 	GDI_ReleaseObj(hrgn);
@@ -512,6 +512,82 @@ static void test_window_dc_clipping(void)
 }
 
 
+static void test_complex_clip_region(void)
+{
+    BITMAPINFO bmi;
+    HBITMAP dib, old;
+    HRGN hrgn, cell;
+    DWORD *bits;
+    RECT rc;
+    HDC hdc;
+    int x, y, ret, inside;
+
+    /* checkerboard of 8x8 cells, which gives a region with many bands of many rectangles */
+    hrgn = CreateRectRgn( 0, 0, 0, 0 );
+    for (y = 0; y < 32; y++)
+        for (x = y & 1; x < 32; x += 2)
+        {
+            cell = CreateRectRgn( x * 8, y * 8, x * 8 + 8, y * 8 + 8 );
+            CombineRgn( hrgn, hrgn, cell, RGN_OR );
+            DeleteObject( cell );
+        }
+
+    for (y = -1; y <= 256; y += 3)
+        for (x = -1; x <= 256; x += 3)
+        {
+            inside = x >= 0 && y >= 0 && x < 256 && y < 256 && !(((x / 8) ^ (y / 8)) & 1);
+            ret = PtInRegion( hrgn, x, y );
+            ok( ret == inside, "PtInRegion( %d, %d ) returned %d\n", x, y, ret );
+        }
+
+    for (y = 0; y < 256; y += 5)
+        for (x = 0; x < 256; x += 5)
+        {
+            /* inside a single cell */
+            SetRect( &rc, x, y, x + 1, y + 1 );
+            inside = !(((x / 8) ^ (y / 8)) & 1);
+            ret = RectInRegion( hrgn, &rc );
+            ok( ret == inside, "RectInRegion( %d,%d-%d,%d ) returned %d\n",
+                rc.left, rc.top, rc.right, rc.bottom, ret );
+        }
+    SetRect( &rc, 8, 0, 16, 8 );
+    ok( !RectInRegion( hrgn, &rc ), "RectInRegion succeeded on a hole\n" );
+    SetRect( &rc, 250, 7, 252, 9 );
+    ok( RectInRegion( hrgn, &rc ), "RectInRegion failed across two bands\n" );
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize        = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth       = 256;
+    bmi.bmiHeader.biHeight      = -256;
+    bmi.bmiHeader.biPlanes      = 1;
+    bmi.bmiHeader.biBitCount    = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    hdc = CreateCompatibleDC( 0 );
+    dib = CreateDIBSection( hdc, &bmi, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    ok( dib != NULL, "CreateDIBSection failed\n" );
+    old = SelectObject( hdc, dib );
+
+    memset( bits, 0, 256 * 256 * 4 );
+    ExtSelectClipRgn( hdc, hrgn, RGN_COPY );
+    PatBlt( hdc, 3, 21, 200, 150, WHITENESS );
+    for (y = 0; y < 256; y++)
+        for (x = 0; x < 256; x++)
+        {
+            inside = x >= 3 && y >= 21 && x < 203 && y < 171 && !(((x / 8) ^ (y / 8)) & 1);
+            if (bits[y * 256 + x] != (inside ? 0xffffff : 0))
+            {
+                ok( 0, "wrong pixel %08x at %d,%d\n", bits[y * 256 + x], x, y );
+                y = 256;
+                break;
+            }
+        }
+
+    SelectObject( hdc, old );
+    DeleteObject( dib );
+    DeleteDC( hdc );
+    DeleteObject( hrgn );
+}
+
 START_TEST(clipping)
 {
     test_GetRandomRgn();
@@ -519,4 +595,5 @@ START_TEST(clipping)
     test_GetClipRgn();
     test_memory_dc_clipping();
     test_window_dc_clipping();
+    test_complex_clip_region();
 }
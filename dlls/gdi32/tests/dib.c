@@ -25,6 +25,7 @@
 #include "windef.h"
 #include "winbase.h"
 #include "wingdi.h"
+#include "winreg.h"
 #include "winuser.h"
 #include "wincrypt.h"
 #include "mmsystem.h" /* DIBINDEX */
@@ -3199,16 +3200,501 @@ static void test_simple_graphics(void)
     DeleteDC(mem_dc);
 }
 
+static DWORD span_seed;
+
+static DWORD span_rand(void)
+{
+    span_seed = span_seed * 1103515245 + 12345;
+    return (span_seed >> 16) | (span_seed << 16);
+}
+
+static inline BYTE span_blend_color( BYTE dst, BYTE src, DWORD alpha )
+{
+    return (src * alpha + dst * (255 - alpha) + 127) / 255;
+}
+
+static DWORD span_blend( DWORD dst, DWORD src, BLENDFUNCTION blend )
+{
+    DWORD alpha = blend.SourceConstantAlpha, res = 0;
+    int i;
+
+    if (!(blend.AlphaFormat & AC_SRC_ALPHA))
+    {
+        for (i = 0; i < 32; i += 8)
+            res |= span_blend_color( dst >> i, src >> i, alpha ) << i;
+        return res;
+    }
+    if (alpha != 255)
+    {
+        for (i = 0; i < 32; i += 8)
+            res |= (((src >> i) & 0xff) * alpha + 127) / 255 << i;
+        src = res;
+        res = 0;
+    }
+    alpha = src >> 24;
+    for (i = 0; i < 32; i += 8)
+        res |= (((src >> i) & 0xff) + (((dst >> i) & 0xff) * (255 - alpha) + 127) / 255) << i;
+    return res;
+}
+
+/* The 32-bpp fills, blits and blends are vectorized on some cpus; check that
+ * spans of every width and alignment give the same bits as the per-pixel
+ * formulas, including the partial vectors at the end of each row. */
+static void test_32bpp_spans(void)
+{
+    static const DWORD rops[] = { SRCINVERT, SRCAND, SRCPAINT, SRCERASE, NOTSRCCOPY, NOTSRCERASE, MERGEPAINT };
+    static const BYTE alphas[] = { 255, 128, 1, 0 };
+    BITMAPINFO bmi;
+    HDC src_dc, dst_dc;
+    HBITMAP src_dib, dst_dib, orig_src, orig_dst;
+    DWORD *src_bits, *dst_bits, orig[16 * 3], expect, src, dst;
+    BLENDFUNCTION blend;
+    HBRUSH brush, orig_brush;
+    int i, x, y, left, width, r, a, fmt;
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = 16;
+    bmi.bmiHeader.biHeight = -3;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    src_dc = CreateCompatibleDC( NULL );
+    dst_dc = CreateCompatibleDC( NULL );
+    src_dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    dst_dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    orig_src = SelectObject( src_dc, src_dib );
+    orig_dst = SelectObject( dst_dc, dst_dib );
+    span_seed = 0x1234;
+
+    for (left = 0; left < 4; left++)
+    {
+        for (width = 1; width <= 11; width++)
+        {
+            for (i = 0; i < 16 * 3; i++)
+            {
+                /* premultiplied source with partial alpha */
+                a = span_rand() & 0xff;
+                src_bits[i] = ((DWORD)a << 24) | ((span_rand() & 0xff) * a / 255 << 16) |
+                              ((span_rand() & 0xff) * a / 255 << 8) | ((span_rand() & 0xff) * a / 255);
+                orig[i] = span_rand();
+            }
+
+            for (r = 0; r < sizeof(rops) / sizeof(rops[0]); r++)
+            {
+                memcpy( dst_bits, orig, sizeof(orig) );
+                BitBlt( dst_dc, left, 0, width, 3, src_dc, 0, 0, rops[r] );
+                for (y = 0; y < 3; y++)
+                {
+                    for (x = 0; x < 16; x++)
+                    {
+                        expect = dst = orig[y * 16 + x];
+                        if (x >= left && x < left + width)
+                        {
+                            src = src_bits[y * 16 + x - left];
+                            switch (rops[r])
+                            {
+                            case SRCINVERT:   expect = dst ^ src; break;
+                            case SRCAND:      expect = dst & src; break;
+                            case SRCPAINT:    expect = dst | src; break;
+                            case SRCERASE:    expect = ~dst & src; break;
+                            case NOTSRCCOPY:  expect = ~src; break;
+                            case NOTSRCERASE: expect = ~(dst | src); break;
+                            case MERGEPAINT:  expect = dst | ~src; break;
+                            }
+                        }
+                        ok( dst_bits[y * 16 + x] == expect, "rop %06x left %d width %d (%d,%d): got %08x expected %08x\n",
+                            rops[r], left, width, x, y, dst_bits[y * 16 + x], expect );
+                    }
+                }
+            }
+
+            memcpy( dst_bits, orig, sizeof(orig) );
+            brush = CreateSolidBrush( RGB( 0x12, 0x34, 0x56 ));
+            orig_brush = SelectObject( dst_dc, brush );
+            PatBlt( dst_dc, left, 0, width, 3, PATINVERT );
+            PatBlt( dst_dc, left, 0, width, 3, DSTINVERT );
+            SelectObject( dst_dc, orig_brush );
+            DeleteObject( brush );
+            for (i = 0; i < 16 * 3; i++)
+            {
+                x = i % 16;
+                expect = orig[i];
+                if (x >= left && x < left + width) expect = ~(expect ^ 0x123456);
+                ok( dst_bits[i] == expect, "fill left %d width %d (%d,%d): got %08x expected %08x\n",
+                    left, width, x, i / 16, dst_bits[i], expect );
+            }
+
+            if (!pGdiAlphaBlend) continue;
+
+            for (fmt = 0; fmt < 2; fmt++)
+            {
+                for (a = 0; a < sizeof(alphas); a++)
+                {
+                    blend.BlendOp = AC_SRC_OVER;
+                    blend.BlendFlags = 0;
+                    blend.SourceConstantAlpha = alphas[a];
+                    blend.AlphaFormat = fmt ? AC_SRC_ALPHA : 0;
+                    memcpy( dst_bits, orig, sizeof(orig) );
+                    pGdiAlphaBlend( dst_dc, left, 0, width, 3, src_dc, 0, 0, width, 3, blend );
+                    for (y = 0; y < 3; y++)
+                    {
+                        for (x = 0; x < 16; x++)
+                        {
+                            expect = orig[y * 16 + x];
+                            if (x >= left && x < left + width)
+                                expect = span_blend( expect, src_bits[y * 16 + x - left], blend );
+                            ok( dst_bits[y * 16 + x] == expect,
+                                "blend %02x/%u left %d width %d (%d,%d): got %08x expected %08x\n",
+                                blend.AlphaFormat, blend.SourceConstantAlpha, left, width, x, y,
+                                dst_bits[y * 16 + x], expect );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    SelectObject( src_dc, orig_src );
+    SelectObject( dst_dc, orig_dst );
+    DeleteObject( src_dib );
+    DeleteObject( dst_dib );
+    DeleteDC( src_dc );
+    DeleteDC( dst_dc );
+}
+
+#define GLYPH_TEST_WIDTH  320
+#define GLYPH_TEST_HEIGHT 24
+
+/* render some antialiased text into a 32-bpp buffer */
+static void draw_glyph_cache_text( DWORD *buffer )
+{
+    static const char text[] = "The quick brown fox jumps over the lazy dog 0123456789";
+    BITMAPINFO bmi;
+    LOGFONTA lf;
+    HDC hdc;
+    HBITMAP dib, orig_bm;
+    HFONT font, orig_font;
+    DWORD *bits;
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = GLYPH_TEST_WIDTH;
+    bmi.bmiHeader.biHeight = -GLYPH_TEST_HEIGHT;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    memset( &lf, 0, sizeof(lf) );
+    lf.lfHeight = -16;
+    lf.lfQuality = ANTIALIASED_QUALITY;
+    strcpy( lf.lfFaceName, "Tahoma" );
+
+    hdc = CreateCompatibleDC( NULL );
+    dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    orig_bm = SelectObject( hdc, dib );
+    font = CreateFontIndirectA( &lf );
+    orig_font = SelectObject( hdc, font );
+
+    PatBlt( hdc, 0, 0, GLYPH_TEST_WIDTH, GLYPH_TEST_HEIGHT, WHITENESS );
+    SetTextColor( hdc, RGB( 0x20, 0x40, 0x80 ));
+    SetBkMode( hdc, TRANSPARENT );
+    TextOutA( hdc, 2, 2, text, strlen(text) );
+    memcpy( buffer, bits, GLYPH_TEST_WIDTH * GLYPH_TEST_HEIGHT * 4 );
+
+    SelectObject( hdc, orig_font );
+    DeleteObject( font );
+    SelectObject( hdc, orig_bm );
+    DeleteObject( dib );
+    DeleteDC( hdc );
+}
+
+static void run_child( const char *cmdline )
+{
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    char buffer[3 * MAX_PATH];
+    BOOL ret;
+
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    strcpy( buffer, cmdline );
+    ret = CreateProcessA( NULL, buffer, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info );
+    ok( ret, "failed to create child process error %u\n", GetLastError() );
+    if (!ret) return;
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hThread );
+    CloseHandle( info.hProcess );
+}
+
+/* Render the text in the child and store the result in the first file. If
+ * there is a second file, run another child while this one is still alive,
+ * so that it finds the glyphs that have just been rendered. */
+static void test_glyph_cache_child( char **argv, int argc )
+{
+    static DWORD buffer[GLYPH_TEST_WIDTH * GLYPH_TEST_HEIGHT];
+    char cmdline[3 * MAX_PATH];
+    HANDLE file;
+    DWORD written;
+
+    draw_glyph_cache_text( buffer );
+    file = CreateFileA( argv[3], GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "failed to create %s error %u\n", argv[3], GetLastError() );
+    WriteFile( file, buffer, sizeof(buffer), &written, NULL );
+    CloseHandle( file );
+
+    if (argc < 5) return;
+    sprintf( cmdline, "%s dib glyph_cache %s", argv[0], argv[4] );
+    run_child( cmdline );
+}
+
+static void check_glyph_cache_file( const char *name, const DWORD *expect )
+{
+    static DWORD buffer[GLYPH_TEST_WIDTH * GLYPH_TEST_HEIGHT];
+    HANDLE file;
+    DWORD size = 0;
+
+    file = CreateFileA( name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "failed to open %s error %u\n", name, GetLastError() );
+    ReadFile( file, buffer, sizeof(buffer), &size, NULL );
+    CloseHandle( file );
+    DeleteFileA( name );
+    ok( size == sizeof(buffer), "got %u bytes\n", size );
+    ok( !memcmp( buffer, expect, sizeof(buffer) ), "%s: text rendered differently\n", name );
+}
+
+/* Rendered glyphs can be shared between processes when the GlyphCache value
+ * of the DIB engine key is set. It must not change the result, neither when
+ * the glyphs are rendered and added to the cache, nor when they are taken
+ * from it. */
+static void test_shared_glyph_cache(void)
+{
+    static DWORD expect[GLYPH_TEST_WIDTH * GLYPH_TEST_HEIGHT];
+    char temp[MAX_PATH], files[2][MAX_PATH], cmdline[3 * MAX_PATH], old[16], **argv;
+    DWORD disposition, old_type, old_size = sizeof(old);
+    BOOL has_old;
+    HKEY key;
+
+    if (RegCreateKeyExA( HKEY_CURRENT_USER, "Software\\Wine\\DIB Engine", 0, NULL, 0,
+                         KEY_ALL_ACCESS, NULL, &key, &disposition ))
+    {
+        skip( "can't create the DIB engine key\n" );
+        return;
+    }
+    has_old = !RegQueryValueExA( key, "GlyphCache", NULL, &old_type, (BYTE *)old, &old_size );
+    RegSetValueExA( key, "GlyphCache", 0, REG_SZ, (const BYTE *)"4", 2 );
+
+    winetest_get_mainargs( &argv );
+    draw_glyph_cache_text( expect );
+
+    GetTempPathA( MAX_PATH, temp );
+    GetTempFileNameA( temp, "gly", 0, files[0] );
+    GetTempFileNameA( temp, "gly", 0, files[1] );
+
+    sprintf( cmdline, "%s dib glyph_cache %s %s", argv[0], files[0], files[1] );
+    run_child( cmdline );
+
+    if (has_old) RegSetValueExA( key, "GlyphCache", 0, old_type, (BYTE *)old, old_size );
+    else RegDeleteValueA( key, "GlyphCache" );
+    RegCloseKey( key );
+    if (disposition == REG_CREATED_NEW_KEY) RegDeleteKeyA( HKEY_CURRENT_USER, "Software\\Wine\\DIB Engine" );
+
+    check_glyph_cache_file( files[0], expect );
+    check_glyph_cache_file( files[1], expect );
+}
+
+#define BAND_TEST_WIDTH  640
+#define BAND_TEST_HEIGHT 480
+#define BAND_TEST_SIZE   (BAND_TEST_WIDTH * BAND_TEST_HEIGHT)
+
+/* fill a buffer with a repeatable pattern of premultiplied pixels */
+static void fill_band_pattern( DWORD *bits, int count, DWORD seed )
+{
+    BYTE a, r, g, b;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        a = seed >> 24;
+        r = (seed >> 16) % (a + 1);
+        g = (seed >> 8) % (a + 1);
+        b = seed % (a + 1);
+        bits[i] = (a << 24) | (r << 16) | (g << 8) | b;
+    }
+}
+
+/* Render operations that are large enough to be split into bands into
+ * three 32-bpp buffers: a StretchBlt, an AlphaBlend and a clipped GradientFill. */
+static void draw_band_test( DWORD *buffer )
+{
+    static const BLENDFUNCTION blend = { AC_SRC_OVER, 0, 0xc0, AC_SRC_ALPHA };
+    TRIVERTEX vert[3] =
+    {
+        { 0, 0, 0xff00, 0x8000, 0x0000, 0x8000 },
+        { BAND_TEST_WIDTH, BAND_TEST_HEIGHT / 3, 0x0000, 0xff00, 0x4000, 0xff00 },
+        { BAND_TEST_WIDTH / 4, BAND_TEST_HEIGHT, 0x2000, 0x1000, 0xff00, 0x0000 },
+    };
+    GRADIENT_TRIANGLE tri = { 0, 1, 2 };
+    BITMAPINFO bmi;
+    HDC hdc, src_dc;
+    HBITMAP dib, src_dib, orig_bm, orig_src_bm;
+    HRGN rgn;
+    DWORD *bits, *src_bits;
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = BAND_TEST_WIDTH;
+    bmi.bmiHeader.biHeight = -BAND_TEST_HEIGHT;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    hdc = CreateCompatibleDC( NULL );
+    dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    orig_bm = SelectObject( hdc, dib );
+
+    bmi.bmiHeader.biWidth = 200;
+    bmi.bmiHeader.biHeight = -150;
+    src_dc = CreateCompatibleDC( NULL );
+    src_dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    orig_src_bm = SelectObject( src_dc, src_dib );
+    fill_band_pattern( src_bits, 200 * 150, 1 );
+
+    SetStretchBltMode( hdc, COLORONCOLOR );
+    StretchBlt( hdc, 0, 0, BAND_TEST_WIDTH, BAND_TEST_HEIGHT, src_dc, 10, 5, 180, 140, SRCCOPY );
+    memcpy( buffer, bits, BAND_TEST_SIZE * 4 );
+
+    fill_band_pattern( bits, BAND_TEST_SIZE, 2 );
+    pGdiAlphaBlend( hdc, 0, 0, BAND_TEST_WIDTH, BAND_TEST_HEIGHT, src_dc, 0, 0, 200, 150, blend );
+    memcpy( buffer + BAND_TEST_SIZE, bits, BAND_TEST_SIZE * 4 );
+
+    fill_band_pattern( bits, BAND_TEST_SIZE, 3 );
+    rgn = CreateRectRgn( 0, 0, BAND_TEST_WIDTH, BAND_TEST_HEIGHT );
+    SelectClipRgn( hdc, rgn );
+    ExcludeClipRect( hdc, 100, 50, 300, 400 );
+    pGdiGradientFill( hdc, vert, 3, &tri, 1, GRADIENT_FILL_TRIANGLE );
+    memcpy( buffer + 2 * BAND_TEST_SIZE, bits, BAND_TEST_SIZE * 4 );
+    SelectClipRgn( hdc, NULL );
+    DeleteObject( rgn );
+
+    SelectObject( src_dc, orig_src_bm );
+    DeleteObject( src_dib );
+    DeleteDC( src_dc );
+    SelectObject( hdc, orig_bm );
+    DeleteObject( dib );
+    DeleteDC( hdc );
+}
+
+static void test_band_threads_child( const char *name )
+{
+    DWORD *buffer, written;
+    HANDLE file;
+
+    buffer = HeapAlloc( GetProcessHeap(), 0, 3 * BAND_TEST_SIZE * 4 );
+    draw_band_test( buffer );
+    file = CreateFileA( name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "failed to create %s error %u\n", name, GetLastError() );
+    WriteFile( file, buffer, 3 * BAND_TEST_SIZE * 4, &written, NULL );
+    CloseHandle( file );
+    HeapFree( GetProcessHeap(), 0, buffer );
+}
+
+static DWORD *read_band_test_file( const char *name )
+{
+    DWORD *buffer, size = 0;
+    HANDLE file;
+
+    buffer = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, 3 * BAND_TEST_SIZE * 4 );
+    file = CreateFileA( name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "failed to open %s error %u\n", name, GetLastError() );
+    ReadFile( file, buffer, 3 * BAND_TEST_SIZE * 4, &size, NULL );
+    CloseHandle( file );
+    DeleteFileA( name );
+    ok( size == 3 * BAND_TEST_SIZE * 4, "got %u bytes\n", size );
+    return buffer;
+}
+
+/* The DIB engine can render large operations in bands on several threads
+ * when the Threads value of its registry key is set. The option is read
+ * once per process, so render the same operations in a child with one
+ * thread and in a child with four, and compare the results. */
+static void test_band_threads(void)
+{
+    static const char * const names[] = { "StretchBlt", "AlphaBlend", "GradientFill" };
+    static const char * const threads[] = { "1", "4" };
+    char temp[MAX_PATH], files[2][MAX_PATH], cmdline[3 * MAX_PATH], old[16], **argv;
+    DWORD *results[2], disposition, old_type, old_size = sizeof(old);
+    BOOL has_old;
+    HKEY key;
+    int i;
+
+    if (!pGdiAlphaBlend || !pGdiGradientFill)
+    {
+        win_skip( "GdiAlphaBlend or GdiGradientFill not available\n" );
+        return;
+    }
+    if (RegCreateKeyExA( HKEY_CURRENT_USER, "Software\\Wine\\DIB Engine", 0, NULL, 0,
+                         KEY_ALL_ACCESS, NULL, &key, &disposition ))
+    {
+        skip( "can't create the DIB engine key\n" );
+        return;
+    }
+    has_old = !RegQueryValueExA( key, "Threads", NULL, &old_type, (BYTE *)old, &old_size );
+
+    winetest_get_mainargs( &argv );
+    GetTempPathA( MAX_PATH, temp );
+    for (i = 0; i < 2; i++)
+    {
+        GetTempFileNameA( temp, "bnd", 0, files[i] );
+        RegSetValueExA( key, "Threads", 0, REG_SZ, (const BYTE *)threads[i], strlen(threads[i]) + 1 );
+        sprintf( cmdline, "%s dib band_threads %s", argv[0], files[i] );
+        run_child( cmdline );
+        results[i] = read_band_test_file( files[i] );
+    }
+
+    if (has_old) RegSetValueExA( key, "Threads", 0, old_type, (BYTE *)old, old_size );
+    else RegDeleteValueA( key, "Threads" );
+    RegCloseKey( key );
+    if (disposition == REG_CREATED_NEW_KEY) RegDeleteKeyA( HKEY_CURRENT_USER, "Software\\Wine\\DIB Engine" );
+
+    for (i = 0; i < 3; i++)
+        ok( !memcmp( results[0] + i * BAND_TEST_SIZE, results[1] + i * BAND_TEST_SIZE, BAND_TEST_SIZE * 4 ),
+            "%s: banded output differs from the serial one\n", names[i] );
+
+    HeapFree( GetProcessHeap(), 0, results[0] );
+    HeapFree( GetProcessHeap(), 0, results[1] );
+}
+
 START_TEST(dib)
 {
     HMODULE mod = GetModuleHandleA("gdi32.dll");
+    char **argv;
+    int argc;
+
     pSetLayout = (void *)GetProcAddress( mod, "SetLayout" );
     pGdiAlphaBlend = (void *)GetProcAddress( mod, "GdiAlphaBlend" );
     pGdiGradientFill = (void *)GetProcAddress( mod, "GdiGradientFill" );
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 4 && !strcmp( argv[2], "glyph_cache" ))
+    {
+        test_glyph_cache_child( argv, argc );
+        return;
+    }
+    if (argc >= 4 && !strcmp( argv[2], "band_threads" ))
+    {
+        test_band_threads_child( argv[3] );
+        return;
+    }
+
     CryptAcquireContextW(&crypt_prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
 
     test_simple_graphics();
+    test_32bpp_spans();
+    test_shared_glyph_cache();
+    test_band_threads();
 
     CryptReleaseContext(crypt_prov, 0);
 }
@@ -57,6 +57,7 @@ typedef struct
     HANDLE            handle;      /* handle to directory */
     CRITICAL_SECTION  cs;          /* crit section protecting this structure */
     FINDEX_SEARCH_OPS search_op;   /* Flags passed to FindFirst.  */
+    FINDEX_INFO_LEVELS level;      /* Level passed to FindFirst */
     UNICODE_STRING    mask;        /* file mask */
     UNICODE_STRING    path;        /* NT path used to open the directory */
     BOOL              is_root;     /* is directory the root of the drive? */
@@ -118,7 +119,7 @@ static HANDLE create_file_OF( LPCSTR path, INT mode )
  *
  * Check if a dir symlink should be returned by FindNextFile.
  */
-static BOOL check_dir_symlink( FIND_FIRST_INFO *info, const FILE_BOTH_DIR_INFORMATION *file_info )
+static BOOL check_dir_symlink( FIND_FIRST_INFO *info, const WCHAR *name, ULONG name_len )
 {
     UNICODE_STRING str;
     ANSI_STRING unix_name;
@@ -126,13 +127,13 @@ static BOOL check_dir_symlink( FIND_FIRST_INFO *info, const FILE_BOTH_DIR_INFORM
     BOOL ret = TRUE;
     DWORD len;
 
-    str.MaximumLength = info->path.Length + sizeof(WCHAR) + file_info->FileNameLength;
+    str.MaximumLength = info->path.Length + sizeof(WCHAR) + name_len;
     if (!(str.Buffer = HeapAlloc( GetProcessHeap(), 0, str.MaximumLength ))) return TRUE;
     memcpy( str.Buffer, info->path.Buffer, info->path.Length );
     len = info->path.Length / sizeof(WCHAR);
     if (!len || str.Buffer[len-1] != '\\') str.Buffer[len++] = '\\';
-    memcpy( str.Buffer + len, file_info->FileName, file_info->FileNameLength );
-    str.Length = len * sizeof(WCHAR) + file_info->FileNameLength;
+    memcpy( str.Buffer + len, name, name_len );
+    str.Length = len * sizeof(WCHAR) + name_len;
 
     unix_name.Buffer = NULL;
     if (!wine_nt_to_unix_file_name( &str, &unix_name, OPEN_EXISTING, FALSE ) &&
@@ -1829,6 +1830,13 @@ BOOL WINAPI ReplaceFileA(LPCSTR lpReplacedFileName,LPCSTR lpReplacementFileName,
 }
 
 
+/* the directory information class to use for a given search */
+static inline FILE_INFORMATION_CLASS get_find_info_class( const FIND_FIRST_INFO *info )
+{
+    if (info->level == FindExInfoBasic) return FileFullDirectoryInformation;
+    return FileBothDirectoryInformation;
+}
+
 /*************************************************************************
  *           FindFirstFileExW  (KERNEL32.@)
  *
@@ -1850,12 +1858,12 @@ HANDLE WINAPI FindFirstFileExW( LPCWSTR filename, FINDEX_INFO_LEVELS level,
     TRACE("%s %d %p %d %p %x\n", debugstr_w(filename), level, data, search_op, filter, flags);
 
     if ((search_op != FindExSearchNameMatch && search_op != FindExSearchLimitToDirectories)
-	|| flags != 0)
+	|| (flags & ~FIND_FIRST_EX_LARGE_FETCH))
     {
         FIXME("options not implemented 0x%08x 0x%08x\n", search_op, flags );
         return INVALID_HANDLE_VALUE;
     }
-    if (level != FindExInfoStandard)
+    if (level != FindExInfoStandard && level != FindExInfoBasic)
     {
         FIXME("info level %d not implemented\n", level );
         return INVALID_HANDLE_VALUE;
@@ -1958,6 +1966,7 @@ HANDLE WINAPI FindFirstFileExW( LPCWSTR filename, FINDEX_INFO_LEVELS level,
     info->data_size = 0;
     info->data      = NULL;
     info->search_op = search_op;
+    info->level     = level;
 
     if (device)
     {
@@ -1974,7 +1983,8 @@ HANDLE WINAPI FindFirstFileExW( LPCWSTR filename, FINDEX_INFO_LEVELS level,
         IO_STATUS_BLOCK io;
         BOOL has_wildcard = strpbrkW( info->mask.Buffer, wildcardsW ) != NULL;
 
-        info->data_size = has_wildcard ? 8192 : max_entry_size * 2;
+        if (!has_wildcard) info->data_size = max_entry_size * 2;
+        else info->data_size = (flags & FIND_FIRST_EX_LARGE_FETCH) ? 65536 : 8192;
 
         while (info->data_size)
         {
@@ -1986,7 +1996,7 @@ HANDLE WINAPI FindFirstFileExW( LPCWSTR filename, FINDEX_INFO_LEVELS level,
             }
 
             NtQueryDirectoryFile( info->handle, 0, NULL, NULL, &io, info->data, info->data_size,
-                                  FileBothDirectoryInformation, FALSE, &info->mask, TRUE );
+                                  get_find_info_class( info ), FALSE, &info->mask, TRUE );
             if (io.u.Status)
             {
                 FindClose( info );
@@ -2041,6 +2051,7 @@ BOOL WINAPI FindNextFileW( HANDLE handle, WIN32_FIND_DATAW *data )
 {
     FIND_FIRST_INFO *info;
     FILE_BOTH_DIR_INFORMATION *dir_info;
+    const WCHAR *name;
     BOOL ret = FALSE;
 
     TRACE("%p %p\n", handle, data);
@@ -2068,7 +2079,7 @@ BOOL WINAPI FindNextFileW( HANDLE handle, WIN32_FIND_DATAW *data )
 
             if (info->data_size)
                 NtQueryDirectoryFile( info->handle, 0, NULL, NULL, &io, info->data, info->data_size,
-                                      FileBothDirectoryInformation, FALSE, &info->mask, FALSE );
+                                      get_find_info_class( info ), FALSE, &info->mask, FALSE );
             else
                 io.u.Status = STATUS_NO_MORE_FILES;
 
@@ -2093,12 +2104,18 @@ BOOL WINAPI FindNextFileW( HANDLE handle, WIN32_FIND_DATAW *data )
         if (dir_info->NextEntryOffset) info->data_pos += dir_info->NextEntryOffset;
         else info->data_pos = info->data_len;
 
+        /* the basic level doesn't return short names, all the other fields have the same layout */
+        if (info->level == FindExInfoBasic)
+            name = ((FILE_FULL_DIR_INFORMATION *)dir_info)->FileName;
+        else
+            name = dir_info->FileName;
+
         /* don't return '.' and '..' in the root of the drive */
         if (info->is_root)
         {
-            if (dir_info->FileNameLength == sizeof(WCHAR) && dir_info->FileName[0] == '.') continue;
+            if (dir_info->FileNameLength == sizeof(WCHAR) && name[0] == '.') continue;
             if (dir_info->FileNameLength == 2 * sizeof(WCHAR) &&
-                dir_info->FileName[0] == '.' && dir_info->FileName[1] == '.') continue;
+                name[0] == '.' && name[1] == '.') continue;
         }
 
         /* check for dir symlink */
@@ -2106,7 +2123,7 @@ BOOL WINAPI FindNextFileW( HANDLE handle, WIN32_FIND_DATAW *data )
             (dir_info->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
             strpbrkW( info->mask.Buffer, wildcardsW ))
         {
-            if (!check_dir_symlink( info, dir_info )) continue;
+            if (!check_dir_symlink( info, name, dir_info->FileNameLength )) continue;
         }
 
         data->dwFileAttributes = dir_info->FileAttributes;
@@ -2118,10 +2135,15 @@ BOOL WINAPI FindNextFileW( HANDLE handle, WIN32_FIND_DATAW *data )
         data->dwReserved0      = 0;
         data->dwReserved1      = 0;
 
-        memcpy( data->cFileName, dir_info->FileName, dir_info->FileNameLength );
+        memcpy( data->cFileName, name, dir_info->FileNameLength );
         data->cFileName[dir_info->FileNameLength/sizeof(WCHAR)] = 0;
-        memcpy( data->cAlternateFileName, dir_info->ShortName, dir_info->ShortNameLength );
-        data->cAlternateFileName[dir_info->ShortNameLength/sizeof(WCHAR)] = 0;
+        if (info->level == FindExInfoBasic)
+            data->cAlternateFileName[0] = 0;
+        else
+        {
+            memcpy( data->cAlternateFileName, dir_info->ShortName, dir_info->ShortNameLength );
+            data->cAlternateFileName[dir_info->ShortNameLength/sizeof(WCHAR)] = 0;
+        }
 
         TRACE("returning %s (%s)\n",
               debugstr_w(data->cFileName), debugstr_w(data->cAlternateFileName) );
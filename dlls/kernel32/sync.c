@@ -2141,6 +2141,55 @@ BOOL WINAPI GetQueuedCompletionStatus( HANDLE CompletionPort, LPDWORD lpNumberOf
 }
 
 
+/******************************************************************************
+ *		GetQueuedCompletionStatusEx (KERNEL32.@)
+ */
+BOOL WINAPI GetQueuedCompletionStatusEx( HANDLE port, OVERLAPPED_ENTRY *entries, ULONG count,
+                                         ULONG *written, DWORD timeout, BOOL alertable )
+{
+    FILE_IO_COMPLETION_INFORMATION buffer[64], *info = buffer;
+    LARGE_INTEGER time;
+    NTSTATUS status;
+    ULONG i, ret;
+
+    TRACE( "%p %p %u %p %u %u\n", port, entries, count, written, timeout, alertable );
+
+    if (!count)
+    {
+        SetLastError( ERROR_INVALID_PARAMETER );
+        return FALSE;
+    }
+    if (count > sizeof(buffer) / sizeof(buffer[0]) &&
+        !(info = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*info) )))
+    {
+        SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+        return FALSE;
+    }
+
+    status = NtRemoveIoCompletionEx( port, info, count, &ret, get_nt_timeout( &time, timeout ), alertable );
+    if (status == STATUS_SUCCESS)
+    {
+        for (i = 0; i < ret; i++)
+        {
+            entries[i].lpCompletionKey            = info[i].CompletionKey;
+            entries[i].lpOverlapped               = (LPOVERLAPPED)info[i].CompletionValue;
+            entries[i].Internal                   = info[i].IoStatusBlock.u.Status;
+            entries[i].dwNumberOfBytesTransferred = info[i].IoStatusBlock.Information;
+        }
+        if (info != buffer) HeapFree( GetProcessHeap(), 0, info );
+        *written = ret;
+        return TRUE;
+    }
+
+    if (info != buffer) HeapFree( GetProcessHeap(), 0, info );
+    *written = 0;
+    if (status == STATUS_TIMEOUT) SetLastError( WAIT_TIMEOUT );
+    else if (status == STATUS_USER_APC) SetLastError( WAIT_IO_COMPLETION );
+    else SetLastError( RtlNtStatusToDosError(status) );
+    return FALSE;
+}
+
+
 /******************************************************************************
  *		PostQueuedCompletionStatus (KERNEL32.@)
  */
@@ -2266,6 +2315,42 @@ BOOL WINAPI InitOnceExecuteOnce( INIT_ONCE *once, PINIT_ONCE_FN func, void *para
     return !RtlRunOnceExecuteOnce( once, (PRTL_RUN_ONCE_INIT_FN)func, param, context );
 }
 
+/***********************************************************************
+ *           SleepConditionVariableCS   (KERNEL32.@)
+ */
+BOOL WINAPI SleepConditionVariableCS( CONDITION_VARIABLE *variable, CRITICAL_SECTION *crit, DWORD timeout )
+{
+    NTSTATUS status;
+    LARGE_INTEGER time;
+
+    status = RtlSleepConditionVariableCS( variable, crit, get_nt_timeout( &time, timeout ) );
+
+    if (status != STATUS_SUCCESS)
+    {
+        SetLastError( RtlNtStatusToDosError(status) );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/***********************************************************************
+ *           SleepConditionVariableSRW   (KERNEL32.@)
+ */
+BOOL WINAPI SleepConditionVariableSRW( CONDITION_VARIABLE *variable, SRWLOCK *lock, DWORD timeout, ULONG flags )
+{
+    NTSTATUS status;
+    LARGE_INTEGER time;
+
+    status = RtlSleepConditionVariableSRW( variable, lock, get_nt_timeout( &time, timeout ), flags );
+
+    if (status != STATUS_SUCCESS)
+    {
+        SetLastError( RtlNtStatusToDosError(status) );
+        return FALSE;
+    }
+    return TRUE;
+}
+
 #ifdef __i386__
 
 /***********************************************************************
@@ -46,6 +46,7 @@ static HANDLE (WINAPI *pOpenFileById)(HANDLE, LPFILE_ID_DESCRIPTOR, DWORD, DWORD
 static BOOL (WINAPI *pSetFileValidData)(HANDLE, LONGLONG);
 static HRESULT (WINAPI *pCopyFile2)(PCWSTR,PCWSTR,COPYFILE2_EXTENDED_PARAMETERS*);
 static HANDLE (WINAPI *pCreateFile2)(LPCWSTR, DWORD, DWORD, DWORD, CREATEFILE2_EXTENDED_PARAMETERS*);
+static BOOL (WINAPI *pCancelIoEx)(HANDLE, LPOVERLAPPED);
 
 /* keep filename and filenameW the same */
 static const char filename[] = "testfile.xxx";
@@ -85,6 +86,7 @@ static void InitFunctionPointers(void)
     pSetFileValidData = (void *) GetProcAddress(hkernel32, "SetFileValidData");
     pCopyFile2 = (void *) GetProcAddress(hkernel32, "CopyFile2");
     pCreateFile2 = (void *) GetProcAddress(hkernel32, "CreateFile2");
+    pCancelIoEx = (void *) GetProcAddress(hkernel32, "CancelIoEx");
 }
 
 static void test__hread( void )
@@ -2618,6 +2620,56 @@ cleanup:
     RemoveDirectoryA("test-dir");
 }
 
+static void test_FindFirstFileEx_basic(void)
+{
+    WIN32_FIND_DATAA search_results;
+    char name[MAX_PATH];
+    HANDLE handle;
+    int i, count = 0;
+
+    if (!pFindFirstFileExA)
+    {
+        win_skip("FindFirstFileExA() is missing\n");
+        return;
+    }
+
+    CreateDirectoryA("test-dir", NULL);
+    for (i = 0; i < 500; i++)
+    {
+        snprintf(name, sizeof(name), "test-dir\\long file name %u.text", i);
+        _lclose(_lcreat(name, 0));
+    }
+
+    SetLastError(0xdeadbeef);
+    handle = pFindFirstFileExA("test-dir\\*", FindExInfoBasic, &search_results, FindExSearchNameMatch,
+                               NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (handle == INVALID_HANDLE_VALUE && GetLastError() == ERROR_INVALID_PARAMETER)
+    {
+        win_skip("FindExInfoBasic is not supported\n");
+        goto cleanup;
+    }
+    ok(handle != INVALID_HANDLE_VALUE, "FindFirstFileExA failed (err=%u)\n", GetLastError());
+    do
+    {
+        ok(!search_results.cAlternateFileName[0], "got short name %s for %s\n",
+           search_results.cAlternateFileName, search_results.cFileName);
+        if (strncmp(search_results.cFileName, "long file name ", 15)) continue;
+        count++;
+    }
+    while (FindNextFileA(handle, &search_results));
+    ok(GetLastError() == ERROR_NO_MORE_FILES, "got error %u\n", GetLastError());
+    ok(count == 500, "found %d files\n", count);
+    FindClose(handle);
+
+cleanup:
+    for (i = 0; i < 500; i++)
+    {
+        snprintf(name, sizeof(name), "test-dir\\long file name %u.text", i);
+        DeleteFileA(name);
+    }
+    RemoveDirectoryA("test-dir");
+}
+
 static int test_Mapfile_createtemp(HANDLE *handle)
 {
     SetFileAttributesA(filename,FILE_ATTRIBUTE_NORMAL);
@@ -3178,6 +3230,199 @@ static void test_overlapped(void)
     ok( r == TRUE, "close handle failed\n");
 }
 
+static void test_overlapped_queue_depth(void)
+{
+    static const DWORD depths[] = { 1, 4, 16, 64 };
+    char temp_path[MAX_PATH], file_name[MAX_PATH], *buffers;
+    OVERLAPPED ov[64];
+    DWORD i, d, pass, depth, next, done, count, start;
+    const DWORD block = 4096, blocks = 256;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "ovl", 0, file_name );
+    file = CreateFileA( file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed with error %u\n", GetLastError() );
+    if (file == INVALID_HANDLE_VALUE) return;
+
+    buffers = HeapAlloc( GetProcessHeap(), 0, 64 * block );
+    for (i = 0; i < 64; i++)
+    {
+        memset( &ov[i], 0, sizeof(ov[i]) );
+        ov[i].hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+    }
+
+    for (d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+    {
+        for (pass = 0; pass < 2; pass++)  /* write the blocks, then read them back */
+        {
+            depth = depths[d];
+            start = GetTickCount();
+            for (next = done = 0; done < blocks; done++)
+            {
+                /* keep depth requests in flight, slot i handles blocks i, i + depth, ... */
+                while (next < blocks && next < done + depth)
+                {
+                    i = next % depth;
+                    ov[i].Offset = next * block;
+                    if (pass) ret = ReadFile( file, buffers + i * block, block, NULL, &ov[i] );
+                    else
+                    {
+                        memset( buffers + i * block, next & 0xff, block );
+                        ret = WriteFile( file, buffers + i * block, block, NULL, &ov[i] );
+                    }
+                    ok( ret || GetLastError() == ERROR_IO_PENDING, "I/O failed with error %u\n", GetLastError() );
+                    next++;
+                }
+                i = done % depth;
+                count = 0;
+                ret = GetOverlappedResult( file, &ov[i], &count, TRUE );
+                ok( ret, "GetOverlappedResult failed with error %u\n", GetLastError() );
+                ok( count == block, "got %u bytes for block %u\n", count, done );
+                if (pass) ok( (unsigned char)buffers[i * block] == (done & 0xff) &&
+                              (unsigned char)buffers[(i + 1) * block - 1] == (done & 0xff),
+                              "wrong data in block %u\n", done );
+            }
+            trace( "%s %u blocks at queue depth %u took %u ms\n", pass ? "read" : "wrote",
+                   blocks, depth, GetTickCount() - start );
+        }
+    }
+
+    for (i = 0; i < 64; i++) CloseHandle( ov[i].hEvent );
+    HeapFree( GetProcessHeap(), 0, buffers );
+    CloseHandle( file );
+}
+
+/* start reads of all the blocks of the file at once */
+static void queue_overlapped_reads( HANDLE file, char *buffers, OVERLAPPED *ov, DWORD count, DWORD block )
+{
+    DWORD i;
+    BOOL ret;
+
+    for (i = 0; i < count; i++)
+    {
+        ResetEvent( ov[i].hEvent );
+        ov[i].Internal = ov[i].InternalHigh = 0;
+        ov[i].Offset = i * block;
+        ret = ReadFile( file, buffers + i * block, block, NULL, &ov[i] );
+        ok( ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed with error %u\n", GetLastError() );
+    }
+}
+
+/* a canceled read either completed before the cancel or got aborted */
+static void check_canceled_read( HANDLE file, OVERLAPPED *ov, DWORD block, DWORD index )
+{
+    DWORD count = 0;
+    BOOL ret;
+
+    SetLastError( 0xdeadbeef );
+    ret = GetOverlappedResult( file, ov, &count, TRUE );
+    if (ret) ok( count == block, "got %u bytes for block %u\n", count, index );
+    else ok( GetLastError() == ERROR_OPERATION_ABORTED, "block %u failed with error %u\n",
+             index, GetLastError() );
+}
+
+/* Cancelling or closing the file must complete the requests that are still
+ * pending, so that they don't touch the buffers or the OVERLAPPED afterwards. */
+static void test_overlapped_cancel(void)
+{
+    char temp_path[MAX_PATH], file_name[MAX_PATH], *buffers;
+    OVERLAPPED ov[64];
+    const DWORD block = 4096;
+    DWORD i, written;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "ovl", 0, file_name );
+    file = CreateFileA( file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed with error %u\n", GetLastError() );
+    if (file == INVALID_HANDLE_VALUE) return;
+    buffers = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, 64 * block );
+    WriteFile( file, buffers, 64 * block, &written, NULL );
+    CloseHandle( file );
+
+    file = CreateFileA( file_name, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed with error %u\n", GetLastError() );
+    for (i = 0; i < 64; i++)
+    {
+        memset( &ov[i], 0, sizeof(ov[i]) );
+        ov[i].hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+    }
+
+    queue_overlapped_reads( file, buffers, ov, 64, block );
+    ret = CancelIo( file );
+    ok( ret, "CancelIo failed with error %u\n", GetLastError() );
+    for (i = 0; i < 64; i++) check_canceled_read( file, &ov[i], block, i );
+
+    if (pCancelIoEx)
+    {
+        queue_overlapped_reads( file, buffers, ov, 64, block );
+        SetLastError( 0xdeadbeef );
+        ret = pCancelIoEx( file, &ov[63] );
+        ok( ret || GetLastError() == ERROR_NOT_FOUND, "CancelIoEx failed with error %u\n", GetLastError() );
+        check_canceled_read( file, &ov[63], block, 63 );
+        ret = pCancelIoEx( file, NULL );
+        ok( ret || GetLastError() == ERROR_NOT_FOUND, "CancelIoEx failed with error %u\n", GetLastError() );
+        for (i = 0; i < 63; i++) check_canceled_read( file, &ov[i], block, i );
+    }
+    else win_skip( "CancelIoEx not available\n" );
+
+    queue_overlapped_reads( file, buffers, ov, 64, block );
+    CloseHandle( file );
+    for (i = 0; i < 64; i++)
+    {
+        ret = WaitForSingleObject( ov[i].hEvent, 5000 );
+        ok( ret == WAIT_OBJECT_0, "block %u not completed after CloseHandle\n", i );
+        ok( ov[i].Internal != STATUS_PENDING, "block %u still pending\n", i );
+        if (!ov[i].Internal) ok( ov[i].InternalHigh == block, "got %lu bytes for block %u\n",
+                                 ov[i].InternalHigh, i );
+    }
+
+    for (i = 0; i < 64; i++) CloseHandle( ov[i].hEvent );
+    HeapFree( GetProcessHeap(), 0, buffers );
+    DeleteFileA( file_name );
+}
+
+/* Overlapped I/O on regular files is only handed to the thread pool when
+ * WINEASYNCFILEIO is set, and the setting is read once per process, so run
+ * the overlapped tests again in a child process that has it set. */
+static void test_async_file_io(void)
+{
+    static const char var[] = "WINEASYNCFILEIO=1";
+    char cmdline[MAX_PATH + 32], **argv;
+    char *strings, *env, *ptr;
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    SIZE_T len;
+    BOOL ret;
+
+    winetest_get_mainargs( &argv );
+
+    /* the environment block of the child is the current one with the thread pool enabled */
+    strings = GetEnvironmentStringsA();
+    for (ptr = strings; *ptr; ptr += strlen(ptr) + 1) ;
+    len = ptr - strings;
+    env = HeapAlloc( GetProcessHeap(), 0, sizeof(var) + len + 1 );
+    memcpy( env, var, sizeof(var) );
+    memcpy( env + sizeof(var), strings, len );
+    env[sizeof(var) + len] = 0;
+    FreeEnvironmentStringsA( strings );
+
+    sprintf( cmdline, "%s file async_io", argv[0] );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, env, NULL, &startup, &info );
+    ok( ret, "failed to create child process error %u\n", GetLastError() );
+    HeapFree( GetProcessHeap(), 0, env );
+    if (!ret) return;
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hThread );
+    CloseHandle( info.hProcess );
+}
+
 static void test_RemoveDirectory(void)
 {
     int rc;
@@ -4031,10 +4276,68 @@ todo_wine
     }
 }
 
+static void test_case_insensitive_names(void)
+{
+    static const char *names[][2] =
+    {
+        { "MixedCase.txt", "MIXEDCASE.TXT" },
+        { "Another File.Text", "another file.TEXT" },
+        { "third", "THIRD" },
+    };
+    char temp[MAX_PATH], dir[MAX_PATH], path[2 * MAX_PATH], upper[2 * MAX_PATH];
+    DWORD attrs;
+    HANDLE file;
+    int i;
+
+    GetTempPathA( MAX_PATH, temp );
+    GetTempFileNameA( temp, "dcn", 0, dir );
+    DeleteFileA( dir );
+    ok( CreateDirectoryA( dir, NULL ), "CreateDirectory failed, gle=%d\n", GetLastError() );
+
+    for (i = 0; i < sizeof(names)/sizeof(names[0]); i++)
+    {
+        sprintf( path, "%s\\%s", dir, names[i][0] );
+        sprintf( upper, "%s\\%s", dir, names[i][1] );
+
+        /* the name must not be found before it's created, even if the directory was scanned */
+        attrs = GetFileAttributesA( upper );
+        ok( attrs == INVALID_FILE_ATTRIBUTES, "%s: file exists before creation\n", names[i][0] );
+
+        file = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+        ok( file != INVALID_HANDLE_VALUE, "%s: CreateFile failed, gle=%d\n", names[i][0], GetLastError() );
+        CloseHandle( file );
+
+        attrs = GetFileAttributesA( upper );
+        ok( attrs != INVALID_FILE_ATTRIBUTES, "%s: file not found after creation, gle=%d\n",
+            names[i][0], GetLastError() );
+    }
+
+    for (i = 0; i < sizeof(names)/sizeof(names[0]); i++)
+    {
+        sprintf( path, "%s\\%s", dir, names[i][0] );
+        sprintf( upper, "%s\\%s", dir, names[i][1] );
+        ok( DeleteFileA( upper ), "%s: DeleteFile failed, gle=%d\n", names[i][0], GetLastError() );
+        attrs = GetFileAttributesA( upper );
+        ok( attrs == INVALID_FILE_ATTRIBUTES, "%s: file still exists after deletion\n", names[i][0] );
+    }
+    ok( RemoveDirectoryA( dir ), "RemoveDirectory failed, gle=%d\n", GetLastError() );
+}
+
 START_TEST(file)
 {
+    char **argv;
+    int argc;
+
     InitFunctionPointers();
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp( argv[2], "async_io" ))
+    {
+        test_overlapped_queue_depth();
+        test_overlapped_cancel();
+        return;
+    }
+
     test__hread(  );
     test__hwrite(  );
     test__lclose(  );
@@ -4060,6 +4363,7 @@ START_TEST(file)
     test_FindFirstFileExA(0);
     /* FindExLimitToDirectories is ignored if the file system doesn't support directory filtering */
     test_FindFirstFileExA(FindExSearchLimitToDirectories);
+    test_FindFirstFileEx_basic();
     test_LockFile();
     test_file_sharing();
     test_offset_in_overlapped_structure();
@@ -4069,6 +4373,9 @@ START_TEST(file)
     test_read_write();
     test_OpenFile();
     test_overlapped();
+    test_overlapped_queue_depth();
+    test_overlapped_cancel();
+    test_async_file_io();
     test_RemoveDirectory();
     test_ReplaceFileA();
     test_ReplaceFileW();
@@ -4076,4 +4383,5 @@ START_TEST(file)
     test_OpenFileById();
     test_SetFileValidData();
     test_file_access();
+    test_case_insensitive_names();
 }
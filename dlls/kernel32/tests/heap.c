@@ -38,6 +38,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
 struct heap_layout
@@ -580,6 +581,90 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+static void test_low_fragmentation_heap(void)
+{
+    BYTE *blocks[200], *p;
+    HANDLE heap;
+    ULONG info;
+    SIZE_T size, i, j;
+    BOOL ret;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "HeapSetInformation succeeded on a HEAP_NO_SERIALIZE heap\n" );
+    HeapDestroy( heap );
+
+    /* the front-end gets enabled by itself once a heap does many small allocations */
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    for (i = 0; i < 4096; i++) HeapFree( heap, 0, HeapAlloc( heap, 0, 32 ));
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 2 || broken(info == 0), /* xp */ "expected 2, got %u\n", info );
+    HeapDestroy( heap );
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    if (!ret)
+    {
+        skip( "low fragmentation heap not supported\n" );
+        HeapDestroy( heap );
+        return;
+    }
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 2, "expected 2, got %u\n", info );
+
+    for (i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        blocks[i] = HeapAlloc( heap, HEAP_ZERO_MEMORY, i * 7 );
+        ok( blocks[i] != NULL, "HeapAlloc %lu failed\n", i * 7 );
+        for (j = 0; j < i * 7; j++) if (blocks[i][j]) break;
+        ok( j == i * 7, "block %lu not zeroed at %lu\n", i, j );
+        memset( blocks[i], i, i * 7 );
+        size = HeapSize( heap, 0, blocks[i] );
+        ok( size == i * 7, "wrong size %lu for %lu\n", size, i * 7 );
+    }
+
+    for (i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        ret = HeapValidate( heap, 0, blocks[i] );
+        ok( ret, "HeapValidate failed for block %lu\n", i );
+
+        p = HeapReAlloc( heap, HEAP_ZERO_MEMORY, blocks[i], i * 7 + 100 );
+        ok( p != NULL, "HeapReAlloc failed for block %lu\n", i );
+        for (j = 0; j < i * 7; j++) if (p[j] != (BYTE)i) break;
+        ok( j == i * 7, "block %lu not preserved at %lu\n", i, j );
+        for (; j < i * 7 + 100; j++) if (p[j]) break;
+        ok( j == i * 7 + 100, "block %lu not zeroed at %lu\n", i, j );
+        size = HeapSize( heap, 0, p );
+        ok( size == i * 7 + 100, "wrong size %lu for %lu\n", size, i * 7 + 100 );
+        blocks[i] = p;
+    }
+
+    for (i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        ret = HeapFree( heap, 0, blocks[i] );
+        ok( ret, "HeapFree failed for block %lu\n", i );
+    }
+
+    ret = HeapDestroy( heap );
+    ok( ret, "HeapDestroy failed\n" );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -897,6 +982,7 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), (2 << 20));
     test_sized_HeapReAlloc((1 << 20), 1);
     test_HeapQueryInformation();
+    test_low_fragmentation_heap();
 
     if (pRtlGetNtGlobalFlags)
     {
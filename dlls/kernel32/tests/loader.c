@@ -852,6 +852,241 @@ wine_is_broken:
     CloseHandle(hfile);
 }
 
+static void test_image_relocation(void)
+{
+    struct
+    {
+        IMAGE_DOS_HEADER dos;
+        IMAGE_NT_HEADERS nt;
+        IMAGE_SECTION_HEADER section;
+        char pad[0x200 - sizeof(IMAGE_DOS_HEADER) - sizeof(IMAGE_NT_HEADERS) - sizeof(IMAGE_SECTION_HEADER)];
+    } headers;
+    struct
+    {
+        ULONG_PTR ptr;
+        IMAGE_BASE_RELOCATION rel;
+        USHORT types[2];
+        char pad[0x200 - sizeof(ULONG_PTR) - sizeof(IMAGE_BASE_RELOCATION) - 2 * sizeof(USHORT)];
+    } data;
+    char temp_path[MAX_PATH], dll_name[MAX_PATH];
+    HANDLE hfile, hmap;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+    SIZE_T size;
+    DWORD written;
+    char *addr1, *addr2;
+    ULONG_PTR *ptr;
+    BOOL ret;
+    int i;
+
+    if (!pNtMapViewOfSection || page_size != 0x1000) return;
+
+    memset(&headers, 0, sizeof(headers));
+    headers.dos.e_magic = IMAGE_DOS_SIGNATURE;
+    headers.dos.e_lfanew = sizeof(headers.dos);
+    headers.nt.Signature = IMAGE_NT_SIGNATURE;
+    headers.nt.FileHeader.Machine = nt_header.FileHeader.Machine;
+    headers.nt.FileHeader.NumberOfSections = 1;
+    headers.nt.FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER);
+    headers.nt.FileHeader.Characteristics = IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_DLL;
+    headers.nt.OptionalHeader.Magic = IMAGE_NT_OPTIONAL_HDR_MAGIC;
+    headers.nt.OptionalHeader.ImageBase = 0x10000000;
+    headers.nt.OptionalHeader.SectionAlignment = 0x1000;
+    headers.nt.OptionalHeader.FileAlignment = 0x200;
+    headers.nt.OptionalHeader.MajorOperatingSystemVersion = 4;
+    headers.nt.OptionalHeader.MajorSubsystemVersion = 4;
+    headers.nt.OptionalHeader.SizeOfImage = 0x2000;
+    headers.nt.OptionalHeader.SizeOfHeaders = sizeof(headers);
+    headers.nt.OptionalHeader.Subsystem = IMAGE_SUBSYSTEM_WINDOWS_CUI;
+    headers.nt.OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    headers.nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress =
+        0x1000 + (char *)&data.rel - (char *)&data;
+    headers.nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size =
+        sizeof(data.rel) + sizeof(data.types);
+    memcpy(headers.section.Name, ".data", 6);
+    headers.section.Misc.VirtualSize = 0x1000;
+    headers.section.VirtualAddress = 0x1000;
+    headers.section.SizeOfRawData = sizeof(data);
+    headers.section.PointerToRawData = sizeof(headers);
+    headers.section.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+    memset(&data, 0, sizeof(data));
+    data.ptr = 0x10001000;
+    data.rel.VirtualAddress = 0x1000;
+    data.rel.SizeOfBlock = sizeof(data.rel) + sizeof(data.types);
+#ifdef _WIN64
+    data.types[0] = IMAGE_REL_BASED_DIR64 << 12;
+#else
+    data.types[0] = IMAGE_REL_BASED_HIGHLOW << 12;
+#endif
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "ldr", 0, dll_name);
+    hfile = CreateFileA(dll_name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, 0);
+    ok(hfile != INVALID_HANDLE_VALUE, "CreateFile error %d\n", GetLastError());
+    ret = WriteFile(hfile, &headers, sizeof(headers), &written, NULL);
+    ok(ret, "WriteFile error %d\n", GetLastError());
+    ret = WriteFile(hfile, &data, sizeof(data), &written, NULL);
+    ok(ret, "WriteFile error %d\n", GetLastError());
+
+    hmap = CreateFileMappingW(hfile, NULL, PAGE_READONLY | SEC_IMAGE, 0, 0, 0);
+    ok(hmap != 0, "CreateFileMapping error %d\n", GetLastError());
+
+    offset.QuadPart = 0;
+    addr1 = NULL;
+    size = 0;
+    status = pNtMapViewOfSection(hmap, GetCurrentProcess(), (void **)&addr1, 0, 0, &offset,
+                                 &size, 1 /* ViewShare */, 0, PAGE_READONLY);
+    ok(status == STATUS_SUCCESS || status == STATUS_IMAGE_NOT_AT_BASE, "NtMapViewOfSection error %x\n", status);
+    ptr = (ULONG_PTR *)(addr1 + 0x1000);
+    ok(*ptr == (ULONG_PTR)ptr, "got %p, expected %p\n", (void *)*ptr, ptr);
+
+    /* map the image again several times, modifying the relocated data in each view */
+    for (i = 0; i < 3; i++)
+    {
+        addr2 = NULL;
+        size = 0;
+        status = pNtMapViewOfSection(hmap, GetCurrentProcess(), (void **)&addr2, 0, 0, &offset,
+                                     &size, 1 /* ViewShare */, 0, PAGE_READONLY);
+        ok(status == STATUS_IMAGE_NOT_AT_BASE, "%d: expected STATUS_IMAGE_NOT_AT_BASE, got %x\n", i, status);
+        if (status != STATUS_IMAGE_NOT_AT_BASE) break;
+        ok(addr2 != addr1, "%d: mapped addresses should be different\n", i);
+        ptr = (ULONG_PTR *)(addr2 + 0x1000);
+        ok(*ptr == (ULONG_PTR)ptr, "%d: got %p, expected %p\n", i, (void *)*ptr, ptr);
+        *ptr = 0xdeadbeef;
+        status = pNtUnmapViewOfSection(GetCurrentProcess(), addr2);
+        ok(status == STATUS_SUCCESS, "%d: NtUnmapViewOfSection error %x\n", i, status);
+    }
+
+    ptr = (ULONG_PTR *)(addr1 + 0x1000);
+    ok(*ptr == (ULONG_PTR)ptr, "got %p, expected %p\n", (void *)*ptr, ptr);
+    status = pNtUnmapViewOfSection(GetCurrentProcess(), addr1);
+    ok(status == STATUS_SUCCESS, "NtUnmapViewOfSection error %x\n", status);
+
+    CloseHandle(hmap);
+    CloseHandle(hfile);
+    DeleteFileA(dll_name);
+}
+
+static void test_export_lookup(void)
+{
+    static const int count = 5000;
+    struct
+    {
+        IMAGE_DOS_HEADER dos;
+        IMAGE_NT_HEADERS nt;
+        IMAGE_SECTION_HEADER section;
+        char pad[0x200 - sizeof(IMAGE_DOS_HEADER) - sizeof(IMAGE_NT_HEADERS) - sizeof(IMAGE_SECTION_HEADER)];
+    } headers;
+    IMAGE_EXPORT_DIRECTORY *dir;
+    DWORD *functions, *names, data_size, raw_size, code_rva, written;
+    WORD *ordinals;
+    char *data, *str, temp_path[MAX_PATH], dll_name[MAX_PATH], name[16];
+    HANDLE hfile;
+    HMODULE module;
+    FARPROC proc;
+    BOOL ret;
+    int i;
+
+    if (page_size != 0x1000) return;
+
+    /* export directory, arrays and names, laid out at rva 0x1000 */
+    data_size = sizeof(*dir) + count * (2 * sizeof(DWORD) + sizeof(WORD)) + count * 10 + 32;
+    raw_size = (data_size + 0x1ff) & ~0x1ff;
+    code_rva = 0x1000 + raw_size;
+    data = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, raw_size);
+
+    dir = (IMAGE_EXPORT_DIRECTORY *)data;
+    functions = (DWORD *)(dir + 1);
+    names = functions + count;
+    ordinals = (WORD *)(names + count);
+    str = (char *)(ordinals + count);
+    strcpy(str, "exports.dll");
+    dir->Name = 0x1000 + (str - data);
+    str += strlen(str) + 1;
+    dir->Base = 1;
+    dir->NumberOfFunctions = count;
+    dir->NumberOfNames = count;
+    dir->AddressOfFunctions = 0x1000 + ((char *)functions - data);
+    dir->AddressOfNames = 0x1000 + ((char *)names - data);
+    dir->AddressOfNameOrdinals = 0x1000 + ((char *)ordinals - data);
+    for (i = 0; i < count; i++)
+    {
+        functions[i] = code_rva + i;
+        ordinals[i] = i;
+        names[i] = 0x1000 + (str - data);
+        sprintf(str, "func%05d", i);
+        str += strlen(str) + 1;
+    }
+    ok(str - data <= data_size, "export data too large\n");
+
+    memset(&headers, 0, sizeof(headers));
+    headers.dos.e_magic = IMAGE_DOS_SIGNATURE;
+    headers.dos.e_lfanew = sizeof(headers.dos);
+    headers.nt.Signature = IMAGE_NT_SIGNATURE;
+    headers.nt.FileHeader.Machine = nt_header.FileHeader.Machine;
+    headers.nt.FileHeader.NumberOfSections = 1;
+    headers.nt.FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER);
+    headers.nt.FileHeader.Characteristics = IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_DLL;
+    headers.nt.OptionalHeader.Magic = IMAGE_NT_OPTIONAL_HDR_MAGIC;
+    headers.nt.OptionalHeader.ImageBase = 0x10000000;
+    headers.nt.OptionalHeader.SectionAlignment = 0x1000;
+    headers.nt.OptionalHeader.FileAlignment = 0x200;
+    headers.nt.OptionalHeader.MajorOperatingSystemVersion = 4;
+    headers.nt.OptionalHeader.MajorSubsystemVersion = 4;
+    headers.nt.OptionalHeader.SizeOfImage = (code_rva + count + 0xfff) & ~0xfff;
+    headers.nt.OptionalHeader.SizeOfHeaders = sizeof(headers);
+    headers.nt.OptionalHeader.Subsystem = IMAGE_SUBSYSTEM_WINDOWS_CUI;
+    headers.nt.OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    headers.nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress = 0x1000;
+    headers.nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size = data_size;
+    memcpy(headers.section.Name, ".edata", 7);
+    headers.section.Misc.VirtualSize = raw_size + count;
+    headers.section.VirtualAddress = 0x1000;
+    headers.section.SizeOfRawData = raw_size;
+    headers.section.PointerToRawData = sizeof(headers);
+    headers.section.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ;
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "ldr", 0, dll_name);
+    hfile = CreateFileA(dll_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0);
+    ok(hfile != INVALID_HANDLE_VALUE, "CreateFile error %d\n", GetLastError());
+    ret = WriteFile(hfile, &headers, sizeof(headers), &written, NULL);
+    ok(ret, "WriteFile error %d\n", GetLastError());
+    ret = WriteFile(hfile, data, raw_size, &written, NULL);
+    ok(ret, "WriteFile error %d\n", GetLastError());
+    CloseHandle(hfile);
+    HeapFree(GetProcessHeap(), 0, data);
+
+    module = LoadLibraryA(dll_name);
+    ok(module != NULL, "LoadLibrary error %d\n", GetLastError());
+    if (!module)
+    {
+        DeleteFileA(dll_name);
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "func%05d", i);
+        proc = GetProcAddress(module, name);
+        ok(proc == (FARPROC)((char *)module + code_rva + i), "%s: got %p, module %p\n", name, proc, module);
+        if (proc != (FARPROC)((char *)module + code_rva + i)) break;
+    }
+    proc = GetProcAddress(module, (LPCSTR)(ULONG_PTR)(count / 2 + 1));
+    ok(proc == (FARPROC)((char *)module + code_rva + count / 2), "got %p, module %p\n", proc, module);
+
+    SetLastError(0xdeadbeef);
+    proc = GetProcAddress(module, "func");
+    ok(!proc, "got %p\n", proc);
+    ok(GetLastError() == ERROR_PROC_NOT_FOUND, "got %d\n", GetLastError());
+    proc = GetProcAddress(module, "func050000");
+    ok(!proc, "got %p\n", proc);
+
+    FreeLibrary(module);
+    DeleteFileA(dll_name);
+}
+
 static BOOL is_mem_writable(DWORD prot)
 {
     switch (prot & 0xff)
@@ -2667,5 +2902,7 @@ START_TEST(loader)
     test_ResolveDelayLoadedAPI();
     test_ImportDescriptors();
     test_section_access();
+    test_image_relocation();
+    test_export_lookup();
     test_ExitProcess();
 }
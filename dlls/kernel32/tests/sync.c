@@ -46,6 +46,15 @@ static VOID   (WINAPI *pInitializeConditionVariable)(PCONDITION_VARIABLE);
 static BOOL   (WINAPI *pSleepConditionVariableCS)(PCONDITION_VARIABLE,PCRITICAL_SECTION,DWORD);
 static VOID   (WINAPI *pWakeAllConditionVariable)(PCONDITION_VARIABLE);
 static VOID   (WINAPI *pWakeConditionVariable)(PCONDITION_VARIABLE);
+static VOID   (WINAPI *pInitializeSRWLock)(PSRWLOCK);
+static VOID   (WINAPI *pAcquireSRWLockExclusive)(PSRWLOCK);
+static VOID   (WINAPI *pAcquireSRWLockShared)(PSRWLOCK);
+static VOID   (WINAPI *pReleaseSRWLockExclusive)(PSRWLOCK);
+static VOID   (WINAPI *pReleaseSRWLockShared)(PSRWLOCK);
+static BOOLEAN (WINAPI *pTryAcquireSRWLockExclusive)(PSRWLOCK);
+static BOOLEAN (WINAPI *pTryAcquireSRWLockShared)(PSRWLOCK);
+static BOOL   (WINAPI *pSleepConditionVariableSRW)(PCONDITION_VARIABLE,PSRWLOCK,DWORD,ULONG);
+static BOOL   (WINAPI *pGetQueuedCompletionStatusEx)(HANDLE,OVERLAPPED_ENTRY*,ULONG,ULONG*,DWORD,BOOL);
 
 static void test_signalandwait(void)
 {
@@ -524,6 +533,99 @@ static void test_waitable_timer(void)
     CloseHandle( handle );
 }
 
+static void test_waitable_timer_churn(void)
+{
+    HANDLE timers[512];
+    LARGE_INTEGER due;
+    DWORD start, ret;
+    int i;
+
+    if (!pCreateWaitableTimerA)
+    {
+        win_skip("CreateWaitableTimerA() is not available\n");
+        return;
+    }
+
+    for (i = 0; i < sizeof(timers) / sizeof(timers[0]); i++)
+    {
+        timers[i] = pCreateWaitableTimerA( NULL, TRUE, NULL );
+        ok( timers[i] != NULL, "CreateWaitableTimer failed with error %u\n", GetLastError() );
+    }
+
+    /* set and cancel lots of distant timeouts in scattered order */
+    start = GetTickCount();
+    for (i = 0; i < 16 * 512; i++)
+    {
+        HANDLE timer = timers[(i * 7919) % 512];
+
+        due.QuadPart = -(10000000 + (LONGLONG)(i % 997) * 10000);
+        if (i % 3 == 2) ret = CancelWaitableTimer( timer );
+        else ret = SetWaitableTimer( timer, &due, 0, NULL, NULL, FALSE );
+        ok( ret, "timer update %u failed with error %u\n", i, GetLastError() );
+    }
+    trace( "%u timer updates took %u ms\n", 16 * 512, GetTickCount() - start );
+
+    /* the earliest timeout must still expire first */
+    due.QuadPart = -2000000;
+    ok( SetWaitableTimer( timers[2], &due, 0, NULL, NULL, FALSE ), "SetWaitableTimer failed\n" );
+    due.QuadPart = -200000;
+    ok( SetWaitableTimer( timers[0], &due, 0, NULL, NULL, FALSE ), "SetWaitableTimer failed\n" );
+    due.QuadPart = -1000000;
+    ok( SetWaitableTimer( timers[1], &due, 0, NULL, NULL, FALSE ), "SetWaitableTimer failed\n" );
+    ret = WaitForMultipleObjects( 3, timers, FALSE, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", ret );
+    ret = WaitForSingleObject( timers[2], 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+
+    for (i = 0; i < sizeof(timers) / sizeof(timers[0]); i++) CloseHandle( timers[i] );
+}
+
+static void test_many_named_objects(void)
+{
+    static const int count = 8192;
+    HANDLE *events, handle;
+    char name[64];
+    DWORD start;
+    int i;
+
+    events = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*events) );
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "winetest_named_object_%u_%d", GetCurrentProcessId(), i );
+        events[i] = CreateEventA( NULL, TRUE, FALSE, name );
+        ok( events[i] != NULL, "CreateEvent %d failed with error %u\n", i, GetLastError() );
+        ok( GetLastError() != ERROR_ALREADY_EXISTS, "event %d already exists\n", i );
+    }
+    trace( "creating %d named events took %u ms\n", count, GetTickCount() - start );
+
+    /* close every other one, the remaining ones must still be found */
+    for (i = 0; i < count; i += 2) CloseHandle( events[i] );
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "winetest_named_object_%u_%d", GetCurrentProcessId(), i );
+        SetLastError( 0xdeadbeef );
+        handle = OpenEventA( EVENT_ALL_ACCESS, FALSE, name );
+        if (i % 2)
+        {
+            ok( handle != NULL, "OpenEvent %d failed with error %u\n", i, GetLastError() );
+            CloseHandle( handle );
+        }
+        else
+        {
+            ok( !handle, "OpenEvent %d succeeded\n", i );
+            ok( GetLastError() == ERROR_FILE_NOT_FOUND, "OpenEvent %d failed with error %u\n", i, GetLastError() );
+        }
+    }
+    trace( "opening %d named events took %u ms\n", count, GetTickCount() - start );
+
+    for (i = 1; i < count; i += 2) CloseHandle( events[i] );
+    HeapFree( GetProcessHeap(), 0, events );
+}
+
 static HANDLE sem = 0;
 
 static void CALLBACK iocp_callback(DWORD dwErrorCode, DWORD dwNumberOfBytesTransferred, LPOVERLAPPED lpOverlapped)
@@ -1666,10 +1768,355 @@ static void test_condvars_base(void) {
     WaitForSingleObject(hc, 100);
 }
 
+static SRWLOCK srwlock;
+static CONDITION_VARIABLE srwlock_cv;
+static LONG srwlock_counter, srwlock_shadow, srwlock_errors;
+
+static DWORD WINAPI srwlock_thread(LPVOID arg)
+{
+    int i;
+
+    for (i = 0; i < 10000; i++)
+    {
+        if (i % 4)
+        {
+            pAcquireSRWLockShared(&srwlock);
+            if (srwlock_counter != srwlock_shadow) InterlockedIncrement(&srwlock_errors);
+            pReleaseSRWLockShared(&srwlock);
+        }
+        else
+        {
+            pAcquireSRWLockExclusive(&srwlock);
+            srwlock_counter++;
+            if (!(i % 64)) Sleep(0);
+            srwlock_shadow++;
+            pReleaseSRWLockExclusive(&srwlock);
+        }
+    }
+    return 0;
+}
+
+static DWORD WINAPI srwlock_cv_thread(LPVOID arg)
+{
+    pAcquireSRWLockExclusive(&srwlock);
+    srwlock_counter = 1;
+    pWakeConditionVariable(&srwlock_cv);
+    pReleaseSRWLockExclusive(&srwlock);
+    return 0;
+}
+
+static void test_srwlock(void)
+{
+    HANDLE threads[4];
+    DWORD dummy;
+    BOOL ret;
+    int i;
+
+    if (!pInitializeSRWLock || !pTryAcquireSRWLockExclusive)
+    {
+        win_skip("no SRW lock support.\n");
+        return;
+    }
+
+    pInitializeSRWLock(&srwlock);
+    ok(pTryAcquireSRWLockExclusive(&srwlock), "TryAcquireSRWLockExclusive failed\n");
+    ok(!pTryAcquireSRWLockExclusive(&srwlock), "TryAcquireSRWLockExclusive succeeded on owned lock\n");
+    ok(!pTryAcquireSRWLockShared(&srwlock), "TryAcquireSRWLockShared succeeded on exclusive lock\n");
+    pReleaseSRWLockExclusive(&srwlock);
+
+    ok(pTryAcquireSRWLockShared(&srwlock), "TryAcquireSRWLockShared failed\n");
+    ok(pTryAcquireSRWLockShared(&srwlock), "TryAcquireSRWLockShared failed on shared lock\n");
+    ok(!pTryAcquireSRWLockExclusive(&srwlock), "TryAcquireSRWLockExclusive succeeded on shared lock\n");
+    pReleaseSRWLockShared(&srwlock);
+    pReleaseSRWLockShared(&srwlock);
+
+    srwlock_counter = srwlock_shadow = srwlock_errors = 0;
+    for (i = 0; i < 4; i++)
+        threads[i] = CreateThread(NULL, 0, srwlock_thread, NULL, 0, &dummy);
+    WaitForMultipleObjects(4, threads, TRUE, INFINITE);
+    for (i = 0; i < 4; i++) CloseHandle(threads[i]);
+
+    ok(srwlock_counter == 4 * 2500, "got counter %d\n", srwlock_counter);
+    ok(!srwlock_errors, "shared owners saw %d inconsistent states\n", srwlock_errors);
+    ok(pTryAcquireSRWLockExclusive(&srwlock), "lock is still owned\n");
+    pReleaseSRWLockExclusive(&srwlock);
+
+    if (!pSleepConditionVariableSRW)
+    {
+        win_skip("SleepConditionVariableSRW not available.\n");
+        return;
+    }
+
+    pAcquireSRWLockExclusive(&srwlock);
+    ret = pSleepConditionVariableSRW(&srwlock_cv, &srwlock, 10, 0);
+    ok(!ret, "SleepConditionVariableSRW should fail on untriggered condvar\n");
+    ok(GetLastError() == ERROR_TIMEOUT, "expected ERROR_TIMEOUT, got %d\n", GetLastError());
+
+    srwlock_counter = 0;
+    threads[0] = CreateThread(NULL, 0, srwlock_cv_thread, NULL, 0, &dummy);
+    while (!srwlock_counter)
+    {
+        ret = pSleepConditionVariableSRW(&srwlock_cv, &srwlock, 5000, 0);
+        ok(ret, "SleepConditionVariableSRW failed, error %d\n", GetLastError());
+        if (!ret) break;
+    }
+    pReleaseSRWLockExclusive(&srwlock);
+    WaitForSingleObject(threads[0], INFINITE);
+    CloseHandle(threads[0]);
+}
+
+static void test_GetQueuedCompletionStatusEx(void)
+{
+    OVERLAPPED_ENTRY entries[100];
+    HANDLE port;
+    ULONG count, i;
+    DWORD start;
+    BOOL ret;
+
+    if (!pGetQueuedCompletionStatusEx)
+    {
+        win_skip( "GetQueuedCompletionStatusEx not available\n" );
+        return;
+    }
+    port = CreateIoCompletionPort( INVALID_HANDLE_VALUE, NULL, 0, 0 );
+    ok( port != NULL, "CreateIoCompletionPort failed err %u\n", GetLastError() );
+
+    start = GetTickCount();
+    count = 0xdeadbeef;
+    SetLastError( 0xdeadbeef );
+    ret = pGetQueuedCompletionStatusEx( port, entries, 100, &count, 200, FALSE );
+    ok( !ret, "GetQueuedCompletionStatusEx succeeded\n" );
+    ok( GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError() );
+    ok( !count, "got %u entries\n", count );
+    ok( GetTickCount() - start >= 180, "wait timed out after %u ms\n", GetTickCount() - start );
+
+    /* more entries than a single server request returns */
+    for (i = 0; i < 100; i++) PostQueuedCompletionStatus( port, i, i + 1, (OVERLAPPED *)(ULONG_PTR)(i + 2) );
+    count = 0;
+    ret = pGetQueuedCompletionStatusEx( port, entries, 100, &count, 0, FALSE );
+    ok( ret, "GetQueuedCompletionStatusEx failed err %u\n", GetLastError() );
+    ok( count == 100, "got %u entries\n", count );
+    for (i = 0; i < count; i++)
+        ok( entries[i].dwNumberOfBytesTransferred == i && entries[i].lpCompletionKey == i + 1 &&
+            entries[i].lpOverlapped == (OVERLAPPED *)(ULONG_PTR)(i + 2),
+            "wrong entry %u: %u %lu %p\n", i, entries[i].dwNumberOfBytesTransferred,
+            entries[i].lpCompletionKey, entries[i].lpOverlapped );
+
+    CloseHandle( port );
+}
+
+static DWORD WINAPI client_sync_set_thread( void *arg )
+{
+    Sleep( 50 );
+    SetEvent( arg );
+    return 0;
+}
+
+static DWORD WINAPI client_sync_wait_thread( void *arg )
+{
+    return WaitForSingleObject( arg, 5000 );
+}
+
+static void run_child( char *cmdline, void *env )
+{
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    BOOL ret;
+
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, env, NULL, &startup, &info );
+    ok( ret, "failed to create child process error %u\n", GetLastError() );
+    if (!ret) return;
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hThread );
+    CloseHandle( info.hProcess );
+}
+
+/* Runs in a process started by test_client_sync_child, checking the objects
+ * it has duplicated or inherited, and changing their state in return. */
+static void test_client_sync_remote( char **argv )
+{
+    HANDLE inherited, pipe, duplicated = 0;
+    DWORD ret, size = 0;
+
+    sscanf( argv[3], "%p", &inherited );
+    sscanf( argv[4], "%p", &pipe );
+    ReadFile( pipe, &duplicated, sizeof(duplicated), &size, NULL );
+    ok( size == sizeof(duplicated), "got %u bytes\n", size );
+
+    ret = WaitForSingleObject( inherited, 0 );
+    ok( ret == WAIT_OBJECT_0, "inherited event not signaled, ret %u\n", ret );
+    ret = ResetEvent( inherited );
+    ok( ret, "ResetEvent failed err %u\n", GetLastError() );
+
+    ret = WaitForSingleObject( duplicated, 0 );
+    ok( ret == WAIT_OBJECT_0, "duplicated event not signaled, ret %u\n", ret );
+    ret = WaitForSingleObject( duplicated, 0 );
+    ok( ret == WAIT_TIMEOUT, "duplicated event still signaled, ret %u\n", ret );
+}
+
+/* Runs with WINECLIENTSYNC set, so that the unnamed and non-inheritable
+ * objects below are handled in-process until they get promoted. */
+static void test_client_sync_child( char **argv )
+{
+    HANDLE event, events[2], sem, thread, inherited, duplicated, remote, pipe_read, pipe_write;
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    char cmdline[MAX_PATH + 64];
+    DWORD ret, start, written;
+    LONG prev;
+
+    /* set, reset and pulse */
+    event = CreateEventA( NULL, TRUE, FALSE, NULL );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    SetEvent( event );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_OBJECT_0, "manual-reset event got reset, ret %u\n", ret );
+    ResetEvent( event );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+
+    thread = CreateThread( NULL, 0, client_sync_wait_thread, event, 0, NULL );
+    Sleep( 100 );
+    ret = PulseEvent( event );
+    ok( ret, "PulseEvent failed err %u\n", GetLastError() );
+    ret = WaitForSingleObject( thread, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    GetExitCodeThread( thread, &ret );
+    ok( ret == WAIT_OBJECT_0, "pulsed waiter returned %u\n", ret );
+    CloseHandle( thread );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "pulsed event left signaled, ret %u\n", ret );
+    CloseHandle( event );
+
+    event = CreateEventA( NULL, FALSE, TRUE, NULL );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "auto-reset event not reset, ret %u\n", ret );
+
+    /* waits with a timeout */
+    start = GetTickCount();
+    ret = WaitForSingleObject( event, 100 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    ok( GetTickCount() - start >= 80, "wait timed out after %u ms\n", GetTickCount() - start );
+
+    thread = CreateThread( NULL, 0, client_sync_set_thread, event, 0, NULL );
+    ret = WaitForSingleObject( event, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+    CloseHandle( event );
+
+    /* semaphores */
+    sem = CreateSemaphoreA( NULL, 1, 2, NULL );
+    SetLastError( 0xdeadbeef );
+    ret = ReleaseSemaphore( sem, 2, NULL );
+    ok( !ret, "ReleaseSemaphore succeeded\n" );
+    ok( GetLastError() == ERROR_TOO_MANY_POSTS, "wrong error %u\n", GetLastError() );
+    prev = -1;
+    ret = ReleaseSemaphore( sem, 1, &prev );
+    ok( ret, "ReleaseSemaphore failed err %u\n", GetLastError() );
+    ok( prev == 1, "wrong previous count %d\n", prev );
+    ret = WaitForSingleObject( sem, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( sem, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    start = GetTickCount();
+    ret = WaitForSingleObject( sem, 100 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    ok( GetTickCount() - start >= 80, "wait timed out after %u ms\n", GetTickCount() - start );
+    CloseHandle( sem );
+
+    /* waiting on several objects promotes them with their current state */
+    events[0] = CreateEventA( NULL, FALSE, FALSE, NULL );
+    events[1] = CreateEventA( NULL, FALSE, FALSE, NULL );
+    SetEvent( events[1] );
+    ret = WaitForMultipleObjects( 2, events, FALSE, 0 );
+    ok( ret == WAIT_OBJECT_0 + 1, "WaitForMultipleObjects returned %u\n", ret );
+    ret = WaitForMultipleObjects( 2, events, FALSE, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForMultipleObjects returned %u\n", ret );
+    SetEvent( events[0] );
+    SetEvent( events[1] );
+    ret = WaitForMultipleObjects( 2, events, TRUE, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", ret );
+    ret = WaitForSingleObject( events[0], 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( events[0] );
+    CloseHandle( events[1] );
+
+    /* objects made inheritable or duplicated into another process */
+    inherited = CreateEventA( NULL, TRUE, FALSE, NULL );
+    SetEvent( inherited );
+    ret = SetHandleInformation( inherited, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT );
+    ok( ret, "SetHandleInformation failed err %u\n", GetLastError() );
+    duplicated = CreateEventA( NULL, FALSE, FALSE, NULL );
+    SetEvent( duplicated );
+
+    ret = CreatePipe( &pipe_read, &pipe_write, &sa, 0 );
+    ok( ret, "CreatePipe failed err %u\n", GetLastError() );
+    SetHandleInformation( pipe_write, HANDLE_FLAG_INHERIT, 0 );
+
+    sprintf( cmdline, "%s sync client_sync_remote %p %p", argv[0], inherited, pipe_read );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, TRUE, 0, NULL, NULL, &startup, &info );
+    ok( ret, "failed to create child process error %u\n", GetLastError() );
+    remote = 0;
+    ret = DuplicateHandle( GetCurrentProcess(), duplicated, info.hProcess, &remote,
+                           0, FALSE, DUPLICATE_SAME_ACCESS );
+    ok( ret, "DuplicateHandle failed err %u\n", GetLastError() );
+    WriteFile( pipe_write, &remote, sizeof(remote), &written, NULL );
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hThread );
+    CloseHandle( info.hProcess );
+
+    ret = WaitForSingleObject( inherited, 0 );
+    ok( ret == WAIT_TIMEOUT, "inherited event not reset by the child, ret %u\n", ret );
+    ret = WaitForSingleObject( duplicated, 0 );
+    ok( ret == WAIT_TIMEOUT, "duplicated event not consumed by the child, ret %u\n", ret );
+
+    CloseHandle( pipe_read );
+    CloseHandle( pipe_write );
+    CloseHandle( inherited );
+    CloseHandle( duplicated );
+}
+
+static void test_client_sync(void)
+{
+    static const char var[] = "WINECLIENTSYNC=1";
+    char cmdline[MAX_PATH + 32], **argv;
+    char *strings, *env, *ptr;
+    SIZE_T len;
+
+    winetest_get_mainargs( &argv );
+
+    /* the environment block of the child is the current one with in-process objects enabled */
+    strings = GetEnvironmentStringsA();
+    for (ptr = strings; *ptr; ptr += strlen(ptr) + 1) ;
+    len = ptr - strings;
+    env = HeapAlloc( GetProcessHeap(), 0, sizeof(var) + len + 1 );
+    memcpy( env, var, sizeof(var) );
+    memcpy( env + sizeof(var), strings, len );
+    env[sizeof(var) + len] = 0;
+    FreeEnvironmentStringsA( strings );
+
+    sprintf( cmdline, "%s sync client_sync", argv[0] );
+    run_child( cmdline, env );
+    HeapFree( GetProcessHeap(), 0, env );
+}
 
 START_TEST(sync)
 {
     HMODULE hdll = GetModuleHandleA("kernel32.dll");
+    char **argv;
+    int argc;
+
     pChangeTimerQueueTimer = (void*)GetProcAddress(hdll, "ChangeTimerQueueTimer");
     pCreateTimerQueue = (void*)GetProcAddress(hdll, "CreateTimerQueue");
     pCreateTimerQueueTimer = (void*)GetProcAddress(hdll, "CreateTimerQueueTimer");
@@ -1687,6 +2134,27 @@ START_TEST(sync)
     pSleepConditionVariableCS = (void *)GetProcAddress(hdll, "SleepConditionVariableCS");
     pWakeAllConditionVariable = (void *)GetProcAddress(hdll, "WakeAllConditionVariable");
     pWakeConditionVariable = (void *)GetProcAddress(hdll, "WakeConditionVariable");
+    pInitializeSRWLock = (void *)GetProcAddress(hdll, "InitializeSRWLock");
+    pAcquireSRWLockExclusive = (void *)GetProcAddress(hdll, "AcquireSRWLockExclusive");
+    pAcquireSRWLockShared = (void *)GetProcAddress(hdll, "AcquireSRWLockShared");
+    pReleaseSRWLockExclusive = (void *)GetProcAddress(hdll, "ReleaseSRWLockExclusive");
+    pReleaseSRWLockShared = (void *)GetProcAddress(hdll, "ReleaseSRWLockShared");
+    pTryAcquireSRWLockExclusive = (void *)GetProcAddress(hdll, "TryAcquireSRWLockExclusive");
+    pTryAcquireSRWLockShared = (void *)GetProcAddress(hdll, "TryAcquireSRWLockShared");
+    pSleepConditionVariableSRW = (void *)GetProcAddress(hdll, "SleepConditionVariableSRW");
+    pGetQueuedCompletionStatusEx = (void *)GetProcAddress(hdll, "GetQueuedCompletionStatusEx");
+
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp( argv[2], "client_sync" ))
+    {
+        test_client_sync_child( argv );
+        return;
+    }
+    if (argc >= 5 && !strcmp( argv[2], "client_sync_remote" ))
+    {
+        test_client_sync_remote( argv );
+        return;
+    }
 
     test_signalandwait();
     test_mutex();
@@ -1694,11 +2162,16 @@ START_TEST(sync)
     test_event();
     test_semaphore();
     test_waitable_timer();
+    test_waitable_timer_churn();
+    test_many_named_objects();
     test_iocp_callback();
+    test_GetQueuedCompletionStatusEx();
     test_timer_queue();
     test_WaitForSingleObject();
     test_WaitForMultipleObjects();
     test_initonce();
     test_condvars_base();
     test_condvars_consumer_producer();
+    test_srwlock();
+    test_client_sync();
 }
@@ -1056,6 +1056,50 @@ static void test_QueueUserWorkItem(void)
     ok(times_executed == 100, "didn't execute all of the work items\n");
 }
 
+static DWORD persistent_tid;
+
+static void CALLBACK persistent_apc(ULONG_PTR arg)
+{
+    ok(GetCurrentThreadId() == persistent_tid, "APC ran in thread %04x instead of %04x\n",
+       GetCurrentThreadId(), persistent_tid);
+    SetEvent((HANDLE)arg);
+}
+
+static DWORD CALLBACK persistent_function(void *p)
+{
+    persistent_tid = GetCurrentThreadId();
+    /* the thread outlives the work item, so it can receive the APCs of its I/O */
+    ok(QueueUserAPC(persistent_apc, GetCurrentThread(), (ULONG_PTR)p),
+       "QueueUserAPC failed with error %d\n", GetLastError());
+    return 0;
+}
+
+static void test_QueueUserWorkItem_persistent(void)
+{
+    ULONG flags[] = { WT_EXECUTEINIOTHREAD, WT_EXECUTEINPERSISTENTTHREAD, WT_EXECUTEINPERSISTENTTHREAD };
+    HANDLE event;
+    DWORD wait_result;
+    unsigned int i;
+    BOOL ret;
+
+    if (!pQueueUserWorkItem) return;
+
+    /* a thread limit in the high word must not make the call fail */
+    WT_SET_MAX_THREADPOOL_THREADS(flags[2], 4);
+
+    event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+    {
+        ret = pQueueUserWorkItem(persistent_function, event, flags[i]);
+        ok(ret, "%u: QueueUserWorkItem failed with error %d\n", i, GetLastError());
+
+        wait_result = WaitForSingleObject(event, 5000);
+        ok(wait_result == WAIT_OBJECT_0, "%u: wait failed with error 0x%x\n", i, wait_result);
+        ok(persistent_tid != GetCurrentThreadId(), "%u: work item ran in the calling thread\n", i);
+    }
+    CloseHandle(event);
+}
+
 static void CALLBACK signaled_function(PVOID p, BOOLEAN TimerOrWaitFired)
 {
     HANDLE event = p;
@@ -1119,6 +1163,21 @@ static void test_RegisterWaitForSingleObject(void)
 
     ret = pUnregisterWait(wait_handle);
     ok(ret, "UnregisterWait failed with error %d\n", GetLastError());
+
+    /* test callback in the wait thread */
+
+    SetEvent(handle);
+
+    ret = pRegisterWaitForSingleObject(&wait_handle, handle, signaled_function, complete_event, INFINITE,
+                                       WT_EXECUTEONLYONCE | WT_EXECUTEINWAITTHREAD);
+    ok(ret, "RegisterWaitForSingleObject failed with error %d\n", GetLastError());
+
+    ok(WaitForSingleObject(complete_event, 5000) == WAIT_OBJECT_0, "callback wasn't called\n");
+    /* give wait thread chance to complete */
+    Sleep(100);
+
+    ret = pUnregisterWait(wait_handle);
+    ok(ret, "UnregisterWait failed with error %d\n", GetLastError());
 }
 
 static DWORD TLS_main;
@@ -1680,6 +1739,7 @@ START_TEST(thread)
    test_SetThreadContext();
 #endif
    test_QueueUserWorkItem();
+   test_QueueUserWorkItem_persistent();
    test_RegisterWaitForSingleObject();
    test_TLS();
    test_ThreadErrorMode();
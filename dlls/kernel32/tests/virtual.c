@@ -941,6 +941,54 @@ static void test_MapViewOfFile(void)
     DeleteFileA(testfile);
 }
 
+static void test_sparse_commit(void)
+{
+    static const unsigned int count = 2048;
+    MEMORY_BASIC_INFORMATION info;
+    SYSTEM_INFO si;
+    HANDLE mapping;
+    char *ptr, *ptr2, *addr;
+    unsigned int i, j, page;
+    SIZE_T ret;
+
+    GetSystemInfo(&si);
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE | SEC_RESERVE, 0,
+                                 count * si.dwPageSize, NULL);
+    ok(mapping != NULL, "CreateFileMappingA failed with error %d\n", GetLastError());
+    ptr = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    ok(ptr != NULL, "MapViewOfFile failed with error %d\n", GetLastError());
+
+    /* commit two pages out of three, in scattered order */
+    for (i = 0; i < count; i++)
+    {
+        page = (i * 769) % count;
+        if (page % 3 == 1) continue;
+        addr = VirtualAlloc(ptr + page * si.dwPageSize, si.dwPageSize, MEM_COMMIT, PAGE_READWRITE);
+        ok(addr == ptr + page * si.dwPageSize, "VirtualAlloc failed for page %u error %d\n", page, GetLastError());
+    }
+
+    /* the committed ranges are stored in the section, check them through another view */
+    ptr2 = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    ok(ptr2 != NULL, "MapViewOfFile failed with error %d\n", GetLastError());
+
+    for (i = 0; i < count; i = j)
+    {
+        BOOL committed = (i % 3 != 1);
+
+        for (j = i + 1; j < count; j++) if ((j % 3 != 1) != committed) break;
+        ret = VirtualQuery(ptr2 + i * si.dwPageSize, &info, sizeof(info));
+        ok(ret == sizeof(info), "VirtualQuery failed with error %d\n", GetLastError());
+        ok(info.State == (committed ? MEM_COMMIT : MEM_RESERVE), "%u: got state %#x\n", i, info.State);
+        ok(info.RegionSize == (j - i) * si.dwPageSize, "%u: got size %#lx, expected %#x\n",
+           i, info.RegionSize, (j - i) * si.dwPageSize);
+        if (info.RegionSize != (j - i) * si.dwPageSize) break;
+    }
+
+    UnmapViewOfFile(ptr2);
+    UnmapViewOfFile(ptr);
+    CloseHandle(mapping);
+}
+
 static void test_NtMapViewOfSection(void)
 {
     HANDLE hProcess;
@@ -2540,6 +2588,7 @@ START_TEST(virtual)
     test_VirtualAllocEx();
     test_VirtualAlloc();
     test_MapViewOfFile();
+    test_sparse_commit();
     test_NtMapViewOfSection();
     test_NtAreMappedFilesTheSame();
     test_CreateFileMapping();
@@ -167,6 +167,7 @@ UNICODE_STRING system_dir = { 0, 0, NULL };  /* system directory */
 
 static struct file_identity curdir;
 static struct file_identity windir;
+static int curdir_fd = -1;  /* fd of the directory being read */
 
 static RTL_CRITICAL_SECTION dir_section;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -1251,6 +1252,47 @@ static BOOLEAN match_filename( const UNICODE_STRING *name_str, const UNICODE_STR
 }
 
 
+/***********************************************************************
+ *           stat_dir_entry
+ *
+ * Get the attributes of an entry of the directory being read. The lookup
+ * is done relative to the directory fd, so that the kernel doesn't need
+ * to resolve the name from the current directory for each entry.
+ * dir_section must be held by caller.
+ */
+static int stat_dir_entry( const char *name, struct stat *st, BOOL follow_links )
+{
+#ifdef AT_SYMLINK_NOFOLLOW
+    if (!fstatat( curdir_fd, name, st, follow_links ? 0 : AT_SYMLINK_NOFOLLOW )) return 0;
+    if (errno != ENOSYS) return -1;
+#endif
+    return follow_links ? stat( name, st ) : lstat( name, st );
+}
+
+/***********************************************************************
+ *           get_entry_short_name
+ *
+ * Get the short name of a directory entry, either from the file system
+ * or by generating one. Returns 0 if the long name is a valid 8.3 name.
+ */
+static int get_entry_short_name( const UNICODE_STRING *long_name, const char *short_name,
+                                 WCHAR short_nameW[12] )
+{
+    BOOLEAN spaces;
+    int len;
+
+    if (short_name)
+    {
+        len = ntdll_umbstowcs( 0, short_name, strlen(short_name), short_nameW, 12 );
+        return len == -1 ? 12 : len;
+    }
+    /* names longer than 12 chars can't be valid 8.3 names, no need to convert them */
+    if (long_name->Length <= 12 * sizeof(WCHAR) &&
+        RtlIsNameLegalDOS8Dot3( long_name, NULL, &spaces ) && !spaces)
+        return 0;
+    return hash_short_file_name( long_name, short_nameW );
+}
+
 /***********************************************************************
  *           append_entry
  *
@@ -1268,6 +1310,7 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
     WCHAR *filename;
     UNICODE_STRING str;
     ULONG attributes = 0;
+    BOOL matched;
 
     io->u.Status = STATUS_SUCCESS;
     long_len = ntdll_umbstowcs( 0, long_name, strlen(long_name), long_nameW, MAX_DIR_ENTRY_LEN );
@@ -1277,25 +1320,16 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
     str.Length = long_len * sizeof(WCHAR);
     str.MaximumLength = sizeof(long_nameW);
 
-    if (short_name)
-    {
-        short_len = ntdll_umbstowcs( 0, short_name, strlen(short_name),
-                                     short_nameW, sizeof(short_nameW) / sizeof(WCHAR) );
-        if (short_len == -1) short_len = sizeof(short_nameW) / sizeof(WCHAR);
-    }
-    else  /* generate a short name if necessary */
-    {
-        BOOLEAN spaces;
-
-        short_len = 0;
-        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
-            short_len = hash_short_file_name( &str, short_nameW );
-    }
+    /* the short name is only needed by some classes, or if the long name doesn't match */
+    matched = !mask || match_filename( &str, mask );
+    short_len = 0;
+    if (!matched || class == FileBothDirectoryInformation || class == FileIdBothDirectoryInformation)
+        short_len = get_entry_short_name( &str, short_name, short_nameW );
 
     TRACE( "long %s short %s mask %s\n",
            debugstr_us(&str), debugstr_wn(short_nameW, short_len), debugstr_us(mask) );
 
-    if (mask && !match_filename( &str, mask ))
+    if (!matched)
     {
         if (!short_len) return NULL;  /* no short name to match */
         str.Buffer = short_nameW;
@@ -1304,10 +1338,10 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
         if (!match_filename( &str, mask )) return NULL;
     }
 
-    if (lstat( long_name, &st ) == -1) return NULL;
+    if (stat_dir_entry( long_name, &st, FALSE ) == -1) return NULL;
     if (S_ISLNK( st.st_mode ))
     {
-        if (stat( long_name, &st ) == -1) return NULL;
+        if (stat_dir_entry( long_name, &st, TRUE ) == -1) return NULL;
         if (S_ISDIR( st.st_mode )) attributes |= FILE_ATTRIBUTE_REPARSE_POINT;
     }
     if (is_ignored_file( &st ))
@@ -1983,7 +2017,7 @@ static int read_directory_stat( int fd, IO_STATUS_BLOCK *io, void *buffer, ULONG
             goto done;
         }
 
-        ret = stat( unix_name, &st );
+        ret = stat_dir_entry( unix_name, &st, TRUE );
         if (!ret)
         {
             union file_directory_info *info = append_entry( buffer, io, length, unix_name, NULL, NULL, class );
@@ -2062,6 +2096,7 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
         fstat( fd, &st );
         curdir.dev = st.st_dev;
         curdir.ino = st.st_ino;
+        curdir_fd = fd;
 #ifdef VFAT_IOCTL_READDIR_BOTH
         if ((read_directory_vfat( fd, io, buffer, length, single_entry,
                                   mask, restart_scan, info_class )) != -1) goto done;
@@ -2079,6 +2114,7 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
         read_directory_readdir( fd, io, buffer, length, single_entry, mask, restart_scan, info_class );
 
     done:
+        curdir_fd = -1;
         if (cwd == -1 || fchdir( cwd ) == -1) chdir( "/" );
     }
     else io->u.Status = FILE_GetNtStatus();
@@ -2092,6 +2128,294 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/***********************************************************************
+ *           Directory name cache
+ *
+ * Case-insensitive lookups that miss the exact-case shortcut have to scan
+ * the whole directory. To avoid doing that for every path component of
+ * every file that gets opened, the lower-cased names of recently scanned
+ * directories are kept in a hash table, together with the generated short
+ * names. A cached listing is only used as long as the directory mtime
+ * hasn't changed, and only if the directory was last modified before the
+ * listing was read, so that changes within the mtime granularity can't be
+ * missed. Directories that are too large are remembered with an entry that
+ * has no names, so that they aren't read again until they change.
+ */
+
+#define DIR_CACHE_MAX_DIRS    64           /* number of cached directories */
+#define DIR_CACHE_MAX_NAMES   16384        /* larger directories aren't cached */
+
+struct dir_cache_name
+{
+    const WCHAR   *key;       /* lower-case long or short name */
+    unsigned int   len;       /* length of the key in chars */
+    unsigned int   hash;      /* hash of the key */
+    const char    *unix_name; /* Unix name of the entry */
+    BOOL           is_short;  /* whether the key is a generated short name */
+};
+
+struct dir_cache
+{
+    struct list            entry;      /* entry in the LRU list */
+    dev_t                  dev;        /* directory identity */
+    ino_t                  ino;
+    time_t                 mtime;      /* directory mtime when the listing was read */
+    unsigned long          mtime_nsec;
+    time_t                 read_time;  /* time the listing was read */
+    unsigned int           size;       /* hash table size, power of 2 */
+    struct dir_cache_name *names;      /* hash table of names, NULL if too large */
+    char                  *data;       /* storage for keys and Unix names */
+};
+
+static struct list dir_cache_list = LIST_INIT( dir_cache_list );
+static unsigned int dir_cache_count;
+static unsigned int dir_cache_hits, dir_cache_misses;
+
+static RTL_CRITICAL_SECTION dir_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG dir_cache_critsect_debug =
+{
+    0, 0, &dir_cache_section,
+    { &dir_cache_critsect_debug.ProcessLocksList, &dir_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": dir_cache_section") }
+};
+static RTL_CRITICAL_SECTION dir_cache_section = { &dir_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline unsigned long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+static unsigned int dir_cache_hash( const WCHAR *name, unsigned int len )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < len; i++) hash = hash * 31 + name[i];
+    return hash;
+}
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+    list_remove( &cache->entry );
+    dir_cache_count--;
+    RtlFreeHeap( GetProcessHeap(), 0, cache->names );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->data );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+/* add a key to the hash table, the table is never full */
+static void dir_cache_insert( struct dir_cache *cache, const WCHAR *key, unsigned int len,
+                              const char *unix_name, BOOL is_short )
+{
+    unsigned int hash = dir_cache_hash( key, len );
+    unsigned int i = hash & (cache->size - 1);
+
+    while (cache->names[i].key) i = (i + 1) & (cache->size - 1);
+    cache->names[i].key       = key;
+    cache->names[i].len       = len;
+    cache->names[i].hash      = hash;
+    cache->names[i].unix_name = unix_name;
+    cache->names[i].is_short  = is_short;
+}
+
+/***********************************************************************
+ *           read_dir_cache
+ *
+ * Read a directory and build the corresponding cache entry, or an entry
+ * without names if the directory is too large to be cached.
+ */
+static struct dir_cache *read_dir_cache( const char *unix_name, const struct stat *st )
+{
+    struct dir_cache *cache;
+    struct { unsigned int offset, len, short_len; } *entries = NULL, *new_entries;
+    unsigned int i, count = 0, alloc = 64, size = 0, data_size = 4096;
+    WCHAR name[MAX_DIR_ENTRY_LEN], short_name[12];
+    UNICODE_STRING str;
+    BOOLEAN spaces;
+    struct dirent *de;
+    DIR *dir;
+    char *new_data;
+    int len, short_len, unix_len;
+
+    if (!(dir = opendir( unix_name ))) return NULL;
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) ))) goto error;
+    cache->dev        = st->st_dev;
+    cache->ino        = st->st_ino;
+    cache->mtime      = st->st_mtime;
+    cache->mtime_nsec = get_mtime_nsec( st );
+    cache->read_time  = time( NULL );
+
+    if (!(entries = RtlAllocateHeap( GetProcessHeap(), 0, alloc * sizeof(*entries) ))) goto error;
+    if (!(cache->data = RtlAllocateHeap( GetProcessHeap(), 0, data_size ))) goto error;
+
+    /* store each entry as lower-case name, lower-case short name, and Unix name */
+    while ((de = readdir( dir )))
+    {
+        if ((len = ntdll_umbstowcs( 0, de->d_name, strlen(de->d_name), name, MAX_DIR_ENTRY_LEN )) <= 0)
+            continue;
+        if (count == DIR_CACHE_MAX_NAMES)
+        {
+            TRACE( "%s has too many entries to be cached\n", debugstr_a(unix_name) );
+            closedir( dir );
+            RtlFreeHeap( GetProcessHeap(), 0, entries );
+            RtlFreeHeap( GetProcessHeap(), 0, cache->data );
+            cache->data = NULL;
+            return cache;
+        }
+
+        str.Buffer = name;
+        str.Length = str.MaximumLength = len * sizeof(WCHAR);
+        short_len = 0;
+        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+            short_len = hash_short_file_name( &str, short_name );
+
+        if (count == alloc)
+        {
+            if (!(new_entries = RtlReAllocateHeap( GetProcessHeap(), 0, entries,
+                                                   2 * alloc * sizeof(*entries) ))) goto error;
+            entries = new_entries;
+            alloc *= 2;
+        }
+        unix_len = (strlen( de->d_name ) + 2) & ~1;  /* keep the next entry WCHAR-aligned */
+        while (size + (len + short_len) * sizeof(WCHAR) + unix_len > data_size)
+        {
+            if (!(new_data = RtlReAllocateHeap( GetProcessHeap(), 0, cache->data, 2 * data_size )))
+                goto error;
+            cache->data = new_data;
+            data_size *= 2;
+        }
+
+        entries[count].offset    = size;
+        entries[count].len       = len;
+        entries[count].short_len = short_len;
+        for (i = 0; i < len; i++) ((WCHAR *)(cache->data + size))[i] = tolowerW( name[i] );
+        size += len * sizeof(WCHAR);
+        for (i = 0; i < short_len; i++) ((WCHAR *)(cache->data + size))[i] = tolowerW( short_name[i] );
+        size += short_len * sizeof(WCHAR);
+        strcpy( cache->data + size, de->d_name );
+        size += unix_len;
+        count++;
+    }
+    closedir( dir );
+
+    for (cache->size = 16; cache->size < 2 * (2 * count + 1); cache->size *= 2) ;
+    if (!(cache->names = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                          cache->size * sizeof(*cache->names) )))
+    {
+        dir = NULL;
+        goto error;
+    }
+    for (i = 0; i < count; i++)
+    {
+        const WCHAR *key = (const WCHAR *)(cache->data + entries[i].offset);
+        const char *unix_entry = (const char *)(key + entries[i].len + entries[i].short_len);
+
+        dir_cache_insert( cache, key, entries[i].len, unix_entry, FALSE );
+        if (entries[i].short_len)
+            dir_cache_insert( cache, key + entries[i].len, entries[i].short_len, unix_entry, TRUE );
+    }
+
+    RtlFreeHeap( GetProcessHeap(), 0, entries );
+    TRACE( "cached %u names for %s\n", count, debugstr_a(unix_name) );
+    return cache;
+
+error:
+    if (dir) closedir( dir );
+    RtlFreeHeap( GetProcessHeap(), 0, entries );
+    if (cache)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, cache->names );
+        RtlFreeHeap( GetProcessHeap(), 0, cache->data );
+        RtlFreeHeap( GetProcessHeap(), 0, cache );
+    }
+    return NULL;
+}
+
+/***********************************************************************
+ *           find_file_in_dir_cache
+ *
+ * Look up a name in the cached listing of the directory unix_name, reading
+ * the directory if necessary. On success the Unix name is appended at pos.
+ * Returns STATUS_MORE_PROCESSING_REQUIRED if the directory can't be cached.
+ */
+static NTSTATUS find_file_in_dir_cache( char *unix_name, int pos, const WCHAR *name, int length )
+{
+    struct dir_cache *cache;
+    const struct dir_cache_name *match = NULL;
+    struct stat st;
+    WCHAR key[MAX_DIR_ENTRY_LEN];
+    unsigned int i, hash;
+
+    if (length > MAX_DIR_ENTRY_LEN) return STATUS_OBJECT_PATH_NOT_FOUND;
+    if (stat( unix_name, &st ) == -1)
+        return errno == ENOENT ? STATUS_OBJECT_PATH_NOT_FOUND : FILE_GetNtStatus();
+    if (!S_ISDIR( st.st_mode )) return STATUS_OBJECT_PATH_NOT_FOUND;
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_cache_list, struct dir_cache, entry )
+    {
+        if (cache->dev != st.st_dev || cache->ino != st.st_ino) continue;
+        if (cache->mtime == st.st_mtime && cache->mtime_nsec == get_mtime_nsec( &st ) &&
+            cache->mtime < cache->read_time)
+        {
+            dir_cache_hits++;
+            goto found;
+        }
+        free_dir_cache( cache );
+        break;
+    }
+
+    dir_cache_misses++;
+    if (!(cache = read_dir_cache( unix_name, &st )))
+    {
+        RtlLeaveCriticalSection( &dir_cache_section );
+        return STATUS_MORE_PROCESSING_REQUIRED;
+    }
+    if (dir_cache_count == DIR_CACHE_MAX_DIRS)
+        free_dir_cache( LIST_ENTRY( list_tail( &dir_cache_list ), struct dir_cache, entry ));
+    list_add_head( &dir_cache_list, &cache->entry );
+    dir_cache_count++;
+    if (!(dir_cache_misses % 1024))
+        TRACE( "%u hits, %u misses\n", dir_cache_hits, dir_cache_misses );
+
+found:
+    list_remove( &cache->entry );
+    list_add_head( &dir_cache_list, &cache->entry );
+    if (!cache->names)
+    {
+        RtlLeaveCriticalSection( &dir_cache_section );
+        return STATUS_MORE_PROCESSING_REQUIRED;
+    }
+
+    for (i = 0; i < length; i++) key[i] = tolowerW( name[i] );
+    hash = dir_cache_hash( key, length );
+    for (i = hash & (cache->size - 1); cache->names[i].key; i = (i + 1) & (cache->size - 1))
+    {
+        const struct dir_cache_name *entry = &cache->names[i];
+
+        if (entry->hash != hash || entry->len != length) continue;
+        if (memcmp( entry->key, key, length * sizeof(WCHAR) )) continue;
+        match = entry;
+        /* a long name takes precedence over a generated short name */
+        if (!entry->is_short) break;
+    }
+    if (match)
+    {
+        unix_name[pos - 1] = '/';
+        strcpy( unix_name + pos, match->unix_name );
+    }
+
+    RtlLeaveCriticalSection( &dir_cache_section );
+    return match ? STATUS_SUCCESS : STATUS_OBJECT_PATH_NOT_FOUND;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2108,6 +2432,7 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     DIR *dir;
     struct dirent *de;
     struct stat st;
+    NTSTATUS status;
     int ret, used_default;
 
     /* try a shortcut for this directory */
@@ -2199,6 +2524,14 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    unix_name[pos - 1] = 0;
+    status = find_file_in_dir_cache( unix_name, pos, name, length );
+    if (status == STATUS_SUCCESS) goto success;
+    if (status == STATUS_OBJECT_PATH_NOT_FOUND) goto not_found;
+    if (status != STATUS_MORE_PROCESSING_REQUIRED) return status;
+
+    /* the directory can't be cached, scan it directly */
+
     if (!(dir = opendir( unix_name )))
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
@@ -83,6 +83,7 @@
 #include "wine/unicode.h"
 #include "wine/debug.h"
 #include "wine/server.h"
+#include "wine/list.h"
 #include "ntdll_misc.h"
 
 #include "winternl.h"
@@ -559,6 +560,231 @@ static NTSTATUS get_io_avail_mode( HANDLE handle, enum server_fd_type type, BOOL
 }
 
 
+/*
+ * Overlapped I/O on regular files
+ *
+ * Regular files are always ready for I/O, so overlapped reads and writes are
+ * normally performed synchronously by the calling thread. When WINEASYNCFILEIO
+ * is set, overlapped I/O at an explicit offset that has an event to wait on is
+ * instead handed to the thread pool, so that several requests can be in flight
+ * at the same time. Pending requests are kept in a list so that cancelling them
+ * or closing the file handle completes them before the caller can free the
+ * buffer or the I/O status block.
+ */
+
+enum async_file_io_state
+{
+    ASYNC_IO_QUEUED,            /* waiting for a worker thread */
+    ASYNC_IO_RUNNING,           /* a worker thread is doing the I/O */
+    ASYNC_IO_CANCELED           /* completed with STATUS_CANCELLED before it started */
+};
+
+struct async_file_io
+{
+    struct list      entry;     /* entry in the pending requests list */
+    enum async_file_io_state state;
+    HANDLE           handle;    /* file handle the request was issued on */
+    ULONG            thread_id; /* thread that issued the request */
+    int              fd;        /* private copy of the unix fd */
+    BOOL             write;     /* write or read? */
+    HANDLE           event;     /* event to signal on completion */
+    HANDLE           thread;    /* thread to queue the APC to */
+    PIO_APC_ROUTINE  apc;       /* user APC */
+    void            *apc_user;  /* user APC argument */
+    ULONG_PTR        cvalue;    /* completion port value */
+    IO_STATUS_BLOCK *iosb;      /* user I/O status block */
+    void            *buffer;    /* user buffer */
+    ULONG            length;    /* length of the transfer */
+    off_t            offset;    /* file offset */
+};
+
+static struct list async_file_io_list = LIST_INIT( async_file_io_list );
+static RTL_CONDITION_VARIABLE async_file_io_done = RTL_CONDITION_VARIABLE_INIT;
+
+static RTL_CRITICAL_SECTION async_file_io_section;
+static RTL_CRITICAL_SECTION_DEBUG async_file_io_critsect_debug =
+{
+    0, 0, &async_file_io_section,
+    { &async_file_io_critsect_debug.ProcessLocksList, &async_file_io_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": async_file_io_section") }
+};
+static RTL_CRITICAL_SECTION async_file_io_section = { &async_file_io_critsect_debug, -1, 0, 0, 0, 0 };
+
+static int async_file_io_enabled = -1;
+
+/* check whether overlapped I/O on regular files should run in the thread pool */
+static BOOL use_async_file_io(void)
+{
+    if (async_file_io_enabled == -1)
+    {
+        const char *env = getenv( "WINEASYNCFILEIO" );
+        async_file_io_enabled = env && atoi( env );
+    }
+    return async_file_io_enabled;
+}
+
+/* report the completion of an overlapped file I/O to the application */
+static void complete_async_file_io( struct async_file_io *io, NTSTATUS status, ULONG total )
+{
+    io->iosb->Information = total;
+    interlocked_xchg( (int *)&io->iosb->u.Status, status );  /* status must be set last */
+    if (io->event) NtSetEvent( io->event, NULL );
+    if (io->thread)
+    {
+        if (!status) NtQueueApcThread( io->thread, (PNTAPCFUNC)io->apc, (ULONG_PTR)io->apc_user,
+                                       (ULONG_PTR)io->iosb, 0 );
+        NtClose( io->thread );
+        io->thread = 0;
+    }
+    if (io->cvalue) NTDLL_AddCompletion( io->handle, io->cvalue, status, total );
+}
+
+/* thread pool callback performing an overlapped file I/O */
+static DWORD CALLBACK async_file_io_work( void *arg )
+{
+    struct async_file_io *io = arg;
+    NTSTATUS status;
+    ULONG total = 0;
+    ssize_t result;
+
+    RtlEnterCriticalSection( &async_file_io_section );
+    if (io->state == ASYNC_IO_QUEUED) io->state = ASYNC_IO_RUNNING;
+    RtlLeaveCriticalSection( &async_file_io_section );
+
+    if (io->state == ASYNC_IO_CANCELED)  /* already completed and removed from the list */
+    {
+        close( io->fd );
+        RtlFreeHeap( GetProcessHeap(), 0, io );
+        return 0;
+    }
+
+    do
+    {
+        if (io->write) result = pwrite( io->fd, io->buffer, io->length, io->offset );
+        else result = pread( io->fd, io->buffer, io->length, io->offset );
+    } while (result == -1 && errno == EINTR);
+
+    if (result == -1)
+    {
+        if (io->write && errno == EFAULT) status = STATUS_INVALID_USER_BUFFER;
+        else status = FILE_GetNtStatus();
+    }
+    else
+    {
+        total = result;
+        status = (total || io->write) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+    close( io->fd );
+
+    TRACE( "%p %s %u bytes at %s = %x\n", io->handle, io->write ? "write" : "read",
+           total, wine_dbgstr_longlong( io->offset ), status );
+
+    complete_async_file_io( io, status, total );
+
+    RtlEnterCriticalSection( &async_file_io_section );
+    list_remove( &io->entry );
+    RtlWakeAllConditionVariable( &async_file_io_done );
+    RtlLeaveCriticalSection( &async_file_io_section );
+
+    RtlFreeHeap( GetProcessHeap(), 0, io );
+    return 0;
+}
+
+/* hand an overlapped file I/O to the thread pool, return FALSE if it has to be done synchronously */
+static BOOL queue_async_file_io( HANDLE handle, int fd, BOOL write, HANDLE event,
+                                 PIO_APC_ROUTINE apc, void *apc_user, ULONG_PTR cvalue,
+                                 IO_STATUS_BLOCK *io_status, void *buffer, ULONG length, off_t offset )
+{
+    struct async_file_io *io;
+
+    if (!use_async_file_io()) return FALSE;
+    /* without an event GetOverlappedResult waits on the file handle, which is always signaled */
+    if (!length || !event) return FALSE;
+
+    if (!(io = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*io) ))) return FALSE;
+    io->state     = ASYNC_IO_QUEUED;
+    io->handle    = handle;
+    io->thread_id = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    io->write     = write;
+    io->event     = event;
+    io->thread    = 0;
+    io->apc       = apc;
+    io->apc_user  = apc_user;
+    io->cvalue    = cvalue;
+    io->iosb      = io_status;
+    io->buffer    = buffer;
+    io->length    = length;
+    io->offset    = offset;
+
+    if ((io->fd = dup( fd )) == -1) goto failed;
+    if (apc && NtDuplicateObject( NtCurrentProcess(), GetCurrentThread(), NtCurrentProcess(),
+                                  &io->thread, 0, 0, DUPLICATE_SAME_ACCESS ))
+        goto failed;
+    NtResetEvent( event, NULL );
+
+    io_status->u.Status = STATUS_PENDING;
+    io_status->Information = 0;
+
+    RtlEnterCriticalSection( &async_file_io_section );
+    list_add_tail( &async_file_io_list, &io->entry );
+    if (!RtlQueueWorkItem( async_file_io_work, io, WT_EXECUTELONGFUNCTION ))
+    {
+        RtlLeaveCriticalSection( &async_file_io_section );
+        return TRUE;
+    }
+    list_remove( &io->entry );
+    RtlLeaveCriticalSection( &async_file_io_section );
+
+failed:
+    if (io->fd != -1) close( io->fd );
+    if (io->thread) NtClose( io->thread );
+    RtlFreeHeap( GetProcessHeap(), 0, io );
+    return FALSE;
+}
+
+/***********************************************************************
+ *           cancel_async_file_io
+ *
+ * Cancel the thread pool requests issued on a file handle. Requests that
+ * haven't started are completed with STATUS_CANCELLED, running ones are
+ * waited for, so that none of them touches the caller's buffers afterwards.
+ * Returns TRUE if any request matched.
+ */
+BOOL cancel_async_file_io( HANDLE handle, IO_STATUS_BLOCK *iosb, BOOL only_thread )
+{
+    ULONG thread_id = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    struct async_file_io *io, *next;
+    BOOL found = FALSE, running;
+
+    if (list_empty( &async_file_io_list )) return FALSE;
+
+    RtlEnterCriticalSection( &async_file_io_section );
+    do
+    {
+        running = FALSE;
+        LIST_FOR_EACH_ENTRY_SAFE( io, next, &async_file_io_list, struct async_file_io, entry )
+        {
+            if (io->handle != handle) continue;
+            if (iosb && io->iosb != iosb) continue;
+            if (only_thread && io->thread_id != thread_id) continue;
+            found = TRUE;
+            if (io->state == ASYNC_IO_RUNNING)
+            {
+                running = TRUE;
+                continue;
+            }
+            TRACE( "canceling %s on %p\n", io->write ? "write" : "read", io->handle );
+            io->state = ASYNC_IO_CANCELED;
+            list_remove( &io->entry );
+            complete_async_file_io( io, STATUS_CANCELLED, 0 );
+        }
+        if (running) RtlSleepConditionVariableCS( &async_file_io_done, &async_file_io_section, NULL );
+    } while (running);
+    RtlLeaveCriticalSection( &async_file_io_section );
+    return found;
+}
+
+
 /******************************************************************************
  *  NtReadFile					[NTDLL.@]
  *  ZwReadFile					[NTDLL.@]
@@ -622,7 +848,13 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
-            /* async I/O doesn't make sense on regular files */
+            if (async_read && queue_async_file_io( hFile, unix_handle, FALSE, hEvent, apc, apc_user, cvalue,
+                                                   io_status, buffer, length, offset->QuadPart ))
+            {
+                status = STATUS_PENDING;
+                goto err;
+            }
+
             while ((result = pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
                 if (errno != EINTR)
@@ -1034,7 +1266,13 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
                 goto done;
             }
 
-            /* async I/O doesn't make sense on regular files */
+            if (async_write && queue_async_file_io( hFile, unix_handle, TRUE, hEvent, apc, apc_user, cvalue,
+                                                    io_status, (void *)buffer, length, off ))
+            {
+                status = STATUS_PENDING;
+                goto err;
+            }
+
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
             {
                 if (errno != EINTR)
@@ -3066,9 +3304,12 @@ NTSTATUS WINAPI NtDeleteFile( POBJECT_ATTRIBUTES ObjectAttributes )
 NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATUS_BLOCK io_status )
 {
     LARGE_INTEGER timeout;
+    BOOL found;
 
     TRACE("%p %p %p\n", hFile, iosb, io_status );
 
+    found = cancel_async_file_io( hFile, iosb, FALSE );
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( hFile );
@@ -3077,6 +3318,7 @@ NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATU
         io_status->u.Status = wine_server_call( req );
     }
     SERVER_END_REQ;
+    if (found && io_status->u.Status == STATUS_NOT_FOUND) io_status->u.Status = STATUS_SUCCESS;
     if (io_status->u.Status)
         return io_status->u.Status;
 
@@ -3101,6 +3343,8 @@ NTSTATUS WINAPI NtCancelIoFile( HANDLE hFile, PIO_STATUS_BLOCK io_status )
 
     TRACE("%p %p\n", hFile, io_status );
 
+    cancel_async_file_io( hFile, NULL, TRUE );
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( hFile );
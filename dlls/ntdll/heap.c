@@ -129,6 +129,77 @@ typedef union
 
 struct tagHEAP;
 
+/* low-fragmentation heap front-end */
+
+#define LFH_GRANULARITY      16      /* size granularity of the LFH blocks */
+#define LFH_MAX_BLOCK_SIZE   0x400   /* largest block (including arena) handled by the LFH */
+#define LFH_NB_CLASSES       (LFH_MAX_BLOCK_SIZE / LFH_GRANULARITY)
+#define LFH_MAX_DATA_SIZE    (LFH_MAX_BLOCK_SIZE - sizeof(ARENA_INUSE))
+#define LFH_SUBSEGMENT_SIZE  0x10000 /* size of the chunks taken from the back-end; must match the allocation granularity */
+#define LFH_CACHE_MAX        32      /* max number of free blocks in a thread cache bin */
+#define LFH_CACHE_BATCH      16      /* number of blocks moved at once between a thread and the heap */
+#define LFH_THREAD_HEAPS     4       /* number of heaps a thread can cache blocks for */
+#define LFH_TABLE_MIN_SIZE   512     /* initial number of slots of the subsegment table */
+#define LFH_ACTIVATION_COUNT 2048    /* small allocations before the LFH is enabled automatically */
+#define LFH_SLOT_REMOVED     1       /* subsegment table slot of a released subsegment */
+
+#define ARENA_LFH_MAGIC      0x484652  /* in-use LFH block */
+#define ARENA_LFH_FREE_MAGIC 0x464652  /* free LFH block */
+#define LFH_SUBSEGMENT_MAGIC ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('S'<<24)))
+
+/* free LFH blocks, chained through their first data pointer */
+struct lfh_bin
+{
+    ARENA_INUSE        *free;       /* first free block */
+    ULONG               count;      /* number of blocks in the chain */
+};
+
+/* per-heap state of a size class */
+struct lfh_class
+{
+    struct list         subsegments; /* subsegments that have free blocks */
+    ULONG               empty;      /* number of empty subsegments kept for reuse */
+};
+
+/* header of a chunk of LFH blocks, stored in a large block of the back-end */
+typedef struct tagLFH_SUBSEGMENT
+{
+    DWORD               magic;      /* Magic number */
+    DWORD               block_size; /* Size of the blocks, including the arena */
+    struct tagHEAP     *heap;       /* Heap owning the subsegment */
+    struct list         entry;      /* Entry in the size class list */
+    ARENA_INUSE        *free;       /* Free blocks given back to the subsegment */
+    char               *next;       /* Next never used block */
+    char               *end;        /* End of the blocks */
+    ULONG               used;       /* Blocks held by thread caches or the application */
+} LFH_SUBSEGMENT;
+
+/* open addressing table of the subsegment addresses of a heap; it is looked up
+ * without holding the heap lock, so tables are only replaced, never freed
+ * before the heap is destroyed */
+struct lfh_table
+{
+    struct lfh_table   *prev;       /* Previous table */
+    SIZE_T              alloc_size; /* Size of the table allocation */
+    ULONG               size;       /* Number of slots, a power of two */
+    ULONG               used;       /* Slots in use, including removed ones */
+    ULONG               count;      /* Subsegments in the table */
+    ULONG_PTR           slots[1];   /* Subsegment addresses */
+};
+
+/* per-thread cache of free blocks for a given heap */
+struct lfh_thread_heap
+{
+    struct tagHEAP     *heap;       /* Heap the blocks belong to */
+    LONG                serial;     /* Serial of the heap when the cache was created */
+    struct lfh_bin      bins[LFH_NB_CLASSES];
+};
+
+struct lfh_thread_cache
+{
+    struct lfh_thread_heap heaps[LFH_THREAD_HEAPS];
+};
+
 typedef struct tagSUBHEAP
 {
     void               *base;       /* Base address of the sub-heap memory block */
@@ -159,6 +230,10 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct lfh_class *lfh;          /* Size classes of the LFH front-end, if enabled */
+    struct lfh_table *lfh_table;    /* Table of the LFH subsegments */
+    LONG             lfh_serial;    /* Serial number identifying the heap in thread caches */
+    DWORD            small_allocs;  /* Small allocations done before enabling the LFH */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -174,6 +249,7 @@ typedef struct tagHEAP
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static HEAP *processHeap;  /* main process heap */
+static LONG lfh_serial;   /* last serial number given to a LFH heap */
 
 static BOOL HEAP_IsRealArena( HEAP *heapPtr, DWORD flags, LPCVOID block, BOOL quiet );
 
@@ -860,6 +936,496 @@ static BOOL validate_large_arena( HEAP *heap, const ARENA_LARGE *arena, BOOL qui
 }
 
 
+/***********************************************************************
+ *           lfh_get_class
+ *
+ * Get the LFH size class for a given data size.
+ */
+static inline unsigned int lfh_get_class( SIZE_T size )
+{
+    return (size + sizeof(ARENA_INUSE) - 1) / LFH_GRANULARITY;
+}
+
+
+/***********************************************************************
+ *           lfh_first_block
+ *
+ * Get the arena of the first block of a subsegment.
+ */
+static inline char *lfh_first_block( const LFH_SUBSEGMENT *subsegment )
+{
+    return (char *)subsegment + ROUND_SIZE( sizeof(*subsegment) );
+}
+
+
+/***********************************************************************
+ *           lfh_hash
+ */
+static inline ULONG lfh_hash( ULONG_PTR base )
+{
+    return (ULONG)(base / LFH_SUBSEGMENT_SIZE) * 0x9e3779b1;
+}
+
+
+/***********************************************************************
+ *           lfh_find_subsegment
+ *
+ * Find the LFH subsegment containing a block. Subsegments are aligned on
+ * their size; the pointer is only dereferenced once its subsegment has been
+ * found in the heap table, so that invalid pointers are handled by the back-end.
+ */
+static LFH_SUBSEGMENT *lfh_find_subsegment( const HEAP *heap, const void *ptr )
+{
+    ULONG_PTR base = (ULONG_PTR)ptr & ~(ULONG_PTR)(LFH_SUBSEGMENT_SIZE - 1);
+    const struct lfh_table *table = *(struct lfh_table * volatile *)&heap->lfh_table;
+    const char *arena = (const char *)((const ARENA_INUSE *)ptr - 1);
+    LFH_SUBSEGMENT *subsegment;
+    ULONG_PTR slot;
+    ULONG i;
+
+    if (!table || (ULONG_PTR)ptr % ALIGNMENT) return NULL;
+
+    for (i = lfh_hash( base ) & (table->size - 1); ; i = (i + 1) & (table->size - 1))
+    {
+        slot = ((volatile const ULONG_PTR *)table->slots)[i];
+        if (!slot) return NULL;
+        if (slot == base) break;
+    }
+
+    subsegment = (LFH_SUBSEGMENT *)((ARENA_LARGE *)base + 1);
+    if (arena < lfh_first_block( subsegment ) || arena >= subsegment->next) return NULL;
+    if ((arena - lfh_first_block( subsegment )) % subsegment->block_size) return NULL;
+    return subsegment;
+}
+
+
+/***********************************************************************
+ *           lfh_table_add
+ *
+ * Add a subsegment to the heap table. The heap must be locked.
+ */
+static BOOL lfh_table_add( HEAP *heap, LFH_SUBSEGMENT *subsegment )
+{
+    ULONG_PTR base = (ULONG_PTR)((ARENA_LARGE *)subsegment - 1);
+    struct lfh_table *table = heap->lfh_table, *new_table;
+    ULONG i, j, size;
+
+    if (!table || (table->used + 1) * 4 > table->size * 3)
+    {
+        void *addr = NULL;
+        SIZE_T alloc_size;
+
+        size = table ? table->size : LFH_TABLE_MIN_SIZE;
+        while ((table ? table->count + 1 : 1) * 2 > size) size *= 2;
+        alloc_size = FIELD_OFFSET( struct lfh_table, slots[size] );
+        if (NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &alloc_size, MEM_COMMIT, PAGE_READWRITE ))
+            return FALSE;
+        new_table = addr;
+        new_table->prev = table;
+        new_table->alloc_size = alloc_size;
+        new_table->size = size;
+        new_table->used = new_table->count = table ? table->count : 0;
+        for (i = 0; table && i < table->size; i++)
+        {
+            if (table->slots[i] <= LFH_SLOT_REMOVED) continue;
+            for (j = lfh_hash( table->slots[i] ) & (size - 1); new_table->slots[j]; j = (j + 1) & (size - 1)) ;
+            new_table->slots[j] = table->slots[i];
+        }
+        interlocked_xchg_ptr( (void **)&heap->lfh_table, new_table );
+        table = new_table;
+    }
+
+    for (i = lfh_hash( base ) & (table->size - 1); table->slots[i] > LFH_SLOT_REMOVED;
+         i = (i + 1) & (table->size - 1)) ;
+    if (!table->slots[i]) table->used++;
+    table->count++;
+    interlocked_xchg_ptr( (void **)&table->slots[i], (void *)base );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_table_remove
+ *
+ * Remove a subsegment from the heap table. The heap must be locked.
+ */
+static void lfh_table_remove( HEAP *heap, LFH_SUBSEGMENT *subsegment )
+{
+    ULONG_PTR base = (ULONG_PTR)((ARENA_LARGE *)subsegment - 1);
+    struct lfh_table *table = heap->lfh_table;
+    ULONG i;
+
+    for (i = lfh_hash( base ) & (table->size - 1); table->slots[i]; i = (i + 1) & (table->size - 1))
+    {
+        if (table->slots[i] != base) continue;
+        table->slots[i] = LFH_SLOT_REMOVED;
+        table->count--;
+        return;
+    }
+}
+
+
+/***********************************************************************
+ *           lfh_free_tables
+ *
+ * Free the subsegment tables of a heap that is being destroyed.
+ */
+static void lfh_free_tables( HEAP *heap )
+{
+    struct lfh_table *table = heap->lfh_table, *prev;
+    SIZE_T size;
+
+    while (table)
+    {
+        prev = table->prev;
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), (void **)&table, &size, MEM_RELEASE );
+        table = prev;
+    }
+    heap->lfh_table = NULL;
+}
+
+
+/***********************************************************************
+ *           lfh_enable
+ *
+ * Enable the LFH front-end on a heap. The heap must be locked.
+ */
+static BOOL lfh_enable( HEAP *heap )
+{
+    struct lfh_class *classes;
+    unsigned int i;
+
+    if (heap->lfh) return TRUE;
+
+    /* the front-end bypasses the debugging features of the back-end */
+    if (!(heap->flags & HEAP_GROWABLE)) return FALSE;
+    if (heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED | HEAP_VALIDATE | HEAP_PAGE_ALLOCS |
+                       HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED))
+        return FALSE;
+    if (RUNNING_ON_VALGRIND) return FALSE;
+
+    if (!(classes = RtlAllocateHeap( heap, HEAP_ZERO_MEMORY, LFH_NB_CLASSES * sizeof(*classes) )))
+        return FALSE;
+    for (i = 0; i < LFH_NB_CLASSES; i++) list_init( &classes[i].subsegments );
+    heap->lfh_serial = interlocked_xchg_add( &lfh_serial, 1 ) + 1;
+    heap->lfh = classes;
+    TRACE( "enabled LFH on heap %p\n", heap );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_get_thread_heap
+ *
+ * Get the cache of the current thread for a given heap.
+ */
+static struct lfh_thread_heap *lfh_get_thread_heap( HEAP *heap )
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct lfh_thread_cache *cache = thread_data->heap_cache;
+    struct lfh_thread_heap *thread_heap, *unused = NULL;
+    unsigned int i;
+
+    if (!cache)
+    {
+        if (!(cache = RtlAllocateHeap( processHeap, HEAP_ZERO_MEMORY, sizeof(*cache) ))) return NULL;
+        thread_data->heap_cache = cache;
+    }
+
+    for (i = 0; i < LFH_THREAD_HEAPS; i++)
+    {
+        thread_heap = &cache->heaps[i];
+        if (thread_heap->heap == heap)
+        {
+            if (thread_heap->serial == heap->lfh_serial) return thread_heap;
+            unused = thread_heap;  /* left over from a destroyed heap */
+            break;
+        }
+        if (!thread_heap->heap && !unused) unused = thread_heap;
+    }
+    if (!unused) return NULL;
+
+    memset( unused, 0, sizeof(*unused) );
+    unused->heap = heap;
+    unused->serial = heap->lfh_serial;
+    return unused;
+}
+
+
+/***********************************************************************
+ *           lfh_create_subsegment
+ *
+ * Get a new subsegment from the back-end for a size class. The heap must be locked.
+ */
+static BOOL lfh_create_subsegment( HEAP *heap, unsigned int index )
+{
+    struct lfh_class *class = &heap->lfh[index];
+    SIZE_T size = LFH_SUBSEGMENT_SIZE - sizeof(ARENA_LARGE) - ALIGNMENT;
+    LFH_SUBSEGMENT *subsegment;
+
+    if (!(subsegment = allocate_large_block( heap, heap->flags, size ))) return FALSE;
+    subsegment->magic = LFH_SUBSEGMENT_MAGIC;
+    subsegment->block_size = (index + 1) * LFH_GRANULARITY;
+    subsegment->heap = heap;
+    subsegment->free = NULL;
+    subsegment->next = lfh_first_block( subsegment );
+    subsegment->end = (char *)subsegment + size;
+    subsegment->used = 0;
+    if (!lfh_table_add( heap, subsegment ))
+    {
+        free_large_block( heap, heap->flags, subsegment );
+        return FALSE;
+    }
+    list_add_head( &class->subsegments, &subsegment->entry );
+    class->empty++;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_subsegment_full
+ */
+static inline BOOL lfh_subsegment_full( const LFH_SUBSEGMENT *subsegment )
+{
+    return !subsegment->free && (SIZE_T)(subsegment->end - subsegment->next) < subsegment->block_size;
+}
+
+
+/***********************************************************************
+ *           lfh_refill_bin
+ *
+ * Move a batch of free blocks from the heap to a thread cache bin.
+ */
+static BOOL lfh_refill_bin( HEAP *heap, unsigned int index, struct lfh_bin *bin )
+{
+    struct lfh_class *class = &heap->lfh[index];
+    LFH_SUBSEGMENT *subsegment;
+    ARENA_INUSE *arena;
+    struct list *ptr;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    while (bin->count < LFH_CACHE_BATCH)
+    {
+        if (!(ptr = list_head( &class->subsegments )))
+        {
+            if (!lfh_create_subsegment( heap, index )) break;
+            continue;
+        }
+        subsegment = LIST_ENTRY( ptr, LFH_SUBSEGMENT, entry );
+        if ((arena = subsegment->free))
+        {
+            subsegment->free = *(ARENA_INUSE **)(arena + 1);
+        }
+        else
+        {
+            arena = (ARENA_INUSE *)subsegment->next;
+            subsegment->next += subsegment->block_size;
+            arena->size = 0;
+            arena->magic = ARENA_LFH_FREE_MAGIC;
+        }
+        if (!subsegment->used++) class->empty--;
+        if (lfh_subsegment_full( subsegment )) list_remove( &subsegment->entry );
+
+        *(ARENA_INUSE **)(arena + 1) = bin->free;
+        bin->free = arena;
+        bin->count++;
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+    return bin->free != NULL;
+}
+
+
+/***********************************************************************
+ *           lfh_flush_bin
+ *
+ * Give back some free blocks of a thread cache bin to their subsegments.
+ * Empty subsegments are returned to the back-end, except for one per size
+ * class which is kept to avoid thrashing.
+ */
+static void lfh_flush_bin( HEAP *heap, unsigned int index, struct lfh_bin *bin, ULONG count )
+{
+    struct lfh_class *class = &heap->lfh[index];
+    LFH_SUBSEGMENT *subsegment;
+    ARENA_INUSE *arena;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    while (count-- && (arena = bin->free))
+    {
+        bin->free = *(ARENA_INUSE **)(arena + 1);
+        bin->count--;
+
+        subsegment = (LFH_SUBSEGMENT *)((ARENA_LARGE *)((ULONG_PTR)arena & ~(ULONG_PTR)(LFH_SUBSEGMENT_SIZE - 1)) + 1);
+        if (lfh_subsegment_full( subsegment )) list_add_head( &class->subsegments, &subsegment->entry );
+        *(ARENA_INUSE **)(arena + 1) = subsegment->free;
+        subsegment->free = arena;
+
+        if (--subsegment->used) continue;
+        if (!class->empty)
+        {
+            class->empty++;
+            continue;
+        }
+        TRACE( "heap %p: releasing subsegment %p\n", heap, subsegment );
+        list_remove( &subsegment->entry );
+        lfh_table_remove( heap, subsegment );
+        free_large_block( heap, heap->flags, subsegment );
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+}
+
+
+/***********************************************************************
+ *           lfh_allocate
+ *
+ * Allocate a block from the LFH front-end. Return NULL to fall back to the back-end.
+ */
+static void *lfh_allocate( HEAP *heap, DWORD flags, SIZE_T size )
+{
+    unsigned int index = lfh_get_class( size );
+    struct lfh_thread_heap *thread_heap;
+    struct lfh_bin *bin, shared;
+    ARENA_INUSE *arena;
+
+    if (!(thread_heap = lfh_get_thread_heap( heap )))
+    {
+        /* no room in the thread cache, take a single block from the heap */
+        shared.free = NULL;
+        shared.count = LFH_CACHE_BATCH - 1;
+        bin = &shared;
+    }
+    else bin = &thread_heap->bins[index];
+
+    if (!bin->free && !lfh_refill_bin( heap, index, bin )) return NULL;
+
+    arena = bin->free;
+    bin->free = *(ARENA_INUSE **)(arena + 1);
+    bin->count--;
+
+    arena->size = (size + 3) & ARENA_SIZE_MASK;
+    arena->magic = ARENA_LFH_MAGIC;
+    arena->unused_bytes = arena->size - size;
+    initialize_block( arena + 1, size, arena->unused_bytes, flags );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           lfh_free
+ *
+ * Free a block of the LFH front-end.
+ */
+static BOOL lfh_free( HEAP *heap, LFH_SUBSEGMENT *subsegment, void *ptr )
+{
+    ARENA_INUSE *arena = (ARENA_INUSE *)ptr - 1;
+    unsigned int index = subsegment->block_size / LFH_GRANULARITY - 1;
+    struct lfh_thread_heap *thread_heap;
+    struct lfh_bin *bin, shared;
+
+    if (arena->magic != ARENA_LFH_MAGIC)
+    {
+        if (arena->magic == ARENA_LFH_FREE_MAGIC)
+            WARN( "Heap %p: block %p used after free\n", heap, ptr );
+        else
+            WARN( "Heap %p: invalid LFH arena magic %08x for %p\n", heap, arena->magic, arena );
+        return FALSE;
+    }
+    arena->magic = ARENA_LFH_FREE_MAGIC;
+
+    if (!(thread_heap = lfh_get_thread_heap( heap )))
+    {
+        shared.free = NULL;
+        shared.count = 0;
+        bin = &shared;
+    }
+    else bin = &thread_heap->bins[index];
+
+    *(ARENA_INUSE **)(arena + 1) = bin->free;
+    bin->free = arena;
+    bin->count++;
+
+    if (bin == &shared) lfh_flush_bin( heap, index, bin, 1 );
+    else if (bin->count >= LFH_CACHE_MAX) lfh_flush_bin( heap, index, bin, LFH_CACHE_BATCH );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_reallocate
+ *
+ * Resize a block of the LFH front-end.
+ */
+static NTSTATUS lfh_reallocate( HEAP *heap, LFH_SUBSEGMENT *subsegment, DWORD flags,
+                                void *ptr, SIZE_T size, void **ret )
+{
+    ARENA_INUSE *arena = (ARENA_INUSE *)ptr - 1;
+    SIZE_T old_size;
+
+    *ret = NULL;
+    if (arena->magic != ARENA_LFH_MAGIC)
+    {
+        WARN( "Heap %p: invalid LFH arena magic %08x for %p\n", heap, arena->magic, arena );
+        return STATUS_INVALID_PARAMETER;
+    }
+    old_size = (arena->size & ARENA_SIZE_MASK) - arena->unused_bytes;
+
+    if (size <= subsegment->block_size - sizeof(*arena))
+    {
+        arena->size = (size + 3) & ARENA_SIZE_MASK;
+        arena->unused_bytes = arena->size - size;
+        if (size > old_size)
+            initialize_block( (char *)ptr + old_size, size - old_size, arena->unused_bytes, flags );
+        *ret = ptr;
+        return STATUS_SUCCESS;
+    }
+
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY) return STATUS_NO_MEMORY;
+    if (!(*ret = RtlAllocateHeap( heap, flags & HEAP_ZERO_MEMORY, size ))) return STATUS_NO_MEMORY;
+    memcpy( *ret, ptr, old_size );
+    lfh_free( heap, subsegment, ptr );
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           heap_free_thread_cache
+ *
+ * Give back the blocks cached by the current thread to their heaps.
+ */
+void heap_free_thread_cache(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct lfh_thread_cache *cache = thread_data->heap_cache;
+    unsigned int i, j;
+
+    if (!cache) return;
+    thread_data->heap_cache = NULL;
+
+    /* the process heap lock prevents heaps from being destroyed meanwhile */
+    RtlEnterCriticalSection( &processHeap->critSection );
+    for (i = 0; i < LFH_THREAD_HEAPS; i++)
+    {
+        struct lfh_thread_heap *thread_heap = &cache->heaps[i];
+        HEAP *heap = processHeap;
+        struct list *ptr = &processHeap->entry;
+
+        if (!thread_heap->heap) continue;
+        while (heap != thread_heap->heap)
+        {
+            if ((ptr = list_next( &processHeap->entry, ptr ))) heap = LIST_ENTRY( ptr, HEAP, entry );
+            else break;
+        }
+        if (heap != thread_heap->heap || heap->lfh_serial != thread_heap->serial) continue;
+
+        for (j = 0; j < LFH_NB_CLASSES; j++)
+            if (thread_heap->bins[j].count)
+                lfh_flush_bin( heap, j, &thread_heap->bins[j], thread_heap->bins[j].count );
+    }
+    RtlLeaveCriticalSection( &processHeap->critSection );
+    RtlFreeHeap( processHeap, 0, cache );
+}
+
+
 /***********************************************************************
  *           HEAP_CreateSubHeap
  */
@@ -915,6 +1481,10 @@ static SUBHEAP *HEAP_CreateSubHeap( HEAP *heap, LPVOID address, DWORD flags,
         heap->flags         = flags;
         heap->magic         = HEAP_MAGIC;
         heap->grow_size     = max( HEAP_DEF_SIZE, totalSize );
+        heap->lfh           = NULL;
+        heap->lfh_table     = NULL;
+        heap->lfh_serial    = 0;
+        heap->small_allocs  = 0;
         list_init( &heap->subheap_list );
         list_init( &heap->large_list );
 
@@ -1335,8 +1905,18 @@ static BOOL HEAP_IsRealArena( HEAP *heapPtr,   /* [in] ptr to the heap */
     {
         const ARENA_INUSE *arena = (const ARENA_INUSE *)block - 1;
 
-        if (!(subheap = HEAP_FindSubHeap( heapPtr, arena )) ||
-            ((const char *)arena < (char *)subheap->base + subheap->headerSize))
+        if (heapPtr->lfh && lfh_find_subsegment( heapPtr, block ))
+        {
+            if (!(ret = (arena->magic == ARENA_LFH_MAGIC)))
+            {
+                if (quiet == NOISY)
+                    ERR("Heap %p: invalid LFH arena magic %08x for %p\n", heapPtr, arena->magic, arena );
+                else if (WARN_ON(heap))
+                    WARN("Heap %p: invalid LFH arena magic %08x for %p\n", heapPtr, arena->magic, arena );
+            }
+        }
+        else if (!(subheap = HEAP_FindSubHeap( heapPtr, arena )) ||
+                 ((const char *)arena < (char *)subheap->base + subheap->headerSize))
         {
             if (!(large_arena = find_large_block( heapPtr, block )))
             {
@@ -1628,6 +2208,7 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
         addr = heapPtr->pending_free;
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
     }
+    lfh_free_tables( heapPtr );
     size = 0;
     addr = heapPtr->subheap.base;
     NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
@@ -1673,8 +2254,22 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && size <= LFH_MAX_DATA_SIZE)
+    {
+        void *ret = lfh_allocate( heapPtr, flags, size );
+        if (ret)
+        {
+            TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+            return ret;
+        }
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
+    if (!heapPtr->lfh && size <= LFH_MAX_DATA_SIZE && heapPtr->small_allocs < LFH_ACTIVATION_COUNT &&
+        ++heapPtr->small_allocs == LFH_ACTIVATION_COUNT)
+        lfh_enable( heapPtr );
+
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
     {
         void *ret = allocate_large_block( heap, flags, size );
@@ -1741,6 +2336,7 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 {
     ARENA_INUSE *pInUse;
     SUBHEAP *subheap;
+    LFH_SUBSEGMENT *subsegment;
     HEAP *heapPtr;
 
     /* Validate the parameters */
@@ -1754,6 +2350,18 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
         return FALSE;
     }
 
+    if (heapPtr->lfh && (subsegment = lfh_find_subsegment( heapPtr, ptr )))
+    {
+        if (!lfh_free( heapPtr, subsegment, ptr ))
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            TRACE("(%p,%08x,%p): returning FALSE\n", heap, flags, ptr );
+            return FALSE;
+        }
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
@@ -1802,6 +2410,7 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     ARENA_INUSE *pArena;
     HEAP *heapPtr;
     SUBHEAP *subheap;
+    LFH_SUBSEGMENT *subsegment;
     SIZE_T oldBlockSize, oldActualSize, rounded_size;
     void *ret;
 
@@ -1817,6 +2426,17 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY |
              HEAP_REALLOC_IN_PLACE_ONLY;
     flags |= heapPtr->flags;
+
+    if (heapPtr->lfh && (subsegment = lfh_find_subsegment( heapPtr, ptr )))
+    {
+        NTSTATUS status = lfh_reallocate( heapPtr, subsegment, flags, ptr, size, &ret );
+
+        if (status == STATUS_NO_MEMORY && (flags & HEAP_GENERATE_EXCEPTIONS)) RtlRaiseStatus( status );
+        if (status) RtlSetLastWin32ErrorAndNtStatusFromNtStatus( status );
+        TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE(flags);
@@ -2026,9 +2646,23 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
     }
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
-    if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     pArena = (const ARENA_INUSE *)ptr - 1;
+    if (heapPtr->lfh && lfh_find_subsegment( heapPtr, ptr ))
+    {
+        if (pArena->magic == ARENA_LFH_MAGIC)
+            ret = (pArena->size & ARENA_SIZE_MASK) - pArena->unused_bytes;
+        else
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            ret = ~0UL;
+        }
+        TRACE("(%p,%08x,%p): returning %08lx\n", heap, flags, ptr, ret );
+        return ret;
+    }
+
+    if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
+
     if (!validate_block_pointer( heapPtr, &subheap, pArena ))
     {
         RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
@@ -2236,6 +2870,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2244,7 +2880,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        heapPtr = HEAP_GetPtr( heap );
+        *(ULONG *)info = (heapPtr && heapPtr->lfh) ? 2 /* low fragmentation heap */ : 0 /* standard heap */;
         return STATUS_SUCCESS;
 
     default:
@@ -2252,3 +2889,37 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         return STATUS_INVALID_INFO_CLASS;
     }
 }
+
+/***********************************************************************
+ *           RtlSetHeapInformation    (NTDLL.@)
+ */
+NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
+                                       PVOID info, SIZE_T size )
+{
+    HEAP *heapPtr;
+    BOOL ret;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* standard heap */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2:  /* low fragmentation heap */
+            if (!(heapPtr->flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
+            ret = lfh_enable( heapPtr );
+            if (!(heapPtr->flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
+            return ret ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+        default:
+            return STATUS_UNSUCCESSFUL;
+        }
+
+    default:
+        FIXME("%p %u %p %lu: stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
+}
@@ -349,6 +349,7 @@ NTSTATUS close_handle( HANDLE handle )
     NTSTATUS ret;
     int fd = server_remove_fd_from_cache( handle );
 
+    cancel_async_file_io( handle, NULL, FALSE );
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
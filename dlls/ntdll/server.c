@@ -28,6 +28,9 @@
 #endif
 #include <errno.h>
 #include <fcntl.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #ifdef HAVE_LWP_H
 #include <lwp.h>
 #endif
@@ -262,6 +265,149 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 }
 
 
+#if defined(__linux__) && defined(__NR_futex)
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS   1033
+#define F_GET_SEALS   1034
+#endif
+#ifndef F_SEAL_SEAL
+#define F_SEAL_SEAL   0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW   0x0004
+#endif
+
+/* number of iterations to spin on the shared reply area before sleeping */
+static const unsigned int reply_spin_count = 500;
+
+static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+/* make sure the reply data isn't read before the sequence number that published it;
+ * pairs with the interlocked increment done by the server after writing the reply */
+static inline void read_barrier(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "" : : : "memory" );  /* loads are not reordered with other loads */
+#else
+    __sync_synchronize();
+#endif
+}
+
+/***********************************************************************
+ *           check_reply_pipe
+ *
+ * Check whether the server closed the reply pipe while we were waiting
+ * on the shared area; helper for wait_reply_shm.
+ */
+static void check_reply_pipe(void)
+{
+    struct pollfd pfd;
+
+    pfd.fd = ntdll_get_thread_data()->reply_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll( &pfd, 1, 0 ) == 1 && (pfd.revents & (POLLHUP | POLLERR))) abort_thread(0);
+}
+
+/***********************************************************************
+ *           wait_reply_shm
+ *
+ * Wait for a reply from the server in the shared reply area.
+ */
+static unsigned int wait_reply_shm( struct __server_request_info *req, struct reply_shm *shm, int seq )
+{
+    static const struct timespec timeout = { 1, 0 };
+    volatile int *reply_seq = &shm->seq;
+    unsigned int i;
+
+    if (NtCurrentTeb()->Peb->NumberOfProcessors > 1)
+        for (i = 0; i < reply_spin_count && *reply_seq == seq; i++) small_pause();
+
+    while (*reply_seq == seq)
+    {
+        struct timespec ts = timeout;
+
+        interlocked_xchg( &shm->waiting, 1 );
+        if (*reply_seq != seq) break;
+        if (futex_wait( &shm->seq, seq, &ts ) == -1 && errno == ETIMEDOUT) check_reply_pipe();
+    }
+    read_barrier();
+
+    if (shm->use_pipe) return wait_reply( req );
+
+    memcpy( &req->u.reply, &shm->reply, sizeof(req->u.reply) );
+    if (req->u.reply.reply_header.reply_size)
+        memcpy( req->reply_data, shm + 1, req->u.reply.reply_header.reply_size );
+    return req->u.reply.reply_header.error;
+}
+
+/***********************************************************************
+ *           create_reply_shm
+ *
+ * Create the shared reply area for the current thread.
+ */
+static int create_reply_shm( struct reply_shm **shm )
+{
+#ifdef __NR_memfd_create
+    void *ptr;
+    int fd = syscall( __NR_memfd_create, "wine-reply", 3 /* MFD_CLOEXEC | MFD_ALLOW_SEALING */ );
+
+    if (fd == -1) return -1;
+    /* the server refuses areas that could still be resized under it */
+    if (ftruncate( fd, REPLY_SHM_SIZE ) != -1 &&
+        fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL ) != -1 &&
+        (ptr = mmap( NULL, REPLY_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) != MAP_FAILED)
+    {
+        *shm = ptr;
+        return fd;
+    }
+    close( fd );
+#endif
+    return -1;
+}
+
+#else  /* __linux__ */
+
+static inline unsigned int wait_reply_shm( struct __server_request_info *req, struct reply_shm *shm, int seq )
+{
+    return wait_reply( req );
+}
+
+static inline int create_reply_shm( struct reply_shm **shm )
+{
+    return -1;
+}
+
+#endif  /* __linux__ */
+
+
+/***********************************************************************
+ *           server_free_reply_shm
+ *
+ * Release the shared reply area of the current thread.
+ */
+void server_free_reply_shm(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+
+    if (!thread_data->reply_shm) return;
+    munmap( thread_data->reply_shm, REPLY_SHM_SIZE );
+    thread_data->reply_shm = NULL;
+}
+
+
 /***********************************************************************
  *           wine_server_call (NTDLL.@)
  *
@@ -287,12 +433,15 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 unsigned int wine_server_call( void *req_ptr )
 {
     struct __server_request_info * const req = req_ptr;
+    struct reply_shm *shm = ntdll_get_thread_data()->reply_shm;
     sigset_t old_set;
     unsigned int ret;
+    int seq;
 
     pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
+    seq = shm ? *(volatile int *)&shm->seq : 0;
     ret = send_request( req );
-    if (!ret) ret = wait_reply( req );
+    if (!ret) ret = shm ? wait_reply_shm( req, shm, seq ) : wait_reply( req );
     pthread_sigmask( SIG_SETMASK, &old_set, NULL );
     return ret;
 }
@@ -1431,8 +1580,9 @@ size_t server_init_thread( void *entry_point )
     static const char *cpu_names[] = { "x86", "x86_64", "PowerPC", "ARM", "ARM64" };
     static const BOOL is_win64 = (sizeof(void *) > sizeof(int));
     const char *arch = getenv( "WINEARCH" );
-    int ret;
+    int ret, reply_shm = 0, shm_fd;
     int reply_pipe[2];
+    struct reply_shm *shm = NULL;
     struct sigaction sig_act;
     size_t info_size;
 
@@ -1451,6 +1601,9 @@ size_t server_init_thread( void *entry_point )
     ntdll_get_thread_data()->reply_fd = reply_pipe[0];
     close( reply_pipe[1] );
 
+    /* create the shared reply area, the server falls back to the pipe if it can't use it */
+    if ((shm_fd = create_reply_shm( &shm )) != -1) wine_server_send_fd( shm_fd );
+
     SERVER_START_REQ( init_thread )
     {
         req->unix_pid    = getpid();
@@ -1461,15 +1614,24 @@ size_t server_init_thread( void *entry_point )
         req->wait_fd     = ntdll_get_thread_data()->wait_fd[1];
         req->debug_level = (TRACE_ON(server) != 0);
         req->cpu         = client_cpu;
+        req->reply_shm_fd = shm_fd;
         ret = wine_server_call( req );
         NtCurrentTeb()->ClientId.UniqueProcess = ULongToHandle(reply->pid);
         NtCurrentTeb()->ClientId.UniqueThread  = ULongToHandle(reply->tid);
         info_size         = reply->info_size;
         server_start_time = reply->server_start;
         server_cpus       = reply->all_cpus;
+        reply_shm         = reply->reply_shm;
     }
     SERVER_END_REQ;
 
+    if (shm_fd != -1)
+    {
+        close( shm_fd );
+        if (!ret && reply_shm) ntdll_get_thread_data()->reply_shm = shm;
+        else munmap( shm, REPLY_SHM_SIZE );
+    }
+
     is_wow64 = !is_win64 && (server_cpus & (1 << CPU_x86_64)) != 0;
     ntdll_get_thread_data()->wow64_redir = is_wow64;
 
@@ -42,6 +42,13 @@
 #ifdef HAVE_SCHED_H
 # include <sched.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <limits.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -56,6 +63,7 @@
 #include "windef.h"
 #include "winternl.h"
 #include "wine/server.h"
+#include "wine/library.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -133,6 +141,273 @@ void NTDLL_free_struct_sd(struct security_descriptor *server_sd)
     RtlFreeHeap(GetProcessHeap(), 0, server_sd);
 }
 
+/*
+ *	In-process synchronization objects
+ *
+ * When WINECLIENTSYNC is set, unnamed and non-inheritable events and
+ * semaphores keep their state in a section shared with the server, and
+ * are set, released and waited upon with atomics and futexes without a
+ * server round trip. The server maintains the entries that map the
+ * handles of the process to these objects, so a handle closed or
+ * duplicated from any process is seen immediately. Whenever the server
+ * needs the object itself (waits on several objects, use from another
+ * process, asynchronous notifications...) it takes the state over and
+ * marks the object as promoted; from then on everything goes through
+ * the server.
+ */
+
+static const unsigned int *client_sync_handles;      /* handle entries, written by the server */
+static struct client_sync_shm *client_sync_objects;  /* object states */
+static int client_sync_enabled = -1;
+
+#ifdef __linux__
+
+static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 128 /* FUTEX_WAIT_PRIVATE */, val, timeout, 0, 0 );
+}
+
+static inline int futex_wake( int *addr, int val )
+{
+    return syscall( __NR_futex, addr, 129 /* FUTEX_WAKE_PRIVATE */, val, NULL, 0, 0 );
+}
+
+static inline int futex_wait_bitset( int *addr, int val, struct timespec *timeout, int mask )
+{
+    return syscall( __NR_futex, addr, 137 /* FUTEX_WAIT_BITSET_PRIVATE */, val, timeout, 0, mask );
+}
+
+static inline int futex_wake_bitset( int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, 138 /* FUTEX_WAKE_BITSET_PRIVATE */, val, NULL, 0, mask );
+}
+
+/* the server also wakes up the waiters of in-process objects, so these can't be private */
+static inline int futex_wait_shared( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+static inline int futex_wake_shared( int *addr, int val )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, val, NULL, 0, 0 );
+}
+
+#else
+
+static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int futex_wake( int *addr, int val )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int futex_wait_bitset( int *addr, int val, struct timespec *timeout, int mask )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int futex_wake_bitset( int *addr, int val, int mask )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int futex_wait_shared( int *addr, int val, struct timespec *timeout )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int futex_wake_shared( int *addr, int val )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
+
+/* check whether futexes are available for the lock primitives */
+static BOOL use_futexes(void)
+{
+    static int supported = -1;
+
+    if (supported == -1)
+    {
+        int dummy = 0;
+
+        futex_wait_bitset( &dummy, 10, NULL, ~0 );
+        supported = (errno != ENOSYS);
+    }
+    return supported;
+}
+
+/* check whether in-process objects should be used, mapping the shared section on first use */
+static BOOL use_client_sync(void)
+{
+    if (client_sync_enabled == -1)
+    {
+        const char *env = getenv( "WINECLIENTSYNC" );
+        HANDLE handle = 0;
+        SIZE_T size = 0;
+        void *ptr = NULL;
+        int dummy = 0;
+
+        if (env && atoi( env ) && (futex_wake_shared( &dummy, 1 ) != -1 || errno != ENOSYS))
+        {
+            SERVER_START_REQ( get_client_sync_section )
+            {
+                if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+            }
+            SERVER_END_REQ;
+        }
+        if (handle)
+        {
+            if (NtMapViewOfSection( handle, NtCurrentProcess(), &ptr, 0, 0, NULL, &size,
+                                    ViewShare, 0, PAGE_READWRITE ))
+                ptr = NULL;
+            NtClose( handle );
+        }
+        /* the section is the same for all threads, keep the first view */
+        if (ptr && interlocked_cmpxchg_ptr( (void **)&client_sync_handles, ptr, NULL ))
+            NtUnmapViewOfSection( NtCurrentProcess(), ptr );
+        if (client_sync_handles)
+            client_sync_objects = (struct client_sync_shm *)(client_sync_handles + CLIENT_SYNC_HANDLES);
+        client_sync_enabled = (client_sync_handles != NULL);
+    }
+    return client_sync_enabled;
+}
+
+/* retrieve the entry of a handle in the shared section */
+static inline unsigned int get_client_sync_entry( HANDLE handle )
+{
+    unsigned int index = (wine_server_obj_handle( handle ) >> 2) - 1;
+
+    if (index >= CLIENT_SYNC_HANDLES) return 0;
+    return *(volatile const unsigned int *)&client_sync_handles[index];
+}
+
+/* return the in-process object for a handle, or NULL if it's a plain server object */
+static inline struct client_sync_shm *get_client_sync( HANDLE handle, unsigned int *entry )
+{
+    unsigned int index;
+
+    if (client_sync_enabled <= 0) return NULL;
+    *entry = get_client_sync_entry( handle );
+    index = *entry & CLIENT_SYNC_INDEX_MASK;
+    if (!index || index > CLIENT_SYNC_OBJECTS) return NULL;
+    return &client_sync_objects[index - 1];
+}
+
+/* retrieve the current value of an in-process object, or -1 if the server holds the state */
+static inline int get_client_sync_value( struct client_sync_shm *obj )
+{
+    return *(volatile int *)&obj->value;
+}
+
+/* check if a newly created object can be implemented in-process */
+static inline BOOL is_client_sync_candidate( const OBJECT_ATTRIBUTES *attr )
+{
+    if (attr && (attr->ObjectName || (attr->Attributes & OBJ_INHERIT))) return FALSE;
+    return use_client_sync();
+}
+
+/* set or reset an in-process event */
+static NTSTATUS set_client_event( struct client_sync_shm *obj, unsigned int entry, int state )
+{
+    unsigned int type = obj->type;
+    int value;
+
+    if (type == CLIENT_SYNC_SEMAPHORE) return STATUS_OBJECT_TYPE_MISMATCH;
+    if (!(entry & CLIENT_SYNC_MODIFY)) return STATUS_ACCESS_DENIED;
+
+    for (;;)
+    {
+        if ((value = get_client_sync_value( obj )) < 0) return STATUS_MORE_PROCESSING_REQUIRED;
+        if (value == state) return STATUS_SUCCESS;
+        if (interlocked_cmpxchg( &obj->value, state, value ) == value) break;
+    }
+    if (state) futex_wake_shared( &obj->value, type == CLIENT_SYNC_MANUAL_EVENT ? INT_MAX : 1 );
+    return STATUS_SUCCESS;
+}
+
+/* release an in-process semaphore */
+static NTSTATUS release_client_semaphore( struct client_sync_shm *obj, unsigned int entry,
+                                          ULONG count, ULONG *previous )
+{
+    int value;
+
+    if (obj->type != CLIENT_SYNC_SEMAPHORE) return STATUS_OBJECT_TYPE_MISMATCH;
+    if (!(entry & CLIENT_SYNC_MODIFY)) return STATUS_ACCESS_DENIED;
+
+    for (;;)
+    {
+        if ((value = get_client_sync_value( obj )) < 0) return STATUS_MORE_PROCESSING_REQUIRED;
+        if (count > (ULONG)(obj->max - value)) return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+        if (interlocked_cmpxchg( &obj->value, value + count, value ) == value) break;
+    }
+    if (previous) *previous = value;
+    if (count) futex_wake_shared( &obj->value, count );
+    return STATUS_SUCCESS;
+}
+
+/* wait on a single in-process object */
+static NTSTATUS wait_client_sync( HANDLE handle, struct client_sync_shm *obj, unsigned int entry,
+                                  const LARGE_INTEGER *timeout, LARGE_INTEGER *end )
+{
+    LARGE_INTEGER now;
+    int value;
+
+    if (!(entry & CLIENT_SYNC_WAIT)) return STATUS_ACCESS_DENIED;
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        NtQuerySystemTime( &now );
+        end->QuadPart = timeout->QuadPart < 0 ? now.QuadPart - timeout->QuadPart : timeout->QuadPart;
+    }
+    else timeout = NULL;
+
+    for (;;)
+    {
+        if ((value = get_client_sync_value( obj )) < 0) return STATUS_MORE_PROCESSING_REQUIRED;
+        /* the handle may have been closed while we were sleeping */
+        if (get_client_sync_entry( handle ) != entry) return STATUS_MORE_PROCESSING_REQUIRED;
+
+        switch (obj->type)
+        {
+        case CLIENT_SYNC_MANUAL_EVENT:
+            if (value) return STATUS_WAIT_0;
+            break;
+        case CLIENT_SYNC_AUTO_EVENT:
+        case CLIENT_SYNC_SEMAPHORE:
+            if (!value) break;
+            if (interlocked_cmpxchg( &obj->value, value - 1, value ) == value) return STATUS_WAIT_0;
+            continue;
+        default:
+            return STATUS_MORE_PROCESSING_REQUIRED;
+        }
+
+        if (timeout)
+        {
+            struct timespec ts;
+            timeout_t diff;
+
+            NtQuerySystemTime( &now );
+            if ((diff = end->QuadPart - now.QuadPart) <= 0) return STATUS_TIMEOUT;
+            ts.tv_sec  = diff / 10000000;
+            ts.tv_nsec = (diff % 10000000) * 100;
+            futex_wait_shared( &obj->value, 0, &ts );
+        }
+        else futex_wait_shared( &obj->value, 0, NULL );
+    }
+}
+
 /*
  *	Semaphores
  */
@@ -170,6 +445,7 @@ NTSTATUS WINAPI NtCreateSemaphore( OUT PHANDLE SemaphoreHandle,
         req->attributes = (attr) ? attr->Attributes : 0;
         req->initial = InitialCount;
         req->max     = MaximumCount;
+        req->client_sync = is_client_sync_candidate( attr );
         wine_server_add_data( req, &objattr, sizeof(objattr) );
         if (objattr.sd_len) wine_server_add_data( req, sd, objattr.sd_len );
         if (len) wine_server_add_data( req, attr->ObjectName->Buffer, len );
@@ -216,6 +492,8 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 {
     NTSTATUS ret;
     SEMAPHORE_BASIC_INFORMATION *out = info;
+    struct client_sync_shm *obj;
+    unsigned int entry;
 
     if (class != SemaphoreBasicInformation)
     {
@@ -225,6 +503,20 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 
     if (len != sizeof(SEMAPHORE_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((obj = get_client_sync( handle, &entry )))
+    {
+        int value = get_client_sync_value( obj );
+
+        if (!(entry & CLIENT_SYNC_QUERY)) return STATUS_ACCESS_DENIED;
+        if (value >= 0 && obj->type == CLIENT_SYNC_SEMAPHORE)
+        {
+            out->CurrentCount = value;
+            out->MaximumCount = obj->max;
+            if (ret_len) *ret_len = sizeof(SEMAPHORE_BASIC_INFORMATION);
+            return STATUS_SUCCESS;
+        }
+    }
+
     SERVER_START_REQ( query_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -245,7 +537,14 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
  */
 NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, PULONG previous )
 {
+    struct client_sync_shm *obj;
+    unsigned int entry;
     NTSTATUS ret;
+
+    if ((obj = get_client_sync( handle, &entry )) &&
+        (ret = release_client_semaphore( obj, entry, count, previous )) != STATUS_MORE_PROCESSING_REQUIRED)
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -292,6 +591,7 @@ NTSTATUS WINAPI NtCreateEvent( PHANDLE EventHandle, ACCESS_MASK DesiredAccess,
         req->attributes = (attr) ? attr->Attributes : 0;
         req->manual_reset = (type == NotificationEvent);
         req->initial_state = InitialState;
+        req->client_sync = is_client_sync_candidate( attr );
         wine_server_add_data( req, &objattr, sizeof(objattr) );
         if (objattr.sd_len) wine_server_add_data( req, sd, objattr.sd_len );
         if (len) wine_server_add_data( req, attr->ObjectName->Buffer, len );
@@ -339,10 +639,16 @@ NTSTATUS WINAPI NtOpenEvent(
  */
 NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 {
+    struct client_sync_shm *obj;
+    unsigned int entry;
     NTSTATUS ret;
 
     /* FIXME: set NumberOfThreadsReleased */
 
+    if ((obj = get_client_sync( handle, &entry )) &&
+        (ret = set_client_event( obj, entry, 1 )) != STATUS_MORE_PROCESSING_REQUIRED)
+        return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -358,11 +664,17 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
  */
 NTSTATUS WINAPI NtResetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 {
+    struct client_sync_shm *obj;
+    unsigned int entry;
     NTSTATUS ret;
 
     /* resetting an event can't release any thread... */
     if (NumberOfThreadsReleased) *NumberOfThreadsReleased = 0;
 
+    if ((obj = get_client_sync( handle, &entry )) &&
+        (ret = set_client_event( obj, entry, 0 )) != STATUS_MORE_PROCESSING_REQUIRED)
+        return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -415,6 +727,8 @@ NTSTATUS WINAPI NtQueryEvent( HANDLE handle, EVENT_INFORMATION_CLASS class,
 {
     NTSTATUS ret;
     EVENT_BASIC_INFORMATION *out = info;
+    struct client_sync_shm *obj;
+    unsigned int entry;
 
     if (class != EventBasicInformation)
     {
@@ -425,6 +739,21 @@ NTSTATUS WINAPI NtQueryEvent( HANDLE handle, EVENT_INFORMATION_CLASS class,
 
     if (len != sizeof(EVENT_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((obj = get_client_sync( handle, &entry )))
+    {
+        unsigned int type = obj->type;
+        int value = get_client_sync_value( obj );
+
+        if (!(entry & CLIENT_SYNC_QUERY)) return STATUS_ACCESS_DENIED;
+        if (value >= 0 && (type == CLIENT_SYNC_AUTO_EVENT || type == CLIENT_SYNC_MANUAL_EVENT))
+        {
+            out->EventType  = type == CLIENT_SYNC_MANUAL_EVENT ? NotificationEvent : SynchronizationEvent;
+            out->EventState = value;
+            if (ret_len) *ret_len = sizeof(EVENT_BASIC_INFORMATION);
+            return STATUS_SUCCESS;
+        }
+    }
+
     SERVER_START_REQ( query_event )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -843,9 +1172,21 @@ NTSTATUS WINAPI NtWaitForMultipleObjects( DWORD count, const HANDLE *handles,
 {
     select_op_t select_op;
     UINT i, flags = SELECT_INTERRUPTIBLE;
+    struct client_sync_shm *obj;
+    unsigned int entry;
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    if (count == 1 && !alertable && (obj = get_client_sync( handles[0], &entry )))
+    {
+        LARGE_INTEGER end;
+        NTSTATUS ret = wait_client_sync( handles[0], obj, entry, timeout, &end );
+
+        if (ret != STATUS_MORE_PROCESSING_REQUIRED) return ret;
+        /* the object got promoted while we were waiting, continue on the server */
+        if (timeout && timeout->QuadPart != TIMEOUT_INFINITE) timeout = &end;
+    }
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_all ? SELECT_WAIT_ALL : SELECT_WAIT;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -1153,6 +1494,79 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
     return status;
 }
 
+/******************************************************************
+ *              NtRemoveIoCompletionEx (NTDLL.@)
+ *              ZwRemoveIoCompletionEx (NTDLL.@)
+ *
+ * (Wait for and) retrieve several completion messages from completion object's queue
+ *
+ * PARAMS
+ *      CompletionPort  [I] HANDLE to I/O completion object
+ *      Information     [O] array receiving the completion messages
+ *      Count           [I] size of the array
+ *      Written         [O] number of messages retrieved
+ *      WaitTime        [I] optional wait time in NTDLL format
+ *      Alertable       [I] whether the wait is alertable
+ *
+ */
+NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE CompletionPort, FILE_IO_COMPLETION_INFORMATION *Information,
+                                        ULONG Count, ULONG *Written, PLARGE_INTEGER WaitTime,
+                                        BOOLEAN Alertable )
+{
+    completion_data_t data[64];
+    LARGE_INTEGER now, end;
+    NTSTATUS status;
+    ULONG i, size;
+
+    TRACE("(%p, %p, %u, %p, %p, %u)\n", CompletionPort, Information, Count, Written, WaitTime, Alertable);
+
+    *Written = 0;
+    if (!Count) return STATUS_INVALID_PARAMETER;
+
+    /* the port may be woken up several times, keep waiting until the original deadline */
+    if (WaitTime && WaitTime->QuadPart < 0)
+    {
+        NtQuerySystemTime( &now );
+        end.QuadPart = now.QuadPart - WaitTime->QuadPart;
+        WaitTime = &end;
+    }
+
+    for (;;)
+    {
+        size = 0;
+        SERVER_START_REQ( remove_completions )
+        {
+            req->handle = wine_server_obj_handle( CompletionPort );
+            wine_server_set_reply( req, data, min( Count - *Written, sizeof(data)/sizeof(data[0]) ) * sizeof(data[0]) );
+            if (!(status = wine_server_call( req )))
+            {
+                size = wine_server_reply_size( reply ) / sizeof(data[0]);
+                for (i = 0; i < size; i++)
+                {
+                    Information[*Written].CompletionKey             = data[i].ckey;
+                    Information[*Written].CompletionValue           = data[i].cvalue;
+                    Information[*Written].IoStatusBlock.Information = data[i].information;
+                    Information[*Written].IoStatusBlock.u.Status    = data[i].status;
+                    (*Written)++;
+                }
+            }
+        }
+        SERVER_END_REQ;
+
+        if (*Written)
+        {
+            /* keep going without waiting while the buffers come back full */
+            if (!status && size == sizeof(data)/sizeof(data[0]) && *Written < Count) continue;
+            return STATUS_SUCCESS;
+        }
+        if (status != STATUS_PENDING) break;
+
+        status = NtWaitForSingleObject( CompletionPort, Alertable, WaitTime );
+        if (status != WAIT_OBJECT_0) break;
+    }
+    return status;
+}
+
 /******************************************************************
  *              NtOpenIoCompletion (NTDLL.@)
  *              ZwOpenIoCompletion (NTDLL.@)
@@ -1371,6 +1785,218 @@ DWORD WINAPI RtlRunOnceExecuteOnce( RTL_RUN_ONCE *once, PRTL_RUN_ONCE_INIT_FN fu
     return RtlRunOnceComplete( once, 0, context ? *context : NULL );
 }
 
+/*
+ *	Slim reader/writer locks and condition variables
+ *
+ * Both only use the first 32 bits of their pointer-sized storage. When the
+ * kernel supports futexes, waiters sleep directly on that value; otherwise
+ * they are queued on the process keyed event, using the address of the lock
+ * (or of one of its halves) as the key.
+ */
+
+/* futex lock layout */
+#define SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT      0x80000000
+#define SRWLOCK_FUTEX_SHARED_WAITERS_BIT      0x40000000
+#define SRWLOCK_FUTEX_SHARED_OWNERS_MASK      0x3fff0000
+#define SRWLOCK_FUTEX_SHARED_OWNERS_INC       0x00010000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK  0x0000ffff
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC   0x00000001
+
+/* futex wake-up masks, independent from the lock bits */
+#define SRWLOCK_FUTEX_BITSET_EXCLUSIVE  1
+#define SRWLOCK_FUTEX_BITSET_SHARED     2
+
+/* keyed event lock layout */
+#define SRWLOCK_MASK_IN_EXCLUSIVE     0x80000000
+#define SRWLOCK_MASK_EXCLUSIVE_QUEUE  0x7fff0000
+#define SRWLOCK_MASK_SHARED_QUEUE     0x0000ffff
+#define SRWLOCK_RES_EXCLUSIVE         0x00010000
+#define SRWLOCK_RES_SHARED            0x00000001
+
+#ifdef WORDS_BIGENDIAN
+#define srwlock_key_exclusive(lock)   ((void *)(lock))
+#define srwlock_key_shared(lock)      ((void *)((char *)(lock) + 2))
+#else
+#define srwlock_key_exclusive(lock)   ((void *)((char *)(lock) + 2))
+#define srwlock_key_shared(lock)      ((void *)(lock))
+#endif
+
+static inline int *srwlock_value( RTL_SRWLOCK *lock )
+{
+    return (int *)&lock->Ptr;
+}
+
+static inline int *cond_value( RTL_CONDITION_VARIABLE *variable )
+{
+    return (int *)&variable->Ptr;
+}
+
+/* convert an NT timeout to a relative timespec, returns FALSE if it already expired */
+static BOOL get_futex_timeout( struct timespec *ts, const LARGE_INTEGER *timeout )
+{
+    LONGLONG diff = timeout->QuadPart;
+
+    if (diff >= 0)
+    {
+        LARGE_INTEGER now;
+
+        NtQuerySystemTime( &now );
+        diff = now.QuadPart - diff;
+    }
+    if (diff >= 0) return FALSE;
+    ts->tv_sec  = -diff / 10000000;
+    ts->tv_nsec = (-diff % 10000000) * 100;
+    return TRUE;
+}
+
+static inline void srwlock_check_invalid( unsigned int val )
+{
+    /* raise an exception if it's impossible to acquire/release this lock */
+    if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) == SRWLOCK_MASK_EXCLUSIVE_QUEUE ||
+        (val & SRWLOCK_MASK_SHARED_QUEUE) == SRWLOCK_MASK_SHARED_QUEUE)
+        RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+}
+
+/* add incr to the lock value; once the shared queue has drained and exclusive
+ * waiters remain, mark the lock as in exclusive mode so that shared waiters
+ * may use the shared counter again */
+static inline unsigned int srwlock_lock_exclusive( int *dest, int incr )
+{
+    unsigned int val, tmp;
+
+    for (val = *dest;; val = tmp)
+    {
+        tmp = val + incr;
+        srwlock_check_invalid( tmp );
+        if ((tmp & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(tmp & SRWLOCK_MASK_SHARED_QUEUE))
+            tmp |= SRWLOCK_MASK_IN_EXCLUSIVE;
+        if ((tmp = interlocked_cmpxchg( dest, tmp, val )) == val) break;
+    }
+    return val;
+}
+
+/* add incr to the lock value, leaving exclusive mode when no exclusive waiters remain */
+static inline unsigned int srwlock_unlock_exclusive( int *dest, int incr )
+{
+    unsigned int val, tmp;
+
+    for (val = *dest;; val = tmp)
+    {
+        tmp = val + incr;
+        srwlock_check_invalid( tmp );
+        if (!(tmp & SRWLOCK_MASK_EXCLUSIVE_QUEUE)) tmp &= SRWLOCK_MASK_SHARED_QUEUE;
+        if ((tmp = interlocked_cmpxchg( dest, tmp, val )) == val) break;
+    }
+    return val;
+}
+
+/* hand the lock over once an exclusive owner is done: other exclusive
+ * waiters go first, then all the shared waiters */
+static inline void srwlock_leave_exclusive( RTL_SRWLOCK *lock, unsigned int val )
+{
+    if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
+        NtReleaseKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
+    else
+    {
+        val &= SRWLOCK_MASK_SHARED_QUEUE;
+        while (val--) NtReleaseKeyedEvent( keyed_event, srwlock_key_shared(lock), FALSE, NULL );
+    }
+}
+
+/* wake up an exclusive waiter once the last shared owner is gone */
+static inline void srwlock_leave_shared( RTL_SRWLOCK *lock, unsigned int val )
+{
+    if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(val & SRWLOCK_MASK_SHARED_QUEUE))
+        NtReleaseKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
+}
+
+static void futex_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int *value = srwlock_value( lock );
+    int old, new;
+
+    interlocked_xchg_add( value, SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC );
+
+    for (;;)
+    {
+        old = *value;
+        if (!(old & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_SHARED_OWNERS_MASK)))
+        {
+            new = (old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) - SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC;
+            if (interlocked_cmpxchg( value, new, old ) == old) return;
+            continue;
+        }
+        futex_wait_bitset( value, old, NULL, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    }
+}
+
+static void futex_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int *value = srwlock_value( lock );
+    int old, new;
+
+    for (;;)
+    {
+        old = *value;
+        /* exclusive waiters have priority over new shared owners */
+        if (!(old & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)))
+        {
+            new = old + SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+            if (interlocked_cmpxchg( value, new, old ) == old) return;
+            continue;
+        }
+        new = old | SRWLOCK_FUTEX_SHARED_WAITERS_BIT;
+        if (new != old && interlocked_cmpxchg( value, new, old ) != old) continue;
+        futex_wait_bitset( value, new, NULL, SRWLOCK_FUTEX_BITSET_SHARED );
+    }
+}
+
+static void futex_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int *value = srwlock_value( lock );
+    int old, new;
+
+    do
+    {
+        old = *value;
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT))
+        {
+            ERR( "lock %p is not owned exclusive (%#x)\n", lock, old );
+            RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+        }
+        new = old & ~SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT;
+        if (!(new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)) new &= ~SRWLOCK_FUTEX_SHARED_WAITERS_BIT;
+    }
+    while (interlocked_cmpxchg( value, new, old ) != old);
+
+    if (new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)
+        futex_wake_bitset( value, 1, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    else if (old & SRWLOCK_FUTEX_SHARED_WAITERS_BIT)
+        futex_wake_bitset( value, INT_MAX, SRWLOCK_FUTEX_BITSET_SHARED );
+}
+
+static void futex_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    int *value = srwlock_value( lock );
+    int old, new;
+
+    do
+    {
+        old = *value;
+        if ((old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) || !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+        {
+            ERR( "lock %p is not owned shared (%#x)\n", lock, old );
+            RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+        }
+        new = old - SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+    }
+    while (interlocked_cmpxchg( value, new, old ) != old);
+
+    /* only the last shared owner needs to hand the lock over */
+    if (!(new & SRWLOCK_FUTEX_SHARED_OWNERS_MASK) && (new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+        futex_wake_bitset( value, 1, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+}
+
 /***********************************************************************
  *              RtlInitializeSRWLock (NTDLL.@)
  */
@@ -1384,7 +2010,13 @@ void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
-    FIXME( "%p stub\n", lock );
+    if (use_futexes())
+    {
+        futex_acquire_srw_exclusive( lock );
+        return;
+    }
+    if (srwlock_lock_exclusive( srwlock_value( lock ), SRWLOCK_RES_EXCLUSIVE ))
+        NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
 }
 
 /***********************************************************************
@@ -1392,7 +2024,35 @@ void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
-    FIXME( "%p stub\n", lock );
+    unsigned int val, tmp;
+
+    if (use_futexes())
+    {
+        futex_acquire_srw_shared( lock );
+        return;
+    }
+
+    /* if the shared counter can't be used right now, queue as an exclusive waiter instead */
+    for (val = *srwlock_value( lock );; val = tmp)
+    {
+        if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(val & SRWLOCK_MASK_IN_EXCLUSIVE))
+            tmp = val + SRWLOCK_RES_EXCLUSIVE;
+        else
+            tmp = val + SRWLOCK_RES_SHARED;
+        if ((tmp = interlocked_cmpxchg( srwlock_value( lock ), tmp, val )) == val) break;
+    }
+
+    /* once woken up, trade the exclusive reservation for a shared one */
+    if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(val & SRWLOCK_MASK_IN_EXCLUSIVE))
+    {
+        NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
+        val = srwlock_unlock_exclusive( srwlock_value( lock ),
+                                        SRWLOCK_RES_SHARED - SRWLOCK_RES_EXCLUSIVE ) - SRWLOCK_RES_EXCLUSIVE;
+        srwlock_leave_exclusive( lock, val );
+    }
+
+    if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
+        NtWaitForKeyedEvent( keyed_event, srwlock_key_shared(lock), FALSE, NULL );
 }
 
 /***********************************************************************
@@ -1400,7 +2060,13 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
 {
-    FIXME( "%p stub\n", lock );
+    if (use_futexes())
+    {
+        futex_release_srw_exclusive( lock );
+        return;
+    }
+    srwlock_leave_exclusive( lock, srwlock_unlock_exclusive( srwlock_value( lock ),
+                             -SRWLOCK_RES_EXCLUSIVE ) - SRWLOCK_RES_EXCLUSIVE );
 }
 
 /***********************************************************************
@@ -1408,5 +2074,198 @@ void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
 {
-    FIXME( "%p stub\n", lock );
+    if (use_futexes())
+    {
+        futex_release_srw_shared( lock );
+        return;
+    }
+    srwlock_leave_shared( lock, srwlock_lock_exclusive( srwlock_value( lock ),
+                          -SRWLOCK_RES_SHARED ) - SRWLOCK_RES_SHARED );
+}
+
+/***********************************************************************
+ *              RtlTryAcquireSRWLockExclusive (NTDLL.@)
+ */
+BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
+{
+    int *value = srwlock_value( lock );
+    int old;
+
+    if (!use_futexes())
+        return interlocked_cmpxchg( value, SRWLOCK_MASK_IN_EXCLUSIVE | SRWLOCK_RES_EXCLUSIVE, 0 ) == 0;
+
+    do
+    {
+        old = *value;
+        if (old & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_SHARED_OWNERS_MASK)) return FALSE;
+    }
+    while (interlocked_cmpxchg( value, old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT, old ) != old);
+    return TRUE;
+}
+
+/***********************************************************************
+ *              RtlTryAcquireSRWLockShared (NTDLL.@)
+ */
+BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
+{
+    int *value = srwlock_value( lock );
+    int old;
+
+    if (!use_futexes())
+    {
+        do
+        {
+            old = *value;
+            if (old & SRWLOCK_MASK_EXCLUSIVE_QUEUE) return FALSE;
+        }
+        while (interlocked_cmpxchg( value, old + SRWLOCK_RES_SHARED, old ) != old);
+        return TRUE;
+    }
+
+    do
+    {
+        old = *value;
+        if (old & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)) return FALSE;
+    }
+    while (interlocked_cmpxchg( value, old + SRWLOCK_FUTEX_SHARED_OWNERS_INC, old ) != old);
+    return TRUE;
+}
+
+/* decrement a waiter count unless it already dropped to zero */
+static inline BOOL cond_dec_if_nonzero( int *count )
+{
+    int old;
+
+    do
+    {
+        if ((old = *count) <= 0) return FALSE;
+    }
+    while (interlocked_cmpxchg( count, old - 1, old ) != old);
+    return TRUE;
+}
+
+/* With futexes, the condition variable holds a sequence number that is
+ * bumped by every wake-up; sleepers wait for it to change. Otherwise it
+ * holds the number of threads waiting on the keyed event. */
+
+/* register as a waiter, returns the sequence number to wait on */
+static int cond_prepare_wait( RTL_CONDITION_VARIABLE *variable )
+{
+    if (use_futexes()) return *cond_value( variable );
+    interlocked_xchg_add( cond_value( variable ), 1 );
+    return 0;
+}
+
+static NTSTATUS cond_wait( RTL_CONDITION_VARIABLE *variable, int seq, const LARGE_INTEGER *timeout )
+{
+    NTSTATUS status;
+
+    if (use_futexes())
+    {
+        struct timespec ts;
+
+        if (!timeout || timeout->QuadPart == TIMEOUT_INFINITE)
+            futex_wait( cond_value( variable ), seq, NULL );
+        else if (!get_futex_timeout( &ts, timeout ) ||
+                 (futex_wait( cond_value( variable ), seq, &ts ) == -1 && errno == ETIMEDOUT))
+            return STATUS_TIMEOUT;
+        /* spurious wake-ups are allowed by the API */
+        return STATUS_SUCCESS;
+    }
+
+    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
+    if (status != STATUS_SUCCESS)
+    {
+        /* a waker may have picked us already, it's blocked until we consume its release */
+        if (!cond_dec_if_nonzero( cond_value( variable ) ))
+            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+    }
+    return status;
+}
+
+/***********************************************************************
+ *              RtlInitializeConditionVariable (NTDLL.@)
+ */
+void WINAPI RtlInitializeConditionVariable( RTL_CONDITION_VARIABLE *variable )
+{
+    variable->Ptr = NULL;
+}
+
+/***********************************************************************
+ *              RtlWakeConditionVariable (NTDLL.@)
+ *
+ * Wakes up one thread waiting on the condition variable.
+ */
+void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
+{
+    if (use_futexes())
+    {
+        interlocked_xchg_add( cond_value( variable ), 1 );
+        futex_wake( cond_value( variable ), 1 );
+    }
+    else if (cond_dec_if_nonzero( cond_value( variable ) ))
+        NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+}
+
+/***********************************************************************
+ *              RtlWakeAllConditionVariable (NTDLL.@)
+ *
+ * Wakes up all threads waiting on the condition variable.
+ */
+void WINAPI RtlWakeAllConditionVariable( RTL_CONDITION_VARIABLE *variable )
+{
+    int val;
+
+    if (use_futexes())
+    {
+        interlocked_xchg_add( cond_value( variable ), 1 );
+        futex_wake( cond_value( variable ), INT_MAX );
+        return;
+    }
+    val = interlocked_xchg( cond_value( variable ), 0 );
+    while (val-- > 0) NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+}
+
+/***********************************************************************
+ *              RtlSleepConditionVariableCS (NTDLL.@)
+ *
+ * Atomically releases the critical section and waits on the condition variable.
+ *
+ * RETURNS
+ *  STATUS_SUCCESS if the condition variable was signaled, STATUS_TIMEOUT otherwise.
+ */
+NTSTATUS WINAPI RtlSleepConditionVariableCS( RTL_CONDITION_VARIABLE *variable, RTL_CRITICAL_SECTION *crit,
+                                             const LARGE_INTEGER *timeout )
+{
+    NTSTATUS status;
+    int seq = cond_prepare_wait( variable );
+
+    RtlLeaveCriticalSection( crit );
+    status = cond_wait( variable, seq, timeout );
+    RtlEnterCriticalSection( crit );
+    return status;
+}
+
+/***********************************************************************
+ *              RtlSleepConditionVariableSRW (NTDLL.@)
+ *
+ * Atomically releases the SRW lock and waits on the condition variable.
+ *
+ * RETURNS
+ *  STATUS_SUCCESS if the condition variable was signaled, STATUS_TIMEOUT otherwise.
+ */
+NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable, RTL_SRWLOCK *lock,
+                                              const LARGE_INTEGER *timeout, ULONG flags )
+{
+    NTSTATUS status;
+    int seq = cond_prepare_wait( variable );
+
+    if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED) RtlReleaseSRWLockShared( lock );
+    else RtlReleaseSRWLockExclusive( lock );
+
+    status = cond_wait( variable, seq, timeout );
+
+    if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED) RtlAcquireSRWLockShared( lock );
+    else RtlAcquireSRWLockExclusive( lock );
+    return status;
 }
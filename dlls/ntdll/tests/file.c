@@ -72,6 +72,7 @@ static NTSTATUS (WINAPI *pNtCreateIoCompletion)(PHANDLE, ACCESS_MASK, POBJECT_AT
 static NTSTATUS (WINAPI *pNtOpenIoCompletion)(PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES);
 static NTSTATUS (WINAPI *pNtQueryIoCompletion)(HANDLE, IO_COMPLETION_INFORMATION_CLASS, PVOID, ULONG, PULONG);
 static NTSTATUS (WINAPI *pNtRemoveIoCompletion)(HANDLE, PULONG_PTR, PULONG_PTR, PIO_STATUS_BLOCK, PLARGE_INTEGER);
+static NTSTATUS (WINAPI *pNtRemoveIoCompletionEx)(HANDLE, FILE_IO_COMPLETION_INFORMATION *, ULONG, ULONG *, PLARGE_INTEGER, BOOLEAN);
 static NTSTATUS (WINAPI *pNtSetIoCompletion)(HANDLE, ULONG_PTR, ULONG_PTR, NTSTATUS, SIZE_T);
 static NTSTATUS (WINAPI *pNtSetInformationFile)(HANDLE, PIO_STATUS_BLOCK, PVOID, ULONG, FILE_INFORMATION_CLASS);
 static NTSTATUS (WINAPI *pNtQueryInformationFile)(HANDLE, PIO_STATUS_BLOCK, PVOID, ULONG, FILE_INFORMATION_CLASS);
@@ -1059,6 +1060,63 @@ static void test_iocp_setcompletion(HANDLE h)
     ok( !count, "Unexpected msg count: %d\n", count );
 }
 
+static void test_iocp_remove_ex(HANDLE h)
+{
+    FILE_IO_COMPLETION_INFORMATION info[16];
+    LARGE_INTEGER timeout;
+    NTSTATUS res;
+    ULONG i, count, total, start;
+
+    if (!pNtRemoveIoCompletionEx)
+    {
+        win_skip( "NtRemoveIoCompletionEx not available\n" );
+        return;
+    }
+
+    timeout.QuadPart = 0;
+    count = 0xdeadbeef;
+    res = pNtRemoveIoCompletionEx( h, info, 16, &count, &timeout, FALSE );
+    ok( res == STATUS_TIMEOUT, "NtRemoveIoCompletionEx returned %x\n", res );
+    ok( !count, "got %u packets\n", count );
+
+    for (i = 0; i < 40; i++)
+    {
+        res = pNtSetIoCompletion( h, CKEY_FIRST + i, CVALUE_FIRST, STATUS_SUCCESS, i );
+        ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %x\n", res );
+    }
+
+    total = 0;
+    while (total < 40)
+    {
+        res = pNtRemoveIoCompletionEx( h, info, 16, &count, &timeout, FALSE );
+        ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx returned %x\n", res );
+        if (res) break;
+        ok( count == min( 16, 40 - total ), "got %u packets after %u\n", count, total );
+        for (i = 0; i < count; i++, total++)
+        {
+            ok( info[i].CompletionKey == CKEY_FIRST + total, "wrong key %lx\n", info[i].CompletionKey );
+            ok( info[i].CompletionValue == CVALUE_FIRST, "wrong value %lx\n", info[i].CompletionValue );
+            ok( info[i].IoStatusBlock.Information == total, "wrong information %lu\n",
+                info[i].IoStatusBlock.Information );
+            ok( U(info[i].IoStatusBlock).Status == STATUS_SUCCESS, "wrong status %x\n",
+                U(info[i].IoStatusBlock).Status );
+        }
+    }
+    count = get_pending_msgs(h);
+    ok( !count, "Unexpected msg count: %d\n", count );
+
+    /* rough throughput figure for batched dequeuing */
+    start = GetTickCount();
+    for (total = 0; total < 20000; total += count)
+    {
+        for (i = 0; i < 16; i++) pNtSetIoCompletion( h, CKEY_FIRST, CVALUE_FIRST, STATUS_SUCCESS, i );
+        res = pNtRemoveIoCompletionEx( h, info, 16, &count, &timeout, FALSE );
+        if (res) break;
+    }
+    trace( "%u packets dequeued 16 at a time in %u ms\n", total, GetTickCount() - start );
+    while (!pNtRemoveIoCompletionEx( h, info, 16, &count, &timeout, FALSE ));
+}
+
 static void test_iocp_fileio(HANDLE h)
 {
     static const char pipe_name[] = "\\\\.\\pipe\\iocompletiontestnamedpipe";
@@ -1516,6 +1574,7 @@ static void test_iocompletion(void)
     if ( h && h != INVALID_HANDLE_VALUE)
     {
         test_iocp_setcompletion(h);
+        test_iocp_remove_ex(h);
         test_iocp_fileio(h);
         pNtClose(h);
     }
@@ -2702,6 +2761,7 @@ START_TEST(file)
     pNtOpenIoCompletion     = (void *)GetProcAddress(hntdll, "NtOpenIoCompletion");
     pNtQueryIoCompletion    = (void *)GetProcAddress(hntdll, "NtQueryIoCompletion");
     pNtRemoveIoCompletion   = (void *)GetProcAddress(hntdll, "NtRemoveIoCompletion");
+    pNtRemoveIoCompletionEx = (void *)GetProcAddress(hntdll, "NtRemoveIoCompletionEx");
     pNtSetIoCompletion      = (void *)GetProcAddress(hntdll, "NtSetIoCompletion");
     pNtSetInformationFile   = (void *)GetProcAddress(hntdll, "NtSetInformationFile");
     pNtQueryInformationFile = (void *)GetProcAddress(hntdll, "NtQueryInformationFile");
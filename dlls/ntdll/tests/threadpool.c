@@ -0,0 +1,480 @@
+/*
+ * Unit test suite for thread pool functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdarg.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "wine/test.h"
+
+static NTSTATUS (WINAPI *pTpAllocCleanupGroup)(TP_CLEANUP_GROUP **);
+static NTSTATUS (WINAPI *pTpAllocPool)(TP_POOL **,PVOID);
+static NTSTATUS (WINAPI *pTpAllocTimer)(TP_TIMER **,PTP_TIMER_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static NTSTATUS (WINAPI *pTpAllocWait)(TP_WAIT **,PTP_WAIT_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static NTSTATUS (WINAPI *pTpAllocWork)(TP_WORK **,PTP_WORK_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static void (WINAPI *pTpCallbackReleaseSemaphoreOnCompletion)(TP_CALLBACK_INSTANCE *,HANDLE,DWORD);
+static BOOL (WINAPI *pTpIsTimerSet)(TP_TIMER *);
+static void (WINAPI *pTpPostWork)(TP_WORK *);
+static void (WINAPI *pTpReleaseCleanupGroup)(TP_CLEANUP_GROUP *);
+static void (WINAPI *pTpReleaseCleanupGroupMembers)(TP_CLEANUP_GROUP *,BOOL,PVOID);
+static void (WINAPI *pTpReleasePool)(TP_POOL *);
+static void (WINAPI *pTpReleaseTimer)(TP_TIMER *);
+static void (WINAPI *pTpReleaseWait)(TP_WAIT *);
+static void (WINAPI *pTpReleaseWork)(TP_WORK *);
+static void (WINAPI *pTpSetPoolMaxThreads)(TP_POOL *,DWORD);
+static void (WINAPI *pTpSetTimer)(TP_TIMER *,LARGE_INTEGER *,LONG,LONG);
+static void (WINAPI *pTpSetWait)(TP_WAIT *,HANDLE,LARGE_INTEGER *);
+static NTSTATUS (WINAPI *pTpSimpleTryPost)(PTP_SIMPLE_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static void (WINAPI *pTpWaitForTimer)(TP_TIMER *,BOOL);
+static void (WINAPI *pTpWaitForWait)(TP_WAIT *,BOOL);
+static void (WINAPI *pTpWaitForWork)(TP_WORK *,BOOL);
+
+#define NTDLL_GET_PROC(func) \
+    do \
+    { \
+        p ## func = (void *)GetProcAddress(hntdll, #func); \
+        if (!p ## func) trace("Failed to get address for %s\n", #func); \
+    } \
+    while (0)
+
+static BOOL init_threadpool(void)
+{
+    HMODULE hntdll = GetModuleHandleA("ntdll");
+
+    NTDLL_GET_PROC(TpAllocCleanupGroup);
+    NTDLL_GET_PROC(TpAllocPool);
+    NTDLL_GET_PROC(TpAllocTimer);
+    NTDLL_GET_PROC(TpAllocWait);
+    NTDLL_GET_PROC(TpAllocWork);
+    NTDLL_GET_PROC(TpCallbackReleaseSemaphoreOnCompletion);
+    NTDLL_GET_PROC(TpIsTimerSet);
+    NTDLL_GET_PROC(TpPostWork);
+    NTDLL_GET_PROC(TpReleaseCleanupGroup);
+    NTDLL_GET_PROC(TpReleaseCleanupGroupMembers);
+    NTDLL_GET_PROC(TpReleasePool);
+    NTDLL_GET_PROC(TpReleaseTimer);
+    NTDLL_GET_PROC(TpReleaseWait);
+    NTDLL_GET_PROC(TpReleaseWork);
+    NTDLL_GET_PROC(TpSetPoolMaxThreads);
+    NTDLL_GET_PROC(TpSetTimer);
+    NTDLL_GET_PROC(TpSetWait);
+    NTDLL_GET_PROC(TpSimpleTryPost);
+    NTDLL_GET_PROC(TpWaitForTimer);
+    NTDLL_GET_PROC(TpWaitForWait);
+    NTDLL_GET_PROC(TpWaitForWork);
+
+    if (!pTpAllocPool)
+    {
+        win_skip("Threadpool functions not supported, skipping tests\n");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+#undef NTDLL_GET_PROC
+
+
+static void CALLBACK simple_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    HANDLE semaphore = userdata;
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+static void CALLBACK simple2_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    Sleep(50);
+    InterlockedIncrement((LONG *)userdata);
+}
+
+static void test_tp_simple(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_CLEANUP_GROUP *group;
+    HANDLE semaphore;
+    NTSTATUS status;
+    TP_POOL *pool;
+    LONG userdata;
+    DWORD result;
+    int i;
+
+    semaphore = CreateSemaphoreA(NULL, 0, 1, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    /* post the callback using the default threadpool */
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = NULL;
+    status = pTpSimpleTryPost(simple_cb, semaphore, &environment);
+    ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    result = WaitForSingleObject(semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    /* post the callback using the new threadpool */
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    status = pTpSimpleTryPost(simple_cb, semaphore, &environment);
+    ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    result = WaitForSingleObject(semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    /* test with cleanup group */
+    group = NULL;
+    status = pTpAllocCleanupGroup(&group);
+    ok(!status, "TpAllocCleanupGroup failed with status %x\n", status);
+    ok(group != NULL, "expected group != NULL\n");
+
+    /* releasing the group members waits for the callbacks */
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    environment.CleanupGroup = group;
+    userdata = 0;
+    for (i = 0; i < 10; i++)
+    {
+        status = pTpSimpleTryPost(simple2_cb, &userdata, &environment);
+        ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    }
+    pTpReleaseCleanupGroupMembers(group, FALSE, NULL);
+    ok(userdata == 10, "expected userdata = 10, got %u\n", userdata);
+
+    /* cleanup */
+    pTpReleaseCleanupGroup(group);
+    pTpReleasePool(pool);
+    CloseHandle(semaphore);
+}
+
+static void CALLBACK work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    Sleep(10);
+    InterlockedIncrement((LONG *)userdata);
+}
+
+static void CALLBACK work2_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    InterlockedIncrement((LONG *)userdata);
+}
+
+static void test_tp_work(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    LONG userdata;
+    int i;
+
+    /* allocate new threadpool with only one thread */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+    pTpSetPoolMaxThreads(pool, 1);
+
+    /* allocate new work item */
+    work = NULL;
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    status = pTpAllocWork(&work, work_cb, &userdata, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    ok(work != NULL, "expected work != NULL\n");
+
+    /* post 5 identical work items at once */
+    userdata = 0;
+    for (i = 0; i < 5; i++)
+        pTpPostWork(work);
+    pTpWaitForWork(work, FALSE);
+    ok(userdata == 5, "expected userdata = 5, got %u\n", userdata);
+
+    /* add more tasks and cancel them immediately */
+    userdata = 0;
+    for (i = 0; i < 10; i++)
+        pTpPostWork(work);
+    pTpWaitForWork(work, TRUE);
+    ok(userdata < 10, "expected userdata < 10, got %u\n", userdata);
+
+    pTpReleaseWork(work);
+
+    /* many tiny work items */
+    work = NULL;
+    status = pTpAllocWork(&work, work2_cb, &userdata, NULL);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    ok(work != NULL, "expected work != NULL\n");
+
+    userdata = 0;
+    for (i = 0; i < 10000; i++)
+        pTpPostWork(work);
+    pTpWaitForWork(work, FALSE);
+    ok(userdata == 10000, "expected userdata = 10000, got %u\n", userdata);
+
+    /* cleanup */
+    pTpReleaseWork(work);
+    pTpReleasePool(pool);
+}
+
+struct nested_work
+{
+    TP_WORK *work;
+    LONG     count;
+    LONG     depth;
+};
+
+static void CALLBACK nested_work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    struct nested_work *nested = userdata;
+
+    /* each callback posts two more until the limit is reached */
+    if (InterlockedIncrement(&nested->count) <= nested->depth)
+    {
+        pTpPostWork(nested->work);
+        pTpPostWork(nested->work);
+    }
+}
+
+static void test_tp_work_nested(void)
+{
+    struct nested_work nested;
+    NTSTATUS status;
+
+    nested.work  = NULL;
+    nested.count = 0;
+    nested.depth = 500;
+    status = pTpAllocWork(&nested.work, nested_work_cb, &nested, NULL);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    ok(nested.work != NULL, "expected work != NULL\n");
+
+    pTpPostWork(nested.work);
+    pTpWaitForWork(nested.work, FALSE);
+    ok(nested.count == 2 * nested.depth + 1, "expected count = %u, got %u\n",
+       2 * nested.depth + 1, nested.count);
+
+    pTpReleaseWork(nested.work);
+}
+
+static void CALLBACK timer_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_TIMER *timer)
+{
+    HANDLE semaphore = userdata;
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+static void test_tp_timer(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    DWORD result, ticks;
+    LARGE_INTEGER when;
+    HANDLE semaphore;
+    NTSTATUS status;
+    TP_TIMER *timer;
+    TP_POOL *pool;
+    BOOL success;
+    int i;
+
+    semaphore = CreateSemaphoreA(NULL, 0, 1, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    /* allocate new timer */
+    timer = NULL;
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    status = pTpAllocTimer(&timer, timer_cb, semaphore, &environment);
+    ok(!status, "TpAllocTimer failed with status %x\n", status);
+    ok(timer != NULL, "expected timer != NULL\n");
+
+    success = pTpIsTimerSet(timer);
+    ok(!success, "TpIsTimerSet returned TRUE\n");
+
+    /* test timer with a relative timeout */
+    when.QuadPart = (ULONGLONG)200 * -10000;
+    pTpSetTimer(timer, &when, 0, 0);
+    success = pTpIsTimerSet(timer);
+    ok(success, "TpIsTimerSet returned FALSE\n");
+
+    ticks = GetTickCount();
+    result = WaitForSingleObject(semaphore, 1000);
+    ticks = GetTickCount() - ticks;
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(ticks >= 150 && ticks <= 500, "expected approximately 200 ticks, got %u\n", ticks);
+    pTpWaitForTimer(timer, FALSE);
+
+    /* test timer with zero timeout */
+    when.QuadPart = 0;
+    pTpSetTimer(timer, &when, 0, 0);
+    result = WaitForSingleObject(semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    /* test periodic timer */
+    when.QuadPart = 0;
+    pTpSetTimer(timer, &when, 50, 0);
+    for (i = 0; i < 4; i++)
+    {
+        result = WaitForSingleObject(semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    }
+
+    /* disarm the timer */
+    pTpSetTimer(timer, NULL, 0, 0);
+    success = pTpIsTimerSet(timer);
+    ok(!success, "TpIsTimerSet returned TRUE\n");
+    pTpWaitForTimer(timer, TRUE);
+    WaitForSingleObject(semaphore, 0);
+    result = WaitForSingleObject(semaphore, 200);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+
+    /* cleanup */
+    pTpReleaseTimer(timer);
+    pTpReleasePool(pool);
+    CloseHandle(semaphore);
+}
+
+struct wait_info
+{
+    HANDLE semaphore;
+    LONG   userdata;
+};
+
+static void CALLBACK wait_cb(TP_CALLBACK_INSTANCE *instance, void *userdata,
+                             TP_WAIT *wait, TP_WAIT_RESULT result)
+{
+    struct wait_info *info = userdata;
+
+    if (result == WAIT_OBJECT_0)
+        InterlockedExchangeAdd(&info->userdata, 1);
+    else if (result == WAIT_TIMEOUT)
+        InterlockedExchangeAdd(&info->userdata, 0x10000);
+    else
+        ok(0, "unexpected result %u\n", result);
+
+    pTpCallbackReleaseSemaphoreOnCompletion(instance, info->semaphore, 1);
+}
+
+static void test_tp_wait(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_WAIT *waits[100];
+    HANDLE events[100];
+    struct wait_info info;
+    LARGE_INTEGER when;
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+    int i;
+
+    info.semaphore = CreateSemaphoreA(NULL, 0, 100, NULL);
+    ok(info.semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    /* more waits than fit in a single wait thread */
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    for (i = 0; i < 100; i++)
+    {
+        events[i] = CreateEventA(NULL, FALSE, FALSE, NULL);
+        ok(events[i] != NULL, "CreateEventA failed %u\n", GetLastError());
+        waits[i] = NULL;
+        status = pTpAllocWait(&waits[i], wait_cb, &info, &environment);
+        ok(!status, "TpAllocWait failed with status %x\n", status);
+        ok(waits[i] != NULL, "expected waits[%d] != NULL\n", i);
+    }
+
+    /* infinite timeout, signal the events */
+    info.userdata = 0;
+    for (i = 0; i < 100; i++)
+        pTpSetWait(waits[i], events[i], NULL);
+    for (i = 0; i < 100; i++)
+        SetEvent(events[i]);
+    for (i = 0; i < 100; i++)
+    {
+        result = WaitForSingleObject(info.semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    }
+    ok(info.userdata == 100, "expected info.userdata = 100, got %u\n", info.userdata);
+
+    /* relative timeout, no event */
+    info.userdata = 0;
+    when.QuadPart = (ULONGLONG)200 * -10000;
+    pTpSetWait(waits[0], events[0], &when);
+    result = WaitForSingleObject(info.semaphore, 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 0x10000, "expected info.userdata = 0x10000, got %u\n", info.userdata);
+
+    /* zero timeout with the event already signaled */
+    info.userdata = 0;
+    SetEvent(events[0]);
+    when.QuadPart = 0;
+    pTpSetWait(waits[0], events[0], &when);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 1, "expected info.userdata = 1, got %u\n", info.userdata);
+
+    /* unset the wait before the event is signaled */
+    info.userdata = 0;
+    pTpSetWait(waits[0], events[0], NULL);
+    pTpSetWait(waits[0], NULL, NULL);
+    SetEvent(events[0]);
+    result = WaitForSingleObject(info.semaphore, 200);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 0, "expected info.userdata = 0, got %u\n", info.userdata);
+
+    /* cleanup */
+    for (i = 0; i < 100; i++)
+    {
+        pTpWaitForWait(waits[i], TRUE);
+        pTpReleaseWait(waits[i]);
+        CloseHandle(events[i]);
+    }
+    pTpReleasePool(pool);
+    CloseHandle(info.semaphore);
+}
+
+START_TEST(threadpool)
+{
+    if (!init_threadpool())
+        return;
+
+    test_tp_simple();
+    test_tp_work();
+    test_tp_work_nested();
+    test_tp_timer();
+    test_tp_wait();
+}
@@ -277,6 +277,9 @@ HANDLE thread_init(void)
     thread_data->reply_fd   = -1;
     thread_data->wait_fd[0] = -1;
     thread_data->wait_fd[1] = -1;
+    thread_data->reply_shm  = NULL;
+    thread_data->heap_cache = NULL;
+    thread_data->threadpool_worker = NULL;
     thread_data->debug_info = &debug_info;
     InsertHeadList( &tls_links, &teb->TlsLinks );
 
@@ -344,6 +347,7 @@ void terminate_thread( int status )
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
     close( ntdll_get_thread_data()->request_fd );
+    server_free_reply_shm();
     pthread_exit( UIntToPtr(status) );
 }
 
@@ -374,6 +378,7 @@ void exit_thread( int status )
     }
 
     LdrShutdownThread();
+    heap_free_thread_cache();
 
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
 
@@ -392,6 +397,7 @@ void exit_thread( int status )
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
     close( ntdll_get_thread_data()->request_fd );
+    server_free_reply_shm();
     pthread_exit( UIntToPtr(status) );
 }
 
@@ -531,6 +537,9 @@ NTSTATUS WINAPI RtlCreateUserThread( HANDLE process, const SECURITY_DESCRIPTOR *
     thread_data->reply_fd    = -1;
     thread_data->wait_fd[0]  = -1;
     thread_data->wait_fd[1]  = -1;
+    thread_data->reply_shm   = NULL;
+    thread_data->heap_cache  = NULL;
+    thread_data->threadpool_worker = NULL;
 
     if ((status = virtual_alloc_thread_stack( teb, stack_reserve, stack_commit ))) goto error;
 
@@ -39,21 +39,11 @@ WINE_DEFAULT_DEBUG_CHANNEL(threadpool);
 
 #define WORKER_TIMEOUT 30000 /* 30 seconds */
 
-static LONG num_workers;
-static LONG num_work_items;
-static LONG num_busy_workers;
-
-static struct list work_item_list = LIST_INIT(work_item_list);
-static HANDLE work_item_event;
-
-static RTL_CRITICAL_SECTION threadpool_cs;
-static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
-{
-    0, 0, &threadpool_cs,
-    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
-    0, 0, { (DWORD_PTR)(__FILE__ ": threadpool_cs") }
-};
-static RTL_CRITICAL_SECTION threadpool_cs = { &critsect_debug, -1, 0, 0, 0, 0 };
+#define THREADPOOL_MAX_WORKERS  500
+#define WORKER_QUEUE_SIZE       256     /* must be a power of 2 */
+#define WORKER_BATCH_SIZE       32
+#define WAIT_BUCKET_SIZE        (MAXIMUM_WAIT_OBJECTS - 1)
+#define WAIT_BUCKET_TIMEOUT     20000   /* 20 seconds */
 
 static HANDLE compl_port = NULL;
 static RTL_CRITICAL_SECTION threadpool_compl_cs;
@@ -65,993 +55,2605 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
 };
 static RTL_CRITICAL_SECTION threadpool_compl_cs = { &critsect_compl_debug, -1, 0, 0, 0, 0 };
 
-struct work_item
+/* thread running the callbacks that must not go to an exiting worker, protected by threadpool_compl_cs */
+static HANDLE persistent_thread;
+
+/*
+ * Thread pool objects
+ *
+ * Every work, timer and wait object (and every simple callback) is a
+ * threadpool_object.  Posting a callback increments the object's pending
+ * count and queues a reference to the object.  A worker posting from one
+ * of its own callbacks pushes the reference onto its private deque and pops
+ * it back in LIFO order; other threads, including the timer and wait
+ * threads, go through the pool's injection queue, from which workers take
+ * batches.  Idle workers steal the oldest entries from other workers'
+ * deques.  Cancelling only resets the pending count; the queued references
+ * that no longer have a pending callback are dropped when dequeued.
+ * Callbacks that must run in a specific thread (persistent or I/O work
+ * items, WT_EXECUTEINWAITTHREAD waits) are queued to it as user APCs.
+ */
+
+enum threadpool_objtype
 {
-    struct list entry;
-    PRTL_WORK_ITEM_ROUTINE function;
-    PVOID context;
+    TP_OBJECT_TYPE_SIMPLE,
+    TP_OBJECT_TYPE_WORK,
+    TP_OBJECT_TYPE_TIMER,
+    TP_OBJECT_TYPE_WAIT
 };
 
-static inline LONG interlocked_inc( PLONG dest )
+struct threadpool
 {
-    return interlocked_xchg_add( dest, 1 ) + 1;
-}
+    LONG                       refcount;
+    BOOL                       shutdown;
+    RTL_CRITICAL_SECTION       cs;
+    struct list                workers;      /* worker threads, protected by cs */
+    int                        num_workers;
+    int                        max_workers;
+    int                        min_workers;
+    LONG                       num_idle;     /* idle workers, also the key to wake them */
+    LONG                       num_busy;     /* workers executing a callback */
+    LONG                       num_queued;   /* queued references, including cancelled ones */
+    struct threadpool_object **queue;        /* injection queue, protected by cs */
+    unsigned int               queue_head;
+    unsigned int               queue_count;
+    unsigned int               queue_size;
+};
 
-static inline LONG interlocked_dec( PLONG dest )
+struct threadpool_worker
 {
-    return interlocked_xchg_add( dest, -1 ) - 1;
-}
+    struct list                entry;
+    struct threadpool         *pool;
+    LONG                       lock;         /* spin lock protecting the deque */
+    unsigned int               head;         /* oldest entry, stolen first */
+    unsigned int               count;
+    struct threadpool_object  *deque[WORKER_QUEUE_SIZE];
+};
 
-static void WINAPI worker_thread_proc(void * param)
+struct threadpool_group
 {
-    interlocked_inc(&num_workers);
+    LONG                       refcount;
+    BOOL                       shutdown;
+    RTL_CRITICAL_SECTION       cs;
+    struct list                members;      /* protected by cs */
+};
+
+struct waitqueue_bucket;
 
-    /* free the work item memory sooner to reduce memory usage */
-    while (TRUE)
+struct threadpool_object
+{
+    LONG                       refcount;
+    BOOL                       shutdown;
+    enum threadpool_objtype    type;
+    struct threadpool         *pool;
+    struct threadpool_group   *group;
+    PVOID                      userdata;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK group_cancel_callback;
+    PTP_SIMPLE_CALLBACK        finalization_callback;
+    BOOL                       may_run_long;
+    HANDLE                     apc_thread;   /* run the callbacks as APCs in this thread instead of the pool */
+    HMODULE                    race_dll;
+    struct list                group_entry;  /* entry in the group's member list */
+    BOOL                       is_group_member;
+    LONG                       num_pending;  /* posted callbacks not yet started or cancelled */
+    LONG                       num_running;  /* callbacks currently executing */
+    LONG                       num_waiters;  /* threads waiting for callbacks, also the key to wake them */
+    union
     {
-        if (num_work_items > 0)
+        struct
         {
-            struct list *item;
-            RtlEnterCriticalSection(&threadpool_cs);
-            item = list_head(&work_item_list);
-            if (item)
-            {
-                struct work_item *work_item_ptr = LIST_ENTRY(item, struct work_item, entry);
-                struct work_item work_item;
-                list_remove(&work_item_ptr->entry);
-                interlocked_dec(&num_work_items);
-
-                RtlLeaveCriticalSection(&threadpool_cs);
+            PTP_SIMPLE_CALLBACK    callback;
+            PRTL_WORK_ITEM_ROUTINE function;        /* RtlQueueWorkItem routine */
+        } simple;
+        struct
+        {
+            PTP_WORK_CALLBACK      callback;
+        } work;
+        struct
+        {
+            PTP_TIMER_CALLBACK     callback;
+            struct list            entry;           /* entry in the timer list, protected by timerqueue_cs */
+            BOOL                   timer_pending;   /* in the timer list */
+            BOOL                   timer_set;
+            ULONGLONG              timeout;         /* absolute due time */
+            LONG                   period;
+            LONG                   window;
+        } timer;
+        struct
+        {
+            PTP_WAIT_CALLBACK      callback;
+            RTL_WAITORTIMERCALLBACKFUNC function;   /* RtlRegisterWait callback */
+            ULONG                  flags;           /* RtlRegisterWait flags */
+            ULONG                  milliseconds;    /* RtlRegisterWait timeout */
+            HANDLE                 completion_event;
+            struct waitqueue_bucket *bucket;
+            struct list            entry;           /* entry in the bucket, protected by waitqueue_cs */
+            BOOL                   wait_pending;    /* in the bucket's wait list */
+            HANDLE                 handle;
+            ULONGLONG              timeout;         /* absolute, or TIMEOUT_INFINITE */
+            NTSTATUS               result;          /* result passed to the next callback */
+        } wait;
+    } u;
+};
 
-                work_item = *work_item_ptr;
-                RtlFreeHeap(GetProcessHeap(), 0, work_item_ptr);
+struct threadpool_instance
+{
+    struct threadpool_object  *object;
+    DWORD                      threadid;
+    BOOL                       associated;
+    BOOL                       may_run_long;
+    struct
+    {
+        RTL_CRITICAL_SECTION  *critical_section;
+        HANDLE                 mutex;
+        HANDLE                 semaphore;
+        LONG                   semaphore_count;
+        HANDLE                 event;
+        HMODULE                library;
+    } cleanup;
+};
 
-                TRACE("executing %p(%p)\n", work_item.function, work_item.context);
+struct waitqueue_bucket
+{
+    struct list                entry;
+    LONG                       objcount;     /* wait objects assigned to this bucket */
+    struct list                waiting;      /* armed wait objects */
+    HANDLE                     update_event;
+};
 
-                interlocked_inc(&num_busy_workers);
+static struct threadpool *default_threadpool;
 
-                /* do the work */
-                work_item.function(work_item.context);
+static struct list timer_list = LIST_INIT(timer_list);  /* sorted by timeout */
+static HANDLE timer_update_event;
 
-                interlocked_dec(&num_busy_workers);
-            }
-            else
-                RtlLeaveCriticalSection(&threadpool_cs);
-        }
-        else
-        {
-            NTSTATUS status;
-            LARGE_INTEGER timeout;
-            timeout.QuadPart = -(WORKER_TIMEOUT * (ULONGLONG)10000);
-            status = NtWaitForSingleObject(work_item_event, FALSE, &timeout);
-            if (status != STATUS_WAIT_0)
-                break;
-        }
-    }
+static RTL_CRITICAL_SECTION timerqueue_cs;
+static RTL_CRITICAL_SECTION_DEBUG timerqueue_debug =
+{
+    0, 0, &timerqueue_cs,
+    { &timerqueue_debug.ProcessLocksList, &timerqueue_debug.ProcessLocksList },
+    0, 0, { (DWORD_PTR)(__FILE__ ": timerqueue_cs") }
+};
+static RTL_CRITICAL_SECTION timerqueue_cs = { &timerqueue_debug, -1, 0, 0, 0, 0 };
 
-    interlocked_dec(&num_workers);
+static struct list waitqueue_buckets = LIST_INIT(waitqueue_buckets);
 
-    RtlExitUserThread(0);
+static RTL_CRITICAL_SECTION waitqueue_cs;
+static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
+{
+    0, 0, &waitqueue_cs,
+    { &waitqueue_debug.ProcessLocksList, &waitqueue_debug.ProcessLocksList },
+    0, 0, { (DWORD_PTR)(__FILE__ ": waitqueue_cs") }
+};
+static RTL_CRITICAL_SECTION waitqueue_cs = { &waitqueue_debug, -1, 0, 0, 0, 0 };
 
-    /* never reached */
+static inline LONG interlocked_inc( PLONG dest )
+{
+    return interlocked_xchg_add( dest, 1 ) + 1;
 }
 
-static NTSTATUS add_work_item_to_queue(struct work_item *work_item)
+static inline LONG interlocked_dec( PLONG dest )
 {
-    NTSTATUS status;
+    return interlocked_xchg_add( dest, -1 ) - 1;
+}
 
-    RtlEnterCriticalSection(&threadpool_cs);
-    list_add_tail(&work_item_list, &work_item->entry);
-    num_work_items++;
-    RtlLeaveCriticalSection(&threadpool_cs);
+/* decrement a counter unless it is already zero; for counts of sleeping
+ * threads the caller then owns one wake up on the corresponding keyed event */
+static inline BOOL interlocked_dec_if_nonzero( LONG *count )
+{
+    LONG old;
 
-    if (!work_item_event)
+    do
     {
-        HANDLE sem;
-        status = NtCreateSemaphore(&sem, SEMAPHORE_ALL_ACCESS, NULL, 1, INT_MAX);
-        if (interlocked_cmpxchg_ptr( &work_item_event, sem, 0 ))
-            NtClose(sem);  /* somebody beat us to it */
+        if ((old = *count) <= 0) return FALSE;
     }
-    else
-        status = NtReleaseSemaphore(work_item_event, 1, NULL);
+    while (interlocked_cmpxchg( count, old - 1, old ) != old);
+    return TRUE;
+}
 
-    return status;
+static inline struct threadpool *impl_from_TP_POOL( TP_POOL *pool )
+{
+    return (struct threadpool *)pool;
 }
 
-/***********************************************************************
- *              RtlQueueWorkItem   (NTDLL.@)
- *
- * Queues a work item into a thread in the thread pool.
- *
- * PARAMS
- *  Function [I] Work function to execute.
- *  Context  [I] Context to pass to the work function when it is executed.
- *  Flags    [I] Flags. See notes.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- *
- * NOTES
- *  Flags can be one or more of the following:
- *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
- *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
- *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
- *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
- *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
- */
-NTSTATUS WINAPI RtlQueueWorkItem(PRTL_WORK_ITEM_ROUTINE Function, PVOID Context, ULONG Flags)
+static inline struct threadpool_group *impl_from_TP_CLEANUP_GROUP( TP_CLEANUP_GROUP *group )
 {
-    HANDLE thread;
-    NTSTATUS status;
-    struct work_item *work_item = RtlAllocateHeap(GetProcessHeap(), 0, sizeof(struct work_item));
+    return (struct threadpool_group *)group;
+}
 
-    if (!work_item)
-        return STATUS_NO_MEMORY;
+static inline struct threadpool_object *impl_from_TP_WORK( TP_WORK *work )
+{
+    struct threadpool_object *object = (struct threadpool_object *)work;
+    assert( object->type == TP_OBJECT_TYPE_WORK );
+    return object;
+}
 
-    work_item->function = Function;
-    work_item->context = Context;
+static inline struct threadpool_object *impl_from_TP_TIMER( TP_TIMER *timer )
+{
+    struct threadpool_object *object = (struct threadpool_object *)timer;
+    assert( object->type == TP_OBJECT_TYPE_TIMER );
+    return object;
+}
 
-    if (Flags & ~WT_EXECUTELONGFUNCTION)
-        FIXME("Flags 0x%x not supported\n", Flags);
+static inline struct threadpool_object *impl_from_TP_WAIT( TP_WAIT *wait )
+{
+    struct threadpool_object *object = (struct threadpool_object *)wait;
+    assert( object->type == TP_OBJECT_TYPE_WAIT );
+    return object;
+}
 
-    status = add_work_item_to_queue(work_item);
+static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CALLBACK_INSTANCE *instance )
+{
+    return (struct threadpool_instance *)instance;
+}
 
-    /* FIXME: tune this algorithm to not be as aggressive with creating threads
-     * if WT_EXECUTELONGFUNCTION isn't specified */
-    if ((status == STATUS_SUCCESS) &&
-        ((num_workers == 0) || (num_workers == num_busy_workers)))
-    {
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE,
-                                    NULL, 0, 0,
-                                    worker_thread_proc, NULL, &thread, NULL );
-        if (status == STATUS_SUCCESS)
-            NtClose( thread );
+static inline void worker_lock( struct threadpool_worker *worker )
+{
+    while (interlocked_cmpxchg( &worker->lock, 1, 0 )) NtYieldExecution();
+}
 
-        /* NOTE: we don't care if we couldn't create the thread if there is at
-         * least one other available to process the request */
-        if ((num_workers > 0) && (status != STATUS_SUCCESS))
-            status = STATUS_SUCCESS;
-    }
+static inline void worker_unlock( struct threadpool_worker *worker )
+{
+    interlocked_xchg( &worker->lock, 0 );
+}
 
-    if (status != STATUS_SUCCESS)
+/* push onto the bottom of a worker deque, only called by its owner or with the pool lock held */
+static BOOL worker_push( struct threadpool_worker *worker, struct threadpool_object *object )
+{
+    BOOL ret = FALSE;
+
+    worker_lock( worker );
+    if (worker->count < WORKER_QUEUE_SIZE)
     {
-        RtlEnterCriticalSection(&threadpool_cs);
+        worker->deque[(worker->head + worker->count++) & (WORKER_QUEUE_SIZE - 1)] = object;
+        ret = TRUE;
+    }
+    worker_unlock( worker );
+    return ret;
+}
 
-        interlocked_dec(&num_work_items);
-        list_remove(&work_item->entry);
-        RtlFreeHeap(GetProcessHeap(), 0, work_item);
+/* pop the most recently pushed entry, only called by the owner */
+static struct threadpool_object *worker_pop( struct threadpool_worker *worker )
+{
+    struct threadpool_object *object = NULL;
+
+    if (!worker->count) return NULL;
+    worker_lock( worker );
+    if (worker->count)
+        object = worker->deque[(worker->head + --worker->count) & (WORKER_QUEUE_SIZE - 1)];
+    worker_unlock( worker );
+    return object;
+}
 
-        RtlLeaveCriticalSection(&threadpool_cs);
+/* take the oldest entry from another worker's deque, pool lock must be held */
+static struct threadpool_object *worker_steal( struct threadpool_worker *worker )
+{
+    struct threadpool_object *object = NULL;
 
-        return status;
+    if (!worker->count) return NULL;
+    worker_lock( worker );
+    if (worker->count)
+    {
+        object = worker->deque[worker->head];
+        worker->head = (worker->head + 1) & (WORKER_QUEUE_SIZE - 1);
+        worker->count--;
     }
+    worker_unlock( worker );
+    return object;
+}
+
+static NTSTATUS tp_pool_alloc( struct threadpool **out )
+{
+    struct threadpool *pool;
+
+    if (!(pool = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*pool) )))
+        return STATUS_NO_MEMORY;
+
+    pool->refcount    = 1;
+    pool->shutdown    = FALSE;
+    RtlInitializeCriticalSection( &pool->cs );
+    list_init( &pool->workers );
+    pool->max_workers = THREADPOOL_MAX_WORKERS;
+    pool->min_workers = 0;
 
+    TRACE( "allocated pool %p\n", pool );
+
+    *out = pool;
     return STATUS_SUCCESS;
 }
 
-/***********************************************************************
- * iocp_poller - get completion events and run callbacks
- */
-static DWORD CALLBACK iocp_poller(LPVOID Arg)
+static void tp_pool_release( struct threadpool *pool )
 {
-    while( TRUE )
-    {
-        PRTL_OVERLAPPED_COMPLETION_ROUTINE callback;
-        LPVOID overlapped;
-        IO_STATUS_BLOCK iosb;
-        NTSTATUS res = NtRemoveIoCompletion( compl_port, (PULONG_PTR)&callback, (PULONG_PTR)&overlapped, &iosb, NULL );
-        if (res)
-        {
-            ERR("NtRemoveIoCompletion failed: 0x%x\n", res);
-        }
-        else
-        {
-            DWORD transferred = 0;
-            DWORD err = 0;
+    if (interlocked_dec( &pool->refcount )) return;
 
-            if (iosb.u.Status == STATUS_SUCCESS)
-                transferred = iosb.Information;
-            else
-                err = RtlNtStatusToDosError(iosb.u.Status);
+    TRACE( "destroying pool %p\n", pool );
 
-            callback( err, transferred, overlapped );
-        }
-    }
-    return 0;
+    assert( pool->shutdown );
+    assert( list_empty( &pool->workers ) );
+    assert( !pool->queue_count );
+
+    RtlDeleteCriticalSection( &pool->cs );
+    RtlFreeHeap( GetProcessHeap(), 0, pool->queue );
+    RtlFreeHeap( GetProcessHeap(), 0, pool );
 }
 
-/***********************************************************************
- *              RtlSetIoCompletionCallback  (NTDLL.@)
- *
- * Binds a handle to a thread pool's completion port, and possibly
- * starts a non-I/O thread to monitor this port and call functions back.
- *
- * PARAMS
- *  FileHandle [I] Handle to bind to a completion port.
- *  Function   [I] Callback function to call on I/O completions.
- *  Flags      [I] Not used.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- *
- */
-NTSTATUS WINAPI RtlSetIoCompletionCallback(HANDLE FileHandle, PRTL_OVERLAPPED_COMPLETION_ROUTINE Function, ULONG Flags)
+static NTSTATUS tp_pool_get_default( struct threadpool **out )
 {
-    IO_STATUS_BLOCK iosb;
-    FILE_COMPLETION_INFORMATION info;
-
-    if (Flags) FIXME("Unknown value Flags=0x%x\n", Flags);
+    struct threadpool *pool;
+    NTSTATUS status;
 
-    if (!compl_port)
+    if (!default_threadpool)
     {
-        NTSTATUS res = STATUS_SUCCESS;
-
-        RtlEnterCriticalSection(&threadpool_compl_cs);
-        if (!compl_port)
+        if ((status = tp_pool_alloc( &pool ))) return status;
+        if (interlocked_cmpxchg_ptr( (void **)&default_threadpool, pool, NULL ))
         {
-            HANDLE cport;
-
-            res = NtCreateIoCompletion( &cport, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
-            if (!res)
-            {
-                /* FIXME native can start additional threads in case of e.g. hung callback function. */
-                res = RtlQueueWorkItem( iocp_poller, NULL, WT_EXECUTEDEFAULT );
-                if (!res)
-                    compl_port = cport;
-                else
-                    NtClose( cport );
-            }
+            /* somebody beat us to it */
+            pool->shutdown = TRUE;
+            tp_pool_release( pool );
         }
-        RtlLeaveCriticalSection(&threadpool_compl_cs);
-        if (res) return res;
     }
-
-    info.CompletionPort = compl_port;
-    info.CompletionKey = (ULONG_PTR)Function;
-
-    return NtSetInformationFile( FileHandle, &iosb, &info, sizeof(info), FileCompletionInformation );
+    *out = default_threadpool;
+    return STATUS_SUCCESS;
 }
 
-static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout )
+/* append to the injection queue, pool lock must be held */
+static NTSTATUS tp_pool_queue_push( struct threadpool *pool, struct threadpool_object *object )
 {
-    if (timeout == INFINITE) return NULL;
-    pTime->QuadPart = (ULONGLONG)timeout * -10000;
-    return pTime;
+    if (pool->queue_count == pool->queue_size)
+    {
+        unsigned int i, size = max( 64, pool->queue_size * 2 );
+        struct threadpool_object **queue;
+
+        if (!(queue = RtlAllocateHeap( GetProcessHeap(), 0, size * sizeof(*queue) )))
+            return STATUS_NO_MEMORY;
+        for (i = 0; i < pool->queue_count; i++)
+            queue[i] = pool->queue[(pool->queue_head + i) % pool->queue_size];
+        RtlFreeHeap( GetProcessHeap(), 0, pool->queue );
+        pool->queue      = queue;
+        pool->queue_head = 0;
+        pool->queue_size = size;
+    }
+    pool->queue[(pool->queue_head + pool->queue_count++) % pool->queue_size] = object;
+    return STATUS_SUCCESS;
 }
 
-struct wait_work_item
+/* remove the oldest entry of the injection queue, pool lock must be held */
+static struct threadpool_object *tp_pool_queue_pop( struct threadpool *pool )
 {
-    HANDLE Object;
-    HANDLE CancelEvent;
-    WAITORTIMERCALLBACK Callback;
-    PVOID Context;
-    ULONG Milliseconds;
-    ULONG Flags;
-    HANDLE CompletionEvent;
-    LONG DeleteCount;
-    BOOLEAN CallbackInProgress;
-};
+    struct threadpool_object *object;
 
-static void delete_wait_work_item(struct wait_work_item *wait_work_item)
-{
-    NtClose( wait_work_item->CancelEvent );
-    RtlFreeHeap( GetProcessHeap(), 0, wait_work_item );
+    if (!pool->queue_count) return NULL;
+    object = pool->queue[pool->queue_head];
+    pool->queue_head = (pool->queue_head + 1) % pool->queue_size;
+    pool->queue_count--;
+    return object;
 }
 
-static DWORD CALLBACK wait_thread_proc(LPVOID Arg)
+static void CALLBACK threadpool_worker_proc( void *param );
+
+/* start a new worker thread, pool lock must be held */
+static NTSTATUS tp_pool_spawn_worker( struct threadpool *pool )
 {
-    struct wait_work_item *wait_work_item = Arg;
+    struct threadpool_worker *worker;
+    HANDLE thread;
     NTSTATUS status;
-    BOOLEAN alertable = (wait_work_item->Flags & WT_EXECUTEINIOTHREAD) != 0;
-    HANDLE handles[2] = { wait_work_item->Object, wait_work_item->CancelEvent };
-    LARGE_INTEGER timeout;
-    HANDLE completion_event;
 
-    TRACE("\n");
+    if (!(worker = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*worker) )))
+        return STATUS_NO_MEMORY;
+    worker->pool = pool;
 
-    while (TRUE)
+    status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                  threadpool_worker_proc, worker, &thread, NULL );
+    if (status)
     {
-        status = NtWaitForMultipleObjects( 2, handles, FALSE, alertable,
-                                           get_nt_timeout( &timeout, wait_work_item->Milliseconds ) );
-        if (status == STATUS_WAIT_0 || status == STATUS_TIMEOUT)
-        {
-            BOOLEAN TimerOrWaitFired;
+        RtlFreeHeap( GetProcessHeap(), 0, worker );
+        return status;
+    }
 
-            if (status == STATUS_WAIT_0)
-            {
-                TRACE( "object %p signaled, calling callback %p with context %p\n",
-                    wait_work_item->Object, wait_work_item->Callback,
-                    wait_work_item->Context );
-                TimerOrWaitFired = FALSE;
-            }
-            else
-            {
-                TRACE( "wait for object %p timed out, calling callback %p with context %p\n",
-                    wait_work_item->Object, wait_work_item->Callback,
-                    wait_work_item->Context );
-                TimerOrWaitFired = TRUE;
-            }
-            wait_work_item->CallbackInProgress = TRUE;
-            wait_work_item->Callback( wait_work_item->Context, TimerOrWaitFired );
-            wait_work_item->CallbackInProgress = FALSE;
+    interlocked_inc( &pool->refcount );
+    list_add_tail( &pool->workers, &worker->entry );
+    pool->num_workers++;
+    NtClose( thread );
+    return STATUS_SUCCESS;
+}
 
-            if (wait_work_item->Flags & WT_EXECUTEONLYONCE)
-                break;
-        }
-        else
-            break;
+static inline BOOL tp_pool_needs_worker( struct threadpool *pool )
+{
+    return !pool->num_idle && pool->num_busy >= pool->num_workers &&
+           pool->num_workers < pool->max_workers;
+}
+
+/* make sure somebody picks up a newly queued callback; a worker that is
+ * neither idle nor busy is about to look for work and will find it */
+static void tp_pool_wake( struct threadpool *pool )
+{
+    if (interlocked_dec_if_nonzero( &pool->num_idle ))
+    {
+        NtReleaseKeyedEvent( keyed_event, &pool->num_idle, FALSE, NULL );
+        return;
     }
+    if (!tp_pool_needs_worker( pool )) return;
 
-    completion_event = wait_work_item->CompletionEvent;
-    if (completion_event) NtSetEvent( completion_event, NULL );
+    RtlEnterCriticalSection( &pool->cs );
+    if (tp_pool_needs_worker( pool )) tp_pool_spawn_worker( pool );
+    RtlLeaveCriticalSection( &pool->cs );
+}
 
-    if (interlocked_inc( &wait_work_item->DeleteCount ) == 2 )
-        delete_wait_work_item( wait_work_item );
+static void tp_pool_shutdown( struct threadpool *pool )
+{
+    assert( pool != default_threadpool );
 
-    return 0;
+    pool->shutdown = TRUE;
+    while (interlocked_dec_if_nonzero( &pool->num_idle ))
+        NtReleaseKeyedEvent( keyed_event, &pool->num_idle, FALSE, NULL );
 }
 
-/***********************************************************************
- *              RtlRegisterWait   (NTDLL.@)
- *
- * Registers a wait for a handle to become signaled.
- *
- * PARAMS
- *  NewWaitObject [I] Handle to the new wait object. Use RtlDeregisterWait() to free it.
- *  Object   [I] Object to wait to become signaled.
- *  Callback [I] Callback function to execute when the wait times out or the handle is signaled.
- *  Context  [I] Context to pass to the callback function when it is executed.
- *  Milliseconds [I] Number of milliseconds to wait before timing out.
- *  Flags    [I] Flags. See notes.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- *
- * NOTES
- *  Flags can be one or more of the following:
- *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
- *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
- *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
- *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
- *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
- */
-NTSTATUS WINAPI RtlRegisterWait(PHANDLE NewWaitObject, HANDLE Object,
-                                RTL_WAITORTIMERCALLBACKFUNC Callback,
-                                PVOID Context, ULONG Milliseconds, ULONG Flags)
+static void tp_group_release( struct threadpool_group *group )
 {
-    struct wait_work_item *wait_work_item;
-    NTSTATUS status;
+    if (interlocked_dec( &group->refcount )) return;
 
-    TRACE( "(%p, %p, %p, %p, %d, 0x%x)\n", NewWaitObject, Object, Callback, Context, Milliseconds, Flags );
+    TRACE( "destroying group %p\n", group );
 
-    wait_work_item = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*wait_work_item) );
-    if (!wait_work_item)
-        return STATUS_NO_MEMORY;
+    assert( group->shutdown );
+    assert( list_empty( &group->members ) );
 
-    wait_work_item->Object = Object;
-    wait_work_item->Callback = Callback;
-    wait_work_item->Context = Context;
-    wait_work_item->Milliseconds = Milliseconds;
-    wait_work_item->Flags = Flags;
-    wait_work_item->CallbackInProgress = FALSE;
-    wait_work_item->DeleteCount = 0;
-    wait_work_item->CompletionEvent = NULL;
+    RtlDeleteCriticalSection( &group->cs );
+    RtlFreeHeap( GetProcessHeap(), 0, group );
+}
 
-    status = NtCreateEvent( &wait_work_item->CancelEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
-    if (status != STATUS_SUCCESS)
+/* remove an object from its cleanup group, if it is still a member */
+static void tp_group_remove( struct threadpool_object *object )
+{
+    struct threadpool_group *group = object->group;
+
+    if (!group) return;
+    RtlEnterCriticalSection( &group->cs );
+    if (object->is_group_member)
     {
-        RtlFreeHeap( GetProcessHeap(), 0, wait_work_item );
-        return status;
+        list_remove( &object->group_entry );
+        object->is_group_member = FALSE;
     }
+    RtlLeaveCriticalSection( &group->cs );
+}
 
-    Flags = Flags & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD |
-                     WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION);
-    status = RtlQueueWorkItem( wait_thread_proc, wait_work_item, Flags );
-    if (status != STATUS_SUCCESS)
-    {
-        delete_wait_work_item( wait_work_item );
-        return status;
-    }
-
-    *NewWaitObject = wait_work_item;
-    return status;
+static void CALLBACK persistent_thread_proc( void *param )
+{
+    for (;;) NtDelayExecution( TRUE, NULL );
 }
 
-/***********************************************************************
- *              RtlDeregisterWaitEx   (NTDLL.@)
- *
- * Cancels a wait operation and frees the resources associated with calling
- * RtlRegisterWait().
- *
- * PARAMS
- *  WaitObject [I] Handle to the wait object to free.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- */
-NTSTATUS WINAPI RtlDeregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent)
+/* get the thread that never exits, for callbacks that queue APCs to their own thread */
+static NTSTATUS tp_get_persistent_thread( HANDLE *thread )
 {
-    struct wait_work_item *wait_work_item = WaitHandle;
     NTSTATUS status = STATUS_SUCCESS;
 
-    TRACE( "(%p)\n", WaitHandle );
+    RtlEnterCriticalSection( &threadpool_compl_cs );
+    if (!persistent_thread)
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      persistent_thread_proc, NULL, &persistent_thread, NULL );
+    *thread = persistent_thread;
+    RtlLeaveCriticalSection( &threadpool_compl_cs );
+    return status;
+}
 
-    NtSetEvent( wait_work_item->CancelEvent, NULL );
-    if (wait_work_item->CallbackInProgress)
+/* fill in the common fields of a new object; type and callback are set by the caller */
+static NTSTATUS tp_object_initialize( struct threadpool_object *object, PVOID userdata,
+                                      TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool *pool = NULL;
+    NTSTATUS status;
+
+    object->refcount              = 1;
+    object->shutdown              = FALSE;
+    object->userdata              = userdata;
+    object->group                 = NULL;
+    object->group_cancel_callback = NULL;
+    object->finalization_callback = NULL;
+    object->may_run_long          = FALSE;
+    object->apc_thread            = NULL;
+    object->race_dll              = NULL;
+    object->is_group_member       = FALSE;
+    object->num_pending           = 0;
+    object->num_running           = 0;
+    object->num_waiters           = 0;
+
+    if (environment)
     {
-        if (CompletionEvent != NULL)
-        {
-            if (CompletionEvent == INVALID_HANDLE_VALUE)
-            {
-                status = NtCreateEvent( &CompletionEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
-                if (status != STATUS_SUCCESS)
-                    return status;
-                interlocked_xchg_ptr( &wait_work_item->CompletionEvent, CompletionEvent );
-                if (wait_work_item->CallbackInProgress)
-                    NtWaitForSingleObject( CompletionEvent, FALSE, NULL );
-                NtClose( CompletionEvent );
-            }
-            else
-            {
-                interlocked_xchg_ptr( &wait_work_item->CompletionEvent, CompletionEvent );
-                if (wait_work_item->CallbackInProgress)
-                    status = STATUS_PENDING;
-            }
-        }
-        else
-            status = STATUS_PENDING;
+        if (environment->Version != 1)
+            FIXME( "unsupported environment version %u\n", environment->Version );
+        pool = impl_from_TP_POOL( environment->Pool );
+        object->group                 = impl_from_TP_CLEANUP_GROUP( environment->CleanupGroup );
+        object->group_cancel_callback = environment->CleanupGroupCancelCallback;
+        object->finalization_callback = environment->FinalizationCallback;
+        object->may_run_long          = environment->u.s.LongFunction != 0;
+        object->race_dll              = environment->RaceDll;
+
+        if (environment->ActivationContext)
+            FIXME( "activation context not supported yet\n" );
+        if (environment->u.s.Persistent && (status = tp_get_persistent_thread( &object->apc_thread )))
+            return status;
     }
 
-    if (interlocked_inc( &wait_work_item->DeleteCount ) == 2 )
+    if (!pool && (status = tp_pool_get_default( &pool ))) return status;
+    interlocked_inc( &pool->refcount );
+    object->pool = pool;
+
+    if (object->race_dll)
+        LdrAddRefDll( 0, object->race_dll );
+
+    if (object->group)
     {
-        status = STATUS_SUCCESS;
-        delete_wait_work_item( wait_work_item );
+        struct threadpool_group *group = object->group;
+        interlocked_inc( &group->refcount );
+
+        RtlEnterCriticalSection( &group->cs );
+        list_add_tail( &group->members, &object->group_entry );
+        object->is_group_member = TRUE;
+        RtlLeaveCriticalSection( &group->cs );
     }
 
-    return status;
+    TRACE( "allocated object %p of type %u\n", object, object->type );
+    return STATUS_SUCCESS;
 }
 
-/***********************************************************************
- *              RtlDeregisterWait   (NTDLL.@)
- *
- * Cancels a wait operation and frees the resources associated with calling
- * RtlRegisterWait().
- *
- * PARAMS
- *  WaitObject [I] Handle to the wait object to free.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- */
-NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
+static BOOL tp_object_release( struct threadpool_object *object )
 {
-    return RtlDeregisterWaitEx(WaitHandle, NULL);
-}
+    if (interlocked_dec( &object->refcount )) return FALSE;
 
+    TRACE( "destroying object %p of type %u\n", object, object->type );
 
-/************************** Timer Queue Impl **************************/
+    assert( object->shutdown );
+    assert( !object->is_group_member );
+    assert( !object->num_pending && !object->num_running );
 
-struct timer_queue;
-struct queue_timer
-{
-    struct timer_queue *q;
-    struct list entry;
-    ULONG runcount;             /* number of callbacks pending execution */
-    RTL_WAITORTIMERCALLBACKFUNC callback;
-    PVOID param;
-    DWORD period;
-    ULONG flags;
-    ULONGLONG expire;
-    BOOL destroy;      /* timer should be deleted; once set, never unset */
-    HANDLE event;      /* removal event */
-};
+    if (object->type == TP_OBJECT_TYPE_WAIT && object->u.wait.completion_event)
+        NtSetEvent( object->u.wait.completion_event, NULL );
 
-struct timer_queue
-{
-    DWORD magic;
-    RTL_CRITICAL_SECTION cs;
-    struct list timers;          /* sorted by expiration time */
-    BOOL quit;         /* queue should be deleted; once set, never unset */
-    HANDLE event;
-    HANDLE thread;
-};
+    if (object->group) tp_group_release( object->group );
+    tp_pool_release( object->pool );
+    if (object->race_dll) LdrUnloadDll( object->race_dll );
 
-#define EXPIRE_NEVER (~(ULONGLONG) 0)
-#define TIMER_QUEUE_MAGIC 0x516d6954  /* TimQ */
+    RtlFreeHeap( GetProcessHeap(), 0, object );
+    return TRUE;
+}
 
-static void queue_remove_timer(struct queue_timer *t)
+static void CALLBACK tp_object_apc( ULONG_PTR arg1, ULONG_PTR arg2, ULONG_PTR arg3 );
+
+/* queue one callback of the object */
+static NTSTATUS tp_object_submit( struct threadpool_object *object )
 {
-    /* We MUST hold the queue cs while calling this function.  This ensures
-       that we cannot queue another callback for this timer.  The runcount
-       being zero makes sure we don't have any already queued.  */
-    struct timer_queue *q = t->q;
+    struct threadpool_worker *worker = ntdll_get_thread_data()->threadpool_worker;
+    struct threadpool *pool = object->pool;
+    NTSTATUS status = STATUS_SUCCESS;
 
-    assert(t->runcount == 0);
-    assert(t->destroy);
+    /* the queued entry keeps a reference until it is dequeued */
+    interlocked_inc( &object->refcount );
+    interlocked_inc( &object->num_pending );
 
-    list_remove(&t->entry);
-    if (t->event)
-        NtSetEvent(t->event, NULL);
-    RtlFreeHeap(GetProcessHeap(), 0, t);
+    if (object->apc_thread)
+    {
+        status = NtQueueApcThread( object->apc_thread, tp_object_apc, (ULONG_PTR)object, 0, 0 );
+        if (status)
+        {
+            interlocked_dec_if_nonzero( &object->num_pending );
+            tp_object_release( object );
+        }
+        return status;
+    }
 
-    if (q->quit && list_empty(&q->timers))
-        NtSetEvent(q->event, NULL);
-}
+    interlocked_inc( &pool->num_queued );
 
-static void timer_cleanup_callback(struct queue_timer *t)
-{
-    struct timer_queue *q = t->q;
-    RtlEnterCriticalSection(&q->cs);
+    if (!worker || worker->pool != pool || !worker_push( worker, object ))
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        status = tp_pool_queue_push( pool, object );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
 
-    assert(0 < t->runcount);
-    --t->runcount;
+    if (status)
+    {
+        interlocked_dec( &pool->num_queued );
+        interlocked_dec_if_nonzero( &object->num_pending );
+        tp_object_release( object );
+        return status;
+    }
 
-    if (t->destroy && t->runcount == 0)
-        queue_remove_timer(t);
+    tp_pool_wake( pool );
+    return STATUS_SUCCESS;
+}
 
-    RtlLeaveCriticalSection(&q->cs);
+static inline BOOL tp_object_is_idle( struct threadpool_object *object )
+{
+    return !object->num_pending && !object->num_running;
 }
 
-static DWORD WINAPI timer_callback_wrapper(LPVOID p)
+static void tp_object_wake_waiters( struct threadpool_object *object )
 {
-    struct queue_timer *t = p;
-    t->callback(t->param, TRUE);
-    timer_cleanup_callback(t);
-    return 0;
+    while (interlocked_dec_if_nonzero( &object->num_waiters ))
+        NtReleaseKeyedEvent( keyed_event, &object->num_waiters, FALSE, NULL );
 }
 
-static inline ULONGLONG queue_current_time(void)
+static void tp_object_callback_done( struct threadpool_object *object )
 {
-    LARGE_INTEGER now, freq;
-    NtQueryPerformanceCounter(&now, &freq);
-    return now.QuadPart * 1000 / freq.QuadPart;
+    if (!interlocked_dec( &object->num_running ) && !object->num_pending)
+        tp_object_wake_waiters( object );
 }
 
-static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
-                            BOOL set_event)
+/* cancel the callbacks that did not start yet */
+static void tp_object_cancel( struct threadpool_object *object )
 {
-    /* We MUST hold the queue cs while calling this function.  */
-    struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
+    if (interlocked_xchg( &object->num_pending, 0 ) && !object->num_running)
+        tp_object_wake_waiters( object );
+}
 
-    assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
+/* wait until all posted callbacks have completed */
+static void tp_object_wait( struct threadpool_object *object )
+{
+    while (!tp_object_is_idle( object ))
+    {
+        interlocked_inc( &object->num_waiters );
+        if (tp_object_is_idle( object ) && interlocked_dec_if_nonzero( &object->num_waiters )) break;
+        NtWaitForKeyedEvent( keyed_event, &object->num_waiters, FALSE, NULL );
+    }
+}
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
+static void tp_timer_disarm( struct threadpool_object *timer );
+static void tp_wait_disarm( struct threadpool_object *wait );
+static void tp_wait_arm( struct threadpool_object *wait, HANDLE handle, ULONGLONG timeout );
+static void tp_waitqueue_unlock( struct threadpool_object *wait );
+
+/* stop the object from generating new callbacks */
+static void tp_object_prepare_shutdown( struct threadpool_object *object )
+{
+    switch (object->type)
+    {
+    case TP_OBJECT_TYPE_TIMER:
+        RtlEnterCriticalSection( &timerqueue_cs );
+        object->shutdown = TRUE;
+        tp_timer_disarm( object );
+        object->u.timer.timer_set = FALSE;
+        RtlLeaveCriticalSection( &timerqueue_cs );
+        break;
+    case TP_OBJECT_TYPE_WAIT:
+        RtlEnterCriticalSection( &waitqueue_cs );
+        if (!object->shutdown)
         {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
+            object->shutdown = TRUE;
+            tp_waitqueue_unlock( object );
         }
-    list_add_before(ptr, &t->entry);
-
-    t->expire = time;
+        RtlLeaveCriticalSection( &waitqueue_cs );
+        break;
+    default:
+        object->shutdown = TRUE;
+        break;
+    }
+}
 
-    /* If we insert at the head of the list, we need to expire sooner
-       than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
-        NtSetEvent(q->event, NULL);
+/* release the reference held by the application */
+static void tp_object_close( struct threadpool_object *object )
+{
+    tp_group_remove( object );
+    tp_object_prepare_shutdown( object );
+    tp_object_release( object );
 }
 
-static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
-                                    BOOL set_event)
+/* post a simple callback; the initial reference is kept by the cleanup group, if any */
+static NTSTATUS tp_simple_submit( struct threadpool_object *object )
 {
-    /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
-    queue_add_timer(t, time, set_event);
+    NTSTATUS status;
+
+    object->shutdown = TRUE;
+    if ((status = tp_object_submit( object ))) tp_group_remove( object );
+    if (status || !object->group) tp_object_release( object );
+    return status;
 }
 
-static void queue_timer_expire(struct timer_queue *q)
+static void tp_object_execute( struct threadpool_object *object )
 {
-    struct queue_timer *t = NULL;
+    struct threadpool_instance instance;
+    TP_CALLBACK_INSTANCE *callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
 
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    instance.object       = object;
+    instance.threadid     = GetCurrentThreadId();
+    instance.associated   = TRUE;
+    instance.may_run_long = object->may_run_long;
+    memset( &instance.cleanup, 0, sizeof(instance.cleanup) );
+
+    switch (object->type)
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+    case TP_OBJECT_TYPE_SIMPLE:
+        if (object->u.simple.function)
         {
-            ++t->runcount;
-            if (t->period)
+            TRACE( "executing work item %p(%p)\n", object->u.simple.function, object->userdata );
+            object->u.simple.function( object->userdata );
+        }
+        else
+        {
+            TRACE( "executing simple callback %p(%p, %p)\n",
+                   object->u.simple.callback, callback_instance, object->userdata );
+            object->u.simple.callback( callback_instance, object->userdata );
+        }
+        break;
+
+    case TP_OBJECT_TYPE_WORK:
+        TRACE( "executing work callback %p(%p, %p, %p)\n",
+               object->u.work.callback, callback_instance, object->userdata, object );
+        object->u.work.callback( callback_instance, object->userdata, (TP_WORK *)object );
+        break;
+
+    case TP_OBJECT_TYPE_TIMER:
+        TRACE( "executing timer callback %p(%p, %p, %p)\n",
+               object->u.timer.callback, callback_instance, object->userdata, object );
+        object->u.timer.callback( callback_instance, object->userdata, (TP_TIMER *)object );
+        break;
+
+    case TP_OBJECT_TYPE_WAIT:
+        if (object->u.wait.function)
+        {
+            BOOLEAN timed_out = (object->u.wait.result == STATUS_TIMEOUT);
+            TRACE( "executing wait callback %p(%p, %u)\n",
+                   object->u.wait.function, object->userdata, timed_out );
+            object->u.wait.function( object->userdata, timed_out );
+
+            /* RtlRegisterWait callbacks run one at a time, wait again once done */
+            if (!(object->u.wait.flags & WT_EXECUTEONLYONCE))
             {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
+                LARGE_INTEGER now;
+                ULONGLONG timeout = TIMEOUT_INFINITE;
+
+                if (object->u.wait.milliseconds != INFINITE)
+                {
+                    NtQuerySystemTime( &now );
+                    timeout = now.QuadPart + (ULONGLONG)object->u.wait.milliseconds * 10000;
+                }
+                tp_wait_arm( object, object->u.wait.handle, timeout );
             }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
         }
         else
-            t = NULL;
+        {
+            TRACE( "executing wait callback %p(%p, %p, %p, %08x)\n", object->u.wait.callback,
+                   callback_instance, object->userdata, object, object->u.wait.result );
+            object->u.wait.callback( callback_instance, object->userdata,
+                                     (TP_WAIT *)object, object->u.wait.result );
+        }
+        break;
     }
-    RtlLeaveCriticalSection(&q->cs);
 
-    if (t)
+    if (object->finalization_callback)
     {
-        if (t->flags & WT_EXECUTEINTIMERTHREAD)
-            timer_callback_wrapper(t);
-        else
-        {
-            ULONG flags
-                = (t->flags
-                   & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
-                      | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
-            NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
-            if (status != STATUS_SUCCESS)
-                timer_cleanup_callback(t);
-        }
+        TRACE( "executing finalization callback %p(%p, %p)\n",
+               object->finalization_callback, callback_instance, object->userdata );
+        object->finalization_callback( callback_instance, object->userdata );
     }
+
+    /* perform the cleanup actions requested by the callback */
+    if (instance.cleanup.critical_section)
+        RtlLeaveCriticalSection( instance.cleanup.critical_section );
+    if (instance.cleanup.mutex)
+        NtReleaseMutant( instance.cleanup.mutex, NULL );
+    if (instance.cleanup.semaphore)
+        NtReleaseSemaphore( instance.cleanup.semaphore, instance.cleanup.semaphore_count, NULL );
+    if (instance.cleanup.event)
+        NtSetEvent( instance.cleanup.event, NULL );
+    if (instance.cleanup.library)
+        LdrUnloadDll( instance.cleanup.library );
+
+    if (instance.associated) tp_object_callback_done( object );
 }
 
-static ULONG queue_get_timeout(struct timer_queue *q)
+/* run a callback queued to the object's own thread */
+static void CALLBACK tp_object_apc( ULONG_PTR arg1, ULONG_PTR arg2, ULONG_PTR arg3 )
 {
-    struct queue_timer *t;
-    ULONG timeout = INFINITE;
+    struct threadpool_object *object = (struct threadpool_object *)arg1;
+
+    interlocked_inc( &object->num_running );
+    if (interlocked_dec_if_nonzero( &object->num_pending ))
+        tp_object_execute( object );
+    else  /* cancelled */
+        tp_object_callback_done( object );
+    tp_object_release( object );
+}
 
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
-    {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
+/* find the next queued entry for a worker */
+static struct threadpool_object *tp_worker_next( struct threadpool_worker *worker )
+{
+    struct threadpool *pool = worker->pool;
+    struct threadpool_object *object;
+    struct threadpool_worker *other;
+    unsigned int batch;
 
-        if (t->expire != EXPIRE_NEVER)
+    if ((object = worker_pop( worker ))) return object;
+    if (pool->num_queued <= 0) return NULL;
+
+    RtlEnterCriticalSection( &pool->cs );
+    if ((object = tp_pool_queue_pop( pool )))
+    {
+        /* move part of the injection queue to our own deque, where idle
+         * workers can steal it without contending on the pool lock */
+        batch = min( (pool->queue_count + 1) / 2, WORKER_BATCH_SIZE );
+        while (batch--) worker_push( worker, tp_pool_queue_pop( pool ));
+    }
+    else
+    {
+        LIST_FOR_EACH_ENTRY( other, &pool->workers, struct threadpool_worker, entry )
         {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
+            if (other != worker && (object = worker_steal( other ))) break;
         }
     }
-    RtlLeaveCriticalSection(&q->cs);
-
-    return timeout;
+    RtlLeaveCriticalSection( &pool->cs );
+    return object;
 }
 
-static void WINAPI timer_queue_thread_proc(LPVOID p)
+static void CALLBACK threadpool_worker_proc( void *param )
 {
-    struct timer_queue *q = p;
-    ULONG timeout_ms;
+    struct threadpool_worker *worker = param;
+    struct threadpool *pool = worker->pool;
+    struct threadpool_object *object;
+    LARGE_INTEGER timeout;
+
+    TRACE( "starting worker %p for pool %p\n", worker, pool );
+
+    ntdll_get_thread_data()->threadpool_worker = worker;
 
-    timeout_ms = INFINITE;
     for (;;)
     {
-        LARGE_INTEGER timeout;
-        NTSTATUS status;
-        BOOL done = FALSE;
+        if ((object = tp_worker_next( worker )))
+        {
+            interlocked_dec( &pool->num_queued );
+            interlocked_inc( &object->num_running );
+            if (interlocked_dec_if_nonzero( &object->num_pending ))
+            {
+                interlocked_inc( &pool->num_busy );
+                tp_object_execute( object );
+                interlocked_dec( &pool->num_busy );
+            }
+            else  /* cancelled */
+                tp_object_callback_done( object );
+            tp_object_release( object );
+            continue;
+        }
 
-        status = NtWaitForSingleObject(
-            q->event, FALSE, get_nt_timeout(&timeout, timeout_ms));
+        /* nothing to do, wait until somebody queues a callback */
+        interlocked_inc( &pool->num_idle );
+        if (pool->num_queued <= 0 && !pool->shutdown)
+        {
+            timeout.QuadPart = -(WORKER_TIMEOUT * (ULONGLONG)10000);
+            if (NtWaitForKeyedEvent( keyed_event, &pool->num_idle, FALSE, &timeout ) != STATUS_TIMEOUT)
+                continue;
+        }
+        if (!interlocked_dec_if_nonzero( &pool->num_idle ))
+        {
+            /* somebody already decided to wake us up */
+            NtWaitForKeyedEvent( keyed_event, &pool->num_idle, FALSE, NULL );
+            continue;
+        }
+        if (pool->num_queued > 0) continue;
 
-        if (status == STATUS_WAIT_0)
+        RtlEnterCriticalSection( &pool->cs );
+        if (pool->num_queued <= 0 && (pool->shutdown || pool->num_workers > pool->min_workers))
         {
-            /* There are two possible ways to trigger the event.  Either
-               we are quitting and the last timer got removed, or a new
-               timer got put at the head of the list so we need to adjust
-               our timeout.  */
-            RtlEnterCriticalSection(&q->cs);
-            if (q->quit && list_empty(&q->timers))
-                done = TRUE;
-            RtlLeaveCriticalSection(&q->cs);
+            list_remove( &worker->entry );
+            pool->num_workers--;
+            RtlLeaveCriticalSection( &pool->cs );
+            break;
         }
-        else if (status == STATUS_TIMEOUT)
-            queue_timer_expire(q);
+        RtlLeaveCriticalSection( &pool->cs );
+    }
 
-        if (done)
+    TRACE( "terminating worker %p for pool %p\n", worker, pool );
+
+    ntdll_get_thread_data()->threadpool_worker = NULL;
+    RtlFreeHeap( GetProcessHeap(), 0, worker );
+    tp_pool_release( pool );
+    RtlExitUserThread( 0 );
+}
+
+/* insert a timer in the sorted timer list, timerqueue_cs must be held */
+static void tp_timer_insert( struct threadpool_object *timer )
+{
+    struct threadpool_object *other;
+    struct list *ptr;
+
+    LIST_FOR_EACH( ptr, &timer_list )
+    {
+        other = LIST_ENTRY( ptr, struct threadpool_object, u.timer.entry );
+        if (timer->u.timer.timeout < other->u.timer.timeout) break;
+    }
+    list_add_before( ptr, &timer->u.timer.entry );
+    timer->u.timer.timer_pending = TRUE;
+
+    if (list_head( &timer_list ) == &timer->u.timer.entry)
+        NtSetEvent( timer_update_event, NULL );
+}
+
+/* timerqueue_cs must be held */
+static void tp_timer_disarm( struct threadpool_object *timer )
+{
+    if (!timer->u.timer.timer_pending) return;
+    list_remove( &timer->u.timer.entry );
+    timer->u.timer.timer_pending = FALSE;
+}
+
+/*
+ * A single thread serves the timers of all pools.  It sleeps until the
+ * earliest end of a timer window, and then expires every timer that is
+ * due, so that timers with overlapping windows share one wake up.
+ */
+static void CALLBACK timerqueue_thread_proc( void *param )
+{
+    struct threadpool_object *timer;
+    ULONGLONG wake, period;
+    LARGE_INTEGER now, timeout;
+    struct list *ptr;
+
+    TRACE( "starting timer queue thread\n" );
+
+    for (;;)
+    {
+        NtQuerySystemTime( &now );
+
+        RtlEnterCriticalSection( &timerqueue_cs );
+        while ((ptr = list_head( &timer_list )))
+        {
+            timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.entry );
+            if (timer->u.timer.timeout > now.QuadPart) break;
+
+            tp_timer_disarm( timer );
+            if (timer->u.timer.period)
+            {
+                period = (ULONGLONG)timer->u.timer.period * 10000;
+                timer->u.timer.timeout += period;
+                if (timer->u.timer.timeout <= now.QuadPart)
+                    timer->u.timer.timeout = now.QuadPart + period;
+                tp_timer_insert( timer );
+            }
+            tp_object_submit( timer );
+        }
+
+        wake = TIMEOUT_INFINITE;
+        LIST_FOR_EACH_ENTRY( timer, &timer_list, struct threadpool_object, u.timer.entry )
+        {
+            if (timer->u.timer.timeout >= wake) break;
+            wake = min( wake, timer->u.timer.timeout + (ULONGLONG)timer->u.timer.window * 10000 );
+        }
+        RtlLeaveCriticalSection( &timerqueue_cs );
+
+        timeout.QuadPart = wake;
+        NtWaitForSingleObject( timer_update_event, FALSE, wake == TIMEOUT_INFINITE ? NULL : &timeout );
+    }
+}
+
+/* make sure the timer thread is running */
+static NTSTATUS tp_timerqueue_init(void)
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    HANDLE thread;
+
+    RtlEnterCriticalSection( &timerqueue_cs );
+    if (!timer_update_event)
+    {
+        status = NtCreateEvent( &timer_update_event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE );
+        if (!status)
+        {
+            status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                          timerqueue_thread_proc, NULL, &thread, NULL );
+            if (!status) NtClose( thread );
+            else
+            {
+                NtClose( timer_update_event );
+                timer_update_event = NULL;
+            }
+        }
+    }
+    RtlLeaveCriticalSection( &timerqueue_cs );
+    return status;
+}
+
+/* waitqueue_cs must be held */
+static void tp_wait_disarm( struct threadpool_object *wait )
+{
+    if (!wait->u.wait.wait_pending) return;
+    list_remove( &wait->u.wait.entry );
+    wait->u.wait.wait_pending = FALSE;
+    NtSetEvent( wait->u.wait.bucket->update_event, NULL );
+}
+
+static void tp_wait_arm( struct threadpool_object *wait, HANDLE handle, ULONGLONG timeout )
+{
+    RtlEnterCriticalSection( &waitqueue_cs );
+    if (!wait->shutdown)
+    {
+        tp_wait_disarm( wait );
+        wait->u.wait.handle  = handle;
+        wait->u.wait.timeout = timeout;
+        list_add_tail( &wait->u.wait.bucket->waiting, &wait->u.wait.entry );
+        wait->u.wait.wait_pending = TRUE;
+        NtSetEvent( wait->u.wait.bucket->update_event, NULL );
+    }
+    RtlLeaveCriticalSection( &waitqueue_cs );
+}
+
+/* disarm the wait and post its callback, waitqueue_cs must be held */
+static void tp_wait_fire( struct threadpool_object *wait, NTSTATUS result )
+{
+    list_remove( &wait->u.wait.entry );
+    wait->u.wait.wait_pending = FALSE;
+    wait->u.wait.result = result;
+    tp_object_submit( wait );
+}
+
+static BOOL tp_bucket_contains( struct waitqueue_bucket *bucket, struct threadpool_object *wait )
+{
+    struct threadpool_object *other;
+
+    LIST_FOR_EACH_ENTRY( other, &bucket->waiting, struct threadpool_object, u.wait.entry )
+        if (other == wait) return TRUE;
+    return FALSE;
+}
+
+/*
+ * Each wait thread serves up to WAIT_BUCKET_SIZE wait objects with a single
+ * NtWaitForMultipleObjects call; the last handle is the bucket's update
+ * event, signaled whenever a wait is armed or disarmed.
+ */
+static void CALLBACK waitqueue_thread_proc( void *param )
+{
+    struct waitqueue_bucket *bucket = param;
+    struct threadpool_object *objects[MAXIMUM_WAIT_OBJECTS];
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+    struct threadpool_object *wait, *next;
+    LARGE_INTEGER now, timeout, zero, *ptimeout;
+    ULONGLONG wake;
+    NTSTATUS status;
+    DWORD i, count;
+
+    TRACE( "starting wait queue thread for bucket %p\n", bucket );
+
+    zero.QuadPart = 0;
+    RtlEnterCriticalSection( &waitqueue_cs );
+    for (;;)
+    {
+        NtQuerySystemTime( &now );
+        wake  = TIMEOUT_INFINITE;
+        count = 0;
+
+        LIST_FOR_EACH_ENTRY_SAFE( wait, next, &bucket->waiting, struct threadpool_object, u.wait.entry )
+        {
+            if (wait->u.wait.timeout <= now.QuadPart)
+            {
+                status = NtWaitForSingleObject( wait->u.wait.handle, FALSE, &zero );
+                if (status != STATUS_WAIT_0 && status != STATUS_ABANDONED_WAIT_0)
+                    status = STATUS_TIMEOUT;
+                tp_wait_fire( wait, status );
+                continue;
+            }
+            wake = min( wake, wait->u.wait.timeout );
+            objects[count] = wait;
+            handles[count] = wait->u.wait.handle;
+            count++;
+        }
+        handles[count] = bucket->update_event;
+
+        ptimeout = &timeout;
+        if (!count && !bucket->objcount)
+            timeout.QuadPart = -(WAIT_BUCKET_TIMEOUT * (ULONGLONG)10000);
+        else if (wake != TIMEOUT_INFINITE)
+            timeout.QuadPart = wake;
+        else
+            ptimeout = NULL;
+        RtlLeaveCriticalSection( &waitqueue_cs );
+
+        /* alertable, for the WT_EXECUTEINWAITTHREAD callbacks queued by tp_wait_fire */
+        status = NtWaitForMultipleObjects( count + 1, handles, FALSE, TRUE, ptimeout );
+
+        RtlEnterCriticalSection( &waitqueue_cs );
+        if (status >= STATUS_WAIT_0 && status < STATUS_WAIT_0 + count)
+        {
+            wait = objects[status - STATUS_WAIT_0];
+            if (tp_bucket_contains( bucket, wait )) tp_wait_fire( wait, STATUS_WAIT_0 );
+        }
+        else if (status >= STATUS_ABANDONED_WAIT_0 && status < STATUS_ABANDONED_WAIT_0 + count)
+        {
+            wait = objects[status - STATUS_ABANDONED_WAIT_0];
+            if (tp_bucket_contains( bucket, wait )) tp_wait_fire( wait, STATUS_ABANDONED_WAIT_0 );
+        }
+        else if (status == STATUS_TIMEOUT && !bucket->objcount && list_empty( &bucket->waiting ))
+        {
             break;
+        }
+        else if (status != STATUS_WAIT_0 + count && status != STATUS_TIMEOUT && status != STATUS_USER_APC)
+        {
+            /* one of the handles is invalid, find out which */
+            for (i = 0; i < count; i++)
+            {
+                if (!tp_bucket_contains( bucket, objects[i] )) continue;
+                status = NtWaitForSingleObject( handles[i], FALSE, &zero );
+                if (status == STATUS_WAIT_0 || status == STATUS_ABANDONED_WAIT_0)
+                    tp_wait_fire( objects[i], status );
+                else if (status != STATUS_TIMEOUT)
+                {
+                    WARN( "wait on %p failed with status %08x\n", handles[i], status );
+                    list_remove( &objects[i]->u.wait.entry );
+                    objects[i]->u.wait.wait_pending = FALSE;
+                }
+            }
+        }
+    }
 
-        timeout_ms = queue_get_timeout(q);
+    TRACE( "terminating wait queue thread for bucket %p\n", bucket );
+
+    list_remove( &bucket->entry );
+    RtlLeaveCriticalSection( &waitqueue_cs );
+
+    NtClose( bucket->update_event );
+    RtlFreeHeap( GetProcessHeap(), 0, bucket );
+    RtlExitUserThread( 0 );
+}
+
+/* assign a new wait object to a bucket with a free slot */
+static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
+{
+    struct waitqueue_bucket *bucket;
+    NTSTATUS status = STATUS_SUCCESS;
+    HANDLE thread;
+
+    wait->u.wait.wait_pending = FALSE;
+    wait->u.wait.handle       = NULL;
+    wait->u.wait.timeout      = TIMEOUT_INFINITE;
+
+    RtlEnterCriticalSection( &waitqueue_cs );
+
+    LIST_FOR_EACH_ENTRY( bucket, &waitqueue_buckets, struct waitqueue_bucket, entry )
+    {
+        if (bucket->objcount < WAIT_BUCKET_SIZE) goto found;
     }
 
-    NtClose(q->event);
-    RtlDeleteCriticalSection(&q->cs);
-    q->magic = 0;
-    RtlFreeHeap(GetProcessHeap(), 0, q);
+    if (!(bucket = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*bucket) )))
+    {
+        status = STATUS_NO_MEMORY;
+        goto done;
+    }
+    bucket->objcount = 0;
+    list_init( &bucket->waiting );
+    status = NtCreateEvent( &bucket->update_event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE );
+    if (!status)
+    {
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      waitqueue_thread_proc, bucket, &thread, NULL );
+        if (status) NtClose( bucket->update_event );
+    }
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, bucket );
+        goto done;
+    }
+    NtClose( thread );
+    list_add_tail( &waitqueue_buckets, &bucket->entry );
+
+found:
+    bucket->objcount++;
+    wait->u.wait.bucket = bucket;
+done:
+    RtlLeaveCriticalSection( &waitqueue_cs );
+    return status;
 }
 
-static void queue_destroy_timer(struct queue_timer *t)
+/* give up the bucket slot of a wait object, waitqueue_cs must be held */
+static void tp_waitqueue_unlock( struct threadpool_object *wait )
 {
-    /* We MUST hold the queue cs while calling this function.  */
-    t->destroy = TRUE;
-    if (t->runcount == 0)
-        /* Ensure a timer is promptly removed.  If callbacks are pending,
-           it will be removed after the last one finishes by the callback
-           cleanup wrapper.  */
-        queue_remove_timer(t);
-    else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
-        queue_move_timer(t, EXPIRE_NEVER, FALSE);
+    struct waitqueue_bucket *bucket = wait->u.wait.bucket;
+
+    tp_wait_disarm( wait );
+    if (!--bucket->objcount) NtSetEvent( bucket->update_event, NULL );
+}
+
+#define WT_WORK_ITEM_FLAGS (WT_EXECUTEINIOTHREAD | WT_EXECUTEINUITHREAD | WT_EXECUTELONGFUNCTION | \
+                            WT_EXECUTEINPERSISTENTIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD | \
+                            WT_TRANSFER_IMPERSONATION)
+
+/* get the thread that runs the callbacks of a legacy API object, or NULL for the pool */
+static NTSTATUS get_legacy_apc_thread( ULONG flags, HANDLE *thread )
+{
+    *thread = NULL;
+    if (flags & WT_TRANSFER_IMPERSONATION)
+        FIXME( "WT_TRANSFER_IMPERSONATION not supported, callbacks use the process token\n" );
+
+    /* the pseudo handle is resolved by the wait thread when it posts the callback */
+    if (flags & WT_EXECUTEINWAITTHREAD)
+        *thread = GetCurrentThread();
+    /* pool workers exit when idle, so they can't receive the APCs of I/O callbacks */
+    else if (flags & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINUITHREAD |
+                      WT_EXECUTEINPERSISTENTIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD))
+        return tp_get_persistent_thread( thread );
+    return STATUS_SUCCESS;
 }
 
 /***********************************************************************
- *              RtlCreateTimerQueue   (NTDLL.@)
+ *              RtlQueueWorkItem   (NTDLL.@)
  *
- * Creates a timer queue object and returns a handle to it.
+ * Queues a work item into a thread in the thread pool.
  *
  * PARAMS
- *  NewTimerQueue [O] The newly created queue.
+ *  Function [I] Work function to execute.
+ *  Context  [I] Context to pass to the work function when it is executed.
+ *  Flags    [I] Flags. See notes.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ *
+ * NOTES
+ *  Flags can be one or more of the following:
+ *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
+ *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
+ *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
+ *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
+ *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
+ *
+ *  I/O and persistent work items all run in the same thread, which never exits.
+ */
+NTSTATUS WINAPI RtlQueueWorkItem(PRTL_WORK_ITEM_ROUTINE Function, PVOID Context, ULONG Flags)
+{
+    struct threadpool_object *object;
+    HANDLE apc_thread;
+    NTSTATUS status;
+
+    TRACE( "%p %p %u\n", Function, Context, Flags );
+
+    /* the high word is the thread limit set with WT_SET_MAX_THREADPOOL_THREADS */
+    Flags &= 0xffff;
+    if (Flags & ~WT_WORK_ITEM_FLAGS) FIXME( "unknown flags 0x%x\n", Flags & ~WT_WORK_ITEM_FLAGS );
+    if ((status = get_legacy_apc_thread( Flags, &apc_thread ))) return status;
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    object->type = TP_OBJECT_TYPE_SIMPLE;
+    object->u.simple.callback = NULL;
+    object->u.simple.function = Function;
+
+    if ((status = tp_object_initialize( object, Context, NULL )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+    object->may_run_long = (Flags & WT_EXECUTELONGFUNCTION) != 0;
+    object->apc_thread   = apc_thread;
+
+    return tp_simple_submit( object );
+}
+
+/***********************************************************************
+ * iocp_poller - get completion events and run callbacks
+ */
+static void CALLBACK iocp_poller( void *param )
+{
+    HANDLE port = param;
+
+    while( TRUE )
+    {
+        PRTL_OVERLAPPED_COMPLETION_ROUTINE callback;
+        LPVOID overlapped;
+        IO_STATUS_BLOCK iosb;
+        NTSTATUS res = NtRemoveIoCompletion( port, (PULONG_PTR)&callback, (PULONG_PTR)&overlapped, &iosb, NULL );
+        if (res)
+        {
+            ERR("NtRemoveIoCompletion failed: 0x%x\n", res);
+        }
+        else
+        {
+            DWORD transferred = 0;
+            DWORD err = 0;
+
+            if (iosb.u.Status == STATUS_SUCCESS)
+                transferred = iosb.Information;
+            else
+                err = RtlNtStatusToDosError(iosb.u.Status);
+
+            callback( err, transferred, overlapped );
+        }
+    }
+}
+
+/***********************************************************************
+ *              RtlSetIoCompletionCallback  (NTDLL.@)
+ *
+ * Binds a handle to a thread pool's completion port, and possibly
+ * starts a dedicated thread to monitor this port and call functions back.
+ *
+ * PARAMS
+ *  FileHandle [I] Handle to bind to a completion port.
+ *  Function   [I] Callback function to call on I/O completions.
+ *  Flags      [I] Reserved, must be 0.
  *
  * RETURNS
  *  Success: STATUS_SUCCESS.
  *  Failure: Any NTSTATUS code.
+ *
+ */
+NTSTATUS WINAPI RtlSetIoCompletionCallback(HANDLE FileHandle, PRTL_OVERLAPPED_COMPLETION_ROUTINE Function, ULONG Flags)
+{
+    IO_STATUS_BLOCK iosb;
+    FILE_COMPLETION_INFORMATION info;
+
+    if (Flags) return STATUS_INVALID_PARAMETER;
+
+    if (!compl_port)
+    {
+        NTSTATUS res = STATUS_SUCCESS;
+
+        RtlEnterCriticalSection(&threadpool_compl_cs);
+        if (!compl_port)
+        {
+            HANDLE cport, thread;
+
+            res = NtCreateIoCompletion( &cport, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+            if (!res)
+            {
+                /* the poller blocks forever, keep it out of the pool's workers */
+                /* FIXME native can start additional threads in case of e.g. hung callback function. */
+                res = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                           iocp_poller, cport, &thread, NULL );
+                if (!res)
+                {
+                    NtClose( thread );
+                    compl_port = cport;
+                }
+                else
+                    NtClose( cport );
+            }
+        }
+        RtlLeaveCriticalSection(&threadpool_compl_cs);
+        if (res) return res;
+    }
+
+    info.CompletionPort = compl_port;
+    info.CompletionKey = (ULONG_PTR)Function;
+
+    return NtSetInformationFile( FileHandle, &iosb, &info, sizeof(info), FileCompletionInformation );
+}
+
+static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout )
+{
+    if (timeout == INFINITE) return NULL;
+    pTime->QuadPart = (ULONGLONG)timeout * -10000;
+    return pTime;
+}
+
+/***********************************************************************
+ *              RtlRegisterWait   (NTDLL.@)
+ *
+ * Registers a wait for a handle to become signaled.
+ *
+ * PARAMS
+ *  NewWaitObject [I] Handle to the new wait object. Use RtlDeregisterWait() to free it.
+ *  Object   [I] Object to wait to become signaled.
+ *  Callback [I] Callback function to execute when the wait times out or the handle is signaled.
+ *  Context  [I] Context to pass to the callback function when it is executed.
+ *  Milliseconds [I] Number of milliseconds to wait before timing out.
+ *  Flags    [I] Flags. See notes.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ *
+ * NOTES
+ *  Flags can be one or more of the following:
+ *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
+ *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
+ *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
+ *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
+ *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
+ *
+ *|WT_EXECUTEINWAITTHREAD - Executes the callback in the wait thread itself.
+ *|WT_EXECUTEONLYONCE - Stops waiting after the first callback.
+ *
+ *  The wait is performed by a shared wait thread, and the callback runs in
+ *  the default thread pool unless the flags ask for another thread.
+ */
+NTSTATUS WINAPI RtlRegisterWait(PHANDLE NewWaitObject, HANDLE Object,
+                                RTL_WAITORTIMERCALLBACKFUNC Callback,
+                                PVOID Context, ULONG Milliseconds, ULONG Flags)
+{
+    struct threadpool_object *object;
+    LARGE_INTEGER now;
+    ULONGLONG timeout = TIMEOUT_INFINITE;
+    HANDLE apc_thread;
+    NTSTATUS status;
+
+    TRACE( "(%p, %p, %p, %p, %d, 0x%x)\n", NewWaitObject, Object, Callback, Context, Milliseconds, Flags );
+
+    Flags &= 0xffff;
+    if (Flags & ~(WT_WORK_ITEM_FLAGS | WT_EXECUTEINWAITTHREAD | WT_EXECUTEONLYONCE))
+        FIXME( "unknown flags 0x%x\n", Flags & ~(WT_WORK_ITEM_FLAGS | WT_EXECUTEINWAITTHREAD | WT_EXECUTEONLYONCE) );
+    if ((status = get_legacy_apc_thread( Flags, &apc_thread ))) return status;
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    object->type = TP_OBJECT_TYPE_WAIT;
+    object->u.wait.callback         = NULL;
+    object->u.wait.function         = Callback;
+    object->u.wait.flags            = Flags;
+    object->u.wait.milliseconds     = Milliseconds;
+    object->u.wait.completion_event = NULL;
+
+    if ((status = tp_waitqueue_lock( object )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+    if ((status = tp_object_initialize( object, Context, NULL )))
+    {
+        RtlEnterCriticalSection( &waitqueue_cs );
+        tp_waitqueue_unlock( object );
+        RtlLeaveCriticalSection( &waitqueue_cs );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+    object->may_run_long = (Flags & WT_EXECUTELONGFUNCTION) != 0;
+    object->apc_thread   = apc_thread;
+
+    if (Milliseconds != INFINITE)
+    {
+        NtQuerySystemTime( &now );
+        timeout = now.QuadPart + (ULONGLONG)Milliseconds * 10000;
+    }
+    tp_wait_arm( object, Object, timeout );
+
+    *NewWaitObject = object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              RtlDeregisterWaitEx   (NTDLL.@)
+ *
+ * Cancels a wait operation and frees the resources associated with calling
+ * RtlRegisterWait().
+ *
+ * PARAMS
+ *  WaitObject [I] Handle to the wait object to free.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent)
+{
+    struct threadpool_object *object = WaitHandle;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    TRACE( "(%p)\n", WaitHandle );
+
+    tp_object_prepare_shutdown( object );
+    tp_object_cancel( object );
+
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+        tp_object_wait( object );
+    else
+    {
+        /* the event is signaled once the last callback has returned */
+        object->u.wait.completion_event = CompletionEvent;
+        if (object->num_running) status = STATUS_PENDING;
+    }
+
+    tp_object_release( object );
+    return status;
+}
+
+/***********************************************************************
+ *              RtlDeregisterWait   (NTDLL.@)
+ *
+ * Cancels a wait operation and frees the resources associated with calling
+ * RtlRegisterWait().
+ *
+ * PARAMS
+ *  WaitObject [I] Handle to the wait object to free.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
+{
+    return RtlDeregisterWaitEx(WaitHandle, NULL);
+}
+
+
+/************************** Timer Queue Impl **************************/
+
+struct timer_queue;
+struct queue_timer
+{
+    struct timer_queue *q;
+    struct list entry;
+    ULONG runcount;             /* number of callbacks pending execution */
+    RTL_WAITORTIMERCALLBACKFUNC callback;
+    PVOID param;
+    DWORD period;
+    ULONG flags;
+    ULONGLONG expire;
+    BOOL destroy;      /* timer should be deleted; once set, never unset */
+    HANDLE event;      /* removal event */
+};
+
+struct timer_queue
+{
+    DWORD magic;
+    RTL_CRITICAL_SECTION cs;
+    struct list timers;          /* sorted by expiration time */
+    BOOL quit;         /* queue should be deleted; once set, never unset */
+    HANDLE event;
+    HANDLE thread;
+};
+
+#define EXPIRE_NEVER (~(ULONGLONG) 0)
+#define TIMER_QUEUE_MAGIC 0x516d6954  /* TimQ */
+
+static void queue_remove_timer(struct queue_timer *t)
+{
+    /* We MUST hold the queue cs while calling this function.  This ensures
+       that we cannot queue another callback for this timer.  The runcount
+       being zero makes sure we don't have any already queued.  */
+    struct timer_queue *q = t->q;
+
+    assert(t->runcount == 0);
+    assert(t->destroy);
+
+    list_remove(&t->entry);
+    if (t->event)
+        NtSetEvent(t->event, NULL);
+    RtlFreeHeap(GetProcessHeap(), 0, t);
+
+    if (q->quit && list_empty(&q->timers))
+        NtSetEvent(q->event, NULL);
+}
+
+static void timer_cleanup_callback(struct queue_timer *t)
+{
+    struct timer_queue *q = t->q;
+    RtlEnterCriticalSection(&q->cs);
+
+    assert(0 < t->runcount);
+    --t->runcount;
+
+    if (t->destroy && t->runcount == 0)
+        queue_remove_timer(t);
+
+    RtlLeaveCriticalSection(&q->cs);
+}
+
+static DWORD WINAPI timer_callback_wrapper(LPVOID p)
+{
+    struct queue_timer *t = p;
+    t->callback(t->param, TRUE);
+    timer_cleanup_callback(t);
+    return 0;
+}
+
+static inline ULONGLONG queue_current_time(void)
+{
+    LARGE_INTEGER now, freq;
+    NtQueryPerformanceCounter(&now, &freq);
+    return now.QuadPart * 1000 / freq.QuadPart;
+}
+
+static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
+                            BOOL set_event)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    struct timer_queue *q = t->q;
+    struct list *ptr = &q->timers;
+
+    assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
+
+    if (time != EXPIRE_NEVER)
+        LIST_FOR_EACH(ptr, &q->timers)
+        {
+            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
+            if (time < cur->expire)
+                break;
+        }
+    list_add_before(ptr, &t->entry);
+
+    t->expire = time;
+
+    /* If we insert at the head of the list, we need to expire sooner
+       than expected.  */
+    if (set_event && &t->entry == list_head(&q->timers))
+        NtSetEvent(q->event, NULL);
+}
+
+static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
+                                    BOOL set_event)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    list_remove(&t->entry);
+    queue_add_timer(t, time, set_event);
+}
+
+static void queue_timer_expire(struct timer_queue *q)
+{
+    struct queue_timer *t = NULL;
+
+    RtlEnterCriticalSection(&q->cs);
+    if (list_head(&q->timers))
+    {
+        ULONGLONG now, next;
+        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
+        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        {
+            ++t->runcount;
+            if (t->period)
+            {
+                next = t->expire + t->period;
+                /* avoid trigger cascade if overloaded / hibernated */
+                if (next < now)
+                    next = now + t->period;
+            }
+            else
+                next = EXPIRE_NEVER;
+            queue_move_timer(t, next, FALSE);
+        }
+        else
+            t = NULL;
+    }
+    RtlLeaveCriticalSection(&q->cs);
+
+    if (t)
+    {
+        if (t->flags & WT_EXECUTEINTIMERTHREAD)
+            timer_callback_wrapper(t);
+        else
+        {
+            ULONG flags
+                = (t->flags
+                   & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
+                      | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
+            NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
+            if (status != STATUS_SUCCESS)
+                timer_cleanup_callback(t);
+        }
+    }
+}
+
+static ULONG queue_get_timeout(struct timer_queue *q)
+{
+    struct queue_timer *t;
+    ULONG timeout = INFINITE;
+
+    RtlEnterCriticalSection(&q->cs);
+    if (list_head(&q->timers))
+    {
+        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
+        assert(!t->destroy || t->expire == EXPIRE_NEVER);
+
+        if (t->expire != EXPIRE_NEVER)
+        {
+            ULONGLONG time = queue_current_time();
+            timeout = t->expire < time ? 0 : t->expire - time;
+        }
+    }
+    RtlLeaveCriticalSection(&q->cs);
+
+    return timeout;
+}
+
+static void WINAPI timer_queue_thread_proc(LPVOID p)
+{
+    struct timer_queue *q = p;
+    ULONG timeout_ms;
+
+    timeout_ms = INFINITE;
+    for (;;)
+    {
+        LARGE_INTEGER timeout;
+        NTSTATUS status;
+        BOOL done = FALSE;
+
+        status = NtWaitForSingleObject(
+            q->event, FALSE, get_nt_timeout(&timeout, timeout_ms));
+
+        if (status == STATUS_WAIT_0)
+        {
+            /* There are two possible ways to trigger the event.  Either
+               we are quitting and the last timer got removed, or a new
+               timer got put at the head of the list so we need to adjust
+               our timeout.  */
+            RtlEnterCriticalSection(&q->cs);
+            if (q->quit && list_empty(&q->timers))
+                done = TRUE;
+            RtlLeaveCriticalSection(&q->cs);
+        }
+        else if (status == STATUS_TIMEOUT)
+            queue_timer_expire(q);
+
+        if (done)
+            break;
+
+        timeout_ms = queue_get_timeout(q);
+    }
+
+    NtClose(q->event);
+    RtlDeleteCriticalSection(&q->cs);
+    q->magic = 0;
+    RtlFreeHeap(GetProcessHeap(), 0, q);
+}
+
+static void queue_destroy_timer(struct queue_timer *t)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    t->destroy = TRUE;
+    if (t->runcount == 0)
+        /* Ensure a timer is promptly removed.  If callbacks are pending,
+           it will be removed after the last one finishes by the callback
+           cleanup wrapper.  */
+        queue_remove_timer(t);
+    else
+        /* Make sure no destroyed timer masks an active timer at the head
+           of the sorted list.  */
+        queue_move_timer(t, EXPIRE_NEVER, FALSE);
+}
+
+/***********************************************************************
+ *              RtlCreateTimerQueue   (NTDLL.@)
+ *
+ * Creates a timer queue object and returns a handle to it.
+ *
+ * PARAMS
+ *  NewTimerQueue [O] The newly created queue.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
+{
+    NTSTATUS status;
+    struct timer_queue *q = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *q);
+    if (!q)
+        return STATUS_NO_MEMORY;
+
+    RtlInitializeCriticalSection(&q->cs);
+    list_init(&q->timers);
+    q->quit = FALSE;
+    q->magic = TIMER_QUEUE_MAGIC;
+    status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+    if (status != STATUS_SUCCESS)
+    {
+        RtlFreeHeap(GetProcessHeap(), 0, q);
+        return status;
+    }
+    status = RtlCreateUserThread(GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                 timer_queue_thread_proc, q, &q->thread, NULL);
+    if (status != STATUS_SUCCESS)
+    {
+        NtClose(q->event);
+        RtlFreeHeap(GetProcessHeap(), 0, q);
+        return status;
+    }
+
+    *NewTimerQueue = q;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              RtlDeleteTimerQueueEx   (NTDLL.@)
+ *
+ * Deletes a timer queue object.
+ *
+ * PARAMS
+ *  TimerQueue      [I] The timer queue to destroy.
+ *  CompletionEvent [I] If NULL, return immediately.  If INVALID_HANDLE_VALUE,
+ *                      wait until all timers are finished firing before
+ *                      returning.  Otherwise, return immediately and set the
+ *                      event when all timers are done.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS if synchronous, STATUS_PENDING if not.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeleteTimerQueueEx(HANDLE TimerQueue, HANDLE CompletionEvent)
+{
+    struct timer_queue *q = TimerQueue;
+    struct queue_timer *t, *temp;
+    HANDLE thread;
+    NTSTATUS status;
+
+    if (!q || q->magic != TIMER_QUEUE_MAGIC)
+        return STATUS_INVALID_HANDLE;
+
+    thread = q->thread;
+
+    RtlEnterCriticalSection(&q->cs);
+    q->quit = TRUE;
+    if (list_head(&q->timers))
+        /* When the last timer is removed, it will signal the timer thread to
+           exit...  */
+        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, entry)
+            queue_destroy_timer(t);
+    else
+        /* However if we have none, we must do it ourselves.  */
+        NtSetEvent(q->event, NULL);
+    RtlLeaveCriticalSection(&q->cs);
+
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    {
+        NtWaitForSingleObject(thread, FALSE, NULL);
+        status = STATUS_SUCCESS;
+    }
+    else
+    {
+        if (CompletionEvent)
+        {
+            FIXME("asynchronous return on completion event unimplemented\n");
+            NtWaitForSingleObject(thread, FALSE, NULL);
+            NtSetEvent(CompletionEvent, NULL);
+        }
+        status = STATUS_PENDING;
+    }
+
+    NtClose(thread);
+    return status;
+}
+
+static struct timer_queue *default_timer_queue;
+
+static struct timer_queue *get_timer_queue(HANDLE TimerQueue)
+{
+    if (TimerQueue)
+        return TimerQueue;
+    else
+    {
+        if (!default_timer_queue)
+        {
+            HANDLE q;
+            NTSTATUS status = RtlCreateTimerQueue(&q);
+            if (status == STATUS_SUCCESS)
+            {
+                PVOID p = interlocked_cmpxchg_ptr(
+                    (void **) &default_timer_queue, q, NULL);
+                if (p)
+                    /* Got beat to the punch.  */
+                    RtlDeleteTimerQueueEx(p, NULL);
+            }
+        }
+        return default_timer_queue;
+    }
+}
+
+/***********************************************************************
+ *              RtlCreateTimer   (NTDLL.@)
+ *
+ * Creates a new timer associated with the given queue.
+ *
+ * PARAMS
+ *  NewTimer   [O] The newly created timer.
+ *  TimerQueue [I] The queue to hold the timer.
+ *  Callback   [I] The callback to fire.
+ *  Parameter  [I] The argument for the callback.
+ *  DueTime    [I] The delay, in milliseconds, before first firing the
+ *                 timer.
+ *  Period     [I] The period, in milliseconds, at which to fire the timer
+ *                 after the first callback.  If zero, the timer will only
+ *                 fire once.  It still needs to be deleted with
+ *                 RtlDeleteTimer.
+ * Flags       [I] Flags controlling the execution of the callback.  In
+ *                 addition to the WT_* thread pool flags (see
+ *                 RtlQueueWorkItem), WT_EXECUTEINTIMERTHREAD and
+ *                 WT_EXECUTEONLYONCE are supported.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
+                               RTL_WAITORTIMERCALLBACKFUNC Callback,
+                               PVOID Parameter, DWORD DueTime, DWORD Period,
+                               ULONG Flags)
+{
+    NTSTATUS status;
+    struct queue_timer *t;
+    struct timer_queue *q = get_timer_queue(TimerQueue);
+
+    if (!q) return STATUS_NO_MEMORY;
+    if (q->magic != TIMER_QUEUE_MAGIC) return STATUS_INVALID_HANDLE;
+
+    t = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *t);
+    if (!t)
+        return STATUS_NO_MEMORY;
+
+    t->q = q;
+    t->runcount = 0;
+    t->callback = Callback;
+    t->param = Parameter;
+    t->period = Period;
+    t->flags = Flags;
+    t->destroy = FALSE;
+    t->event = NULL;
+
+    status = STATUS_SUCCESS;
+    RtlEnterCriticalSection(&q->cs);
+    if (q->quit)
+        status = STATUS_INVALID_HANDLE;
+    else
+        queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    RtlLeaveCriticalSection(&q->cs);
+
+    if (status == STATUS_SUCCESS)
+        *NewTimer = t;
+    else
+        RtlFreeHeap(GetProcessHeap(), 0, t);
+
+    return status;
+}
+
+/***********************************************************************
+ *              RtlUpdateTimer   (NTDLL.@)
+ *
+ * Changes the time at which a timer expires.
+ *
+ * PARAMS
+ *  TimerQueue [I] The queue that holds the timer.
+ *  Timer      [I] The timer to update.
+ *  DueTime    [I] The delay, in milliseconds, before next firing the timer.
+ *  Period     [I] The period, in milliseconds, at which to fire the timer
+ *                 after the first callback.  If zero, the timer will not
+ *                 refire once.  It still needs to be deleted with
+ *                 RtlDeleteTimer.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlUpdateTimer(HANDLE TimerQueue, HANDLE Timer,
+                               DWORD DueTime, DWORD Period)
+{
+    struct queue_timer *t = Timer;
+    struct timer_queue *q = t->q;
+
+    RtlEnterCriticalSection(&q->cs);
+    /* Can't change a timer if it was once-only or destroyed.  */
+    if (t->expire != EXPIRE_NEVER)
+    {
+        t->period = Period;
+        queue_move_timer(t, queue_current_time() + DueTime, TRUE);
+    }
+    RtlLeaveCriticalSection(&q->cs);
+
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              RtlDeleteTimer   (NTDLL.@)
+ *
+ * Cancels a timer-queue timer.
+ *
+ * PARAMS
+ *  TimerQueue      [I] The queue that holds the timer.
+ *  Timer           [I] The timer to update.
+ *  CompletionEvent [I] If NULL, return immediately.  If INVALID_HANDLE_VALUE,
+ *                      wait until the timer is finished firing all pending
+ *                      callbacks before returning.  Otherwise, return
+ *                      immediately and set the timer is done.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS if the timer is done, STATUS_PENDING if not,
+             or if the completion event is NULL.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
+                               HANDLE CompletionEvent)
+{
+    struct queue_timer *t = Timer;
+    struct timer_queue *q;
+    NTSTATUS status = STATUS_PENDING;
+    HANDLE event = NULL;
+
+    if (!Timer)
+        return STATUS_INVALID_PARAMETER_1;
+    q = t->q;
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    {
+        status = NtCreateEvent(&event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+        if (status == STATUS_SUCCESS)
+            status = STATUS_PENDING;
+    }
+    else if (CompletionEvent)
+        event = CompletionEvent;
+
+    RtlEnterCriticalSection(&q->cs);
+    t->event = event;
+    if (t->runcount == 0 && event)
+        status = STATUS_SUCCESS;
+    queue_destroy_timer(t);
+    RtlLeaveCriticalSection(&q->cs);
+
+    if (CompletionEvent == INVALID_HANDLE_VALUE && event)
+    {
+        if (status == STATUS_PENDING)
+        {
+            NtWaitForSingleObject(event, FALSE, NULL);
+            status = STATUS_SUCCESS;
+        }
+        NtClose(event);
+    }
+
+    return status;
+}
+
+
+/************************** Thread pool API **************************/
+
+/***********************************************************************
+ *           TpAllocCleanupGroup    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocCleanupGroup( TP_CLEANUP_GROUP **out )
+{
+    struct threadpool_group *group;
+
+    TRACE( "%p\n", out );
+
+    if (!(group = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*group) )))
+        return STATUS_NO_MEMORY;
+
+    group->refcount = 1;
+    group->shutdown = FALSE;
+    RtlInitializeCriticalSection( &group->cs );
+    list_init( &group->members );
+
+    *out = (TP_CLEANUP_GROUP *)group;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpAllocPool    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocPool( TP_POOL **out, PVOID reserved )
+{
+    TRACE( "%p %p\n", out, reserved );
+
+    if (reserved)
+        FIXME( "reserved argument is nonzero (%p)\n", reserved );
+
+    return tp_pool_alloc( (struct threadpool **)out );
+}
+
+/***********************************************************************
+ *           TpAllocTimer    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocTimer( TP_TIMER **out, PTP_TIMER_CALLBACK callback, PVOID userdata,
+                              TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    if ((status = tp_timerqueue_init())) return status;
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    object->type = TP_OBJECT_TYPE_TIMER;
+    object->u.timer.callback      = callback;
+    object->u.timer.timer_pending = FALSE;
+    object->u.timer.timer_set     = FALSE;
+    object->u.timer.timeout       = 0;
+    object->u.timer.period        = 0;
+    object->u.timer.window        = 0;
+
+    if ((status = tp_object_initialize( object, userdata, environment )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    *out = (TP_TIMER *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpAllocWait    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocWait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID userdata,
+                             TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    object->type = TP_OBJECT_TYPE_WAIT;
+    object->u.wait.callback         = callback;
+    object->u.wait.function         = NULL;
+    object->u.wait.flags            = 0;
+    object->u.wait.milliseconds     = INFINITE;
+    object->u.wait.completion_event = NULL;
+
+    if ((status = tp_waitqueue_lock( object )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+    if ((status = tp_object_initialize( object, userdata, environment )))
+    {
+        RtlEnterCriticalSection( &waitqueue_cs );
+        tp_waitqueue_unlock( object );
+        RtlLeaveCriticalSection( &waitqueue_cs );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    *out = (TP_WAIT *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpAllocWork    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocWork( TP_WORK **out, PTP_WORK_CALLBACK callback, PVOID userdata,
+                             TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    object->type = TP_OBJECT_TYPE_WORK;
+    object->u.work.callback = callback;
+
+    if ((status = tp_object_initialize( object, userdata, environment )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    *out = (TP_WORK *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpCallbackLeaveCriticalSectionOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackLeaveCriticalSectionOnCompletion( TP_CALLBACK_INSTANCE *instance, RTL_CRITICAL_SECTION *crit )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, crit );
+
+    if (!this->cleanup.critical_section)
+        this->cleanup.critical_section = crit;
+}
+
+/***********************************************************************
+ *           TpCallbackMayRunLong    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+    struct threadpool *pool = this->object->pool;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    TRACE( "%p\n", instance );
+
+    if (this->threadid != GetCurrentThreadId())
+    {
+        ERR( "called from wrong thread, ignoring\n" );
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    if (this->may_run_long)
+        return STATUS_SUCCESS;
+
+    /* make sure another worker can pick up the queued callbacks */
+    RtlEnterCriticalSection( &pool->cs );
+    if (!pool->num_idle)
+    {
+        if (pool->num_workers < pool->max_workers)
+            status = tp_pool_spawn_worker( pool );
+        else
+            status = STATUS_TOO_MANY_THREADS;
+    }
+    RtlLeaveCriticalSection( &pool->cs );
+
+    this->may_run_long = TRUE;
+    return status;
+}
+
+/***********************************************************************
+ *           TpCallbackReleaseMutexOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackReleaseMutexOnCompletion( TP_CALLBACK_INSTANCE *instance, HANDLE mutex )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, mutex );
+
+    if (!this->cleanup.mutex)
+        this->cleanup.mutex = mutex;
+}
+
+/***********************************************************************
+ *           TpCallbackReleaseSemaphoreOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackReleaseSemaphoreOnCompletion( TP_CALLBACK_INSTANCE *instance, HANDLE semaphore, DWORD count )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p %u\n", instance, semaphore, count );
+
+    if (!this->cleanup.semaphore)
+    {
+        this->cleanup.semaphore = semaphore;
+        this->cleanup.semaphore_count = count;
+    }
+}
+
+/***********************************************************************
+ *           TpCallbackSetEventOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackSetEventOnCompletion( TP_CALLBACK_INSTANCE *instance, HANDLE event )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, event );
+
+    if (!this->cleanup.event)
+        this->cleanup.event = event;
+}
+
+/***********************************************************************
+ *           TpCallbackUnloadDllOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackUnloadDllOnCompletion( TP_CALLBACK_INSTANCE *instance, HMODULE module )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, module );
+
+    if (!this->cleanup.library)
+        this->cleanup.library = module;
+}
+
+/***********************************************************************
+ *           TpDisassociateCallback    (NTDLL.@)
+ */
+VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p\n", instance );
+
+    if (this->threadid != GetCurrentThreadId())
+    {
+        ERR( "called from wrong thread, ignoring\n" );
+        return;
+    }
+
+    if (!this->associated)
+        return;
+
+    /* waiting for the object's callbacks no longer waits for this one */
+    this->associated = FALSE;
+    tp_object_callback_done( this->object );
+}
+
+/***********************************************************************
+ *           TpIsTimerSet    (NTDLL.@)
+ */
+BOOL WINAPI TpIsTimerSet( TP_TIMER *timer )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+
+    TRACE( "%p\n", timer );
+
+    return this->u.timer.timer_set;
+}
+
+/***********************************************************************
+ *           TpPostWork    (NTDLL.@)
+ */
+VOID WINAPI TpPostWork( TP_WORK *work )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
+    NTSTATUS status;
+
+    TRACE( "%p\n", work );
+
+    if ((status = tp_object_submit( this )))
+        ERR( "failed to post work %p, status %08x\n", work, status );
+}
+
+/***********************************************************************
+ *           TpReleaseCleanupGroup    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseCleanupGroup( TP_CLEANUP_GROUP *group )
+{
+    struct threadpool_group *this = impl_from_TP_CLEANUP_GROUP( group );
+
+    TRACE( "%p\n", group );
+
+    this->shutdown = TRUE;
+    tp_group_release( this );
+}
+
+/***********************************************************************
+ *           TpReleaseCleanupGroupMembers    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseCleanupGroupMembers( TP_CLEANUP_GROUP *group, BOOL cancel_pending, PVOID userdata )
+{
+    struct threadpool_group *this = impl_from_TP_CLEANUP_GROUP( group );
+    struct threadpool_object *object, *next;
+    struct list members;
+
+    TRACE( "%p %u %p\n", group, cancel_pending, userdata );
+
+    list_init( &members );
+
+    RtlEnterCriticalSection( &this->cs );
+    LIST_FOR_EACH_ENTRY( object, &this->members, struct threadpool_object, group_entry )
+        object->is_group_member = FALSE;
+    list_move_tail( &members, &this->members );
+    RtlLeaveCriticalSection( &this->cs );
+
+    LIST_FOR_EACH_ENTRY_SAFE( object, next, &members, struct threadpool_object, group_entry )
+    {
+        list_remove( &object->group_entry );
+        tp_object_prepare_shutdown( object );
+
+        if (cancel_pending)
+        {
+            tp_object_cancel( object );
+            if (object->group_cancel_callback)
+            {
+                TRACE( "executing group cancel callback %p(%p, %p)\n",
+                       object->group_cancel_callback, object->userdata, userdata );
+                object->group_cancel_callback( object->userdata, userdata );
+            }
+        }
+
+        tp_object_wait( object );
+        tp_object_release( object );
+    }
+}
+
+/***********************************************************************
+ *           TpReleasePool    (NTDLL.@)
+ */
+VOID WINAPI TpReleasePool( TP_POOL *pool )
+{
+    struct threadpool *this = impl_from_TP_POOL( pool );
+
+    TRACE( "%p\n", pool );
+
+    tp_pool_shutdown( this );
+    tp_pool_release( this );
+}
+
+/***********************************************************************
+ *           TpReleaseTimer     (NTDLL.@)
+ */
+VOID WINAPI TpReleaseTimer( TP_TIMER *timer )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+
+    TRACE( "%p\n", timer );
+
+    tp_object_close( this );
+}
+
+/***********************************************************************
+ *           TpReleaseWait    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseWait( TP_WAIT *wait )
+{
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
+
+    TRACE( "%p\n", wait );
+
+    tp_object_close( this );
+}
+
+/***********************************************************************
+ *           TpReleaseWork    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseWork( TP_WORK *work )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
+
+    TRACE( "%p\n", work );
+
+    tp_object_close( this );
+}
+
+/***********************************************************************
+ *           TpSetPoolMaxThreads    (NTDLL.@)
  */
-NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
+VOID WINAPI TpSetPoolMaxThreads( TP_POOL *pool, DWORD maximum )
 {
-    NTSTATUS status;
-    struct timer_queue *q = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *q);
-    if (!q)
-        return STATUS_NO_MEMORY;
+    struct threadpool *this = impl_from_TP_POOL( pool );
 
-    RtlInitializeCriticalSection(&q->cs);
-    list_init(&q->timers);
-    q->quit = FALSE;
-    q->magic = TIMER_QUEUE_MAGIC;
-    status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
-    if (status != STATUS_SUCCESS)
-    {
-        RtlFreeHeap(GetProcessHeap(), 0, q);
-        return status;
-    }
-    status = RtlCreateUserThread(GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                 timer_queue_thread_proc, q, &q->thread, NULL);
-    if (status != STATUS_SUCCESS)
-    {
-        NtClose(q->event);
-        RtlFreeHeap(GetProcessHeap(), 0, q);
-        return status;
-    }
+    TRACE( "%p %u\n", pool, maximum );
 
-    *NewTimerQueue = q;
-    return STATUS_SUCCESS;
+    RtlEnterCriticalSection( &this->cs );
+    this->max_workers = max( maximum, 1 );
+    this->min_workers = min( this->min_workers, this->max_workers );
+    RtlLeaveCriticalSection( &this->cs );
 }
 
 /***********************************************************************
- *              RtlDeleteTimerQueueEx   (NTDLL.@)
- *
- * Deletes a timer queue object.
- *
- * PARAMS
- *  TimerQueue      [I] The timer queue to destroy.
- *  CompletionEvent [I] If NULL, return immediately.  If INVALID_HANDLE_VALUE,
- *                      wait until all timers are finished firing before
- *                      returning.  Otherwise, return immediately and set the
- *                      event when all timers are done.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS if synchronous, STATUS_PENDING if not.
- *  Failure: Any NTSTATUS code.
+ *           TpSetPoolMinThreads    (NTDLL.@)
  */
-NTSTATUS WINAPI RtlDeleteTimerQueueEx(HANDLE TimerQueue, HANDLE CompletionEvent)
+BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 {
-    struct timer_queue *q = TimerQueue;
-    struct queue_timer *t, *temp;
-    HANDLE thread;
-    NTSTATUS status;
+    struct threadpool *this = impl_from_TP_POOL( pool );
+    NTSTATUS status = STATUS_SUCCESS;
 
-    if (!q || q->magic != TIMER_QUEUE_MAGIC)
-        return STATUS_INVALID_HANDLE;
+    TRACE( "%p %u\n", pool, minimum );
 
-    thread = q->thread;
+    RtlEnterCriticalSection( &this->cs );
 
-    RtlEnterCriticalSection(&q->cs);
-    q->quit = TRUE;
-    if (list_head(&q->timers))
-        /* When the last timer is removed, it will signal the timer thread to
-           exit...  */
-        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, entry)
-            queue_destroy_timer(t);
-    else
-        /* However if we have none, we must do it ourselves.  */
-        NtSetEvent(q->event, NULL);
-    RtlLeaveCriticalSection(&q->cs);
+    while (this->num_workers < minimum)
+    {
+        if ((status = tp_pool_spawn_worker( this ))) break;
+    }
 
-    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    if (!status)
     {
-        NtWaitForSingleObject(thread, FALSE, NULL);
-        status = STATUS_SUCCESS;
+        this->min_workers = minimum;
+        this->max_workers = max( this->min_workers, this->max_workers );
     }
-    else
+
+    RtlLeaveCriticalSection( &this->cs );
+    return !status;
+}
+
+/***********************************************************************
+ *           TpSetTimer    (NTDLL.@)
+ */
+VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+    LARGE_INTEGER now;
+    ULONGLONG due = 0;
+    BOOL submit = FALSE;
+
+    TRACE( "%p %p %u %u\n", timer, timeout, period, window_length );
+
+    if (timeout)
     {
-        if (CompletionEvent)
+        NtQuerySystemTime( &now );
+        if (!timeout->QuadPart)
         {
-            FIXME("asynchronous return on completion event unimplemented\n");
-            NtWaitForSingleObject(thread, FALSE, NULL);
-            NtSetEvent(CompletionEvent, NULL);
+            /* fire immediately, then start the period */
+            submit = TRUE;
+            if (period) due = now.QuadPart + (ULONGLONG)period * 10000;
         }
-        status = STATUS_PENDING;
+        else if (timeout->QuadPart < 0)
+            due = now.QuadPart - timeout->QuadPart;
+        else
+            due = timeout->QuadPart;
     }
 
-    NtClose(thread);
-    return status;
-}
+    RtlEnterCriticalSection( &timerqueue_cs );
 
-static struct timer_queue *default_timer_queue;
+    assert( !this->shutdown );
+    tp_timer_disarm( this );
+    this->u.timer.timer_set = timeout != NULL;
+    if (due)
+    {
+        this->u.timer.timeout = due;
+        this->u.timer.period  = period;
+        this->u.timer.window  = window_length;
+        tp_timer_insert( this );
+    }
 
-static struct timer_queue *get_timer_queue(HANDLE TimerQueue)
+    RtlLeaveCriticalSection( &timerqueue_cs );
+
+    if (submit) tp_object_submit( this );
+}
+
+/***********************************************************************
+ *           TpSetWait    (NTDLL.@)
+ */
+VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
 {
-    if (TimerQueue)
-        return TimerQueue;
-    else
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
+    LARGE_INTEGER now;
+    ULONGLONG due = TIMEOUT_INFINITE;
+
+    TRACE( "%p %p %p\n", wait, handle, timeout );
+
+    if (!handle)
     {
-        if (!default_timer_queue)
-        {
-            HANDLE q;
-            NTSTATUS status = RtlCreateTimerQueue(&q);
-            if (status == STATUS_SUCCESS)
-            {
-                PVOID p = interlocked_cmpxchg_ptr(
-                    (void **) &default_timer_queue, q, NULL);
-                if (p)
-                    /* Got beat to the punch.  */
-                    RtlDeleteTimerQueueEx(p, NULL);
-            }
-        }
-        return default_timer_queue;
+        RtlEnterCriticalSection( &waitqueue_cs );
+        tp_wait_disarm( this );
+        RtlLeaveCriticalSection( &waitqueue_cs );
+        return;
+    }
+
+    if (timeout)
+    {
+        NtQuerySystemTime( &now );
+        if (timeout->QuadPart <= 0)
+            due = now.QuadPart - timeout->QuadPart;
+        else
+            due = timeout->QuadPart;
     }
+
+    tp_wait_arm( this, handle, due );
 }
 
 /***********************************************************************
- *              RtlCreateTimer   (NTDLL.@)
- *
- * Creates a new timer associated with the given queue.
- *
- * PARAMS
- *  NewTimer   [O] The newly created timer.
- *  TimerQueue [I] The queue to hold the timer.
- *  Callback   [I] The callback to fire.
- *  Parameter  [I] The argument for the callback.
- *  DueTime    [I] The delay, in milliseconds, before first firing the
- *                 timer.
- *  Period     [I] The period, in milliseconds, at which to fire the timer
- *                 after the first callback.  If zero, the timer will only
- *                 fire once.  It still needs to be deleted with
- *                 RtlDeleteTimer.
- * Flags       [I] Flags controlling the execution of the callback.  In
- *                 addition to the WT_* thread pool flags (see
- *                 RtlQueueWorkItem), WT_EXECUTEINTIMERTHREAD and
- *                 WT_EXECUTEONLYONCE are supported.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ *           TpSimpleTryPost    (NTDLL.@)
  */
-NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
-                               RTL_WAITORTIMERCALLBACKFUNC Callback,
-                               PVOID Parameter, DWORD DueTime, DWORD Period,
-                               ULONG Flags)
+NTSTATUS WINAPI TpSimpleTryPost( PTP_SIMPLE_CALLBACK callback, PVOID userdata,
+                                 TP_CALLBACK_ENVIRON *environment )
 {
+    struct threadpool_object *object;
     NTSTATUS status;
-    struct queue_timer *t;
-    struct timer_queue *q = get_timer_queue(TimerQueue);
 
-    if (!q) return STATUS_NO_MEMORY;
-    if (q->magic != TIMER_QUEUE_MAGIC) return STATUS_INVALID_HANDLE;
+    TRACE( "%p %p %p\n", callback, userdata, environment );
 
-    t = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *t);
-    if (!t)
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) )))
         return STATUS_NO_MEMORY;
 
-    t->q = q;
-    t->runcount = 0;
-    t->callback = Callback;
-    t->param = Parameter;
-    t->period = Period;
-    t->flags = Flags;
-    t->destroy = FALSE;
-    t->event = NULL;
-
-    status = STATUS_SUCCESS;
-    RtlEnterCriticalSection(&q->cs);
-    if (q->quit)
-        status = STATUS_INVALID_HANDLE;
-    else
-        queue_add_timer(t, queue_current_time() + DueTime, TRUE);
-    RtlLeaveCriticalSection(&q->cs);
+    object->type = TP_OBJECT_TYPE_SIMPLE;
+    object->u.simple.callback = callback;
+    object->u.simple.function = NULL;
 
-    if (status == STATUS_SUCCESS)
-        *NewTimer = t;
-    else
-        RtlFreeHeap(GetProcessHeap(), 0, t);
+    if ((status = tp_object_initialize( object, userdata, environment )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
 
-    return status;
+    return tp_simple_submit( object );
 }
 
 /***********************************************************************
- *              RtlUpdateTimer   (NTDLL.@)
- *
- * Changes the time at which a timer expires.
- *
- * PARAMS
- *  TimerQueue [I] The queue that holds the timer.
- *  Timer      [I] The timer to update.
- *  DueTime    [I] The delay, in milliseconds, before next firing the timer.
- *  Period     [I] The period, in milliseconds, at which to fire the timer
- *                 after the first callback.  If zero, the timer will not
- *                 refire once.  It still needs to be deleted with
- *                 RtlDeleteTimer.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ *           TpWaitForTimer    (NTDLL.@)
  */
-NTSTATUS WINAPI RtlUpdateTimer(HANDLE TimerQueue, HANDLE Timer,
-                               DWORD DueTime, DWORD Period)
+VOID WINAPI TpWaitForTimer( TP_TIMER *timer, BOOL cancel_pending )
 {
-    struct queue_timer *t = Timer;
-    struct timer_queue *q = t->q;
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
 
-    RtlEnterCriticalSection(&q->cs);
-    /* Can't change a timer if it was once-only or destroyed.  */
-    if (t->expire != EXPIRE_NEVER)
-    {
-        t->period = Period;
-        queue_move_timer(t, queue_current_time() + DueTime, TRUE);
-    }
-    RtlLeaveCriticalSection(&q->cs);
+    TRACE( "%p %d\n", timer, cancel_pending );
 
-    return STATUS_SUCCESS;
+    if (cancel_pending)
+        tp_object_cancel( this );
+    tp_object_wait( this );
 }
 
 /***********************************************************************
- *              RtlDeleteTimer   (NTDLL.@)
- *
- * Cancels a timer-queue timer.
- *
- * PARAMS
- *  TimerQueue      [I] The queue that holds the timer.
- *  Timer           [I] The timer to update.
- *  CompletionEvent [I] If NULL, return immediately.  If INVALID_HANDLE_VALUE,
- *                      wait until the timer is finished firing all pending
- *                      callbacks before returning.  Otherwise, return
- *                      immediately and set the timer is done.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS if the timer is done, STATUS_PENDING if not,
-             or if the completion event is NULL.
- *  Failure: Any NTSTATUS code.
+ *           TpWaitForWait    (NTDLL.@)
  */
-NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
-                               HANDLE CompletionEvent)
+VOID WINAPI TpWaitForWait( TP_WAIT *wait, BOOL cancel_pending )
 {
-    struct queue_timer *t = Timer;
-    struct timer_queue *q;
-    NTSTATUS status = STATUS_PENDING;
-    HANDLE event = NULL;
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
 
-    if (!Timer)
-        return STATUS_INVALID_PARAMETER_1;
-    q = t->q;
-    if (CompletionEvent == INVALID_HANDLE_VALUE)
-    {
-        status = NtCreateEvent(&event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
-        if (status == STATUS_SUCCESS)
-            status = STATUS_PENDING;
-    }
-    else if (CompletionEvent)
-        event = CompletionEvent;
+    TRACE( "%p %d\n", wait, cancel_pending );
 
-    RtlEnterCriticalSection(&q->cs);
-    t->event = event;
-    if (t->runcount == 0 && event)
-        status = STATUS_SUCCESS;
-    queue_destroy_timer(t);
-    RtlLeaveCriticalSection(&q->cs);
+    if (cancel_pending)
+        tp_object_cancel( this );
+    tp_object_wait( this );
+}
 
-    if (CompletionEvent == INVALID_HANDLE_VALUE && event)
-    {
-        if (status == STATUS_PENDING)
-        {
-            NtWaitForSingleObject(event, FALSE, NULL);
-            status = STATUS_SUCCESS;
-        }
-        NtClose(event);
-    }
+/***********************************************************************
+ *           TpWaitForWork    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForWork( TP_WORK *work, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
 
-    return status;
+    TRACE( "%p %u\n", work, cancel_pending );
+
+    if (cancel_pending)
+        tp_object_cancel( this );
+    tp_object_wait( this );
 }
@@ -52,6 +52,7 @@
 #include "wine/server.h"
 #include "wine/exception.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -70,6 +71,7 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 struct file_view
 {
     struct list   entry;       /* Entry in global view list */
+    struct wine_rb_entry tree_entry; /* Entry in global view tree */
     void         *base;        /* Base address */
     size_t        size;        /* Size in bytes */
     HANDLE        mapping;     /* Handle to the file mapping */
@@ -101,6 +103,7 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 };
 
 static struct list views_list = LIST_INIT(views_list);
+static struct wine_rb_tree views_tree;
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -246,6 +249,97 @@ static void VIRTUAL_Dump(void)
 #endif
 
 
+/***********************************************************************
+ *           views_tree_alloc, views_tree_realloc, views_tree_free, compare_view
+ *
+ * Functions for the view tree, which is indexed by base address.
+ */
+static void *views_tree_alloc( size_t size )
+{
+    return RtlAllocateHeap( virtual_heap, 0, size );
+}
+
+static void *views_tree_realloc( void *ptr, size_t size )
+{
+    return RtlReAllocateHeap( virtual_heap, 0, ptr, size );
+}
+
+static void views_tree_free( void *ptr )
+{
+    RtlFreeHeap( virtual_heap, 0, ptr );
+}
+
+static int compare_view( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, const struct file_view, tree_entry );
+
+    if (addr < view->base) return -1;
+    if (addr > view->base) return 1;
+    return 0;
+}
+
+static const struct wine_rb_functions views_tree_functions =
+{
+    views_tree_alloc,
+    views_tree_realloc,
+    views_tree_free,
+    compare_view
+};
+
+
+/***********************************************************************
+ *           find_view_above
+ *
+ * Find the first view that ends above the given address. Views don't overlap,
+ * so this is also the only view that can contain it.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_above( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *result = NULL;
+
+    while (ptr)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+
+        if ((const char *)view->base + view->size > (const char *)addr)
+        {
+            result = view;
+            ptr = ptr->left;
+        }
+        else ptr = ptr->right;
+    }
+    return result;
+}
+
+
+/***********************************************************************
+ *           find_view_below
+ *
+ * Find the last view that starts below the given address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_below( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *result = NULL;
+
+    while (ptr)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+
+        if (view->base < addr)
+        {
+            result = view;
+            ptr = ptr->right;
+        }
+        else ptr = ptr->left;
+    }
+    return result;
+}
+
+
 /***********************************************************************
  *           VIRTUAL_FindView
  *
@@ -260,17 +354,12 @@ static void VIRTUAL_Dump(void)
  */
 static struct file_view *VIRTUAL_FindView( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_above( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if (view->base > addr) break;  /* no matching view */
-        if ((const char *)view->base + view->size <= (const char *)addr) continue;
-        if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
-        if ((const char *)addr + size < (const char *)addr) break; /* overflow */
-        return view;
-    }
-    return NULL;
+    if (!view || view->base > addr) return NULL;  /* no matching view */
+    if ((const char *)view->base + view->size < (const char *)addr + size) return NULL;  /* size too large */
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
+    return view;
 }
 
 
@@ -293,13 +382,9 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_above( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if ((const char *)view->base >= (const char *)addr + size) break;
-        if ((const char *)view->base + view->size > (const char *)addr) return view;
-    }
+    if (view && (const char *)view->base < (const char *)addr + size) return view;
     return NULL;
 }
 
@@ -313,6 +398,7 @@ static struct file_view *find_view_range( const void *addr, size_t size )
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
     struct list *ptr;
+    struct file_view *first;
     void *start;
 
     if (top_down)
@@ -320,7 +406,10 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)end - size, mask );
         if (start >= end || start < base) return NULL;
 
-        for (ptr = views_list.prev; ptr != &views_list; ptr = ptr->prev)
+        /* skip the views above the range without walking them */
+        if (!(first = find_view_below( (char *)start + size ))) return start;
+
+        for (ptr = &first->entry; ptr != &views_list; ptr = ptr->prev)
         {
             struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
 
@@ -336,7 +425,10 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)base + mask, mask );
         if (start >= end || (char *)end - (char *)start < size) return NULL;
 
-        for (ptr = views_list.next; ptr != &views_list; ptr = ptr->next)
+        /* skip the views below the range without walking them */
+        if (!(first = find_view_above( start ))) return start;
+
+        for (ptr = &first->entry; ptr != &views_list; ptr = ptr->next)
         {
             struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
 
@@ -383,14 +475,16 @@ static void add_reserved_area( void *addr, size_t size )
  */
 static void remove_reserved_area( void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_above( addr );
+    struct list *ptr;
 
     TRACE( "removing %p-%p\n", addr, (char *)addr + size );
     wine_mmap_remove_reserved_area( addr, size, 0 );
 
     /* unmap areas not covered by an existing view */
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    for (ptr = view ? &view->entry : &views_list; ptr != &views_list; ptr = ptr->next)
     {
+        view = LIST_ENTRY( ptr, struct file_view, entry );
         if ((char *)view->base >= (char *)addr + size)
         {
             munmap( addr, size );
@@ -441,6 +535,7 @@ static inline void unmap_area( void *addr, size_t size )
 static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
+    wine_rb_remove( &views_tree, view->base );
     list_remove( &view->entry );
     if (view->mapping) close_handle( view->mapping );
     RtlFreeHeap( virtual_heap, 0, view );
@@ -454,13 +549,24 @@ static void delete_view( struct file_view *view ) /* [in] View */
  */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
-    struct file_view *view;
-    struct list *ptr;
+    struct file_view *view, *prev;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
 
     assert( !((UINT_PTR)base & page_mask) );
     assert( !(size & page_mask) );
 
+    /* Check for overlapping views. This can happen if a previous view
+     * was a system view that got unmapped behind our back. In that case
+     * we recover by simply deleting it. */
+
+    while ((view = find_view_range( base, size )))
+    {
+        TRACE( "overlapping view %p-%p for %p-%p\n",
+               view->base, (char *)view->base + view->size, base, (char *)base + size );
+        assert( view->protect & VPROT_SYSTEM );
+        delete_view( view );
+    }
+
     /* Create the view structure */
 
     if (!(view = RtlAllocateHeap( virtual_heap, 0, sizeof(*view) + (size >> page_shift) - 1 )))
@@ -476,43 +582,16 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->protect = vprot;
     memset( view->prot, vprot, size >> page_shift );
 
-    /* Insert it in the linked list */
+    /* Insert it in the tree and in the linked list */
 
-    LIST_FOR_EACH( ptr, &views_list )
+    if (wine_rb_put( &views_tree, base, &view->tree_entry ) == -1)
     {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if (next->base > base) break;
-    }
-    list_add_before( ptr, &view->entry );
-
-    /* Check for overlapping views. This can happen if the previous view
-     * was a system view that got unmapped behind our back. In that case
-     * we recover by simply deleting it. */
-
-    if ((ptr = list_prev( &views_list, &view->entry )) != NULL)
-    {
-        struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)prev->base + prev->size > (char *)base)
-        {
-            TRACE( "overlapping prev view %p-%p for %p-%p\n",
-                   prev->base, (char *)prev->base + prev->size,
-                   base, (char *)base + view->size );
-            assert( prev->protect & VPROT_SYSTEM );
-            delete_view( prev );
-        }
-    }
-    if ((ptr = list_next( &views_list, &view->entry )) != NULL)
-    {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)base + view->size > (char *)next->base)
-        {
-            TRACE( "overlapping next view %p-%p for %p-%p\n",
-                   next->base, (char *)next->base + next->size,
-                   base, (char *)base + view->size );
-            assert( next->protect & VPROT_SYSTEM );
-            delete_view( next );
-        }
+        FIXME( "out of memory in virtual heap for %p-%p\n", base, (char *)base + size );
+        RtlFreeHeap( virtual_heap, 0, view );
+        return STATUS_NO_MEMORY;
     }
+    if ((prev = find_view_below( base ))) list_add_after( &prev->entry, &view->entry );
+    else list_add_head( &views_list, &view->entry );
 
     *view_ret = view;
     VIRTUAL_DEBUG_DUMP_VIEW( view );
@@ -1051,6 +1130,38 @@ static NTSTATUS stat_mapping_file( struct file_view *view, struct stat *st )
 }
 
 
+/***********************************************************************
+ *           map_relocated_image
+ *
+ * Map the copy of an image that the server has relocated to the view address.
+ * Its pages are shared with the other processes that map the image at the same address.
+ */
+static BOOL map_relocated_image( HANDLE hmapping, struct file_view *view )
+{
+    HANDLE file = 0;
+    int unix_fd, needs_close;
+    NTSTATUS status;
+
+    SERVER_START_REQ( get_relocated_image )
+    {
+        req->handle = wine_server_obj_handle( hmapping );
+        req->base   = wine_server_client_ptr( view->base );
+        if (!(status = wine_server_call( req ))) file = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (status) return FALSE;
+
+    if (!(status = server_get_unix_fd( file, FILE_READ_DATA, &unix_fd, &needs_close, NULL, NULL )))
+    {
+        status = map_file_into_view( view, unix_fd, 0, view->size, 0,
+                                     VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, FALSE );
+        if (needs_close) close( unix_fd );
+    }
+    NtClose( file );
+    return !status;
+}
+
+
 /***********************************************************************
  *           map_image
  *
@@ -1145,6 +1256,20 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
     }
 
 
+    /* use the shared relocated copy if the image needs relocating */
+
+    if (ptr != base && shared_fd == -1 && dup_mapping &&
+        ((nt->FileHeader.Characteristics & IMAGE_FILE_DLL) ||
+          !NtCurrentTeb()->Peb->ImageBaseAddress) &&
+        !(nt->FileHeader.Characteristics & IMAGE_FILE_RELOCS_STRIPPED) &&
+        map_relocated_image( hmapping, view ))
+    {
+        TRACE_(module)( "mapped shared copy relocated from %p-%p to %p-%p\n",
+                        base, base + total_size, ptr, ptr + total_size );
+        delta = ptr - base;
+        goto relocated;
+    }
+
     /* map all the sections */
 
     for (i = pos = 0; i < nt->FileHeader.NumberOfSections; i++, sec++)
@@ -1279,6 +1404,7 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
 
     /* set the image protections */
 
+ relocated:
     VIRTUAL_SetProt( view, ptr, ROUND_SIZE( 0, header_size ), VPROT_COMMITTED | VPROT_READ );
 
     sec = sections;
@@ -1375,6 +1501,7 @@ void virtual_init(void)
     assert( heap_base != (void *)-1 );
     virtual_heap = RtlCreateHeap( HEAP_NO_SERIALIZE, heap_base, VIRTUAL_HEAP_SIZE,
                                   VIRTUAL_HEAP_SIZE, NULL, NULL );
+    wine_rb_init( &views_tree, &views_tree_functions );
     create_view( &heap_view, heap_base, VIRTUAL_HEAP_SIZE, VPROT_COMMITTED | VPROT_READ | VPROT_WRITE );
 
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
@@ -2239,30 +2366,22 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     /* Find the view containing the address */
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
-    ptr = list_head( &views_list );
-    for (;;)
+    if ((view = find_view_above( base )) && (char *)view->base <= base)
     {
-        if (!ptr)
-        {
-            size = (char *)working_set_limit - alloc_base;
-            view = NULL;
-            break;
-        }
-        view = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)view->base > base)
-        {
-            size = (char *)view->base - alloc_base;
-            view = NULL;
-            break;
-        }
-        if ((char *)view->base + view->size > base)
+        alloc_base = view->base;
+        size = view->size;
+    }
+    else
+    {
+        /* the free area extends from the end of the previous view */
+        ptr = view ? list_prev( &views_list, &view->entry ) : list_tail( &views_list );
+        if (ptr)
         {
-            alloc_base = view->base;
-            size = view->size;
-            break;
+            struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
+            alloc_base = (char *)prev->base + prev->size;
         }
-        alloc_base = (char *)view->base + view->size;
-        ptr = list_next( &views_list, ptr );
+        size = (view ? (char *)view->base : (char *)working_set_limit) - alloc_base;
+        view = NULL;
     }
 
     /* Fill the info structure */
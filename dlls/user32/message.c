@@ -2721,6 +2721,84 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+/***********************************************************************
+ *           get_server_queue_handle
+ *
+ * Get a handle to the server message queue for the current thread.
+ */
+static HANDLE get_server_queue_handle(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    HANDLE ret, shared = 0;
+    data_size_t offset = 0;
+
+    if (!(ret = thread_info->server_queue))
+    {
+        SERVER_START_REQ( get_msg_queue )
+        {
+            wine_server_call( req );
+            ret = wine_server_ptr_handle( reply->handle );
+            shared = wine_server_ptr_handle( reply->shared );
+            offset = reply->shared_offset;
+        }
+        SERVER_END_REQ;
+        thread_info->server_queue = ret;
+        if (!ret) ERR( "Cannot get server thread queue\n" );
+        if (shared)
+        {
+            if ((thread_info->shared_queue_view = MapViewOfFile( shared, FILE_MAP_READ, 0, 0, 0 )))
+                thread_info->shared_queue = (const struct queue_shm *)((const char *)thread_info->shared_queue_view + offset);
+            CloseHandle( shared );
+        }
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           is_queue_empty
+ *
+ * Check in the queue state shared with the server whether a get_message
+ * request with these parameters is known to find nothing, in which case
+ * there is no need to ask the server again.
+ */
+static BOOL is_queue_empty( HWND hwnd, UINT first, UINT last, UINT flags, UINT changed_mask )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    const volatile struct queue_shm *shared = thread_info->shared_queue;
+    unsigned int filter = flags >> 16;
+    BOOL ret;
+    int seq;
+
+    if (!shared) return FALSE;
+    /* still call the server from time to time, it uses this to detect hung applications */
+    if (GetTickCount() - thread_info->last_get_msg > 100) return FALSE;
+    if (hwnd && hwnd != HWND_TOPMOST)
+    {
+        /* the cached state doesn't know whether the window still exists */
+        WND *win = WIN_GetPtr( hwnd );
+
+        if (!win || win == WND_OTHER_PROCESS || win == WND_DESKTOP) return FALSE;
+        WIN_ReleasePtr( win );
+    }
+    if (!filter) filter = QS_ALLINPUT;
+
+    seq = shared->seq;
+    if (seq & 1) return FALSE;  /* being updated */
+    read_barrier();
+    ret = (shared->empty &&
+           shared->flags == flags &&
+           shared->get_win == wine_server_user_handle( hwnd ) &&
+           shared->get_first == first &&
+           shared->get_last == last &&
+           shared->wake_mask == (changed_mask & (QS_SENDMESSAGE | QS_SMRESULT)) &&
+           shared->changed_mask == changed_mask &&
+           !(shared->wake_bits & (filter | QS_SENDMESSAGE | QS_POSTMESSAGE)));
+    read_barrier();
+    return ret && shared->seq == seq;
+}
+
+
 /***********************************************************************
  *           peek_message
  *
@@ -2736,17 +2814,21 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     void *buffer;
     size_t buffer_size = 256;
 
-    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
-
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
+    if (!thread_info->server_queue) get_server_queue_handle();
+    if (is_queue_empty( hwnd, first, last, flags, changed_mask )) return FALSE;
+
+    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
+
     for (;;)
     {
         NTSTATUS res;
         size_t size = 0;
         const message_data_t *msg_data = buffer;
 
+        thread_info->last_get_msg = GetTickCount();
         SERVER_START_REQ( get_message )
         {
             req->flags     = flags;
@@ -2969,31 +3051,6 @@ static inline void process_sent_messages(void)
 }
 
 
-/***********************************************************************
- *           get_server_queue_handle
- *
- * Get a handle to the server message queue for the current thread.
- */
-static HANDLE get_server_queue_handle(void)
-{
-    struct user_thread_info *thread_info = get_user_thread_info();
-    HANDLE ret;
-
-    if (!(ret = thread_info->server_queue))
-    {
-        SERVER_START_REQ( get_msg_queue )
-        {
-            wine_server_call( req );
-            ret = wine_server_ptr_handle( reply->handle );
-        }
-        SERVER_END_REQ;
-        thread_info->server_queue = ret;
-        if (!ret) ERR( "Cannot get server thread queue\n" );
-    }
-    return ret;
-}
-
-
 /***********************************************************************
  *           wait_message_reply
  *
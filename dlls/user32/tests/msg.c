@@ -10332,6 +10332,73 @@ done:
     flush_events();
 }
 
+static DWORD WINAPI post_thread_message_proc( void *arg )
+{
+    DWORD tid = PtrToUlong( arg );
+    BOOL ret = PostThreadMessageA( tid, WM_USER + 1, 0x1234, 0 );
+    ok( ret, "PostThreadMessage failed with error %u\n", GetLastError() );
+    return 0;
+}
+
+static void test_PeekMessage_empty_queue(void)
+{
+    DWORD start, elapsed, count = 0;
+    HANDLE thread;
+    MSG msg;
+    BOOL ret;
+    int i;
+
+    flush_events();
+
+    /* peek repeatedly on an empty queue */
+    start = GetTickCount();
+    do
+    {
+        for (i = 0; i < 1000; i++)
+        {
+            ret = PeekMessageA( &msg, 0, 0, 0, PM_REMOVE );
+            ok( !ret, "got message %04x\n", msg.message );
+            if (ret) break;
+        }
+        count += i;
+        elapsed = GetTickCount() - start;
+    } while (!ret && elapsed < 200);
+    trace( "%u empty PeekMessage calls in %u ms\n", count, elapsed );
+
+    /* a message posted by another thread must be seen right away */
+    thread = CreateThread( NULL, 0, post_thread_message_proc, ULongToPtr( GetCurrentThreadId() ), 0, NULL );
+    ok( thread != NULL, "CreateThread failed with error %u\n", GetLastError() );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+    ret = PeekMessageA( &msg, 0, 0, 0, PM_REMOVE );
+    ok( ret, "no message available\n" );
+    ok( msg.message == WM_USER + 1 && msg.wParam == 0x1234, "got message %04x wparam %lx\n",
+        msg.message, msg.wParam );
+    ok( !PeekMessageA( &msg, 0, 0, 0, PM_REMOVE ), "got message %04x\n", msg.message );
+
+    /* messages outside of the filter range don't change the result of a filtered peek */
+    for (i = 0; i < 100; i++)
+        ok( !PeekMessageA( &msg, 0, WM_USER + 2, WM_USER + 2, PM_REMOVE ), "got message %04x\n", msg.message );
+    PostThreadMessageA( GetCurrentThreadId(), WM_USER + 1, 0, 0 );
+    ok( !PeekMessageA( &msg, 0, WM_USER + 2, WM_USER + 2, PM_REMOVE ), "got message %04x\n", msg.message );
+    PostThreadMessageA( GetCurrentThreadId(), WM_USER + 2, 0, 0 );
+    ret = PeekMessageA( &msg, 0, WM_USER + 2, WM_USER + 2, PM_REMOVE );
+    ok( ret && msg.message == WM_USER + 2, "expected WM_USER+2, got %d %04x\n", ret, msg.message );
+    ret = PeekMessageA( &msg, 0, 0, 0, PM_REMOVE );
+    ok( ret && msg.message == WM_USER + 1, "expected WM_USER+1, got %d %04x\n", ret, msg.message );
+    ok( !PeekMessageA( &msg, 0, 0, 0, PM_REMOVE ), "got message %04x\n", msg.message );
+
+    /* neither does a message that has been peeked without removing it */
+    PostThreadMessageA( GetCurrentThreadId(), WM_USER + 1, 0, 0 );
+    for (i = 0; i < 100; i++)
+    {
+        ret = PeekMessageA( &msg, 0, 0, 0, PM_NOREMOVE );
+        ok( ret && msg.message == WM_USER + 1, "expected WM_USER+1, got %d %04x\n", ret, msg.message );
+    }
+    ok( PeekMessageA( &msg, 0, 0, 0, PM_REMOVE ), "no message available\n" );
+    ok( !PeekMessageA( &msg, 0, 0, 0, PM_REMOVE ), "got message %04x\n", msg.message );
+}
+
 static INT_PTR CALLBACK wm_quit_dlg_proc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
 {
     struct recvd_message msg;
@@ -14341,6 +14408,7 @@ START_TEST(msg)
     test_ShowWindow();
     test_PeekMessage();
     test_PeekMessage2();
+    test_PeekMessage_empty_queue();
     test_WaitForInputIdle( test_argv[0] );
     test_scrollwindowex();
     test_messages();
@@ -7469,10 +7469,100 @@ todo_wine
     DestroyWindow(parent);
 }
 
+static void test_other_process_child( char **argv )
+{
+    HWND parent, child;
+    DWORD pid = 0, expect_pid;
+    RECT rect, expect_window, expect_client;
+
+    sscanf( argv[3], "%p", &parent );
+    sscanf( argv[4], "%p", &child );
+    sscanf( argv[5], "%u", &expect_pid );
+    sscanf( argv[6], "%d,%d,%d,%d", &expect_window.left, &expect_window.top,
+            &expect_window.right, &expect_window.bottom );
+    sscanf( argv[7], "%d,%d,%d,%d", &expect_client.left, &expect_client.top,
+            &expect_client.right, &expect_client.bottom );
+
+    if (!strcmp( argv[2], "destroyed" ))
+    {
+        ok( !IsWindow( child ), "window %p should be destroyed\n", child );
+        ok( !GetWindowThreadProcessId( child, NULL ), "got a thread for destroyed window %p\n", child );
+        return;
+    }
+
+    ok( IsWindow( child ), "window %p should exist\n", child );
+    ok( GetWindowThreadProcessId( child, &pid ) != 0, "no thread for window %p\n", child );
+    ok( pid == expect_pid, "wrong process %x/%x\n", pid, expect_pid );
+    ok( GetParent( child ) == parent, "wrong parent %p/%p\n", GetParent( child ), parent );
+    ok( (GetWindowLongA( child, GWL_STYLE ) & (WS_CHILD | WS_BORDER)) == (WS_CHILD | WS_BORDER),
+        "wrong style %08x\n", GetWindowLongA( child, GWL_STYLE ) );
+    ok( !(GetWindowLongA( child, GWL_EXSTYLE ) & WS_EX_LAYOUTRTL),
+        "wrong ex style %08x\n", GetWindowLongA( child, GWL_EXSTYLE ) );
+    GetWindowRect( child, &rect );
+    ok( EqualRect( &rect, &expect_window ), "wrong window rect %d,%d-%d,%d\n",
+        rect.left, rect.top, rect.right, rect.bottom );
+    GetClientRect( child, &rect );
+    ok( EqualRect( &rect, &expect_client ), "wrong client rect %d,%d-%d,%d\n",
+        rect.left, rect.top, rect.right, rect.bottom );
+}
+
+static void run_other_process_child( const char *test, HWND parent, HWND child )
+{
+    char **argv, cmdline[MAX_PATH + 128];
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    RECT window_rect, client_rect;
+
+    SetRectEmpty( &window_rect );
+    SetRectEmpty( &client_rect );
+    if (IsWindow( child ))
+    {
+        GetWindowRect( child, &window_rect );
+        GetClientRect( child, &client_rect );
+    }
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "%s win %s %p %p %u %d,%d,%d,%d %d,%d,%d,%d", argv[0], test, parent, child,
+             GetCurrentProcessId(), window_rect.left, window_rect.top, window_rect.right,
+             window_rect.bottom, client_rect.left, client_rect.top, client_rect.right,
+             client_rect.bottom );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ok( CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+        "CreateProcess failed\n" );
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+}
+
+static void test_other_process( HWND parent )
+{
+    HWND child;
+
+    child = CreateWindowExA( 0, "static", NULL, WS_CHILD | WS_BORDER,
+                             10, 20, 50, 40, parent, 0, 0, NULL );
+    ok( child != 0, "CreateWindowEx failed\n" );
+    run_other_process_child( "window", parent, child );
+
+    SetWindowPos( child, 0, 30, 40, 80, 60, SWP_NOZORDER | SWP_NOACTIVATE );
+    run_other_process_child( "window", parent, child );
+
+    DestroyWindow( child );
+    run_other_process_child( "destroyed", parent, child );
+}
+
 START_TEST(win)
 {
     HMODULE user32 = GetModuleHandleA( "user32.dll" );
     HMODULE gdi32 = GetModuleHandleA("gdi32.dll");
+    char **argv;
+    int argc = winetest_get_mainargs( &argv );
+
+    if (argc >= 8)
+    {
+        test_other_process_child( argv );
+        return;
+    }
+
     pGetAncestor = (void *)GetProcAddress( user32, "GetAncestor" );
     pGetWindowInfo = (void *)GetProcAddress( user32, "GetWindowInfo" );
     pGetWindowModuleFileNameA = (void *)GetProcAddress( user32, "GetWindowModuleFileNameA" );
@@ -7579,6 +7669,7 @@ START_TEST(win)
     test_winregion();
     test_map_points();
     test_update_region();
+    test_other_process( hwndMain );
 
     /* add the tests above this line */
     if (hhook) UnhookWindowsHookEx(hhook);
@@ -187,8 +187,11 @@ struct user_thread_info
     HWND                          top_window;             /* Desktop window */
     HWND                          msg_window;             /* HWND_MESSAGE parent window */
     RAWINPUT                     *rawinput;
+    const struct queue_shm       *shared_queue;           /* Queue state shared with the server */
+    void                         *shared_queue_view;      /* View of the section holding it */
+    DWORD                         last_get_msg;           /* Time of last get_message request */
 
-    ULONG                         pad[8];                 /* Available for more data */
+    ULONG                         pad[2];                 /* Available for more data */
 };
 
 struct hook_extra_info
@@ -208,6 +211,16 @@ static inline BOOL is_broadcast( HWND hwnd )
     return (hwnd == HWND_BROADCAST || hwnd == HWND_TOPMOST);
 }
 
+/* compiler barrier for reading state that the server updates concurrently */
+static inline void read_barrier(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "" : : : "memory" );
+#else
+    __sync_synchronize();
+#endif
+}
+
 extern HMODULE user32_module DECLSPEC_HIDDEN;
 
 struct dce;
@@ -607,6 +607,66 @@ done:
 }
 
 
+/***********************************************************************
+ *           get_shared_windows
+ *
+ * Map the window state that the server shares with all processes.
+ */
+static const struct window_shm *get_shared_windows(void)
+{
+    static const struct window_shm *shared_windows;
+    static BOOL failed;
+    HANDLE handle = 0;
+    void *ptr;
+
+    if (shared_windows || failed) return shared_windows;
+
+    SERVER_START_REQ( get_shared_windows )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+
+    if (!handle || !(ptr = MapViewOfFile( handle, FILE_MAP_READ, 0, 0, 0 ))) failed = TRUE;
+    else if (InterlockedCompareExchangePointer( (void **)&shared_windows, ptr, NULL ))
+        UnmapViewOfFile( ptr );  /* another thread mapped it first */
+    if (handle) CloseHandle( handle );
+    return shared_windows;
+}
+
+
+/***********************************************************************
+ *           get_shared_window
+ *
+ * Get a consistent copy of the state of a window of any process from the
+ * area shared with the server. Return FALSE if the server has to be asked.
+ */
+static BOOL get_shared_window( HWND hwnd, struct window_shm *info )
+{
+    const volatile struct window_shm *shared;
+    UINT index = USER_HANDLE_TO_INDEX( hwnd );
+    int seq, retry;
+
+    if (index >= NB_USER_HANDLES) return FALSE;
+    if (!(shared = get_shared_windows())) return FALSE;
+    shared += index;
+
+    for (retry = 0; retry < 8; retry++)
+    {
+        seq = shared->seq;
+        if (seq & 1) continue;  /* being updated */
+        read_barrier();
+        memcpy( info, (const void *)shared, sizeof(*info) );
+        read_barrier();
+        if (shared->seq != seq) continue;
+
+        if (!info->handle) return FALSE;
+        return ((UINT)(UINT_PTR)hwnd == info->handle || !HIWORD(hwnd) || HIWORD(hwnd) == 0xffff);
+    }
+    return FALSE;
+}
+
+
 /***********************************************************************
  *           WIN_GetPtr
  *
@@ -689,6 +749,10 @@ HWND WIN_GetFullHandle( HWND hwnd )
     }
     else  /* may belong to another process */
     {
+        struct window_shm info;
+
+        if (get_shared_window( hwnd, &info )) return wine_server_ptr_handle( info.handle );
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -791,6 +855,73 @@ ULONG WIN_SetStyle( HWND hwnd, ULONG set_bits, ULONG clear_bits )
 }
 
 
+/***********************************************************************
+ *           get_shared_rectangles
+ *
+ * Get the rectangles of a window of another process from the shared window
+ * state, the same way the server would compute them.
+ */
+static BOOL get_shared_rectangles( HWND hwnd, enum coords_relative relative,
+                                   RECT *rectWindow, RECT *rectClient )
+{
+    struct window_shm info, parent;
+    RECT window_rect, client_rect, rect;
+    HWND handle;
+    UINT depth;
+
+    if (!get_shared_window( hwnd, &info )) return FALSE;
+
+    SetRect( &window_rect, info.window_rect.left, info.window_rect.top,
+             info.window_rect.right, info.window_rect.bottom );
+    SetRect( &client_rect, info.client_rect.left, info.client_rect.top,
+             info.client_rect.right, info.client_rect.bottom );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        rect = client_rect;
+        OffsetRect( &window_rect, -rect.left, -rect.top );
+        OffsetRect( &client_rect, -rect.left, -rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &window_rect );
+        break;
+    case COORDS_WINDOW:
+        rect = window_rect;
+        OffsetRect( &window_rect, -rect.left, -rect.top );
+        OffsetRect( &client_rect, -rect.left, -rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &client_rect );
+        break;
+    case COORDS_PARENT:
+        if (!info.parent) break;
+        if (!get_shared_window( wine_server_ptr_handle( info.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            SetRect( &rect, parent.client_rect.left, parent.client_rect.top,
+                     parent.client_rect.right, parent.client_rect.bottom );
+            mirror_rect( &rect, &window_rect );
+            mirror_rect( &rect, &client_rect );
+        }
+        break;
+    case COORDS_SCREEN:
+        /* the entries may be updated while we walk them, so don't trust the chain blindly */
+        for (handle = wine_server_ptr_handle( info.parent ), depth = 0; handle; depth++)
+        {
+            if (depth >= NB_USER_HANDLES) return FALSE;
+            if (!get_shared_window( handle, &parent )) return FALSE;
+            if (!parent.parent) break;  /* reached the desktop */
+            OffsetRect( &window_rect, parent.client_rect.left, parent.client_rect.top );
+            OffsetRect( &client_rect, parent.client_rect.left, parent.client_rect.top );
+            handle = wine_server_ptr_handle( parent.parent );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (rectWindow) *rectWindow = window_rect;
+    if (rectClient) *rectClient = client_rect;
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           WIN_GetRectangles
  *
@@ -898,6 +1029,8 @@ BOOL WIN_GetRectangles( HWND hwnd, enum coords_relative relative, RECT *rectWind
     }
 
 other_process:
+    if (get_shared_rectangles( hwnd, relative, rectWindow, rectClient )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2206,11 +2339,16 @@ static LONG_PTR WIN_GetWindowLong( HWND hwnd, INT offset, UINT size, BOOL unicod
 
     if (wndPtr == WND_OTHER_PROCESS || wndPtr == WND_DESKTOP)
     {
+        struct window_shm info;
+
         if (offset == GWLP_WNDPROC)
         {
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if ((offset == GWL_STYLE || offset == GWL_EXSTYLE) && get_shared_window( hwnd, &info ))
+            return (offset == GWL_STYLE) ? info.style : info.ex_style;
+
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -2791,6 +2929,7 @@ INT WINAPI GetWindowTextLengthW( HWND hwnd )
  */
 BOOL WINAPI IsWindow( HWND hwnd )
 {
+    struct window_shm info;
     WND *ptr;
     BOOL ret;
 
@@ -2804,6 +2943,8 @@ BOOL WINAPI IsWindow( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_shared_window( hwnd, &info )) return TRUE;
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2819,6 +2960,7 @@ BOOL WINAPI IsWindow( HWND hwnd )
  */
 DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
 {
+    struct window_shm info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -2838,6 +2980,12 @@ DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
     }
 
     /* check other processes */
+    if (ptr == WND_OTHER_PROCESS && get_shared_window( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2868,7 +3016,16 @@ HWND WINAPI GetParent( HWND hwnd )
     if (wndPtr == WND_DESKTOP) return 0;
     if (wndPtr == WND_OTHER_PROCESS)
     {
-        LONG style = GetWindowLongW( hwnd, GWL_STYLE );
+        struct window_shm info;
+        LONG style;
+
+        if (get_shared_window( hwnd, &info ))
+        {
+            if (info.style & WS_POPUP) retvalue = wine_server_ptr_handle( info.owner );
+            else if (info.style & WS_CHILD) retvalue = wine_server_ptr_handle( info.parent );
+            return retvalue;
+        }
+        style = GetWindowLongW( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
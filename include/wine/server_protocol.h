@@ -203,6 +203,54 @@ struct wake_up_reply
 };
 
 
+struct reply_shm
+{
+    int          seq;
+    int          waiting;
+    int          use_pipe;
+    int          __pad;
+    struct request_max_size reply;
+
+};
+#define REPLY_SHM_SIZE 0x10000
+
+
+struct queue_shm
+{
+    int           seq;
+    unsigned int  wake_bits;
+    unsigned int  changed_bits;
+    unsigned int  wake_mask;
+    unsigned int  changed_mask;
+    int           empty;
+    unsigned int  flags;
+    user_handle_t get_win;
+    unsigned int  get_first;
+    unsigned int  get_last;
+};
+
+
+struct client_sync_shm
+{
+    int           value;
+    unsigned int  type;
+    int           max;
+    int           __pad;
+};
+#define CLIENT_SYNC_AUTO_EVENT    1
+#define CLIENT_SYNC_MANUAL_EVENT  2
+#define CLIENT_SYNC_SEMAPHORE     3
+#define CLIENT_SYNC_PROMOTED      (-1)
+
+
+#define CLIENT_SYNC_HANDLES     0x10000
+#define CLIENT_SYNC_OBJECTS     0x4000
+#define CLIENT_SYNC_INDEX_MASK  0x00ffffff
+#define CLIENT_SYNC_WAIT        0x80000000
+#define CLIENT_SYNC_MODIFY      0x40000000
+#define CLIENT_SYNC_QUERY       0x20000000
+
+
 typedef __int64 timeout_t;
 #define TIMEOUT_INFINITE (((timeout_t)0x7fffffff) << 32 | 0xffffffff)
 
@@ -251,6 +299,29 @@ typedef struct
 } property_data_t;
 
 
+typedef struct
+{
+    apc_param_t    ckey;
+    apc_param_t    cvalue;
+    apc_param_t    information;
+    unsigned int   status;
+    int            __pad;
+} completion_data_t;
+
+
+#define REQUEST_STATS_BUCKETS 16
+typedef struct
+{
+    unsigned int     req;
+    unsigned int     count;
+    unsigned __int64 time;
+    unsigned int     max_time;
+    int              __pad;
+    unsigned int     histogram[REQUEST_STATS_BUCKETS];
+    char             name[32];
+} request_stats_t;
+
+
 typedef struct
 {
     int  left;
@@ -260,6 +331,22 @@ typedef struct
 } rectangle_t;
 
 
+struct window_shm
+{
+    int           seq;
+    user_handle_t handle;
+    user_handle_t parent;
+    user_handle_t owner;
+    thread_id_t   tid;
+    process_id_t  pid;
+    unsigned int  style;
+    unsigned int  ex_style;
+    rectangle_t   window_rect;
+    rectangle_t   client_rect;
+};
+#define WINDOW_SHM_ENTRIES ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
+
+
 typedef struct
 {
     obj_handle_t    handle;
@@ -760,7 +847,7 @@ struct init_thread_request
     int          reply_fd;
     int          wait_fd;
     cpu_type_t   cpu;
-    char __pad_52[4];
+    int          reply_shm_fd;
 };
 struct init_thread_reply
 {
@@ -771,7 +858,7 @@ struct init_thread_reply
     data_size_t  info_size;
     int          version;
     unsigned int all_cpus;
-    char __pad_36[4];
+    int          reply_shm;
 };
 
 
@@ -1112,8 +1199,8 @@ struct create_event_request
     unsigned int attributes;
     int          manual_reset;
     int          initial_state;
+    int          client_sync;
     /* VARARG(objattr,object_attributes); */
-    char __pad_28[4];
 };
 struct create_event_reply
 {
@@ -1254,8 +1341,8 @@ struct create_semaphore_request
     unsigned int attributes;
     unsigned int initial;
     unsigned int max;
+    int          client_sync;
     /* VARARG(objattr,object_attributes); */
-    char __pad_28[4];
 };
 struct create_semaphore_reply
 {
@@ -1266,6 +1353,20 @@ struct create_semaphore_reply
 
 
 
+struct get_client_sync_section_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_client_sync_section_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
 struct release_semaphore_request
 {
     struct request_header __header;
@@ -2147,6 +2248,21 @@ struct add_mapping_committed_range_reply
 };
 
 
+
+struct get_relocated_image_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+    client_ptr_t base;
+};
+struct get_relocated_image_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
 #define SNAP_PROCESS    0x00000001
 #define SNAP_THREAD     0x00000002
 
@@ -2810,7 +2926,9 @@ struct get_msg_queue_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    obj_handle_t shared;
+    data_size_t  shared_offset;
+    char __pad_20[4];
 };
 
 
@@ -3278,6 +3396,20 @@ struct set_window_owner_reply
 
 
 
+struct get_shared_windows_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_shared_windows_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
 struct get_window_info_request
 {
     struct request_header __header;
@@ -4907,6 +5039,19 @@ struct remove_completion_reply
 
 
 
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(packets,completions); */
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -5081,6 +5226,24 @@ struct set_suspend_context_reply
 };
 
 
+
+struct get_request_stats_request
+{
+    struct request_header __header;
+    process_id_t   pid;
+    int            reset;
+    char __pad_20[4];
+};
+struct get_request_stats_reply
+{
+    struct reply_header __header;
+    unsigned int   process_count;
+    char __pad_12[4];
+    timeout_t      process_time;
+    /* VARARG(stats,request_stats); */
+};
+
+
 enum request
 {
     REQ_new_process,
@@ -5118,6 +5281,7 @@ enum request
     REQ_release_mutex,
     REQ_open_mutex,
     REQ_create_semaphore,
+    REQ_get_client_sync_section,
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
@@ -5165,6 +5329,7 @@ enum request
     REQ_get_mapping_info,
     REQ_get_mapping_committed_range,
     REQ_add_mapping_committed_range,
+    REQ_get_relocated_image,
     REQ_create_snapshot,
     REQ_next_process,
     REQ_next_thread,
@@ -5233,6 +5398,7 @@ enum request
     REQ_destroy_window,
     REQ_get_desktop_window,
     REQ_set_window_owner,
+    REQ_get_shared_windows,
     REQ_get_window_info,
     REQ_set_window_info,
     REQ_set_parent,
@@ -5327,6 +5493,7 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
@@ -5338,6 +5505,7 @@ enum request
     REQ_update_rawinput_devices,
     REQ_get_suspend_context,
     REQ_set_suspend_context,
+    REQ_get_request_stats,
     REQ_NB_REQUESTS
 };
 
@@ -5380,6 +5548,7 @@ union generic_request
     struct release_mutex_request release_mutex_request;
     struct open_mutex_request open_mutex_request;
     struct create_semaphore_request create_semaphore_request;
+    struct get_client_sync_section_request get_client_sync_section_request;
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
@@ -5427,6 +5596,7 @@ union generic_request
     struct get_mapping_info_request get_mapping_info_request;
     struct get_mapping_committed_range_request get_mapping_committed_range_request;
     struct add_mapping_committed_range_request add_mapping_committed_range_request;
+    struct get_relocated_image_request get_relocated_image_request;
     struct create_snapshot_request create_snapshot_request;
     struct next_process_request next_process_request;
     struct next_thread_request next_thread_request;
@@ -5495,6 +5665,7 @@ union generic_request
     struct destroy_window_request destroy_window_request;
     struct get_desktop_window_request get_desktop_window_request;
     struct set_window_owner_request set_window_owner_request;
+    struct get_shared_windows_request get_shared_windows_request;
     struct get_window_info_request get_window_info_request;
     struct set_window_info_request set_window_info_request;
     struct set_parent_request set_parent_request;
@@ -5589,6 +5760,7 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
@@ -5600,6 +5772,7 @@ union generic_request
     struct update_rawinput_devices_request update_rawinput_devices_request;
     struct get_suspend_context_request get_suspend_context_request;
     struct set_suspend_context_request set_suspend_context_request;
+    struct get_request_stats_request get_request_stats_request;
 };
 union generic_reply
 {
@@ -5640,6 +5813,7 @@ union generic_reply
     struct release_mutex_reply release_mutex_reply;
     struct open_mutex_reply open_mutex_reply;
     struct create_semaphore_reply create_semaphore_reply;
+    struct get_client_sync_section_reply get_client_sync_section_reply;
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
@@ -5687,6 +5861,7 @@ union generic_reply
     struct get_mapping_info_reply get_mapping_info_reply;
     struct get_mapping_committed_range_reply get_mapping_committed_range_reply;
     struct add_mapping_committed_range_reply add_mapping_committed_range_reply;
+    struct get_relocated_image_reply get_relocated_image_reply;
     struct create_snapshot_reply create_snapshot_reply;
     struct next_process_reply next_process_reply;
     struct next_thread_reply next_thread_reply;
@@ -5755,6 +5930,7 @@ union generic_reply
     struct destroy_window_reply destroy_window_reply;
     struct get_desktop_window_reply get_desktop_window_reply;
     struct set_window_owner_reply set_window_owner_reply;
+    struct get_shared_windows_reply get_shared_windows_reply;
     struct get_window_info_reply get_window_info_reply;
     struct set_window_info_reply set_window_info_reply;
     struct set_parent_reply set_parent_reply;
@@ -5849,6 +6025,7 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
@@ -5860,8 +6037,9 @@ union generic_reply
     struct update_rawinput_devices_reply update_rawinput_devices_reply;
     struct get_suspend_context_reply get_suspend_context_reply;
     struct set_suspend_context_reply set_suspend_context_reply;
+    struct get_request_stats_reply get_request_stats_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 454
+#define SERVER_PROTOCOL_VERSION 463
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
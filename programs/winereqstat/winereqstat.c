@@ -0,0 +1,125 @@
+/*
+ * Dump the wineserver request handler statistics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "wine/server.h"
+
+static const char usage[] =
+    "Usage: winereqstat [-r] [pid]\n"
+    "  -r   reset the statistics after displaying them\n"
+    "  pid  also display the totals of the requests made by that process\n";
+
+static int compare_stats( const void *p1, const void *p2 )
+{
+    const request_stats_t *s1 = p1, *s2 = p2;
+
+    if (s1->time > s2->time) return -1;
+    if (s1->time < s2->time) return 1;
+    return 0;
+}
+
+static void dump_stats( const request_stats_t *stats, unsigned int count )
+{
+    unsigned __int64 total_time = 0;
+    unsigned int i, j, total_count = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        total_count += stats[i].count;
+        total_time += stats[i].time;
+    }
+
+    printf( "%-32s %10s %12s %8s %8s %6s  histogram (<1us,<2us,<4us,...)\n",
+            "request", "count", "total(us)", "avg(ns)", "max(us)", "%time" );
+    for (i = 0; i < count; i++)
+    {
+        printf( "%-32s %10u %12u %8u %8u %6.2f ",
+                stats[i].name, stats[i].count, (unsigned int)(stats[i].time / 1000),
+                (unsigned int)(stats[i].time / stats[i].count), stats[i].max_time / 1000,
+                total_time ? stats[i].time * 100.0 / total_time : 0.0 );
+        for (j = 0; j < REQUEST_STATS_BUCKETS; j++) printf( " %u", stats[i].histogram[j] );
+        printf( "\n" );
+    }
+    printf( "%-32s %10u %12u\n", "total", total_count, (unsigned int)(total_time / 1000) );
+}
+
+int main( int argc, char *argv[] )
+{
+    request_stats_t *stats;
+    unsigned int size = 64 * sizeof(*stats), count, process_count = 0;
+    timeout_t process_time = 0;
+    DWORD pid = 0;
+    int i, reset = 0;
+    NTSTATUS status;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp( argv[i], "-r" )) reset = 1;
+        else if (argv[i][0] >= '0' && argv[i][0] <= '9') pid = strtoul( argv[i], NULL, 0 );
+        else
+        {
+            fputs( usage, stderr );
+            return 1;
+        }
+    }
+
+    for (;;)
+    {
+        if (!(stats = HeapAlloc( GetProcessHeap(), 0, size ))) return 1;
+        SERVER_START_REQ( get_request_stats )
+        {
+            req->pid   = pid;
+            req->reset = reset;
+            wine_server_set_reply( req, stats, size );
+            status = wine_server_call( req );
+            count = wine_server_reply_size( reply ) / sizeof(*stats);
+            process_count = reply->process_count;
+            process_time = reply->process_time;
+        }
+        SERVER_END_REQ;
+        if (status || count * sizeof(*stats) < size) break;
+        HeapFree( GetProcessHeap(), 0, stats );
+        size *= 2;
+    }
+
+    if (status)
+    {
+        fprintf( stderr, "winereqstat: failed to get the request statistics (%08x)\n", status );
+        return 1;
+    }
+
+    qsort( stats, count, sizeof(*stats), compare_stats );
+    dump_stats( stats, count );
+    if (pid)
+        printf( "process %04x: %u requests, %u us\n", pid, process_count,
+                (unsigned int)(process_time / 10) );
+
+    HeapFree( GetProcessHeap(), 0, stats );
+    return 0;
+}
@@ -22,40 +22,93 @@
 #include "wine/port.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <unistd.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "thread.h"
+#include "process.h"
 #include "request.h"
 #include "security.h"
 
+/* section holding the state of the in-process events and semaphores of a process */
+struct client_sync_section
+{
+    struct object           obj;        /* object header */
+    struct mapping         *mapping;    /* mapping shared with the client */
+    unsigned int           *handles;    /* handle entries, written only by the server */
+    struct client_sync_shm *objects;    /* object states */
+    unsigned int            next;       /* next object index to try when allocating */
+    unsigned int            used[CLIENT_SYNC_OBJECTS / 32];  /* bitmap of the allocated objects */
+};
+
+#define CLIENT_SYNC_SECTION_SIZE (CLIENT_SYNC_HANDLES * sizeof(unsigned int) + \
+                                  CLIENT_SYNC_OBJECTS * sizeof(struct client_sync_shm))
+
+static void client_sync_section_dump( struct object *obj, int verbose );
+static void client_sync_section_destroy( struct object *obj );
+
+static const struct object_ops client_sync_section_ops =
+{
+    sizeof(struct client_sync_section), /* size */
+    client_sync_section_dump,      /* dump */
+    no_get_type,                   /* get_type */
+    no_add_queue,                  /* add_queue */
+    NULL,                          /* remove_queue */
+    NULL,                          /* signaled */
+    NULL,                          /* satisfied */
+    no_signal,                     /* signal */
+    no_get_fd,                     /* get_fd */
+    no_map_access,                 /* map_access */
+    default_get_sd,                /* get_sd */
+    default_set_sd,                /* set_sd */
+    no_lookup_name,                /* lookup_name */
+    no_open_file,                  /* open_file */
+    no_close_handle,               /* close_handle */
+    client_sync_section_destroy    /* destroy */
+};
+
+
 struct event
 {
     struct object  obj;             /* object header */
     int            manual_reset;    /* is it a manual reset event? */
     int            signaled;        /* event has been signaled */
+    struct client_sync_section *sync; /* section holding the in-process state, if any */
+    unsigned int   sync_index;      /* index of the object in the section */
 };
 
 static void event_dump( struct object *obj, int verbose );
 static struct object_type *event_get_type( struct object *obj );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int event_map_access( struct object *obj, unsigned int access );
 static int event_signal( struct object *obj, unsigned int access);
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     event_dump,                /* dump */
     event_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
+    event_add_queue,           /* add_queue */
     remove_queue,              /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
@@ -67,7 +120,7 @@ static const struct object_ops event_ops =
     no_lookup_name,            /* lookup_name */
     no_open_file,              /* open_file */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -102,6 +155,160 @@ static const struct object_ops keyed_event_ops =
 };
 
 
+static void client_sync_section_dump( struct object *obj, int verbose )
+{
+    assert( obj->ops == &client_sync_section_ops );
+    fprintf( stderr, "Client sync section\n" );
+}
+
+static void client_sync_section_destroy( struct object *obj )
+{
+    struct client_sync_section *section = (struct client_sync_section *)obj;
+    assert( obj->ops == &client_sync_section_ops );
+    if (section->handles) munmap( section->handles, CLIENT_SYNC_SECTION_SIZE );
+    if (section->mapping) release_object( section->mapping );
+}
+
+/* retrieve the client sync section of a process, creating it if needed */
+static struct client_sync_section *get_client_sync_section( struct process *process )
+{
+    struct client_sync_section *section;
+    void *ptr;
+
+    if (process->client_sync) return process->client_sync;
+    if (!(section = alloc_object( &client_sync_section_ops ))) return NULL;
+    section->handles = NULL;
+    section->next = 0;
+    memset( section->used, 0, sizeof(section->used) );
+    if (!(section->mapping = create_shared_mapping( CLIENT_SYNC_SECTION_SIZE, &ptr )))
+    {
+        release_object( section );
+        return NULL;
+    }
+    section->handles = ptr;
+    section->objects = (struct client_sync_shm *)(section->handles + CLIENT_SYNC_HANDLES);
+    process->client_sync = section;
+    return section;
+}
+
+/* wake up the client threads sleeping on an in-process object */
+static void wake_client_sync( struct client_sync_shm *obj )
+{
+#if defined(__linux__) && defined(__NR_futex)
+    syscall( __NR_futex, &obj->value, 1 /* FUTEX_WAKE */, INT_MAX, NULL, 0, 0 );
+#endif
+}
+
+/* retrieve the entry of a handle in the client sync section */
+static unsigned int *get_client_sync_handle( struct process *process, obj_handle_t handle )
+{
+    unsigned int index = (handle >> 2) - 1;
+
+    if (!process->client_sync || index >= CLIENT_SYNC_HANDLES) return NULL;
+    return &process->client_sync->handles[index];
+}
+
+/* build the handle entry of an in-process object */
+static unsigned int client_sync_handle_entry( struct process *process, obj_handle_t handle,
+                                              unsigned int index )
+{
+    unsigned int access = get_handle_access( process, handle );
+    unsigned int ret = index + 1;
+
+    /* the access rights have the same values for events and semaphores */
+    if (access & SYNCHRONIZE) ret |= CLIENT_SYNC_WAIT;
+    if (access & EVENT_MODIFY_STATE) ret |= CLIENT_SYNC_MODIFY;
+    if (access & EVENT_QUERY_STATE) ret |= CLIENT_SYNC_QUERY;
+    return ret;
+}
+
+/* allocate the in-process state of a newly created object and make a handle point to it */
+struct client_sync_section *alloc_client_sync( struct process *process, obj_handle_t handle,
+                                               unsigned int type, int value, int max,
+                                               unsigned int *index )
+{
+    struct client_sync_section *section = process->client_sync;
+    unsigned int *entry = get_client_sync_handle( process, handle );
+    unsigned int i, idx;
+
+    if (!entry) return NULL;
+
+    for (i = 0; i < CLIENT_SYNC_OBJECTS; i++)
+    {
+        idx = (section->next + i) % CLIENT_SYNC_OBJECTS;
+        if (section->used[idx / 32] & (1u << (idx % 32))) continue;
+        section->used[idx / 32] |= 1u << (idx % 32);
+        section->next = idx + 1;
+        section->objects[idx].value = value;
+        section->objects[idx].type  = type;
+        section->objects[idx].max   = max;
+        *entry = client_sync_handle_entry( process, handle, idx );
+        *index = idx;
+        return (struct client_sync_section *)grab_object( section );
+    }
+    return NULL;
+}
+
+/* free the in-process state of an object that is being destroyed */
+void free_client_sync( struct client_sync_section *section, unsigned int index )
+{
+    struct client_sync_shm *obj = &section->objects[index];
+
+    /* threads still waiting through a closed handle go back to the server */
+    obj->type = 0;
+    interlocked_xchg( &obj->value, CLIENT_SYNC_PROMOTED );
+    wake_client_sync( obj );
+    section->used[index / 32] &= ~(1u << (index % 32));
+    release_object( section );
+}
+
+/* take over the state of an in-process object; return -1 if it was already done */
+int promote_client_sync( struct client_sync_section *section, unsigned int index )
+{
+    struct client_sync_shm *obj = &section->objects[index];
+    int value = interlocked_xchg( &obj->value, CLIENT_SYNC_PROMOTED );
+
+    if (value < 0) return -1;
+    /* waiting threads will notice and continue their wait on the server */
+    wake_client_sync( obj );
+    return value;
+}
+
+/* make a handle point to the same in-process object as another handle of the same process */
+void dup_client_sync_handle( struct process *process, obj_handle_t src, obj_handle_t dst )
+{
+    unsigned int *src_entry = get_client_sync_handle( process, src );
+    unsigned int *dst_entry = get_client_sync_handle( process, dst );
+    unsigned int index;
+
+    if (!dst_entry) return;
+    index = src_entry ? *src_entry & CLIENT_SYNC_INDEX_MASK : 0;
+    *dst_entry = index ? client_sync_handle_entry( process, dst, index - 1 ) : 0;
+}
+
+/* forget the in-process object of a closed handle */
+void clear_client_sync_handle( struct process *process, obj_handle_t handle )
+{
+    unsigned int *entry = get_client_sync_handle( process, handle );
+
+    if (entry) *entry = 0;
+}
+
+static void promote_event( struct event *event )
+{
+    int value;
+
+    if (event->sync && (value = promote_client_sync( event->sync, event->sync_index )) >= 0)
+        event->signaled = (value != 0);
+}
+
+/* make sure the server object holds the state before it is used outside of its process */
+void promote_client_sync_object( struct object *obj )
+{
+    if (obj->ops == &event_ops) promote_event( (struct event *)obj );
+    else promote_semaphore( obj );
+}
+
 struct event *create_event( struct directory *root, const struct unicode_str *name,
                             unsigned int attr, int manual_reset, int initial_state,
                             const struct security_descriptor *sd )
@@ -115,6 +322,7 @@ struct event *create_event( struct directory *root, const struct unicode_str *na
             /* initialize it if it didn't already exist */
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->sync         = NULL;
             if (sd) default_set_sd( &event->obj, sd, OWNER_SECURITY_INFORMATION|
                                                      GROUP_SECURITY_INFORMATION|
                                                      DACL_SECURITY_INFORMATION|
@@ -126,7 +334,10 @@ struct event *create_event( struct directory *root, const struct unicode_str *na
 
 struct event *get_event_obj( struct process *process, obj_handle_t handle, unsigned int access )
 {
-    return (struct event *)get_handle_obj( process, handle, access, &event_ops );
+    struct event *event = (struct event *)get_handle_obj( process, handle, access, &event_ops );
+
+    if (event) promote_event( event );
+    return event;
 }
 
 void pulse_event( struct event *event )
@@ -166,6 +377,12 @@ static struct object_type *event_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    promote_event( (struct event *)obj );
+    return add_queue( obj, entry );
+}
+
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
@@ -200,10 +417,18 @@ static int event_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
+    promote_event( event );
     set_event( event );
     return 1;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->sync) free_client_sync( event->sync, event->sync_index );
+}
+
 struct keyed_event *create_keyed_event( struct directory *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -306,7 +531,13 @@ DECL_HANDLER(create_event)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, event, req->access, req->attributes );
         else
+        {
             reply->handle = alloc_handle_no_access_check( current->process, event, req->access, req->attributes );
+            if (reply->handle && req->client_sync && !name.len && !(req->attributes & OBJ_INHERIT))
+                event->sync = alloc_client_sync( current->process, reply->handle,
+                                                 req->manual_reset ? CLIENT_SYNC_MANUAL_EVENT : CLIENT_SYNC_AUTO_EVENT,
+                                                 req->initial_state != 0, 1, &event->sync_index );
+        }
         release_object( event );
     }
 
@@ -370,6 +601,16 @@ DECL_HANDLER(query_event)
     release_object( event );
 }
 
+/* retrieve the section holding the in-process events and semaphores */
+DECL_HANDLER(get_client_sync_section)
+{
+    struct client_sync_section *section;
+
+    if ((section = get_client_sync_section( current->process )))
+        reply->handle = alloc_handle( current->process, section->mapping,
+                                      SECTION_QUERY | SECTION_MAP_READ | SECTION_MAP_WRITE, 0 );
+}
+
 /* create a keyed event */
 DECL_HANDLER(create_keyed_event)
 {
@@ -376,6 +376,7 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
     entry->ptr = NULL;
+    clear_client_sync_handle( process, handle );
     table = handle_is_global(handle) ? global_table : process->handles;
     if (entry < table->entries + table->free) table->free = entry - table->entries;
     if (entry == table->entries + table->last) shrink_handle_table( table );
@@ -503,6 +504,8 @@ static int set_handle_flags( struct process *process, obj_handle_t handle, int m
     old_access = entry->access;
     mask  = (mask << RESERVED_SHIFT) & RESERVED_ALL;
     flags = (flags << RESERVED_SHIFT) & mask;
+    /* child processes will need the current state of in-process objects */
+    if (flags & RESERVED_INHERIT) promote_client_sync_object( entry->ptr );
     entry->access = (entry->access & ~mask) | flags;
     return (old_access & RESERVED_ALL) >> RESERVED_SHIFT;
 }
@@ -517,6 +520,8 @@ obj_handle_t duplicate_handle( struct process *src, obj_handle_t src_handle, str
     struct object *obj = get_handle_obj( src, src_handle, 0, NULL );
 
     if (!obj) return 0;
+    /* in-process objects are only shared between handles of their own process */
+    if (dst != src || (attr & OBJ_INHERIT)) promote_client_sync_object( obj );
     if ((entry = get_handle( src, src_handle )))
         src_access = entry->access;
     else  /* pseudo-handle, give it full access */
@@ -551,6 +556,7 @@ obj_handle_t duplicate_handle( struct process *src, obj_handle_t src_handle, str
             res = alloc_handle_entry( dst, obj, access, attr );
     }
 
+    if (res && dst == src) dup_client_sync_handle( src, src_handle, res );
     release_object( obj );
     return res;
 }
@@ -55,6 +55,7 @@ static void usage( FILE *fh )
     fprintf(fh, "   -h,    --help            display this help message\n");
     fprintf(fh, "   -k[n], --kill[=n]        kill the current wineserver, optionally with signal n\n");
     fprintf(fh, "   -p[n], --persistent[=n]  make server persistent, optionally for n seconds\n");
+    fprintf(fh, "   -t[n], --threads[=n]     run registry queries on n threads, default one per CPU\n");
     fprintf(fh, "   -v,    --version         display version information and exit\n");
     fprintf(fh, "   -w,    --wait            wait until the current wineserver terminates\n");
     fprintf(fh, "\n");
@@ -71,6 +72,7 @@ static void parse_args( int argc, char *argv[] )
         {"help",        0, NULL, 'h'},
         {"kill",        2, NULL, 'k'},
         {"persistent",  2, NULL, 'p'},
+        {"threads",     2, NULL, 't'},
         {"version",     0, NULL, 'v'},
         {"wait",        0, NULL, 'w'},
         { NULL,         0, NULL, 0}
@@ -78,7 +80,7 @@ static void parse_args( int argc, char *argv[] )
 
     server_argv0 = argv[0];
 
-    while ((optc = getopt_long( argc, argv, "d::fhk::p::vw", long_options, NULL )) != -1)
+    while ((optc = getopt_long( argc, argv, "d::fhk::p::t::vw", long_options, NULL )) != -1)
     {
         switch(optc)
         {
@@ -107,6 +109,13 @@ static void parse_args( int argc, char *argv[] )
                 else
                     master_socket_timeout = TIMEOUT_INFINITE;
                 break;
+            case 't':
+                if (optarg && isdigit(*optarg))
+                    worker_threads = atoi( optarg );
+                else
+                    worker_threads = sysconf( _SC_NPROCESSORS_ONLN );
+                if (worker_threads < 0) worker_threads = 0;
+                break;
             case 'v':
                 fprintf( stderr, "%s\n", wine_get_build_id());
                 exit(0);
@@ -145,6 +154,7 @@ int main( int argc, char *argv[] )
     init_signals();
     init_directories();
     init_registry();
+    start_worker_threads();
     main_loop();
     return 0;
 }
@@ -35,6 +35,7 @@
 #define WIN32_NO_STATUS
 #include "windef.h"
 #include "winternl.h"
+#include "wine/rbtree.h"
 
 #include "file.h"
 #include "handle.h"
@@ -43,16 +44,12 @@
 #include "request.h"
 #include "security.h"
 
-/* list of memory ranges, used to store committed info */
-struct ranges
+/* memory range, used to store committed info */
+struct range
 {
-    unsigned int count;
-    unsigned int max;
-    struct range
-    {
-        file_pos_t  start;
-        file_pos_t  end;
-    } ranges[1];
+    struct wine_rb_entry entry;      /* entry in the committed ranges tree */
+    file_pos_t           start;      /* start offset, the tree key */
+    file_pos_t           end;        /* end offset */
 };
 
 struct mapping
@@ -64,7 +61,7 @@ struct mapping
     enum cpu_type   cpu;             /* client CPU (for PE image mapping) */
     int             header_size;     /* size of headers (for PE image mapping) */
     client_ptr_t    base;            /* default base addr (for PE image mapping) */
-    struct ranges  *committed;       /* list of committed ranges in this mapping */
+    struct wine_rb_tree *committed;  /* tree of committed ranges in this mapping */
     struct file    *shared_file;     /* temp file for shared PE mapping */
     struct list     shared_entry;    /* entry in global shared PE mappings list */
 };
@@ -110,6 +107,47 @@ static const struct fd_ops mapping_fd_ops =
 
 static struct list shared_list = LIST_INIT(shared_list);
 
+/* copy of a PE image relocated to an address other than its default base */
+struct relocated_image
+{
+    struct list     entry;           /* entry in relocated_list */
+    struct fd      *fd;              /* fd of the image file */
+    client_ptr_t    base;            /* address the image has been relocated to */
+    struct file    *file;            /* temp file holding the relocated image */
+    off_t           size;            /* size of the image file when it was relocated */
+    time_t          mtime;           /* modification time of the image file */
+    time_t          ctime;           /* status change time of the image file */
+    unsigned long   mtime_nsec;      /* nanoseconds of the modification time */
+    unsigned long   ctime_nsec;      /* nanoseconds of the status change time */
+};
+
+#define MAX_RELOCATED_IMAGES 64
+
+static struct list relocated_list = LIST_INIT(relocated_list);  /* most recently used first */
+static unsigned int relocated_count;
+
+static inline unsigned long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+static inline unsigned long get_ctime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_CTIM
+    return st->st_ctim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_CTIMESPEC)
+    return st->st_ctimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
 static size_t page_mask;
 
 #define ROUND_SIZE(size)  (((size) + page_mask) & ~page_mask)
@@ -219,78 +257,134 @@ static inline void get_section_sizes( const IMAGE_SECTION_HEADER *sec, size_t *m
     if (*file_size > *map_size) *file_size = *map_size;
 }
 
-/* add a range to the committed list */
+static void *ranges_tree_alloc( size_t size )
+{
+    return malloc( size );
+}
+
+static void *ranges_tree_realloc( void *ptr, size_t size )
+{
+    return realloc( ptr, size );
+}
+
+static void ranges_tree_free( void *ptr )
+{
+    free( ptr );
+}
+
+static int compare_range( const void *key, const struct wine_rb_entry *entry )
+{
+    const file_pos_t *start = key;
+    const struct range *range = WINE_RB_ENTRY_VALUE( entry, const struct range, entry );
+
+    if (*start < range->start) return -1;
+    if (*start > range->start) return 1;
+    return 0;
+}
+
+static const struct wine_rb_functions ranges_tree_functions =
+{
+    ranges_tree_alloc,
+    ranges_tree_realloc,
+    ranges_tree_free,
+    compare_range
+};
+
+static void free_range( struct wine_rb_entry *entry, void *context )
+{
+    free( WINE_RB_ENTRY_VALUE( entry, struct range, entry ));
+}
+
+/* find the last range that starts at or below the given offset */
+static struct range *find_range_below( struct wine_rb_tree *tree, file_pos_t pos )
+{
+    struct wine_rb_entry *ptr = tree->root;
+    struct range *result = NULL;
+
+    while (ptr)
+    {
+        struct range *range = WINE_RB_ENTRY_VALUE( ptr, struct range, entry );
+
+        if (range->start <= pos)
+        {
+            result = range;
+            ptr = ptr->right;
+        }
+        else ptr = ptr->left;
+    }
+    return result;
+}
+
+/* find the first range that starts above the given offset */
+static struct range *find_range_above( struct wine_rb_tree *tree, file_pos_t pos )
+{
+    struct wine_rb_entry *ptr = tree->root;
+    struct range *result = NULL;
+
+    while (ptr)
+    {
+        struct range *range = WINE_RB_ENTRY_VALUE( ptr, struct range, entry );
+
+        if (range->start > pos)
+        {
+            result = range;
+            ptr = ptr->left;
+        }
+        else ptr = ptr->right;
+    }
+    return result;
+}
+
+/* add a range to the committed tree */
 static void add_committed_range( struct mapping *mapping, file_pos_t start, file_pos_t end )
 {
-    unsigned int i, j;
-    struct range *ranges;
+    struct range *range, *next;
 
     if (!mapping->committed) return;  /* everything committed already */
 
-    for (i = 0, ranges = mapping->committed->ranges; i < mapping->committed->count; i++)
+    /* extend the range below if it touches the new one, otherwise create a new one */
+    if (!(range = find_range_below( mapping->committed, start )) || range->end < start)
     {
-        if (ranges[i].start > end) break;
-        if (ranges[i].end < start) continue;
-        if (ranges[i].start > start) ranges[i].start = start;   /* extend downwards */
-        if (ranges[i].end < end)  /* extend upwards and maybe merge with next */
+        if (!(range = mem_alloc( sizeof(*range) ))) return;
+        range->start = start;
+        range->end   = end;
+        if (wine_rb_put( mapping->committed, &range->start, &range->entry ) == -1)
         {
-            for (j = i + 1; j < mapping->committed->count; j++)
-            {
-                if (ranges[j].start > end) break;
-                if (ranges[j].end > end) end = ranges[j].end;
-            }
-            if (j > i + 1)
-            {
-                memmove( &ranges[i + 1], &ranges[j], (mapping->committed->count - j) * sizeof(*ranges) );
-                mapping->committed->count -= j - (i + 1);
-            }
-            ranges[i].end = end;
+            free( range );
+            return;
         }
-        return;
     }
+    else if (range->end < end) range->end = end;
+    else return;
 
-    /* now add a new range */
-
-    if (mapping->committed->count == mapping->committed->max)
+    /* merge with the following ranges that are now touching it */
+    while ((next = find_range_above( mapping->committed, range->start )) && next->start <= range->end)
     {
-        unsigned int new_size = mapping->committed->max * 2;
-        struct ranges *new_ptr = realloc( mapping->committed, offsetof( struct ranges, ranges[new_size] ));
-        if (!new_ptr) return;
-        new_ptr->max = new_size;
-        ranges = new_ptr->ranges;
-        mapping->committed = new_ptr;
+        if (next->end > range->end) range->end = next->end;
+        wine_rb_remove( mapping->committed, &next->start );
+        free( next );
     }
-    memmove( &ranges[i + 1], &ranges[i], (mapping->committed->count - i) * sizeof(*ranges) );
-    ranges[i].start = start;
-    ranges[i].end = end;
-    mapping->committed->count++;
 }
 
 /* find the range containing start and return whether it's committed */
 static int find_committed_range( struct mapping *mapping, file_pos_t start, mem_size_t *size )
 {
-    unsigned int i;
-    struct range *ranges;
+    struct range *range;
 
     if (!mapping->committed)  /* everything is committed */
     {
         *size = mapping->size - start;
         return 1;
     }
-    for (i = 0, ranges = mapping->committed->ranges; i < mapping->committed->count; i++)
+    if ((range = find_range_below( mapping->committed, start )) && range->end > start)
     {
-        if (ranges[i].start > start)
-        {
-            *size = ranges[i].start - start;
-            return 0;
-        }
-        if (ranges[i].end > start)
-        {
-            *size = ranges[i].end - start;
-            return 1;
-        }
+        *size = range->end - start;
+        return 1;
     }
-    *size = mapping->size - start;
+    if ((range = find_range_above( mapping->committed, start )))
+        *size = range->start - start;
+    else
+        *size = mapping->size - start;
     return 0;
 }
 
@@ -466,6 +560,204 @@ static unsigned int get_image_params( struct mapping *mapping, int unix_fd, int
     return STATUS_INVALID_FILE_FOR_SECTION;
 }
 
+/* apply the base relocations to an image laid out in memory */
+static int relocate_image( char *ptr, mem_size_t size, mem_size_t delta )
+{
+    IMAGE_DOS_HEADER *dos = (IMAGE_DOS_HEADER *)ptr;
+    IMAGE_NT_HEADERS32 *nt = (IMAGE_NT_HEADERS32 *)(ptr + dos->e_lfanew);
+    IMAGE_DATA_DIRECTORY *relocs;
+    mem_size_t pos, end;
+
+    if ((unsigned int)dos->e_lfanew + sizeof(IMAGE_NT_HEADERS64) > size) return 0;
+    if (nt->FileHeader.Characteristics & IMAGE_FILE_RELOCS_STRIPPED) return 0;
+
+    switch (nt->OptionalHeader.Magic)
+    {
+    case IMAGE_NT_OPTIONAL_HDR32_MAGIC:
+        if (nt->OptionalHeader.NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_BASERELOC) return 0;
+        relocs = &nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+        break;
+    case IMAGE_NT_OPTIONAL_HDR64_MAGIC:
+        if (((IMAGE_NT_HEADERS64 *)nt)->OptionalHeader.NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_BASERELOC)
+            return 0;
+        relocs = &((IMAGE_NT_HEADERS64 *)nt)->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+        break;
+    default:
+        return 0;
+    }
+
+    pos = relocs->VirtualAddress;
+    end = pos + relocs->Size;
+    if (end > size) return 0;
+
+    while (pos + sizeof(IMAGE_BASE_RELOCATION) < end)
+    {
+        IMAGE_BASE_RELOCATION *rel = (IMAGE_BASE_RELOCATION *)(ptr + pos);
+        const USHORT *types = (const USHORT *)(rel + 1);
+        unsigned int i, count;
+        char *page;
+
+        if (!rel->SizeOfBlock) break;
+        if (rel->SizeOfBlock < sizeof(*rel) || rel->SizeOfBlock > end - pos) return 0;
+        if (rel->VirtualAddress > size) return 0;
+        page = ptr + rel->VirtualAddress;
+        count = (rel->SizeOfBlock - sizeof(*rel)) / sizeof(USHORT);
+
+        for (i = 0; i < count; i++)
+        {
+            unsigned int offset = types[i] & 0xfff;
+
+            if ((types[i] >> 12) != IMAGE_REL_BASED_ABSOLUTE &&
+                rel->VirtualAddress + offset + sizeof(int) > size) return 0;
+
+            switch (types[i] >> 12)
+            {
+            case IMAGE_REL_BASED_ABSOLUTE:
+                break;
+            case IMAGE_REL_BASED_HIGH:
+                *(short *)(page + offset) += delta >> 16;
+                break;
+            case IMAGE_REL_BASED_LOW:
+                *(short *)(page + offset) += delta;
+                break;
+            case IMAGE_REL_BASED_HIGHLOW:
+                *(int *)(page + offset) += delta;
+                break;
+            case IMAGE_REL_BASED_DIR64:
+                if (rel->VirtualAddress + offset + sizeof(INT64) > size) return 0;
+                *(INT64 *)(page + offset) += delta;
+                break;
+            default:  /* leave the more exotic types to the client */
+                return 0;
+            }
+        }
+        pos += rel->SizeOfBlock;
+    }
+    return 1;
+}
+
+/* build a temp file containing the image laid out and relocated to a given base address */
+static struct file *build_relocated_image( struct mapping *mapping, client_ptr_t base )
+{
+    IMAGE_DOS_HEADER *dos;
+    IMAGE_NT_HEADERS32 *nt;
+    IMAGE_SECTION_HEADER *sec;
+    struct file *file = NULL;
+    unsigned int i, nb_sec;
+    size_t map_size, file_size;
+    off_t file_start;
+    char *ptr;
+    int unix_fd, temp_fd;
+
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1) return NULL;
+    if ((temp_fd = create_temp_file( mapping->size )) == -1) return NULL;
+
+    ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, temp_fd, 0 );
+    if (ptr == MAP_FAILED)
+    {
+        file_set_error();
+        close( temp_fd );
+        return NULL;
+    }
+
+    /* copy the headers and the sections to their virtual addresses */
+
+    if (pread( unix_fd, ptr, min( mapping->header_size, mapping->size ), 0 ) <= 0) goto error;
+
+    dos = (IMAGE_DOS_HEADER *)ptr;
+    if ((unsigned int)dos->e_lfanew + sizeof(*nt) > mapping->header_size) goto error;
+    nt = (IMAGE_NT_HEADERS32 *)(ptr + dos->e_lfanew);
+    nb_sec = nt->FileHeader.NumberOfSections;
+    sec = (IMAGE_SECTION_HEADER *)((char *)&nt->OptionalHeader + nt->FileHeader.SizeOfOptionalHeader);
+    if ((char *)(sec + nb_sec) > ptr + mapping->header_size) goto error;
+
+    for (i = 0; i < nb_sec; i++)
+    {
+        get_section_sizes( &sec[i], &map_size, &file_start, &file_size );
+        if (sec[i].VirtualAddress > mapping->size || map_size > mapping->size - sec[i].VirtualAddress)
+            goto error;
+        if (!sec[i].PointerToRawData || !file_size) continue;
+        /* a partial sector at the end of the file is not an error */
+        if (pread( unix_fd, ptr + sec[i].VirtualAddress, file_size, file_start ) <= 0) goto error;
+    }
+
+    if (!relocate_image( ptr, mapping->size, base - mapping->base )) goto error;
+
+    file = create_file_for_fd( temp_fd, FILE_GENERIC_READ, 0 );
+    munmap( ptr, mapping->size );
+    return file;
+
+ error:
+    set_error( STATUS_NOT_SUPPORTED );
+    munmap( ptr, mapping->size );
+    close( temp_fd );
+    return NULL;
+}
+
+/* remove a relocated image from the cache; the caller frees or reuses the entry */
+static void remove_relocated_image( struct relocated_image *image )
+{
+    list_remove( &image->entry );
+    release_object( image->fd );
+    release_object( image->file );
+    relocated_count--;
+}
+
+/* find or create the relocated copy of an image for a given base address */
+static struct file *get_relocated_image( struct mapping *mapping, client_ptr_t base )
+{
+    struct relocated_image *image, *next;
+    struct file *file;
+    struct stat st;
+    int unix_fd;
+
+    /* the file may have been rewritten in place since it was relocated */
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1) return NULL;
+    if (fstat( unix_fd, &st ) == -1)
+    {
+        file_set_error();
+        return NULL;
+    }
+
+    LIST_FOR_EACH_ENTRY_SAFE( image, next, &relocated_list, struct relocated_image, entry )
+    {
+        if (!is_same_file_fd( image->fd, mapping->fd )) continue;
+        if (image->size != st.st_size || image->mtime != st.st_mtime || image->ctime != st.st_ctime ||
+            image->mtime_nsec != get_mtime_nsec( &st ) || image->ctime_nsec != get_ctime_nsec( &st ))
+        {
+            /* stale copy, drop it */
+            remove_relocated_image( image );
+            free( image );
+            continue;
+        }
+        if (image->base != base) continue;
+        list_remove( &image->entry );
+        list_add_head( &relocated_list, &image->entry );
+        return (struct file *)grab_object( image->file );
+    }
+
+    if (!(file = build_relocated_image( mapping, base ))) return NULL;
+
+    if (relocated_count == MAX_RELOCATED_IMAGES)
+    {
+        image = LIST_ENTRY( list_tail( &relocated_list ), struct relocated_image, entry );
+        remove_relocated_image( image );
+    }
+    else if (!(image = malloc( sizeof(*image) ))) return file;
+
+    image->fd    = (struct fd *)grab_object( mapping->fd );
+    image->base  = base;
+    image->file  = (struct file *)grab_object( file );
+    image->size  = st.st_size;
+    image->mtime = st.st_mtime;
+    image->ctime = st.st_ctime;
+    image->mtime_nsec = get_mtime_nsec( &st );
+    image->ctime_nsec = get_ctime_nsec( &st );
+    list_add_head( &relocated_list, &image->entry );
+    relocated_count++;
+    return file;
+}
+
 static struct object *create_mapping( struct directory *root, const struct unicode_str *name,
                                       unsigned int attr, mem_size_t size, int protect,
                                       obj_handle_t handle, const struct security_descriptor *sd )
@@ -555,9 +847,14 @@ static struct object *create_mapping( struct directory *root, const struct unico
         }
         if (!(protect & VPROT_COMMITTED))
         {
-            if (!(mapping->committed = mem_alloc( offsetof(struct ranges, ranges[8]) ))) goto error;
-            mapping->committed->count = 0;
-            mapping->committed->max   = 8;
+            if (!(mapping->committed = mem_alloc( sizeof(*mapping->committed) ))) goto error;
+            if (wine_rb_init( mapping->committed, &ranges_tree_functions ) == -1)
+            {
+                free( mapping->committed );
+                mapping->committed = NULL;
+                set_error( STATUS_NO_MEMORY );
+                goto error;
+            }
         }
         if ((unix_fd = create_temp_file( size )) == -1) goto error;
         if (!(mapping->fd = create_anonymous_fd( &mapping_fd_ops, unix_fd, &mapping->obj,
@@ -573,6 +870,27 @@ static struct object *create_mapping( struct directory *root, const struct unico
     return NULL;
 }
 
+/* create an anonymous mapping that is also mapped into the server address space */
+struct mapping *create_shared_mapping( mem_size_t size, void **ptr )
+{
+    static const struct unicode_str empty_str = { NULL, 0 };
+    struct mapping *mapping;
+    void *base;
+
+    if (!(mapping = (struct mapping *)create_mapping( NULL, &empty_str, 0, size,
+                                                      VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, 0, NULL )))
+        return NULL;
+    if ((base = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      get_unix_fd( mapping->fd ), 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        release_object( mapping );
+        return NULL;
+    }
+    *ptr = base;
+    return mapping;
+}
+
 struct mapping *get_mapping_obj( struct process *process, obj_handle_t handle, unsigned int access )
 {
     return (struct mapping *)get_handle_obj( process, handle, access, &mapping_ops );
@@ -642,7 +960,11 @@ static void mapping_destroy( struct object *obj )
         release_object( mapping->shared_file );
         list_remove( &mapping->shared_entry );
     }
-    free( mapping->committed );
+    if (mapping->committed)
+    {
+        wine_rb_destroy( mapping->committed, free_range, NULL );
+        free( mapping->committed );
+    }
 }
 
 static enum server_fd_type mapping_get_fd_type( struct fd *fd )
@@ -779,3 +1101,23 @@ DECL_HANDLER(add_mapping_committed_range)
         release_object( mapping );
     }
 }
+
+/* get a copy of an image mapping relocated to a given address */
+DECL_HANDLER(get_relocated_image)
+{
+    struct mapping *mapping;
+    struct file *file;
+
+    if (!(mapping = get_mapping_obj( current->process, req->handle, 0 ))) return;
+
+    if (!(mapping->protect & VPROT_IMAGE) || mapping->shared_file || !mapping->fd)
+        set_error( STATUS_NOT_SUPPORTED );
+    else if ((req->base & page_mask) || req->base == mapping->base)
+        set_error( STATUS_INVALID_PARAMETER );
+    else if ((file = get_relocated_image( mapping, req->base )))
+    {
+        reply->handle = alloc_handle( current->process, file, GENERIC_READ, 0 );
+        release_object( file );
+    }
+    release_object( mapping );
+}
@@ -45,6 +45,8 @@ struct object_name
     struct list         entry;           /* entry in the hash list */
     struct object      *obj;             /* object owning this name */
     struct object      *parent;          /* parent object */
+    struct namespace   *namespace;       /* namespace containing the name */
+    unsigned int        hash;            /* full hash value of the name */
     data_size_t         len;             /* name length in bytes */
     WCHAR               name[1];
 };
@@ -52,9 +54,17 @@ struct object_name
 struct namespace
 {
     unsigned int        hash_size;       /* size of hash table */
-    struct list         names[1];        /* array of hash entry lists */
+    unsigned int        count;           /* number of names in the namespace */
+    struct list        *names;           /* array of hash entry lists */
+    struct list        *old_names;       /* previous hash table while it is being rehashed */
+    unsigned int        old_size;        /* size of the previous hash table */
+    unsigned int        rehash_pos;      /* next bucket of the previous table to move */
+    struct list         initial[1];      /* initial hash table */
 };
 
+#define NAMESPACE_MAX_LOAD   4   /* average chain length that triggers a resize */
+#define NAMESPACE_REHASH_STEP 16 /* number of old buckets moved at each name insertion */
+
 
 #ifdef DEBUG_OBJECTS
 static struct list object_list = LIST_INIT(object_list);
@@ -120,12 +130,50 @@ void *memdup( const void *data, size_t len )
 
 /*****************************************************************/
 
-static int get_name_hash( const struct namespace *namespace, const WCHAR *name, data_size_t len )
+static unsigned int get_name_hash( const WCHAR *name, data_size_t len )
 {
-    WCHAR hash = 0;
+    unsigned int hash = 0;
     len /= sizeof(WCHAR);
-    while (len--) hash ^= tolowerW(*name++);
-    return hash % namespace->hash_size;
+    while (len--) hash = hash * 31 + tolowerW(*name++);
+    return hash;
+}
+
+/* move some buckets of the previous hash table to the current one */
+static void rehash_namespace( struct namespace *namespace )
+{
+    unsigned int end = min( namespace->rehash_pos + NAMESPACE_REHASH_STEP, namespace->old_size );
+    struct object_name *ptr, *next;
+
+    for ( ; namespace->rehash_pos < end; namespace->rehash_pos++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( ptr, next, &namespace->old_names[namespace->rehash_pos],
+                                  struct object_name, entry )
+        {
+            list_remove( &ptr->entry );
+            list_add_tail( &namespace->names[ptr->hash % namespace->hash_size], &ptr->entry );
+        }
+    }
+    if (namespace->rehash_pos < namespace->old_size) return;
+
+    if (namespace->old_names != namespace->initial) free( namespace->old_names );
+    namespace->old_names = NULL;
+    namespace->old_size = 0;
+}
+
+/* start moving the names to a larger hash table */
+static void grow_namespace( struct namespace *namespace )
+{
+    unsigned int i, new_size = namespace->hash_size * 2 + 1;
+    struct list *names;
+
+    if (!(names = malloc( new_size * sizeof(*names) ))) return;  /* keep using the current table */
+    for (i = 0; i < new_size; i++) list_init( &names[i] );
+
+    namespace->old_names  = namespace->names;
+    namespace->old_size   = namespace->hash_size;
+    namespace->rehash_pos = 0;
+    namespace->names      = names;
+    namespace->hash_size  = new_size;
 }
 
 /* allocate a name for an object */
@@ -137,6 +185,7 @@ static struct object_name *alloc_name( const struct unicode_str *name )
     {
         ptr->len = name->len;
         ptr->parent = NULL;
+        ptr->namespace = NULL;
         memcpy( ptr->name, name->str, name->len );
     }
     return ptr;
@@ -147,6 +196,7 @@ static void free_name( struct object *obj )
 {
     struct object_name *ptr = obj->name;
     list_remove( &ptr->entry );
+    if (ptr->namespace) ptr->namespace->count--;
     if (ptr->parent) release_object( ptr->parent );
     free( ptr );
 }
@@ -155,9 +205,13 @@ static void free_name( struct object *obj )
 static void set_object_name( struct namespace *namespace,
                              struct object *obj, struct object_name *ptr )
 {
-    int hash = get_name_hash( namespace, ptr->name, ptr->len );
+    if (namespace->old_names) rehash_namespace( namespace );
+    else if (namespace->count >= namespace->hash_size * NAMESPACE_MAX_LOAD) grow_namespace( namespace );
 
-    list_add_head( &namespace->names[hash], &ptr->entry );
+    ptr->hash = get_name_hash( ptr->name, ptr->len );
+    ptr->namespace = namespace;
+    list_add_head( &namespace->names[ptr->hash % namespace->hash_size], &ptr->entry );
+    namespace->count++;
     ptr->obj = obj;
     obj->name = ptr;
 }
@@ -319,40 +373,60 @@ void release_object( void *ptr )
     }
 }
 
-/* find an object by its name; the refcount is incremented */
-struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
-                            unsigned int attributes )
+/* find a name in a hash bucket */
+static struct object *find_name_in_list( const struct list *list, const struct unicode_str *name,
+                                         unsigned int hash, unsigned int attributes )
 {
-    const struct list *list;
     struct list *p;
 
-    if (!name || !name->len) return NULL;
-
-    list = &namespace->names[ get_name_hash( namespace, name->str, name->len ) ];
     LIST_FOR_EACH( p, list )
     {
         const struct object_name *ptr = LIST_ENTRY( p, struct object_name, entry );
-        if (ptr->len != name->len) continue;
+        if (ptr->hash != hash || ptr->len != name->len) continue;
         if (attributes & OBJ_CASE_INSENSITIVE)
         {
             if (!strncmpiW( ptr->name, name->str, name->len/sizeof(WCHAR) ))
-                return grab_object( ptr->obj );
+                return ptr->obj;
         }
         else
         {
             if (!memcmp( ptr->name, name->str, name->len ))
-                return grab_object( ptr->obj );
+                return ptr->obj;
         }
     }
     return NULL;
 }
 
+/* find an object by its name; the refcount is incremented */
+struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
+                            unsigned int attributes )
+{
+    struct object *obj;
+    unsigned int hash;
+
+    if (!name || !name->len) return NULL;
+
+    hash = get_name_hash( name->str, name->len );
+    obj = find_name_in_list( &namespace->names[hash % namespace->hash_size], name, hash, attributes );
+    if (!obj && namespace->old_names)  /* the name may not have been moved yet */
+        obj = find_name_in_list( &namespace->old_names[hash % namespace->old_size], name, hash, attributes );
+    return obj ? grab_object( obj ) : NULL;
+}
+
 /* find an object by its index; the refcount is incremented */
 struct object *find_object_index( const struct namespace *namespace, unsigned int index )
 {
     unsigned int i;
 
     /* FIXME: not efficient at all */
+    for (i = namespace->rehash_pos; i < namespace->old_size; i++)
+    {
+        const struct object_name *ptr;
+        LIST_FOR_EACH_ENTRY( ptr, &namespace->old_names[i], const struct object_name, entry )
+        {
+            if (!index--) return grab_object( ptr->obj );
+        }
+    }
     for (i = 0; i < namespace->hash_size; i++)
     {
         const struct object_name *ptr;
@@ -365,21 +439,53 @@ struct object *find_object_index( const struct namespace *namespace, unsigned in
     return NULL;
 }
 
+/* dump the hash table statistics of a namespace */
+void dump_namespace_stats( const struct namespace *namespace )
+{
+    unsigned int i, len, used = 0, max_len = 0;
+    struct list *p;
+
+    for (i = 0; i < namespace->hash_size; i++)
+    {
+        len = 0;
+        LIST_FOR_EACH( p, &namespace->names[i] ) len++;
+        if (len) used++;
+        if (len > max_len) max_len = len;
+    }
+    fprintf( stderr, "names=%u buckets=%u used=%u longest=%u%s",
+             namespace->count, namespace->hash_size, used, max_len,
+             namespace->old_names ? " rehashing" : "" );
+}
+
 /* allocate a namespace */
 struct namespace *create_namespace( unsigned int hash_size )
 {
     struct namespace *namespace;
     unsigned int i;
 
-    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->names[0]) );
+    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->initial[0]) );
     if (namespace)
     {
         namespace->hash_size      = hash_size;
+        namespace->count          = 0;
+        namespace->names          = namespace->initial;
+        namespace->old_names      = NULL;
+        namespace->old_size       = 0;
+        namespace->rehash_pos     = 0;
         for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
     }
     return namespace;
 }
 
+/* free a namespace; all the names it contains must have been freed already */
+void free_namespace( struct namespace *namespace )
+{
+    if (!namespace) return;
+    if (namespace->old_names && namespace->old_names != namespace->initial) free( namespace->old_names );
+    if (namespace->names != namespace->initial) free( namespace->names );
+    free( namespace );
+}
+
 /* functions for unimplemented/default object operations */
 
 struct object_type *no_get_type( struct object *obj )
@@ -124,6 +124,8 @@ extern void *create_named_object( struct namespace *namespace, const struct obje
 extern void unlink_named_object( struct object *obj );
 extern void make_object_static( struct object *obj );
 extern struct namespace *create_namespace( unsigned int hash_size );
+extern void free_namespace( struct namespace *namespace );
+extern void dump_namespace_stats( const struct namespace *namespace );
 /* grab/release_object can take any pointer, but you better make sure */
 /* that the thing pointed to starts with a struct object... */
 extern struct object *grab_object( void *obj );
@@ -165,6 +167,20 @@ extern void pulse_event( struct event *event );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
 
+/* in-process event and semaphore functions */
+
+struct client_sync_section;
+
+extern struct client_sync_section *alloc_client_sync( struct process *process, obj_handle_t handle,
+                                                      unsigned int type, int value, int max,
+                                                      unsigned int *index );
+extern void free_client_sync( struct client_sync_section *section, unsigned int index );
+extern int promote_client_sync( struct client_sync_section *section, unsigned int index );
+extern void promote_client_sync_object( struct object *obj );
+extern void dup_client_sync_handle( struct process *process, obj_handle_t src, obj_handle_t dst );
+extern void clear_client_sync_handle( struct process *process, obj_handle_t handle );
+extern void promote_semaphore( struct object *obj );
+
 /* mutex functions */
 
 extern void abandon_mutexes( struct thread *thread );
@@ -189,6 +205,9 @@ extern void debug_exit_thread( struct thread *thread );
 extern unsigned int get_prefix_cpu_mask(void);
 extern void init_registry(void);
 extern void flush_registry(void);
+extern int is_registry_request( enum request req );
+extern void lock_registry(void);
+extern void unlock_registry(void);
 
 /* signal functions */
 
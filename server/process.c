@@ -328,6 +328,7 @@ struct thread *create_process( int fd, struct thread *parent_thread, int inherit
     process->startup_state   = STARTUP_IN_PROGRESS;
     process->startup_info    = NULL;
     process->idle_event      = NULL;
+    process->client_sync     = NULL;
     process->peb             = 0;
     process->ldt_copy        = 0;
     process->winstation      = 0;
@@ -427,6 +428,7 @@ static void process_destroy( struct object *obj )
     if (process->msg_fd) release_object( process->msg_fd );
     list_remove( &process->entry );
     if (process->idle_event) release_object( process->idle_event );
+    if (process->client_sync) release_object( process->client_sync );
     if (process->id) free_ptid( process->id );
     if (process->token) release_object( process->token );
 }
@@ -635,6 +637,11 @@ static void process_killed( struct process *process )
         release_object( process->idle_event );
         process->idle_event = NULL;
     }
+    if (process->client_sync)
+    {
+        release_object( process->client_sync );
+        process->client_sync = NULL;
+    }
 
     /* close the console attached to this process, if any */
     free_console( process );
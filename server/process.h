@@ -81,6 +81,7 @@ struct process
     enum startup_state   startup_state;   /* startup state */
     struct startup_info *startup_info;    /* startup info while init is in progress */
     struct event        *idle_event;      /* event for input idle */
+    struct client_sync_section *client_sync; /* section holding the in-process events and semaphores */
     obj_handle_t         winstation;      /* main handle to process window station */
     obj_handle_t         desktop;         /* handle to desktop to use for new threads */
     struct token        *token;           /* security token associated with this process */
@@ -91,6 +92,8 @@ struct process
     struct list          rawinput_devices;/* list of registered rawinput devices */
     const struct rawinput_device *rawinput_mouse; /* rawinput mouse device, if any */
     const struct rawinput_device *rawinput_kbd;   /* rawinput keyboard device, if any */
+    unsigned int         req_count;       /* number of requests handled for this process */
+    unsigned __int64     req_time;        /* time spent handling them, in nanoseconds */
 };
 
 struct process_snapshot
@@ -135,6 +135,8 @@ struct msg_queue
     struct thread_input   *input;           /* thread input descriptor */
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
+    struct queue_shm_block *shared_block;   /* section block holding the state shared with the client */
+    struct queue_shm      *shared;          /* server view of the shared state */
 };
 
 struct hotkey
@@ -289,6 +291,8 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->input           = (struct thread_input *)grab_object( input );
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
+        queue->shared_block    = NULL;
+        queue->shared          = NULL;
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -416,11 +420,101 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
+/* number of queue states in each section shared with the clients */
+#define QUEUE_SHM_BLOCK_ENTRIES 1024
+
+/* section holding the shared state of a number of queues; the state of all
+ * queues is kept in a few such sections instead of one mapping per queue */
+struct queue_shm_block
+{
+    struct list            entry;           /* entry in the list of blocks */
+    struct mapping        *mapping;         /* mapping shared with the clients */
+    struct queue_shm      *entries;         /* server view of the mapping */
+    unsigned int           free;            /* number of free entries */
+    unsigned int           used[QUEUE_SHM_BLOCK_ENTRIES / 32];  /* bitmap of allocated entries */
+};
+
+static struct list queue_shm_blocks = LIST_INIT( queue_shm_blocks );
+
+/* allocate an entry for the shared state of a queue */
+static int alloc_shared_queue( struct msg_queue *queue )
+{
+    struct queue_shm_block *block;
+    unsigned int i, bit;
+    void *ptr;
+
+    LIST_FOR_EACH_ENTRY( block, &queue_shm_blocks, struct queue_shm_block, entry )
+        if (block->free) goto found;
+
+    if (!(block = mem_alloc( sizeof(*block) ))) return 0;
+    if (!(block->mapping = create_shared_mapping( QUEUE_SHM_BLOCK_ENTRIES * sizeof(*block->entries), &ptr )))
+    {
+        free( block );
+        return 0;
+    }
+    make_object_static( (struct object *)block->mapping );
+    block->entries = ptr;
+    block->free = QUEUE_SHM_BLOCK_ENTRIES;
+    memset( block->used, 0, sizeof(block->used) );
+    list_add_tail( &queue_shm_blocks, &block->entry );
+
+found:
+    for (i = 0; block->used[i] == ~0u; i++) ;
+    for (bit = 0; block->used[i] & (1u << bit); bit++) ;
+    block->used[i] |= 1u << bit;
+    block->free--;
+    queue->shared_block = block;
+    queue->shared = &block->entries[i * 32 + bit];
+    return 1;
+}
+
+/* release the shared state entry of a queue */
+static void free_shared_queue( struct msg_queue *queue )
+{
+    struct queue_shm_block *block = queue->shared_block;
+    unsigned int index = queue->shared - block->entries;
+
+    interlocked_xchg_add( &queue->shared->seq, 1 );
+    queue->shared->empty = 0;
+    interlocked_xchg_add( &queue->shared->seq, 1 );
+    block->used[index / 32] &= ~(1u << (index % 32));
+    block->free++;
+}
+
+/* copy the queue state to the area shared with the client */
+/* if req is set, it's a get_message request that didn't find anything */
+static void update_shared_queue( struct msg_queue *queue, const struct get_message_request *req )
+{
+    struct queue_shm *shared = queue->shared;
+
+    if (!shared) return;
+    if (!req && !shared->empty && shared->wake_bits == queue->wake_bits &&
+        shared->changed_bits == queue->changed_bits && shared->wake_mask == queue->wake_mask &&
+        shared->changed_mask == queue->changed_mask)
+        return;
+
+    interlocked_xchg_add( &shared->seq, 1 );
+    shared->wake_bits    = queue->wake_bits;
+    shared->changed_bits = queue->changed_bits;
+    shared->wake_mask    = queue->wake_mask;
+    shared->changed_mask = queue->changed_mask;
+    shared->empty        = (req != NULL);
+    if (req)
+    {
+        shared->flags     = req->flags;
+        shared->get_win   = req->get_win;
+        shared->get_first = req->get_first;
+        shared->get_last  = req->get_last;
+    }
+    interlocked_xchg_add( &shared->seq, 1 );
+}
+
 /* set some queue bits */
 static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_shared_queue( queue, NULL );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -429,6 +523,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    update_shared_queue( queue, NULL );
 }
 
 /* check whether msg is a keyboard message */
@@ -929,6 +1024,7 @@ static void msg_queue_satisfied( struct object *obj, struct wait_queue_entry *en
     struct msg_queue *queue = (struct msg_queue *)obj;
     queue->wake_mask = 0;
     queue->changed_mask = 0;
+    update_shared_queue( queue, NULL );
 }
 
 static void msg_queue_destroy( struct object *obj )
@@ -967,6 +1063,7 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    if (queue->shared) free_shared_queue( queue );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -2154,7 +2251,23 @@ DECL_HANDLER(get_msg_queue)
     struct msg_queue *queue = get_current_queue();
 
     reply->handle = 0;
-    if (queue) reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+    reply->shared = 0;
+    reply->shared_offset = 0;
+    if (!queue) return;
+    reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+
+    if (!queue->shared)
+    {
+        if (!alloc_shared_queue( queue ))
+        {
+            clear_error();  /* the client can do without it */
+            return;
+        }
+        update_shared_queue( queue, NULL );
+    }
+    reply->shared = alloc_handle( current->process, queue->shared_block->mapping,
+                                  SECTION_QUERY | SECTION_MAP_READ, 0 );
+    reply->shared_offset = (char *)queue->shared - (char *)queue->shared_block->entries;
 }
 
 
@@ -2200,6 +2313,7 @@ DECL_HANDLER(set_queue_mask)
             if (req->skip_wait) queue->wake_mask = queue->changed_mask = 0;
             else wake_up( &queue->obj, 0 );
         }
+        update_shared_queue( queue, NULL );
     }
 }
 
@@ -2212,7 +2326,11 @@ DECL_HANDLER(get_queue_status)
     {
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
-        if (req->clear) queue->changed_bits = 0;
+        if (req->clear)
+        {
+            queue->changed_bits = 0;
+            update_shared_queue( queue, NULL );
+        }
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
@@ -2387,6 +2505,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_shared_queue( queue, NULL );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -2442,6 +2561,8 @@ DECL_HANDLER(get_message)
     if (get_win == -1 && current->process->idle_event) set_event( current->process->idle_event );
     queue->wake_mask = req->wake_mask;
     queue->changed_mask = req->changed_mask;
+    /* let the client know that the same request doesn't need to be repeated until something changes */
+    update_shared_queue( queue, req->hw_id ? NULL : req );
     set_error( STATUS_PENDING );  /* FIXME */
 }
 
@@ -35,6 +35,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -78,6 +81,8 @@ struct key
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    struct hive      *hive;        /* mapped hive file the key was loaded from */
+    const struct hive_key *image;  /* key record in the hive file */
 };
 
 /* key flags */
@@ -87,6 +92,7 @@ struct key
 #define KEY_SYMLINK  0x0008  /* key is a symbolic link */
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
+#define KEY_LAZY     0x0040  /* key contents haven't been loaded from the hive yet */
 
 /* a key value */
 struct key_value
@@ -118,19 +124,39 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index );
+static void load_hive_key( struct key *key );
+static void release_hive( struct hive *hive );
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *hive_path;   /* binary hive file, if enabled */
+    int          text_stale;  /* text file is older than the binary hive */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
 
+/* Key and value queries can be run on the worker threads, which hold this
+ * lock for reading; the main thread holds it for writing while it runs the
+ * other registry request handlers and while it saves the registry. The keys
+ * are loaded from the hive and referenced by the main thread beforehand. */
+static pthread_rwlock_t registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* a key or value query that may be run on a worker thread */
+struct key_job
+{
+    struct worker_job   job;         /* generic part, must be first */
+    struct key         *key;         /* key being queried */
+    int                 index;       /* subkey or value index */
+    int                 info_class;  /* information class */
+    struct unicode_str  name;        /* value name */
+};
+
 
 /* information about a file being loaded */
 struct file_load_info
@@ -253,11 +279,12 @@ static void dump_value( const struct key_value *value, FILE *f )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    load_hive_key( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -413,6 +440,7 @@ static void key_destroy( struct object *obj )
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    if (key->hive) release_hive( key->hive );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -481,6 +509,8 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->values      = NULL;
         key->modif       = modif;
         key->parent      = NULL;
+        key->hive        = NULL;
+        key->image       = NULL;
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
         {
@@ -491,6 +521,192 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
     return key;
 }
 
+/* binary hive files
+ *
+ * When WINEBINARYREG is set, each registry branch is also stored in a binary
+ * file next to the text one. The binary file is mapped at startup and keys
+ * are only created from it when they are first accessed. Periodic saves only
+ * write the binary file, copying unmodified subtrees straight from the
+ * mapping; the text file is rewritten on shutdown, and imported again
+ * whenever it doesn't match the one the binary file was saved with.
+ *
+ * Each key record is followed by its name, class, values, the offsets of its
+ * subkeys relative to the record, and the subkey records themselves, so that
+ * a whole subtree is contiguous and can be copied as is.
+ */
+
+#define HIVE_MAGIC    "WINEHIV1"
+#define HIVE_ALIGN(x) (((x) + 7) & ~(size_t)7)
+#define HIVE_KEY_FLAGS (KEY_SYMLINK | KEY_WOW64)  /* flags stored in the hive */
+
+struct hive_header
+{
+    char               magic[8];     /* HIVE_MAGIC */
+    unsigned int       size;         /* total file size */
+    unsigned int       prefix_type;  /* prefix type of the registry */
+    unsigned long long text_size;    /* identity of the matching text file */
+    unsigned long long text_mtime;
+    unsigned long long text_ino;
+    /* followed by the branch key record */
+};
+
+struct hive_key
+{
+    unsigned int       size;         /* size of the record including all its subkeys */
+    unsigned int       flags;        /* key flags */
+    timeout_t          modif;        /* last modification time */
+    unsigned short     namelen;      /* length of key name */
+    unsigned short     classlen;     /* length of class name */
+    unsigned int       nb_values;    /* number of values */
+    unsigned int       nb_subkeys;   /* number of subkeys */
+    unsigned int       subkeys;      /* offset of the subkey offsets array */
+    /* followed by name, class, values, subkey offsets and subkey records */
+};
+
+struct hive_value
+{
+    unsigned short     namelen;      /* length of value name */
+    unsigned short     type;         /* value type */
+    data_size_t        len;          /* value data length in bytes */
+    /* followed by name and data */
+};
+
+/* a mapped hive file */
+struct hive
+{
+    unsigned int       refcount;     /* number of keys pointing into the mapping */
+    void              *base;         /* mapping base address */
+    size_t             size;         /* mapping size */
+};
+
+/* buffer used to build a hive file */
+struct hive_buffer
+{
+    char              *data;
+    size_t             size;
+    size_t             pos;
+};
+
+static int use_binary_hives;
+
+static void release_hive( struct hive *hive )
+{
+    if (--hive->refcount) return;
+    munmap( hive->base, hive->size );
+    free( hive );
+}
+
+/* make a key point to its record in a mapped hive */
+static void attach_hive_key( struct key *key, struct hive *hive, const struct hive_key *image )
+{
+    key->hive  = hive;
+    key->image = image;
+    hive->refcount++;
+}
+
+/* drop the hive record of a key once it no longer matches the key contents */
+static void detach_hive_key( struct key *key )
+{
+    if (!key->hive) return;
+    release_hive( key->hive );
+    key->hive  = NULL;
+    key->image = NULL;
+}
+
+/* check that a key record fits in the available space */
+static int check_hive_key( const struct hive_key *image, size_t avail )
+{
+    if (avail < sizeof(*image) || image->size < sizeof(*image) || image->size > avail) return 0;
+    if ((image->namelen | image->classlen) & 1) return 0;
+    if (image->namelen > MAX_NAME_LEN * sizeof(WCHAR)) return 0;
+    if (HIVE_ALIGN( sizeof(*image) + image->namelen + image->classlen ) > image->subkeys) return 0;
+    if (image->subkeys > image->size || (image->subkeys & 7)) return 0;
+    if (image->nb_subkeys > (image->size - image->subkeys) / sizeof(unsigned int)) return 0;
+    return 1;
+}
+
+/* create the values and subkeys of a key from its hive record */
+static void load_hive_key( struct key *key )
+{
+    const struct hive_key *image = key->image;
+    const char *base = (const char *)image, *ptr;
+    const unsigned int *offsets;
+    unsigned int i, count;
+    size_t pos;
+
+    if (!(key->flags & KEY_LAZY)) return;
+    key->flags &= ~KEY_LAZY;
+
+    pos = HIVE_ALIGN( sizeof(*image) + image->namelen + image->classlen );
+    if ((count = image->nb_values))
+    {
+        if (!(key->values = mem_alloc( max( count, MIN_VALUES ) * sizeof(*key->values) ))) return;
+        key->nb_values = max( count, MIN_VALUES );
+        for (i = 0; i < count; i++)
+        {
+            const struct hive_value *value = (const struct hive_value *)(base + pos);
+            struct key_value *dst = &key->values[i];
+
+            if (image->subkeys - pos < sizeof(*value) ||
+                image->subkeys - pos - sizeof(*value) < (size_t)value->namelen + value->len ||
+                (value->namelen & 1))
+                goto corrupted;
+            ptr = (const char *)(value + 1);
+            dst->namelen = value->namelen;
+            dst->type    = value->type;
+            dst->len     = value->len;
+            dst->name    = NULL;
+            dst->data    = NULL;
+            if ((value->namelen && !(dst->name = memdup( ptr, value->namelen ))) ||
+                (value->len && !(dst->data = memdup( ptr + value->namelen, value->len ))))
+            {
+                free( dst->name );
+                return;
+            }
+            key->last_value = i;
+            pos += HIVE_ALIGN( sizeof(*value) + value->namelen + value->len );
+        }
+    }
+
+    if ((count = image->nb_subkeys))
+    {
+        if (!(key->subkeys = mem_alloc( max( count, MIN_SUBKEYS ) * sizeof(*key->subkeys) ))) return;
+        key->nb_subkeys = max( count, MIN_SUBKEYS );
+        offsets = (const unsigned int *)(base + image->subkeys);
+        for (i = 0; i < count; i++)
+        {
+            const struct hive_key *child = (const struct hive_key *)(base + offsets[i]);
+            struct unicode_str name;
+            struct key *subkey;
+
+            if (offsets[i] < image->subkeys + count * sizeof(*offsets) || (offsets[i] & 7) ||
+                offsets[i] > image->size - sizeof(*child) ||
+                !check_hive_key( child, image->size - offsets[i] ))
+                goto corrupted;
+            name.str = (const WCHAR *)(child + 1);
+            name.len = child->namelen;
+            if (!(subkey = alloc_key( &name, child->modif ))) return;
+            if (child->classlen &&
+                !(subkey->class = memdup( (const char *)(child + 1) + child->namelen, child->classlen )))
+            {
+                release_object( subkey );
+                return;
+            }
+            subkey->classlen = child->classlen;
+            subkey->flags    = (child->flags & HIVE_KEY_FLAGS) | KEY_LAZY;
+            subkey->parent   = key;
+            attach_hive_key( subkey, key->hive, child );
+            key->subkeys[i] = subkey;
+            key->last_subkey = i;
+        }
+    }
+    return;
+
+corrupted:
+    fprintf( stderr, "wineserver: corrupted registry hive, some keys will be missing\n" );
+}
+
+
 /* mark a key and all its parents as dirty (modified) */
 static void make_dirty( struct key *key )
 {
@@ -510,6 +726,12 @@ static void make_clean( struct key *key )
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
     key->flags &= ~KEY_DIRTY;
+    if (key->image)
+    {
+        /* the hive record is out of date now */
+        load_hive_key( key );
+        detach_hive_key( key );
+    }
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
@@ -625,11 +847,12 @@ static void free_subkey( struct key *parent, int index )
 }
 
 /* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+static struct key *find_subkey( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    load_hive_key( key );
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -861,9 +1084,9 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 }
 
 /* query information about a key or a subkey */
-static void enum_key( const struct key *key, int index, int info_class,
-                      struct enum_key_reply *reply )
+static void enum_key( struct key *key, int index, int info_class, struct worker_job *job )
 {
+    struct enum_key_reply *reply = &job->reply.enum_key_reply;
     int i;
     data_size_t len, namelen, classlen;
     data_size_t max_subkey = 0, max_class = 0;
@@ -872,9 +1095,10 @@ static void enum_key( const struct key *key, int index, int info_class,
 
     if (index != -1)  /* -1 means use the specified key directly */
     {
+        load_hive_key( key );
         if ((index < 0) || (index > key->last_subkey))
         {
-            set_error( STATUS_NO_MORE_ENTRIES );
+            job->error = STATUS_NO_MORE_ENTRIES;
             return;
         }
         key = key->subkeys[index];
@@ -896,6 +1120,7 @@ static void enum_key( const struct key *key, int index, int info_class,
         reply->max_data   = 0;
         break;
     case KeyFullInformation:
+        load_hive_key( key );
         for (i = 0; i <= key->last_subkey; i++)
         {
             struct key *subkey = key->subkeys[i];
@@ -918,16 +1143,25 @@ static void enum_key( const struct key *key, int index, int info_class,
         namelen = 0;  /* only return the class */
         break;
     default:
-        set_error( STATUS_INVALID_PARAMETER );
+        job->error = STATUS_INVALID_PARAMETER;
         return;
     }
-    reply->subkeys = key->last_subkey + 1;
-    reply->values  = key->last_value + 1;
+    if (key->flags & KEY_LAZY)
+    {
+        /* no need to load the key just to count its contents */
+        reply->subkeys = key->image->nb_subkeys;
+        reply->values  = key->image->nb_values;
+    }
+    else
+    {
+        reply->subkeys = key->last_subkey + 1;
+        reply->values  = key->last_value + 1;
+    }
     reply->modif   = key->modif;
     reply->total   = namelen + classlen;
 
-    len = min( reply->total, get_reply_max_size() );
-    if (len && (data = set_reply_data_size( len )))
+    len = min( reply->total, job->reply_max );
+    if (len && (data = set_job_reply_data_size( job, len )))
     {
         if (len > namelen)
         {
@@ -957,6 +1191,7 @@ static int delete_key( struct key *key, int recurse )
         return -1;
     }
     assert( parent );
+    load_hive_key( key );
 
     while (recurse && (key->last_subkey>=0))
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
@@ -1005,11 +1240,12 @@ static int grow_values( struct key *key )
 }
 
 /* find the named value of a given key and return its index in the array */
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    load_hive_key( key );
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1105,31 +1341,37 @@ static void set_value( struct key *key, const struct unicode_str *name,
 }
 
 /* get a key value */
-static void get_value( struct key *key, const struct unicode_str *name, int *type, data_size_t *len )
+static void get_value( struct key *key, const struct unicode_str *name, struct worker_job *job )
 {
+    struct get_key_value_reply *reply = &job->reply.get_key_value_reply;
     struct key_value *value;
+    data_size_t len;
     int index;
 
     if ((value = find_value( key, name, &index )))
     {
-        *type = value->type;
-        *len  = value->len;
-        if (value->data) set_reply_data( value->data, min( value->len, get_reply_max_size() ));
+        reply->type  = value->type;
+        reply->total = value->len;
+        len = min( value->len, job->reply_max );
+        if (value->data && len && set_job_reply_data_size( job, len ))
+            memcpy( job->reply_data, value->data, len );
         if (debug_level > 1) dump_operation( key, value, "Get" );
     }
     else
     {
-        *type = -1;
-        set_error( STATUS_OBJECT_NAME_NOT_FOUND );
+        reply->type = -1;
+        job->error = STATUS_OBJECT_NAME_NOT_FOUND;
     }
 }
 
 /* enumerate a key value */
-static void enum_value( struct key *key, int i, int info_class, struct enum_key_value_reply *reply )
+static void enum_value( struct key *key, int i, int info_class, struct worker_job *job )
 {
+    struct enum_key_value_reply *reply = &job->reply.enum_key_value_reply;
     struct key_value *value;
 
-    if (i < 0 || i > key->last_value) set_error( STATUS_NO_MORE_ENTRIES );
+    load_hive_key( key );
+    if (i < 0 || i > key->last_value) job->error = STATUS_NO_MORE_ENTRIES;
     else
     {
         void *data;
@@ -1152,12 +1394,12 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
             namelen = 0;
             break;
         default:
-            set_error( STATUS_INVALID_PARAMETER );
+            job->error = STATUS_INVALID_PARAMETER;
             return;
         }
 
-        maxlen = min( reply->total, get_reply_max_size() );
-        if (maxlen && ((data = set_reply_data_size( maxlen ))))
+        maxlen = min( reply->total, job->reply_max );
+        if (maxlen && ((data = set_job_reply_data_size( job, maxlen ))))
         {
             if (maxlen > namelen)
             {
@@ -1220,6 +1462,59 @@ static struct key *get_hkey_obj( obj_handle_t hkey, unsigned int access )
     return key;
 }
 
+/* free a key query job, on the main thread */
+static void key_job_destroy( struct worker_job *job )
+{
+    struct key_job *key_job = (struct key_job *)job;
+
+    release_object( key_job->key );
+    free( (void *)key_job->name.str );
+    free( key_job );
+}
+
+/* create a job querying a key; the key must have been loaded from its hive already */
+static struct key_job *create_key_job( struct key *key, void (*run)( struct worker_job *job ) )
+{
+    struct key_job *key_job;
+
+    if (!(key_job = mem_alloc( sizeof(*key_job) ))) return NULL;
+    key_job->job.lock    = &registry_lock;
+    key_job->job.run     = run;
+    key_job->job.destroy = key_job_destroy;
+    key_job->key         = (struct key *)grab_object( key );
+    key_job->index       = 0;
+    key_job->info_class  = 0;
+    key_job->name.str    = NULL;
+    key_job->name.len    = 0;
+    return key_job;
+}
+
+/* the jobs may run after the main thread deleted the key */
+
+static void enum_key_job( struct worker_job *job )
+{
+    struct key_job *key_job = (struct key_job *)job;
+
+    if (key_job->key->flags & KEY_DELETED) job->error = STATUS_KEY_DELETED;
+    else enum_key( key_job->key, key_job->index, key_job->info_class, job );
+}
+
+static void get_key_value_job( struct worker_job *job )
+{
+    struct key_job *key_job = (struct key_job *)job;
+
+    if (key_job->key->flags & KEY_DELETED) job->error = STATUS_KEY_DELETED;
+    else get_value( key_job->key, &key_job->name, job );
+}
+
+static void enum_key_value_job( struct worker_job *job )
+{
+    struct key_job *key_job = (struct key_job *)job;
+
+    if (key_job->key->flags & KEY_DELETED) job->error = STATUS_KEY_DELETED;
+    else enum_value( key_job->key, key_job->index, key_job->info_class, job );
+}
+
 /* get the registry key corresponding to a parent key handle */
 static inline struct key *get_parent_hkey_obj( obj_handle_t hkey )
 {
@@ -1644,28 +1939,103 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* build the name of the hive file that goes with a registry text file */
+static char *get_hive_path( const char *filename )
+{
+    size_t len = strlen( filename );
+    char *path;
+
+    if (len > 4 && !strcmp( filename + len - 4, ".reg" )) len -= 4;
+    if ((path = malloc( len + sizeof(".hiv") )))
+    {
+        memcpy( path, filename, len );
+        strcpy( path + len, ".hiv" );
+    }
+    return path;
+}
+
+/* map a hive file and attach it to the branch key, if it matches the text file */
+static int load_hive( struct key *key, const char *path, const struct stat *text_st )
+{
+    const struct hive_header *header;
+    const struct hive_key *image;
+    struct hive *hive;
+    struct stat st;
+    void *base;
+    int fd;
+
+    if ((fd = open( path, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) + sizeof(*image) || st.st_size > UINT_MAX)
+    {
+        close( fd );
+        return 0;
+    }
+    base = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (base == MAP_FAILED) return 0;
+
+    header = base;
+    image = (const struct hive_key *)(header + 1);
+    if (memcmp( header->magic, HIVE_MAGIC, sizeof(header->magic) ) || header->size != st.st_size ||
+        header->text_size != text_st->st_size || header->text_mtime != text_st->st_mtime ||
+        header->text_ino != text_st->st_ino || !check_hive_key( image, st.st_size - sizeof(*header) ) ||
+        !(hive = mem_alloc( sizeof(*hive) )))
+    {
+        munmap( base, st.st_size );
+        return 0;
+    }
+    hive->refcount = 0;
+    hive->base     = base;
+    hive->size     = st.st_size;
+
+    assert( key->last_subkey == -1 && key->last_value == -1 );
+    attach_hive_key( key, hive, image );
+    key->flags |= (image->flags & HIVE_KEY_FLAGS) | KEY_LAZY;
+    key->modif  = image->modif;
+    if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->prefix_type;
+    return 1;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info *info;
+    struct stat st;
     FILE *f;
+    int loaded = 0;
 
-    if ((f = fopen( filename, "r" )))
+    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+
+    info = &save_branch_info[save_branch_count];
+    info->path = filename;
+    info->hive_path = NULL;
+    info->text_stale = 0;
+
+    if (use_binary_hives && (info->hive_path = get_hive_path( filename )))
+    {
+        if (stat( filename, &st )) memset( &st, 0, sizeof(st) );
+        loaded = load_hive( key, info->hive_path, &st );
+    }
+
+    if (!loaded && (f = fopen( filename, "r" )))
     {
         load_keys( key, filename, f, 0 );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
         {
             fprintf( stderr, "%s is not a valid registry file\n", filename );
+            free( info->hive_path );
             return 1;
         }
+        /* make sure the hive gets created at the next save */
+        if (info->hive_path) make_dirty( key );
+        loaded = 1;
     }
 
-    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
-
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    info->key = (struct key *)grab_object( key );
+    save_branch_count++;
     make_object_static( &key->obj );
-    return (f != NULL);
+    return loaded;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1735,6 +2105,9 @@ void init_registry(void)
     WCHAR *current_user_path;
     struct unicode_str current_user_str;
     struct key *key, *hklm, *hkcu;
+    const char *env;
+
+    use_binary_hives = (env = getenv( "WINEBINARYREG" )) && atoi( env );
 
     /* switch to the config dir */
 
@@ -1840,19 +2213,37 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
-/* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+/* create a temp file in the same directory as the given file */
+static int create_temp_file( const char *path, char **tmp_ret )
 {
-    struct stat st;
-    char *p, *tmp = NULL;
-    int fd, count = 0, ret = 0;
-    FILE *f;
+    char *p, *tmp;
+    int fd, count = 0;
 
-    if (!(key->flags & KEY_DIRTY))
+    if (!(tmp = malloc( strlen(path) + 20 ))) return -1;
+    strcpy( tmp, path );
+    if ((p = strrchr( tmp, '/' ))) p++;
+    else p = tmp;
+    for (;;)
     {
-        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
-        return 1;
+        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
+        if ((fd = open( tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
+        if (errno != EEXIST)
+        {
+            free( tmp );
+            return -1;
+        }
     }
+    *tmp_ret = tmp;
+    return fd;
+}
+
+/* save a registry branch to a text file */
+static int save_text_branch( struct key *key, const char *path )
+{
+    struct stat st;
+    char *tmp = NULL;
+    int fd, ret = 0;
+    FILE *f;
 
     /* test the file type */
 
@@ -1870,17 +2261,7 @@ static int save_branch( struct key *key, const char *path )
 
     /* create a temp file in the same directory */
 
-    if (!(tmp = malloc( strlen(path) + 20 ))) goto done;
-    strcpy( tmp, path );
-    if ((p = strrchr( tmp, '/' ))) p++;
-    else p = tmp;
-    for (;;)
-    {
-        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
-        if ((fd = open( tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
-        if (errno != EEXIST) goto done;
-        close( fd );
-    }
+    if ((fd = create_temp_file( path, &tmp )) == -1) return 0;
 
     /* now save to it */
 
@@ -1910,7 +2291,155 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
+    return ret;
+}
+
+/* append data to a hive buffer, or zeroes if data is NULL */
+static int hive_append( struct hive_buffer *buf, const void *data, size_t len )
+{
+    if (buf->size - buf->pos < len)
+    {
+        size_t new_size = max( buf->size * 2, buf->pos + len );
+        char *new_data;
+
+        if (new_size > UINT_MAX || !(new_data = realloc( buf->data, new_size ))) return 0;
+        buf->data = new_data;
+        buf->size = new_size;
+    }
+    if (data) memcpy( buf->data + buf->pos, data, len );
+    else memset( buf->data + buf->pos, 0, len );
+    buf->pos += len;
+    return 1;
+}
+
+static inline int hive_align( struct hive_buffer *buf )
+{
+    return hive_append( buf, NULL, HIVE_ALIGN( buf->pos ) - buf->pos );
+}
+
+/* append a key and its subkeys to a hive buffer */
+static int write_hive_key( struct hive_buffer *buf, struct key *key )
+{
+    struct hive_key image;
+    struct hive_value value;
+    size_t start = buf->pos;
+    unsigned int offset;
+    int i, count = 0;
+
+    /* nothing changed in this subtree since it was read from the hive */
+    if (!(key->flags & KEY_DIRTY) && key->image) return hive_append( buf, key->image, key->image->size );
+
+    load_hive_key( key );
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) count++;
+
+    memset( &image, 0, sizeof(image) );
+    image.flags      = key->flags & HIVE_KEY_FLAGS;
+    image.modif      = key->modif;
+    image.namelen    = key->namelen;
+    image.classlen   = key->classlen;
+    image.nb_values  = key->last_value + 1;
+    image.nb_subkeys = count;
+    if (!hive_append( buf, &image, sizeof(image) ) ||
+        !hive_append( buf, key->name, key->namelen ) ||
+        !hive_append( buf, key->class, key->classlen ) ||
+        !hive_align( buf ))
+        return 0;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        value.namelen = key->values[i].namelen;
+        value.type    = key->values[i].type;
+        value.len     = key->values[i].len;
+        if (!hive_append( buf, &value, sizeof(value) ) ||
+            !hive_append( buf, key->values[i].name, value.namelen ) ||
+            !hive_append( buf, key->values[i].data, value.len ) ||
+            !hive_align( buf ))
+            return 0;
+    }
+
+    image.subkeys = buf->pos - start;
+    if (!hive_append( buf, NULL, count * sizeof(offset) ) || !hive_align( buf )) return 0;
+
+    for (i = count = 0; i <= key->last_subkey; i++)
+    {
+        if (key->subkeys[i]->flags & KEY_VOLATILE) continue;
+        offset = buf->pos - start;
+        memcpy( buf->data + start + image.subkeys + count++ * sizeof(offset), &offset, sizeof(offset) );
+        if (!write_hive_key( buf, key->subkeys[i] )) return 0;
+    }
+
+    image.size = buf->pos - start;
+    memcpy( buf->data + start, &image, sizeof(image) );
+    return 1;
+}
+
+/* save a registry branch to a binary hive file */
+static int save_hive( struct key *key, const char *path, const char *text_path )
+{
+    struct hive_header header;
+    struct hive_buffer buf;
+    struct stat st;
+    char *tmp;
+    int fd, ret = 0;
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, HIVE_MAGIC, sizeof(header.magic) );
+    header.prefix_type = prefix_type;
+    if (!stat( text_path, &st ))
+    {
+        header.text_size  = st.st_size;
+        header.text_mtime = st.st_mtime;
+        header.text_ino   = st.st_ino;
+    }
+
+    buf.data = NULL;
+    buf.size = buf.pos = 0;
+    if (!hive_append( &buf, &header, sizeof(header) ) || !write_hive_key( &buf, key )) goto done;
+    header.size = buf.pos;
+    memcpy( buf.data, &header, sizeof(header) );
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", path );
+        dump_operation( key, NULL, "saving" );
+    }
+
+    /* keys may still point into the current file, so it can't be overwritten in place */
+    if ((fd = create_temp_file( path, &tmp )) == -1) goto done;
+    ret = (write( fd, buf.data, buf.pos ) == buf.pos);
+    if (close( fd )) ret = 0;
+    if (ret) ret = !rename( tmp, path );
+    if (!ret) unlink( tmp );
+    free( tmp );
+
+done:
+    free( buf.data );
+    return ret;
+}
+
+/* save a registry branch to its files; the text file is only written if requested
+ * or if binary hives are disabled */
+static int save_branch( struct save_branch_info *info, int text )
+{
+    struct key *key = info->key;
+    int ret = 1;
+
+    if (!info->hive_path) text = 1;
+    if (!(key->flags & KEY_DIRTY) && !(text && info->text_stale))
+    {
+        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
+        return 1;
+    }
+
+    if (text) ret = save_text_branch( key, info->path );
+    /* the hive is written last since it records the state of the text file */
+    if (ret && info->hive_path) ret = save_hive( key, info->hive_path, info->path );
+    if (ret)
+    {
+        make_clean( key );
+        info->text_stale = !text;
+    }
     return ret;
 }
 
@@ -1921,8 +2450,9 @@ static void periodic_save( void *arg )
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    lock_registry();
+    for (i = 0; i < save_branch_count; i++) save_branch( &save_branch_info[i], 0 );
+    unlock_registry();
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -1940,18 +2470,55 @@ void flush_registry(void)
     int i;
 
     if (fchdir( config_dir_fd ) == -1) return;
+    lock_registry();
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_branch( &save_branch_info[i], 1 ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
             perror( " " );
         }
     }
+    unlock_registry();
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
 }
 
+/* check whether a request handler accesses the registry */
+int is_registry_request( enum request req )
+{
+    switch (req)
+    {
+    case REQ_create_key:
+    case REQ_open_key:
+    case REQ_delete_key:
+    case REQ_flush_key:
+    case REQ_enum_key:
+    case REQ_set_key_value:
+    case REQ_get_key_value:
+    case REQ_enum_key_value:
+    case REQ_delete_key_value:
+    case REQ_load_registry:
+    case REQ_unload_registry:
+    case REQ_save_registry:
+    case REQ_set_registry_notification:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* lock the registry against the worker threads, for running a handler or saving */
+void lock_registry(void)
+{
+    if (worker_threads) pthread_rwlock_wrlock( &registry_lock );
+}
+
+void unlock_registry(void)
+{
+    if (worker_threads) pthread_rwlock_unlock( &registry_lock );
+}
+
 /* determine if the thread is wow64 (32-bit client running on 64-bit prefix) */
 static int is_wow64_thread( struct thread *thread )
 {
@@ -2047,12 +2614,23 @@ DECL_HANDLER(flush_key)
 /* enumerate registry subkeys */
 DECL_HANDLER(enum_key)
 {
+    struct key_job *job;
     struct key *key;
 
     if ((key = get_hkey_obj( req->hkey,
                              req->index == -1 ? KEY_QUERY_VALUE : KEY_ENUMERATE_SUB_KEYS )))
     {
-        enum_key( key, req->index, req->info_class, reply );
+        load_hive_key( key );
+        if ((job = create_key_job( key, enum_key_job )))
+        {
+            job->index      = req->index;
+            job->info_class = req->info_class;
+            /* the full information of a subkey may require loading it */
+            if (req->index != -1 && req->info_class == KeyFullInformation)
+                run_worker_job( &job->job, (union generic_reply *)reply );
+            else
+                queue_worker_job( &job->job, (union generic_reply *)reply );
+        }
         release_object( key );
     }
 }
@@ -2084,6 +2662,7 @@ DECL_HANDLER(set_key_value)
 /* retrieve the value of a registry key */
 DECL_HANDLER(get_key_value)
 {
+    struct key_job *job;
     struct key *key;
     struct unicode_str name;
 
@@ -2091,7 +2670,17 @@ DECL_HANDLER(get_key_value)
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
         get_req_unicode_str( &name );
-        get_value( key, &name, &reply->type, &reply->total );
+        load_hive_key( key );
+        if ((job = create_key_job( key, get_key_value_job )))
+        {
+            /* the request data is freed once the handler returns */
+            if (!name.len || (job->name.str = memdup( name.str, name.len )))
+            {
+                job->name.len = name.len;
+                queue_worker_job( &job->job, (union generic_reply *)reply );
+            }
+            else key_job_destroy( &job->job );
+        }
         release_object( key );
     }
 }
@@ -2099,11 +2688,18 @@ DECL_HANDLER(get_key_value)
 /* enumerate the value of a registry key */
 DECL_HANDLER(enum_key_value)
 {
+    struct key_job *job;
     struct key *key;
 
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
-        enum_value( key, req->index, req->info_class, reply );
+        load_hive_key( key );
+        if ((job = create_key_job( key, enum_key_value_job )))
+        {
+            job->index      = req->index;
+            job->info_class = req->info_class;
+            queue_worker_job( &job->job, (union generic_reply *)reply );
+        }
         release_object( key );
     }
 }
@@ -34,6 +34,12 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 #include <sys/types.h>
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
@@ -127,6 +133,8 @@ int server_dir_fd = -1;    /* file descriptor for the server dir */
 int config_dir_fd = -1;    /* file descriptor for the config dir */
 
 static struct master_socket *master_socket;  /* the master socket object */
+int worker_threads = 0;    /* number of threads running worker jobs */
+static request_stats_t request_stats[REQ_NB_REQUESTS];  /* per-request handler statistics */
 static struct timeout_user *master_timeout;
 
 /* complain about a protocol error and terminate the client connection */
@@ -188,11 +196,82 @@ void write_reply( struct thread *thread )
         fatal_protocol_error( thread, "reply write: %s\n", strerror( errno ));
 }
 
+#if defined(__linux__) && defined(__NR_futex)
+#ifndef F_GET_SEALS
+#define F_GET_SEALS   1034
+#endif
+#ifndef F_SEAL_SHRINK
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW   0x0004
+#endif
+#endif
+
+/* map the shared reply area passed by the client */
+int set_reply_shm( struct thread *thread, int fd )
+{
+#if defined(__linux__) && defined(__NR_futex) && defined(HAVE_SYS_MMAN_H)
+    struct stat st;
+    void *ptr;
+    int seals;
+
+    /* the size must be sealed, otherwise the client could truncate the area
+     * and make the server crash on the next reply */
+    seals = fcntl( fd, F_GET_SEALS );
+    if (seals == -1 || (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW)) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size != REPLY_SHM_SIZE) return 0;
+    if ((ptr = mmap( NULL, REPLY_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+        return 0;
+    thread->reply_shm = ptr;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/* signal the client that a reply is available in the shared area */
+static void wake_reply_shm( struct reply_shm *shm, int use_pipe )
+{
+    shm->use_pipe = use_pipe;
+    /* the interlocked increment also acts as a release barrier for the reply data */
+    interlocked_xchg_add( &shm->seq, 1 );
+#if defined(__linux__) && defined(__NR_futex)
+    if (interlocked_xchg( &shm->waiting, 0 ))
+        syscall( __NR_futex, &shm->seq, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+#endif
+}
+
+/* unmap the shared reply area, waking up the client so that it notices the closed pipe */
+void release_reply_shm( struct thread *thread )
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (!thread->reply_shm) return;
+    wake_reply_shm( thread->reply_shm, 1 );
+    munmap( thread->reply_shm, REPLY_SHM_SIZE );
+    thread->reply_shm = NULL;
+#endif
+}
+
 /* send a reply to the current thread */
 static void send_reply( union generic_reply *reply )
 {
     int ret;
 
+    /* the client only starts using the shared area once it got the init_thread reply */
+    if (current->reply_shm && current->req.request_header.req != REQ_init_thread)
+    {
+        if (current->reply_size <= REPLY_SHM_SIZE - sizeof(struct reply_shm))
+        {
+            memcpy( &current->reply_shm->reply, reply, sizeof(*reply) );
+            memcpy( current->reply_shm + 1, current->reply_data, current->reply_size );
+            wake_reply_shm( current->reply_shm, 0 );
+            free( current->reply_data );
+            current->reply_data = NULL;
+            return;
+        }
+        /* too large, the client will have to read it from the pipe */
+        wake_reply_shm( current->reply_shm, 1 );
+    }
+
     if (!current->reply_size)
     {
         if ((ret = write( get_unix_fd( current->reply_fd ),
@@ -230,11 +309,293 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
+/*
+ * Worker threads
+ *
+ * A request handler may hand the computation of its reply to a worker
+ * thread with queue_worker_job(); the reply is then sent from the main
+ * loop once the job is done, and the client thread simply keeps waiting
+ * for it. The handler does everything that needs the global state (handle
+ * lookups, object references, errors) on the main thread, and the job only
+ * reads data protected by job->lock, which it holds for reading while it
+ * runs. Lock order: the main thread takes job->lock for writing before
+ * worker_mutex, workers never hold both at the same time.
+ */
+
+struct worker_notify
+{
+    struct object  obj;  /* object header */
+    struct fd     *fd;   /* read side of the done pipe */
+};
+
+static void worker_notify_dump( struct object *obj, int verbose );
+static void worker_notify_poll_event( struct fd *fd, int event );
+
+static const struct object_ops worker_notify_ops =
+{
+    sizeof(struct worker_notify),  /* size */
+    worker_notify_dump,            /* dump */
+    no_get_type,                   /* get_type */
+    no_add_queue,                  /* add_queue */
+    NULL,                          /* remove_queue */
+    NULL,                          /* signaled */
+    NULL,                          /* satisfied */
+    no_signal,                     /* signal */
+    no_get_fd,                     /* get_fd */
+    no_map_access,                 /* map_access */
+    default_get_sd,                /* get_sd */
+    default_set_sd,                /* set_sd */
+    no_lookup_name,                /* lookup_name */
+    no_open_file,                  /* open_file */
+    no_close_handle,               /* close_handle */
+    no_destroy                     /* destroy */
+};
+
+static const struct fd_ops worker_notify_fd_ops =
+{
+    NULL,                          /* get_poll_events */
+    worker_notify_poll_event,      /* poll_event */
+    NULL,                          /* flush */
+    NULL,                          /* get_fd_type */
+    NULL,                          /* ioctl */
+    NULL,                          /* queue_async */
+    NULL,                          /* reselect_async */
+    NULL                           /* cancel_async */
+};
+
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;  /* protects the lists below */
+static pthread_cond_t worker_cond = PTHREAD_COND_INITIALIZER;     /* signaled when a job is queued */
+static struct list queued_jobs = LIST_INIT( queued_jobs );        /* jobs waiting for a worker */
+static struct list done_jobs = LIST_INIT( done_jobs );            /* jobs waiting for their reply */
+static int done_signaled;   /* has the done pipe been written to since it was last read? */
+static int done_pipe = -1;  /* write side of the done pipe */
+
+static void worker_notify_dump( struct object *obj, int verbose )
+{
+    assert( obj->ops == &worker_notify_ops );
+    fprintf( stderr, "Worker threads notification\n" );
+}
+
+/* main function of the worker threads */
+static void *worker_thread( void *arg )
+{
+    struct worker_job *job;
+    struct list *ptr;
+    char dummy = 0;
+
+    pthread_mutex_lock( &worker_mutex );
+    for (;;)
+    {
+        while (!(ptr = list_head( &queued_jobs ))) pthread_cond_wait( &worker_cond, &worker_mutex );
+        list_remove( ptr );
+        pthread_mutex_unlock( &worker_mutex );
+
+        job = LIST_ENTRY( ptr, struct worker_job, entry );
+        pthread_rwlock_rdlock( job->lock );
+        job->run( job );
+        pthread_rwlock_unlock( job->lock );
+
+        pthread_mutex_lock( &worker_mutex );
+        list_add_tail( &done_jobs, &job->entry );
+        if (!done_signaled)
+        {
+            done_signaled = 1;
+            write( done_pipe, &dummy, 1 );
+        }
+    }
+    return NULL;
+}
+
+/* send the reply of a job to its client thread, and free the job */
+static void send_job_reply( struct worker_job *job )
+{
+    struct thread *thread = job->thread;
+
+    thread->job = NULL;
+    /* the thread may have been killed while the job was running */
+    if (thread->state != TERMINATED && thread->reply_fd)
+    {
+        current = thread;
+        current->error = job->error;
+        current->reply_data = job->reply_data;
+        current->reply_size = job->reply_size;
+        job->reply_data = NULL;
+        job->reply.reply_header.error = job->error;
+        job->reply.reply_header.reply_size = job->reply_size;
+        if (debug_level) trace_reply( job->req, &job->reply );
+        send_reply( &job->reply );
+        current = NULL;
+    }
+    free( job->reply_data );
+    release_object( thread );
+    job->destroy( job );
+}
+
+/* send the replies of the jobs that the worker threads have finished */
+static void worker_notify_poll_event( struct fd *fd, int event )
+{
+    struct list jobs = LIST_INIT( jobs );
+    struct list *ptr;
+    char buffer[16];
+
+    read( get_unix_fd( fd ), buffer, sizeof(buffer) );
+
+    pthread_mutex_lock( &worker_mutex );
+    list_move_tail( &jobs, &done_jobs );
+    done_signaled = 0;
+    pthread_mutex_unlock( &worker_mutex );
+
+    while ((ptr = list_head( &jobs )))
+    {
+        list_remove( ptr );
+        send_job_reply( LIST_ENTRY( ptr, struct worker_job, entry ));
+    }
+}
+
+/* start the worker threads requested on the command line */
+void start_worker_threads(void)
+{
+    struct worker_notify *notify;
+    sigset_t sigset, old_sigset;
+    pthread_t thread;
+    int i, fd[2];
+
+    if (!worker_threads) return;
+
+    if (pipe( fd ) == -1) fatal_error( "cannot create the worker pipe: %s\n", strerror( errno ));
+    fcntl( fd[0], F_SETFL, O_NONBLOCK );
+    if (!(notify = alloc_object( &worker_notify_ops ))) fatal_error( "out of memory\n" );
+    if (!(notify->fd = create_anonymous_fd( &worker_notify_fd_ops, fd[0], &notify->obj, 0 )))
+        fatal_error( "out of memory\n" );
+    set_fd_events( notify->fd, POLLIN );
+    make_object_static( &notify->obj );
+    done_pipe = fd[1];
+
+    /* signals are handled by the main thread only */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_BLOCK, &sigset, &old_sigset );
+    for (i = 0; i < worker_threads; i++)
+    {
+        if (pthread_create( &thread, NULL, worker_thread, NULL ))
+            fatal_error( "cannot create worker thread: %s\n", strerror( errno ));
+        pthread_detach( thread );
+    }
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+    if (debug_level) fprintf( stderr, "wineserver: started %d worker threads\n", worker_threads );
+}
+
+/* allocate the reply data of a job; it may be called on a worker thread */
+void *set_job_reply_data_size( struct worker_job *job, data_size_t size )
+{
+    assert( size <= job->reply_max );
+    if (size && !(job->reply_data = malloc( size )))
+    {
+        job->error = STATUS_NO_MEMORY;
+        size = 0;
+    }
+    job->reply_size = size;
+    return job->reply_data;
+}
+
+/* initialize the generic part of a job for the current request */
+static void init_worker_job( struct worker_job *job )
+{
+    job->thread     = current;
+    job->req        = current->req.request_header.req;
+    job->reply_max  = get_reply_max_size();
+    job->error      = 0;
+    job->reply_data = NULL;
+    job->reply_size = 0;
+    memset( &job->reply, 0, sizeof(job->reply) );
+}
+
+/* run a job on the main thread, which owns the data, and set the reply of the current request */
+void run_worker_job( struct worker_job *job, union generic_reply *reply )
+{
+    init_worker_job( job );
+    job->run( job );
+    set_error( job->error );
+    *reply = job->reply;
+    current->reply_data = job->reply_data;
+    current->reply_size = job->reply_size;
+    job->destroy( job );
+}
+
+/* hand a job to the worker threads; the reply is sent once it is done */
+void queue_worker_job( struct worker_job *job, union generic_reply *reply )
+{
+    if (!worker_threads)
+    {
+        run_worker_job( job, reply );
+        return;
+    }
+    init_worker_job( job );
+    grab_object( current );
+    current->job = job;
+
+    pthread_mutex_lock( &worker_mutex );
+    list_add_tail( &queued_jobs, &job->entry );
+    pthread_cond_signal( &worker_cond );
+    pthread_mutex_unlock( &worker_mutex );
+}
+
+/* get a monotonic time in nanoseconds for the request statistics */
+static inline unsigned __int64 get_profile_time(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    if (!clock_gettime( CLOCK_MONOTONIC, &ts ))
+        return (unsigned __int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+
+    if (!timebase.denom) mach_timebase_info( &timebase );
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#endif
+    {
+        struct timeval tv;
+        gettimeofday( &tv, NULL );
+        return (unsigned __int64)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+    }
+}
+
+/* account the time spent in a request handler */
+static void update_request_stats( enum request req, struct process *process, unsigned __int64 time )
+{
+    request_stats_t *stats = &request_stats[req];
+    unsigned int bucket = 0, us = time / 1000;
+
+    while (us && bucket < REQUEST_STATS_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    stats->count++;
+    stats->time += time;
+    if (time > stats->max_time) stats->max_time = min( time, ~0u );
+    stats->histogram[bucket]++;
+
+    if (process)
+    {
+        process->req_count++;
+        process->req_time += time;
+    }
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
+    struct process *process = thread->process;
+    unsigned __int64 start;
+
+    if (thread->job)
+    {
+        fatal_protocol_error( thread, "request %d received while waiting for a reply\n", req );
+        return;
+    }
 
     current = thread;
     current->reply_size = 0;
@@ -244,11 +605,21 @@ static void call_req_handler( struct thread *thread )
     if (debug_level) trace_request();
 
     if (req < REQ_NB_REQUESTS)
+    {
+        int registry = is_registry_request( req );
+
+        start = get_profile_time();
+        if (registry) lock_registry();
         req_handlers[req]( &current->req, &reply );
+        if (registry) unlock_registry();
+        /* the thread may be gone, only account the process if it still is */
+        update_request_stats( req, current ? process : NULL, get_profile_time() - start );
+    }
     else
         set_error( STATUS_NOT_IMPLEMENTED );
 
-    if (current)
+    /* if a job was queued, its reply is sent once it's done */
+    if (current && !current->job)
     {
         if (current->reply_fd)
         {
@@ -841,3 +1212,42 @@ void close_master_socket( timeout_t timeout )
 
     master_timeout = add_timeout_user( timeout, close_socket_timeout, NULL );
 }
+
+/* retrieve the statistics of the request handlers */
+DECL_HANDLER(get_request_stats)
+{
+    request_stats_t *stats;
+    data_size_t max = get_reply_max_size() / sizeof(*stats);
+    unsigned int i, total = 0, count;
+    const char *name;
+
+    if (req->pid)
+    {
+        struct process *process = get_process_from_id( req->pid );
+
+        if (!process) return;
+        reply->process_count = process->req_count;
+        reply->process_time  = process->req_time / 100;
+        release_object( process );
+    }
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++) if (request_stats[i].count) total++;
+    count = min( total, max );
+
+    if (count && (stats = set_reply_data_size( count * sizeof(*stats) )))
+    {
+        for (i = 0; i < REQ_NB_REQUESTS && count; i++)
+        {
+            if (!request_stats[i].count) continue;
+            *stats = request_stats[i];
+            stats->req = i;
+            name = get_request_name( i );
+            memcpy( stats->name, name, min( strlen(name) + 1, sizeof(stats->name) ));
+            stats->name[sizeof(stats->name) - 1] = 0;
+            stats++;
+            count--;
+        }
+    }
+    /* a full buffer tells the caller to retry with a larger one, so only reset when it isn't */
+    if (req->reset && total < max) memset( request_stats, 0, sizeof(request_stats) );
+}
@@ -22,6 +22,7 @@
 #define __WINE_SERVER_REQUEST_H
 
 #include <assert.h>
+#include <pthread.h>
 
 #include "thread.h"
 #include "wine/server_protocol.h"
@@ -50,6 +51,8 @@ extern int receive_fd( struct process *process );
 extern int send_client_fd( struct process *process, int fd, obj_handle_t handle );
 extern void read_request( struct thread *thread );
 extern void write_reply( struct thread *thread );
+extern int set_reply_shm( struct thread *thread, int fd );
+extern void release_reply_shm( struct thread *thread );
 extern unsigned int get_tick_count(void);
 extern void open_master_socket(void);
 extern void close_master_socket( timeout_t timeout );
@@ -60,6 +63,29 @@ extern int server_dir_fd, config_dir_fd;
 
 extern void trace_request(void);
 extern void trace_reply( enum request req, const union generic_reply *reply );
+extern const char *get_request_name( enum request req );
+
+/* a request whose reply is computed by a worker thread, see queue_worker_job() */
+struct worker_job
+{
+    struct list          entry;       /* entry in the queued or done list */
+    struct thread       *thread;      /* thread that sent the request */
+    enum request         req;         /* request being handled */
+    data_size_t          reply_max;   /* max size of the reply data */
+    pthread_rwlock_t    *lock;        /* lock held for reading while running on a worker thread */
+    void               (*run)( struct worker_job *job );      /* compute the reply */
+    void               (*destroy)( struct worker_job *job );  /* free the job, on the main thread */
+    unsigned int         error;       /* status of the request */
+    union generic_reply  reply;       /* reply to send to the client */
+    void                *reply_data;  /* variable-size data for the reply */
+    data_size_t          reply_size;  /* size of the reply data */
+};
+
+extern int worker_threads;
+extern void start_worker_threads(void);
+extern void *set_job_reply_data_size( struct worker_job *job, data_size_t size );
+extern void run_worker_job( struct worker_job *job, union generic_reply *reply );
+extern void queue_worker_job( struct worker_job *job, union generic_reply *reply );
 
 /* get the request vararg data */
 static inline const void *get_req_data(void)
@@ -141,6 +167,7 @@ DECL_HANDLER(create_mutex);
 DECL_HANDLER(release_mutex);
 DECL_HANDLER(open_mutex);
 DECL_HANDLER(create_semaphore);
+DECL_HANDLER(get_client_sync_section);
 DECL_HANDLER(release_semaphore);
 DECL_HANDLER(query_semaphore);
 DECL_HANDLER(open_semaphore);
@@ -188,6 +215,7 @@ DECL_HANDLER(open_mapping);
 DECL_HANDLER(get_mapping_info);
 DECL_HANDLER(get_mapping_committed_range);
 DECL_HANDLER(add_mapping_committed_range);
+DECL_HANDLER(get_relocated_image);
 DECL_HANDLER(create_snapshot);
 DECL_HANDLER(next_process);
 DECL_HANDLER(next_thread);
@@ -256,6 +284,7 @@ DECL_HANDLER(create_window);
 DECL_HANDLER(destroy_window);
 DECL_HANDLER(get_desktop_window);
 DECL_HANDLER(set_window_owner);
+DECL_HANDLER(get_shared_windows);
 DECL_HANDLER(get_window_info);
 DECL_HANDLER(set_window_info);
 DECL_HANDLER(set_parent);
@@ -350,6 +379,7 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
@@ -361,6 +391,7 @@ DECL_HANDLER(set_cursor);
 DECL_HANDLER(update_rawinput_devices);
 DECL_HANDLER(get_suspend_context);
 DECL_HANDLER(set_suspend_context);
+DECL_HANDLER(get_request_stats);
 
 #ifdef WANT_REQUEST_HANDLERS
 
@@ -402,6 +433,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_release_mutex,
     (req_handler)req_open_mutex,
     (req_handler)req_create_semaphore,
+    (req_handler)req_get_client_sync_section,
     (req_handler)req_release_semaphore,
     (req_handler)req_query_semaphore,
     (req_handler)req_open_semaphore,
@@ -449,6 +481,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_mapping_info,
     (req_handler)req_get_mapping_committed_range,
     (req_handler)req_add_mapping_committed_range,
+    (req_handler)req_get_relocated_image,
     (req_handler)req_create_snapshot,
     (req_handler)req_next_process,
     (req_handler)req_next_thread,
@@ -517,6 +550,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_destroy_window,
     (req_handler)req_get_desktop_window,
     (req_handler)req_set_window_owner,
+    (req_handler)req_get_shared_windows,
     (req_handler)req_get_window_info,
     (req_handler)req_set_window_info,
     (req_handler)req_set_parent,
@@ -611,6 +645,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
@@ -622,6 +657,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_update_rawinput_devices,
     (req_handler)req_get_suspend_context,
     (req_handler)req_set_suspend_context,
+    (req_handler)req_get_request_stats,
 };
 
 C_ASSERT( sizeof(affinity_t) == 8 );
@@ -700,6 +736,7 @@ C_ASSERT( FIELD_OFFSET(struct init_thread_request, entry) == 32 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_request, reply_fd) == 40 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_request, wait_fd) == 44 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_request, cpu) == 48 );
+C_ASSERT( FIELD_OFFSET(struct init_thread_request, reply_shm_fd) == 52 );
 C_ASSERT( sizeof(struct init_thread_request) == 56 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, pid) == 8 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, tid) == 12 );
@@ -707,6 +744,7 @@ C_ASSERT( FIELD_OFFSET(struct init_thread_reply, server_start) == 16 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, info_size) == 24 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, version) == 28 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, all_cpus) == 32 );
+C_ASSERT( FIELD_OFFSET(struct init_thread_reply, reply_shm) == 36 );
 C_ASSERT( sizeof(struct init_thread_reply) == 40 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, exit_code) == 16 );
@@ -834,6 +872,7 @@ C_ASSERT( FIELD_OFFSET(struct create_event_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, manual_reset) == 20 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, initial_state) == 24 );
+C_ASSERT( FIELD_OFFSET(struct create_event_request, client_sync) == 28 );
 C_ASSERT( sizeof(struct create_event_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct create_event_reply, handle) == 8 );
 C_ASSERT( sizeof(struct create_event_reply) == 16 );
@@ -882,9 +921,13 @@ C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, initial) == 20 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, max) == 24 );
+C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, client_sync) == 28 );
 C_ASSERT( sizeof(struct create_semaphore_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, handle) == 8 );
 C_ASSERT( sizeof(struct create_semaphore_reply) == 16 );
+C_ASSERT( sizeof(struct get_client_sync_section_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_client_sync_section_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_client_sync_section_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct release_semaphore_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct release_semaphore_request, count) == 16 );
 C_ASSERT( sizeof(struct release_semaphore_request) == 24 );
@@ -1185,6 +1228,11 @@ C_ASSERT( FIELD_OFFSET(struct add_mapping_committed_range_request, handle) == 12
 C_ASSERT( FIELD_OFFSET(struct add_mapping_committed_range_request, offset) == 16 );
 C_ASSERT( FIELD_OFFSET(struct add_mapping_committed_range_request, size) == 24 );
 C_ASSERT( sizeof(struct add_mapping_committed_range_request) == 32 );
+C_ASSERT( FIELD_OFFSET(struct get_relocated_image_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_relocated_image_request, base) == 16 );
+C_ASSERT( sizeof(struct get_relocated_image_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_relocated_image_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_relocated_image_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_snapshot_request, attributes) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_snapshot_request, flags) == 16 );
 C_ASSERT( sizeof(struct create_snapshot_request) == 24 );
@@ -1395,7 +1443,9 @@ C_ASSERT( FIELD_OFFSET(struct init_atom_table_reply, table) == 8 );
 C_ASSERT( sizeof(struct init_atom_table_reply) == 16 );
 C_ASSERT( sizeof(struct get_msg_queue_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, handle) == 8 );
-C_ASSERT( sizeof(struct get_msg_queue_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, shared) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, shared_offset) == 16 );
+C_ASSERT( sizeof(struct get_msg_queue_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_fd_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_queue_fd_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_mask_request, wake_mask) == 12 );
@@ -1565,6 +1615,9 @@ C_ASSERT( sizeof(struct set_window_owner_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_window_owner_reply, full_owner) == 8 );
 C_ASSERT( FIELD_OFFSET(struct set_window_owner_reply, prev_owner) == 12 );
 C_ASSERT( sizeof(struct set_window_owner_reply) == 16 );
+C_ASSERT( sizeof(struct get_shared_windows_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_shared_windows_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_shared_windows_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_request, handle) == 12 );
 C_ASSERT( sizeof(struct get_window_info_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, full_handle) == 8 );
@@ -2150,6 +2203,9 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
@@ -2200,6 +2256,12 @@ C_ASSERT( sizeof(struct update_rawinput_devices_request) == 16 );
 C_ASSERT( sizeof(struct get_suspend_context_request) == 16 );
 C_ASSERT( sizeof(struct get_suspend_context_reply) == 8 );
 C_ASSERT( sizeof(struct set_suspend_context_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_request_stats_request, pid) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_request_stats_request, reset) == 16 );
+C_ASSERT( sizeof(struct get_request_stats_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_request_stats_reply, process_count) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_request_stats_reply, process_time) == 16 );
+C_ASSERT( sizeof(struct get_request_stats_reply) == 24 );
 
 #endif  /* WANT_REQUEST_HANDLERS */
 
@@ -41,21 +41,25 @@ struct semaphore
     struct object  obj;    /* object header */
     unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    struct client_sync_section *sync; /* section holding the in-process state, if any */
+    unsigned int   sync_index;        /* index of the object in the section */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static struct object_type *semaphore_get_type( struct object *obj );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
+    semaphore_add_queue,           /* add_queue */
     remove_queue,                  /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
@@ -67,7 +71,7 @@ static const struct object_ops semaphore_ops =
     no_lookup_name,                /* lookup_name */
     no_open_file,                  /* open_file */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -89,6 +93,7 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->sync  = NULL;
             if (sd) default_set_sd( &sem->obj, sd, OWNER_SECURITY_INFORMATION|
                                                    GROUP_SECURITY_INFORMATION|
                                                    DACL_SECURITY_INFORMATION|
@@ -98,6 +103,26 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
     return sem;
 }
 
+/* make sure the server object holds the state of an in-process semaphore */
+void promote_semaphore( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    int value;
+
+    if (obj->ops != &semaphore_ops || !sem->sync) return;
+    if ((value = promote_client_sync( sem->sync, sem->sync_index )) >= 0)
+        sem->count = min( value, sem->max );
+}
+
+static struct semaphore *get_semaphore_obj( struct process *process, obj_handle_t handle,
+                                            unsigned int access )
+{
+    struct semaphore *sem = (struct semaphore *)get_handle_obj( process, handle, access, &semaphore_ops );
+
+    if (sem) promote_semaphore( &sem->obj );
+    return sem;
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
@@ -136,6 +161,12 @@ static struct object_type *semaphore_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    promote_semaphore( obj );
+    return add_queue( obj, entry );
+}
+
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
@@ -170,9 +201,17 @@ static int semaphore_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
+    promote_semaphore( obj );
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->sync) free_client_sync( sem->sync, sem->sync_index );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -198,7 +237,12 @@ DECL_HANDLER(create_semaphore)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, sem, req->access, req->attributes );
         else
+        {
             reply->handle = alloc_handle_no_access_check( current->process, sem, req->access, req->attributes );
+            if (reply->handle && req->client_sync && !name.len && !(req->attributes & OBJ_INHERIT))
+                sem->sync = alloc_client_sync( current->process, reply->handle, CLIENT_SYNC_SEMAPHORE,
+                                               req->initial, req->max, &sem->sync_index );
+        }
         release_object( sem );
     }
 
@@ -230,8 +274,7 @@ DECL_HANDLER(release_semaphore)
 {
     struct semaphore *sem;
 
-    if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
-                                                   SEMAPHORE_MODIFY_STATE, &semaphore_ops )))
+    if ((sem = get_semaphore_obj( current->process, req->handle, SEMAPHORE_MODIFY_STATE )))
     {
         release_semaphore( sem, req->count, &reply->prev_count );
         release_object( sem );
@@ -243,8 +286,7 @@ DECL_HANDLER(query_semaphore)
 {
     struct semaphore *sem;
 
-    if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
-                                                   SEMAPHORE_QUERY_STATE, &semaphore_ops )))
+    if ((sem = get_semaphore_obj( current->process, req->handle, SEMAPHORE_QUERY_STATE )))
     {
         reply->current = sem->count;
         reply->max = sem->max;
@@ -188,6 +188,8 @@ static inline void init_thread_structure( struct thread *thread )
     thread->request_fd      = NULL;
     thread->reply_fd        = NULL;
     thread->wait_fd         = NULL;
+    thread->reply_shm       = NULL;
+    thread->job             = NULL;
     thread->state           = RUNNING;
     thread->exit_code       = 0;
     thread->priority        = 0;
@@ -276,6 +278,7 @@ static void cleanup_thread( struct thread *thread )
     if (thread->request_fd) release_object( thread->request_fd );
     if (thread->reply_fd) release_object( thread->reply_fd );
     if (thread->wait_fd) release_object( thread->wait_fd );
+    release_reply_shm( thread );
     free( thread->suspend_context );
     cleanup_clipboard_thread(thread);
     destroy_thread_windows( thread );
@@ -1269,6 +1272,16 @@ DECL_HANDLER(init_thread)
     current->unix_tid = req->unix_tid;
     current->teb      = req->teb;
 
+    if (req->reply_shm_fd != -1)
+    {
+        int shm_fd = thread_get_inflight_fd( current, req->reply_shm_fd );
+        if (shm_fd != -1)
+        {
+            set_reply_shm( current, shm_fd );
+            close( shm_fd );
+        }
+    }
+
     if (!process->peb)  /* first thread, initialize the process too */
     {
         if (!is_cpu_supported( req->cpu )) return;
@@ -1301,6 +1314,7 @@ DECL_HANDLER(init_thread)
     reply->version = SERVER_PROTOCOL_VERSION;
     reply->server_start = server_start_time;
     reply->all_cpus     = supported_cpus & get_prefix_cpu_mask();
+    reply->reply_shm    = (current->reply_shm != NULL);
     return;
 
  error:
@@ -31,6 +31,7 @@ struct thread_apc;
 struct debug_ctx;
 struct debug_event;
 struct msg_queue;
+struct worker_job;
 
 enum run_state
 {
@@ -72,6 +73,8 @@ struct thread
     struct fd             *request_fd;    /* fd for receiving client requests */
     struct fd             *reply_fd;      /* fd to send a reply to a client */
     struct fd             *wait_fd;       /* fd to use to wake a sleeping client */
+    struct reply_shm      *reply_shm;     /* shared area to return replies to the client */
+    struct worker_job     *job;           /* request being handled by a worker thread */
     enum run_state         state;         /* running state */
     int                    exit_code;     /* thread exit code */
     int                    unix_pid;      /* Unix pid of client */
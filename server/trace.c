@@ -823,6 +823,43 @@ static void dump_varargs_properties( const char *prefix, data_size_t size )
     remove_data( size );
 }
 
+static void dump_varargs_completions( const char *prefix, data_size_t size )
+{
+    const completion_data_t *data = cur_data;
+    data_size_t len = size / sizeof(*data);
+
+    fprintf( stderr,"%s{", prefix );
+    while (len > 0)
+    {
+        dump_uint64( "{ckey=", &data->ckey );
+        dump_uint64( ",cvalue=", &data->cvalue );
+        dump_uint64( ",information=", &data->information );
+        fprintf( stderr, ",status=%08x}", data->status );
+        data++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
+static void dump_varargs_request_stats( const char *prefix, data_size_t size )
+{
+    const request_stats_t *stats = cur_data;
+    data_size_t len = size / sizeof(*stats);
+
+    fprintf( stderr,"%s{", prefix );
+    while (len > 0)
+    {
+        fprintf( stderr, "{%s,count=%u", stats->name, stats->count );
+        dump_uint64( ",time=", &stats->time );
+        fprintf( stderr, ",max=%u}", stats->max_time );
+        stats++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
 static void dump_varargs_LUID_AND_ATTRIBUTES( const char *prefix, data_size_t size )
 {
     const LUID_AND_ATTRIBUTES *lat = cur_data;
@@ -1176,6 +1213,7 @@ static void dump_init_thread_request( const struct init_thread_request *req )
     fprintf( stderr, ", reply_fd=%d", req->reply_fd );
     fprintf( stderr, ", wait_fd=%d", req->wait_fd );
     dump_cpu_type( ", cpu=", &req->cpu );
+    fprintf( stderr, ", reply_shm_fd=%d", req->reply_shm_fd );
 }
 
 static void dump_init_thread_reply( const struct init_thread_reply *req )
@@ -1186,6 +1224,7 @@ static void dump_init_thread_reply( const struct init_thread_reply *req )
     fprintf( stderr, ", info_size=%u", req->info_size );
     fprintf( stderr, ", version=%d", req->version );
     fprintf( stderr, ", all_cpus=%08x", req->all_cpus );
+    fprintf( stderr, ", reply_shm=%d", req->reply_shm );
 }
 
 static void dump_terminate_process_request( const struct terminate_process_request *req )
@@ -1419,6 +1458,7 @@ static void dump_create_event_request( const struct create_event_request *req )
     fprintf( stderr, ", attributes=%08x", req->attributes );
     fprintf( stderr, ", manual_reset=%d", req->manual_reset );
     fprintf( stderr, ", initial_state=%d", req->initial_state );
+    fprintf( stderr, ", client_sync=%d", req->client_sync );
     dump_varargs_object_attributes( ", objattr=", cur_size );
 }
 
@@ -1524,6 +1564,7 @@ static void dump_create_semaphore_request( const struct create_semaphore_request
     fprintf( stderr, ", attributes=%08x", req->attributes );
     fprintf( stderr, ", initial=%08x", req->initial );
     fprintf( stderr, ", max=%08x", req->max );
+    fprintf( stderr, ", client_sync=%d", req->client_sync );
     dump_varargs_object_attributes( ", objattr=", cur_size );
 }
 
@@ -1532,6 +1573,15 @@ static void dump_create_semaphore_reply( const struct create_semaphore_reply *re
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_get_client_sync_section_request( const struct get_client_sync_section_request *req )
+{
+}
+
+static void dump_get_client_sync_section_reply( const struct get_client_sync_section_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_release_semaphore_request( const struct release_semaphore_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -2090,6 +2140,17 @@ static void dump_add_mapping_committed_range_request( const struct add_mapping_c
     dump_uint64( ", size=", &req->size );
 }
 
+static void dump_get_relocated_image_request( const struct get_relocated_image_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    dump_uint64( ", base=", &req->base );
+}
+
+static void dump_get_relocated_image_reply( const struct get_relocated_image_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_create_snapshot_request( const struct create_snapshot_request *req )
 {
     fprintf( stderr, " attributes=%08x", req->attributes );
@@ -2530,6 +2591,8 @@ static void dump_get_msg_queue_request( const struct get_msg_queue_request *req
 static void dump_get_msg_queue_reply( const struct get_msg_queue_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shared=%04x", req->shared );
+    fprintf( stderr, ", shared_offset=%u", req->shared_offset );
 }
 
 static void dump_set_queue_fd_request( const struct set_queue_fd_request *req )
@@ -2837,6 +2900,15 @@ static void dump_set_window_owner_reply( const struct set_window_owner_reply *re
     fprintf( stderr, ", prev_owner=%08x", req->prev_owner );
 }
 
+static void dump_get_shared_windows_request( const struct get_shared_windows_request *req )
+{
+}
+
+static void dump_get_shared_windows_reply( const struct get_shared_windows_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_get_window_info_request( const struct get_window_info_request *req )
 {
     fprintf( stderr, " handle=%08x", req->handle );
@@ -3994,6 +4066,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completions( " packets=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4095,6 +4177,19 @@ static void dump_set_suspend_context_request( const struct set_suspend_context_r
     dump_varargs_context( " context=", cur_size );
 }
 
+static void dump_get_request_stats_request( const struct get_request_stats_request *req )
+{
+    fprintf( stderr, " pid=%04x", req->pid );
+    fprintf( stderr, ", reset=%d", req->reset );
+}
+
+static void dump_get_request_stats_reply( const struct get_request_stats_reply *req )
+{
+    fprintf( stderr, " process_count=%08x", req->process_count );
+    dump_timeout( ", process_time=", &req->process_time );
+    dump_varargs_request_stats( ", stats=", cur_size );
+}
+
 static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_new_process_request,
     (dump_func)dump_get_new_process_info_request,
@@ -4131,6 +4226,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_mutex_request,
     (dump_func)dump_open_mutex_request,
     (dump_func)dump_create_semaphore_request,
+    (dump_func)dump_get_client_sync_section_request,
     (dump_func)dump_release_semaphore_request,
     (dump_func)dump_query_semaphore_request,
     (dump_func)dump_open_semaphore_request,
@@ -4178,6 +4274,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_mapping_info_request,
     (dump_func)dump_get_mapping_committed_range_request,
     (dump_func)dump_add_mapping_committed_range_request,
+    (dump_func)dump_get_relocated_image_request,
     (dump_func)dump_create_snapshot_request,
     (dump_func)dump_next_process_request,
     (dump_func)dump_next_thread_request,
@@ -4246,6 +4343,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_destroy_window_request,
     (dump_func)dump_get_desktop_window_request,
     (dump_func)dump_set_window_owner_request,
+    (dump_func)dump_get_shared_windows_request,
     (dump_func)dump_get_window_info_request,
     (dump_func)dump_set_window_info_request,
     (dump_func)dump_set_parent_request,
@@ -4340,6 +4438,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
@@ -4351,6 +4450,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_update_rawinput_devices_request,
     (dump_func)dump_get_suspend_context_request,
     (dump_func)dump_set_suspend_context_request,
+    (dump_func)dump_get_request_stats_request,
 };
 
 static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
@@ -4389,6 +4489,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_mutex_reply,
     (dump_func)dump_open_mutex_reply,
     (dump_func)dump_create_semaphore_reply,
+    (dump_func)dump_get_client_sync_section_reply,
     (dump_func)dump_release_semaphore_reply,
     (dump_func)dump_query_semaphore_reply,
     (dump_func)dump_open_semaphore_reply,
@@ -4436,6 +4537,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_mapping_info_reply,
     (dump_func)dump_get_mapping_committed_range_reply,
     NULL,
+    (dump_func)dump_get_relocated_image_reply,
     (dump_func)dump_create_snapshot_reply,
     (dump_func)dump_next_process_reply,
     (dump_func)dump_next_thread_reply,
@@ -4504,6 +4606,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_get_desktop_window_reply,
     (dump_func)dump_set_window_owner_reply,
+    (dump_func)dump_get_shared_windows_reply,
     (dump_func)dump_get_window_info_reply,
     (dump_func)dump_set_window_info_reply,
     (dump_func)dump_set_parent_reply,
@@ -4598,6 +4701,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
@@ -4609,6 +4713,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_get_suspend_context_reply,
     NULL,
+    (dump_func)dump_get_request_stats_reply,
 };
 
 static const char * const req_names[REQ_NB_REQUESTS] = {
@@ -4647,6 +4752,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "release_mutex",
     "open_mutex",
     "create_semaphore",
+    "get_client_sync_section",
     "release_semaphore",
     "query_semaphore",
     "open_semaphore",
@@ -4694,6 +4800,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_mapping_info",
     "get_mapping_committed_range",
     "add_mapping_committed_range",
+    "get_relocated_image",
     "create_snapshot",
     "next_process",
     "next_thread",
@@ -4762,6 +4869,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "destroy_window",
     "get_desktop_window",
     "set_window_owner",
+    "get_shared_windows",
     "get_window_info",
     "set_window_info",
     "set_parent",
@@ -4856,6 +4964,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",
@@ -4867,6 +4976,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "update_rawinput_devices",
     "get_suspend_context",
     "set_suspend_context",
+    "get_request_stats",
 };
 
 static const struct
@@ -5003,6 +5113,11 @@ static const char *get_status_name( unsigned int status )
     return buffer;
 }
 
+const char *get_request_name( enum request req )
+{
+    return req < REQ_NB_REQUESTS ? req_names[req] : "?";
+}
+
 void trace_request(void)
 {
     enum request req = current->req.request_header.req;
@@ -33,6 +33,8 @@
 #include "winternl.h"
 
 #include "object.h"
+#include "file.h"
+#include "handle.h"
 #include "request.h"
 #include "thread.h"
 #include "process.h"
@@ -124,6 +126,10 @@ static struct window *taskman_window;
 #define WINPTR_TOPMOST   ((struct window *)3L)
 #define WINPTR_NOTOPMOST ((struct window *)4L)
 
+/* window state shared with the clients */
+static struct mapping *shared_windows_mapping;
+static struct window_shm *shared_windows;
+
 /* retrieve a pointer to a window from its handle */
 static inline struct window *get_window( user_handle_t handle )
 {
@@ -138,6 +144,43 @@ static inline int is_desktop_window( const struct window *win )
     return !win->parent;  /* only desktop windows have no parent */
 }
 
+/* get the shared state entry of a window */
+static inline struct window_shm *get_window_shm( user_handle_t handle )
+{
+    if (!shared_windows) return NULL;
+    return &shared_windows[((handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+}
+
+/* copy the window state to the area shared with the clients */
+static void update_window_shm( struct window *win )
+{
+    struct window_shm *shm = get_window_shm( win->handle );
+
+    if (!shm) return;
+    interlocked_xchg_add( &shm->seq, 1 );
+    shm->handle      = win->handle;
+    shm->parent      = win->parent ? win->parent->handle : 0;
+    shm->owner       = win->owner;
+    shm->tid         = win->thread ? get_thread_id( win->thread ) : 0;
+    shm->pid         = win->thread ? get_process_id( win->thread->process ) : 0;
+    shm->style       = win->style;
+    shm->ex_style    = win->ex_style;
+    shm->window_rect = win->window_rect;
+    shm->client_rect = win->client_rect;
+    interlocked_xchg_add( &shm->seq, 1 );
+}
+
+/* mark the shared state entry of a window as free */
+static void clear_window_shm( user_handle_t handle )
+{
+    struct window_shm *shm = get_window_shm( handle );
+
+    if (!shm) return;
+    interlocked_xchg_add( &shm->seq, 1 );
+    shm->handle = 0;
+    interlocked_xchg_add( &shm->seq, 1 );
+}
+
 /* get next window in Z-order list */
 static inline struct window *get_next_window( struct window *win )
 {
@@ -227,6 +270,7 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    update_window_shm( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -401,6 +445,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -527,6 +572,7 @@ static struct window *create_window( struct window *parent, struct window *owner
     }
 
     current->desktop_users++;
+    update_window_shm( win );
     return win;
 
 failed:
@@ -1633,6 +1679,7 @@ static void set_window_pos( struct window *win, struct window *previous,
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    update_window_shm( win );
 
     /* keep children at the same position relative to top right corner when the parent is mirrored */
     if (win->ex_style & WS_EX_LAYOUTRTL)
@@ -1646,6 +1693,7 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->window_rect, new_size - old_size, 0 );
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shm( child );
         }
     }
 
@@ -1842,6 +1890,7 @@ void destroy_window( struct window *win )
         else desktop->msg_window = NULL;
     }
     detach_window_thread( win );
+    clear_window_shm( win->handle );
     if (win->win_region) free_region( win->win_region );
     if (win->update_region) free_region( win->update_region );
     if (win->class) release_class( win->class );
@@ -1933,6 +1982,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -1945,6 +1995,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -1980,6 +2031,28 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
+}
+
+
+/* get a handle to the window state shared with the clients */
+DECL_HANDLER(get_shared_windows)
+{
+    if (!shared_windows_mapping)
+    {
+        user_handle_t handle = 0;
+        struct window *win;
+        void *ptr;
+
+        if (!(shared_windows_mapping = create_shared_mapping( WINDOW_SHM_ENTRIES * sizeof(*shared_windows),
+                                                              &ptr )))
+            return;
+        make_object_static( (struct object *)shared_windows_mapping );
+        shared_windows = ptr;
+        while ((win = next_user_handle( &handle, USER_WINDOW ))) update_window_shm( win );
+    }
+    reply->handle = alloc_handle( current->process, shared_windows_mapping,
+                                  SECTION_QUERY | SECTION_MAP_READ, 0 );
 }
 
 
@@ -2052,6 +2125,7 @@ DECL_HANDLER(set_window_info)
     if (req->flags & SET_WIN_USERDATA) win->user_data = req->user_data;
     if (req->flags & SET_WIN_EXTRA) memcpy( win->extra_bytes + req->extra_offset,
                                             &req->extra_value, req->extra_size );
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE)) update_window_shm( win );
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;